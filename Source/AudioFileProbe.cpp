@@ -0,0 +1,870 @@
+#include "AudioFileProbe.h"
+
+namespace
+{
+    //==========================================================================
+    // Random access over a file that keeps its first block in memory, since
+    // nearly every header we need lives there
+    class HeaderReader
+    {
+    public:
+        explicit HeaderReader(const juce::File& file) : stream(file)
+        {
+            if (!stream.openedOk())
+                return;
+
+            auto headSize = (size_t)juce::jmin(stream.getTotalLength(), (juce::int64)headBytes);
+            head.resize(headSize);
+
+            if (stream.read(head.data(), (int)headSize) == (int)headSize)
+                length = stream.getTotalLength();
+        }
+
+        bool isOpen() const noexcept                { return length > 0; }
+        juce::int64 getLength() const noexcept      { return length; }
+
+        bool read(juce::int64 position, void* dest, size_t numBytes)
+        {
+            if (position < 0 || position + (juce::int64)numBytes > length)
+                return false;
+
+            if (position + (juce::int64)numBytes <= (juce::int64)head.size())
+            {
+                std::memcpy(dest, head.data() + position, numBytes);
+                return true;
+            }
+
+            return stream.setPosition(position) && stream.read(dest, (int)numBytes) == (int)numBytes;
+        }
+
+        std::vector<juce::uint8> readBlock(juce::int64 position, size_t numBytes)
+        {
+            std::vector<juce::uint8> block(numBytes);
+            if (!read(position, block.data(), numBytes))
+                block.clear();
+            return block;
+        }
+
+        bool matches(juce::int64 position, const char* magic)
+        {
+            char buffer[8];
+            auto numBytes = std::strlen(magic);
+            return numBytes <= sizeof(buffer) && read(position, buffer, numBytes) && std::memcmp(buffer, magic, numBytes) == 0;
+        }
+
+    private:
+        static constexpr size_t headBytes = 16384;
+
+        juce::FileInputStream stream;
+        juce::int64 length = 0;
+        std::vector<juce::uint8> head;
+    };
+
+    inline juce::uint32 be32(const juce::uint8* p)  { return juce::ByteOrder::bigEndianInt(p); }
+    inline juce::uint16 be16(const juce::uint8* p)  { return juce::ByteOrder::bigEndianShort(p); }
+    inline juce::uint32 le32(const juce::uint8* p)  { return juce::ByteOrder::littleEndianInt(p); }
+    inline juce::uint16 le16(const juce::uint8* p)  { return juce::ByteOrder::littleEndianShort(p); }
+    inline juce::uint64 le64(const juce::uint8* p)  { return juce::ByteOrder::littleEndianInt64(p); }
+
+    inline bool hasId(const juce::uint8* p, const char* id)  { return std::memcmp(p, id, 4) == 0; }
+
+    inline juce::uint32 synchsafe(const juce::uint8* p)
+    {
+        return ((juce::uint32)(p[0] & 0x7f) << 21) | ((juce::uint32)(p[1] & 0x7f) << 14)
+             | ((juce::uint32)(p[2] & 0x7f) << 7)  |  (juce::uint32)(p[3] & 0x7f);
+    }
+
+    //==========================================================================
+    juce::String fromCodePoints(std::vector<juce::juce_wchar>& chars)
+    {
+        chars.push_back(0);
+        return juce::String(juce::CharPointer_UTF32(chars.data()));
+    }
+
+    juce::String fromLatin1(const juce::uint8* p, size_t size)
+    {
+        std::vector<juce::juce_wchar> chars;
+        for (size_t i = 0; i < size && p[i] != 0; ++i)
+            chars.push_back((juce::juce_wchar)p[i]);
+        return fromCodePoints(chars);
+    }
+
+    juce::String fromUTF16(const juce::uint8* p, size_t size, bool bigEndian)
+    {
+        std::vector<juce::juce_wchar> chars;
+
+        for (size_t i = 0; i + 1 < size; i += 2)
+        {
+            juce::juce_wchar unit = bigEndian ? be16(p + i) : le16(p + i);
+            if (unit == 0)
+                break;
+
+            if (unit >= 0xd800 && unit < 0xdc00 && i + 3 < size)
+            {
+                juce::juce_wchar low = bigEndian ? be16(p + i + 2) : le16(p + i + 2);
+                if (low >= 0xdc00 && low < 0xe000)
+                {
+                    unit = 0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00);
+                    i += 2;
+                }
+            }
+
+            chars.push_back(unit);
+        }
+
+        return fromCodePoints(chars);
+    }
+
+    juce::String fromUTF8OrLatin1(const juce::uint8* p, size_t size)
+    {
+        auto length = (size_t)(std::find(p, p + size, 0) - p);
+        auto text = reinterpret_cast<const char*>(p);
+
+        if (juce::CharPointer_UTF8::isValidString(text, (int)length))
+            return juce::String::fromUTF8(text, (int)length);
+
+        return fromLatin1(p, length);
+    }
+
+    //==========================================================================
+    const char* const id3v1Genres[] =
+    {
+        "Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge", "Hip-Hop",
+        "Jazz", "Metal", "New Age", "Oldies", "Other", "Pop", "R&B", "Rap",
+        "Reggae", "Rock", "Techno", "Industrial", "Alternative", "Ska", "Death Metal", "Pranks",
+        "Soundtrack", "Euro-Techno", "Ambient", "Trip-Hop", "Vocal", "Jazz+Funk", "Fusion", "Trance",
+        "Classical", "Instrumental", "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise",
+        "Alternative Rock", "Bass", "Soul", "Punk", "Space", "Meditative", "Instrumental Pop", "Instrumental Rock",
+        "Ethnic", "Gothic", "Darkwave", "Techno-Industrial", "Electronic", "Pop-Folk", "Eurodance", "Dream",
+        "Southern Rock", "Comedy", "Cult", "Gangsta", "Top 40", "Christian Rap", "Pop/Funk", "Jungle",
+        "Native American", "Cabaret", "New Wave", "Psychedelic", "Rave", "Showtunes", "Trailer", "Lo-Fi",
+        "Tribal", "Acid Punk", "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll", "Hard Rock"
+    };
+
+    constexpr int numId3v1Genres = (int)(sizeof(id3v1Genres) / sizeof(id3v1Genres[0]));
+
+    // ID3 genres may be "(17)", "17" or "(17)Rock"
+    juce::String resolveId3Genre(juce::String genre)
+    {
+        genre = genre.trim();
+
+        if (genre.startsWithChar('('))
+        {
+            auto close = genre.indexOfChar(')');
+            if (close > 0)
+            {
+                auto refinement = genre.substring(close + 1).trim();
+                if (refinement.isNotEmpty())
+                    return refinement;
+
+                genre = genre.substring(1, close);
+            }
+        }
+
+        if (genre.isNotEmpty() && genre.containsOnly("0123456789"))
+        {
+            auto index = genre.getIntValue();
+            if (juce::isPositiveAndBelow(index, numId3v1Genres))
+                return id3v1Genres[index];
+        }
+
+        return genre;
+    }
+
+    // Fields use Vorbis comment names; the first non-empty value wins
+    void applyTag(AudioFileInfo& info, const juce::String& field, const juce::String& text)
+    {
+        auto value = text.trim();
+        if (value.isEmpty())
+            return;
+
+        if (field == "TITLE" && info.title.isEmpty())
+            info.title = value;
+        else if (field == "ARTIST" && info.artist.isEmpty())
+            info.artist = value;
+        else if (field == "GENRE" && info.genre.isEmpty())
+            info.genre = value;
+        else if (field == "TRACKNUMBER" && info.trackNumber == 0)
+            info.trackNumber = juce::jmax(0, value.upToFirstOccurrenceOf("/", false, false).trim().getIntValue());
+    }
+
+    //==========================================================================
+    juce::String decodeId3Text(const juce::uint8* p, size_t size)
+    {
+        if (size < 2)
+            return {};
+
+        auto encoding = p[0];
+        ++p;
+        --size;
+
+        switch (encoding)
+        {
+            case 0:  return fromLatin1(p, size);
+            case 2:  return fromUTF16(p, size, true);
+            case 3:  return juce::String::fromUTF8(reinterpret_cast<const char*>(p),
+                                                   (int)(std::find(p, p + size, 0) - p));
+            case 1:
+            {
+                if (size >= 2 && p[0] == 0xfe && p[1] == 0xff)  return fromUTF16(p + 2, size - 2, true);
+                if (size >= 2 && p[0] == 0xff && p[1] == 0xfe)  return fromUTF16(p + 2, size - 2, false);
+                return fromUTF16(p, size, false);
+            }
+            default: return {};
+        }
+    }
+
+    // Maps the text frames we use onto Vorbis comment names
+    juce::String getId3Field(const juce::uint8* frameId, bool isVersion2)
+    {
+        static const char* const fields[][3] =
+        {
+            { "TIT2", "TT2", "TITLE" },
+            { "TPE1", "TP1", "ARTIST" },
+            { "TCON", "TCO", "GENRE" },
+            { "TRCK", "TRK", "TRACKNUMBER" }
+        };
+
+        for (const auto& field : fields)
+            if (std::memcmp(frameId, isVersion2 ? field[1] : field[0], isVersion2 ? 3 : 4) == 0)
+                return field[2];
+
+        return {};
+    }
+
+    // Returns the size of the tag at position, or 0 if there isn't one
+    juce::int64 parseId3v2(HeaderReader& reader, juce::int64 position, AudioFileInfo& info)
+    {
+        juce::uint8 header[10];
+        if (!reader.read(position, header, sizeof(header)) || std::memcmp(header, "ID3", 3) != 0)
+            return 0;
+
+        auto version = header[3];
+        auto flags = header[5];
+        auto tagSize = (juce::int64)synchsafe(header + 6);
+        auto totalSize = 10 + tagSize + ((flags & 0x10) != 0 ? 10 : 0);
+
+        // Whole-tag unsynchronisation (pre-2.4) is rare enough not to bother with
+        if (version < 2 || version > 4 || (version < 4 && (flags & 0x80) != 0))
+            return totalSize;
+
+        auto pos = position + 10;
+        auto end = pos + tagSize;
+
+        if (version >= 3 && (flags & 0x40) != 0)
+        {
+            juce::uint8 extended[4];
+            if (!reader.read(pos, extended, sizeof(extended)))
+                return totalSize;
+
+            pos += version == 4 ? (juce::int64)synchsafe(extended) : (juce::int64)be32(extended) + 4;
+        }
+
+        auto frameHeaderSize = version == 2 ? 6 : 10;
+
+        while (pos + frameHeaderSize <= end)
+        {
+            juce::uint8 frame[10];
+            if (!reader.read(pos, frame, (size_t)frameHeaderSize) || frame[0] == 0)
+                break; // Padding
+
+            juce::uint32 size = 0;
+            juce::uint16 frameFlags = 0;
+
+            if (version == 2)
+            {
+                size = ((juce::uint32)frame[3] << 16) | ((juce::uint32)frame[4] << 8) | frame[5];
+            }
+            else
+            {
+                size = version == 4 ? synchsafe(frame + 4) : be32(frame + 4);
+                frameFlags = be16(frame + 8);
+            }
+
+            pos += frameHeaderSize;
+            if (size == 0 || pos + size > end)
+                break;
+
+            auto field = getId3Field(frame, version == 2);
+            auto unreadable = version == 4 ? (frameFlags & 0x000c) != 0    // compressed or encrypted
+                                           : (frameFlags & 0x00c0) != 0;
+
+            // Anything bigger than a few KB is a picture or similar, skip it unread
+            if (field.isNotEmpty() && !unreadable && size < 4096)
+            {
+                auto data = reader.readBlock(pos, size);
+                size_t offset = (version == 4 && (frameFlags & 0x0001) != 0) ? 4 : 0; // Data length indicator
+
+                if (data.size() > offset)
+                {
+                    auto text = decodeId3Text(data.data() + offset, data.size() - offset);
+                    applyTag(info, field, field == "GENRE" ? resolveId3Genre(text) : text);
+                }
+            }
+
+            pos += size;
+        }
+
+        return totalSize;
+    }
+
+    bool parseId3v1(HeaderReader& reader, AudioFileInfo& info)
+    {
+        juce::uint8 tag[128];
+        if (reader.getLength() < 128 || !reader.read(reader.getLength() - 128, tag, sizeof(tag))
+             || std::memcmp(tag, "TAG", 3) != 0)
+            return false;
+
+        applyTag(info, "TITLE", fromLatin1(tag + 3, 30));
+        applyTag(info, "ARTIST", fromLatin1(tag + 33, 30));
+
+        if (tag[125] == 0 && tag[126] != 0)
+            applyTag(info, "TRACKNUMBER", juce::String((int)tag[126]));
+
+        if (tag[127] < numId3v1Genres)
+            applyTag(info, "GENRE", id3v1Genres[tag[127]]);
+
+        return true;
+    }
+
+    void parseVorbisComments(const juce::uint8* data, size_t size, AudioFileInfo& info)
+    {
+        size_t pos = 0;
+
+        auto readLength = [&](juce::uint32& value)
+        {
+            if (pos + 4 > size)
+                return false;
+
+            value = le32(data + pos);
+            pos += 4;
+            return value <= size - pos;
+        };
+
+        juce::uint32 vendorLength = 0, numComments = 0;
+        if (!readLength(vendorLength))
+            return;
+
+        pos += vendorLength;
+        if (pos + 4 > size)
+            return;
+
+        numComments = le32(data + pos);
+        pos += 4;
+
+        for (juce::uint32 i = 0; i < numComments; ++i)
+        {
+            juce::uint32 length = 0;
+            if (!readLength(length))
+                return; // Truncated, e.g. by an embedded picture we didn't read
+
+            auto comment = juce::String::fromUTF8(reinterpret_cast<const char*>(data + pos), (int)length);
+            pos += length;
+
+            applyTag(info, comment.upToFirstOccurrenceOf("=", false, false).toUpperCase(),
+                     comment.fromFirstOccurrenceOf("=", false, false));
+        }
+    }
+
+    //==========================================================================
+    void parseRiffInfo(HeaderReader& reader, juce::int64 pos, juce::int64 end, AudioFileInfo& info)
+    {
+        while (pos + 8 <= end)
+        {
+            juce::uint8 header[8];
+            if (!reader.read(pos, header, sizeof(header)))
+                return;
+
+            auto size = le32(header + 4);
+            juce::String field;
+
+            if (hasId(header, "INAM"))                                        field = "TITLE";
+            else if (hasId(header, "IART"))                                   field = "ARTIST";
+            else if (hasId(header, "IGNR"))                                   field = "GENRE";
+            else if (hasId(header, "ITRK") || hasId(header, "IPRT"))          field = "TRACKNUMBER";
+
+            if (field.isNotEmpty() && size > 0 && size < 4096)
+            {
+                auto data = reader.readBlock(pos + 8, size);
+                if (!data.empty())
+                    applyTag(info, field, fromUTF8OrLatin1(data.data(), data.size()));
+            }
+
+            pos += 8 + (juce::int64)size + (size & 1);
+        }
+    }
+
+    bool probeWav(HeaderReader& reader, AudioFileInfo& info)
+    {
+        auto isRF64 = reader.matches(0, "RF64");
+        if (!reader.matches(8, "WAVE"))
+            return false;
+
+        juce::uint16 formatTag = 0, numChannels = 0, blockAlign = 0;
+        juce::uint32 sampleRate = 0, byteRate = 0;
+        juce::uint64 dataSize = 0, ds64DataSize = 0;
+        bool haveFormat = false, haveData = false;
+
+        juce::int64 pos = 12;
+
+        while (pos + 8 <= reader.getLength())
+        {
+            juce::uint8 header[8];
+            if (!reader.read(pos, header, sizeof(header)))
+                break;
+
+            auto chunkSize = (juce::uint64)le32(header + 4);
+            auto body = pos + 8;
+
+            if (hasId(header, "fmt ") && chunkSize >= 16)
+            {
+                juce::uint8 format[16];
+                if (!reader.read(body, format, sizeof(format)))
+                    return false;
+
+                formatTag = le16(format);
+                numChannels = le16(format + 2);
+                sampleRate = le32(format + 4);
+                byteRate = le32(format + 8);
+                blockAlign = le16(format + 12);
+                haveFormat = true;
+            }
+            else if (hasId(header, "ds64") && chunkSize >= 16)
+            {
+                juce::uint8 sizes[16];
+                if (reader.read(body, sizes, sizeof(sizes)))
+                    ds64DataSize = le64(sizes + 8);
+            }
+            else if (hasId(header, "data"))
+            {
+                if (isRF64 && chunkSize == 0xffffffff)
+                    chunkSize = ds64DataSize;
+
+                // A file that is still being written can claim more than it has
+                dataSize = juce::jmin(chunkSize, (juce::uint64)(reader.getLength() - body));
+                haveData = true;
+            }
+            else if (hasId(header, "LIST") && chunkSize >= 4 && reader.matches(body, "INFO"))
+            {
+                parseRiffInfo(reader, body + 4, body + (juce::int64)chunkSize, info);
+            }
+            else if (hasId(header, "id3 ") || hasId(header, "ID3 "))
+            {
+                parseId3v2(reader, body, info);
+            }
+
+            pos = body + (juce::int64)chunkSize + (juce::int64)(chunkSize & 1);
+        }
+
+        if (!haveFormat || !haveData || sampleRate == 0)
+            return false;
+
+        info.sampleRate = sampleRate;
+        info.numChannels = numChannels;
+
+        auto isPCM = formatTag == 1 || formatTag == 3 || formatTag == 0xfffe;
+
+        if (isPCM && blockAlign > 0)
+            info.durationInSeconds = (double)(dataSize / blockAlign) / sampleRate;
+        else if (byteRate > 0)
+            info.durationInSeconds = (double)dataSize / byteRate;
+
+        return info.isValid();
+    }
+
+    //==========================================================================
+    double fromExtended(const juce::uint8* p)
+    {
+        auto exponent = ((p[0] & 0x7f) << 8) | p[1];
+        auto mantissa = juce::ByteOrder::bigEndianInt64(p + 2);
+
+        if (exponent == 0 && mantissa == 0)
+            return 0.0;
+
+        auto value = std::ldexp((double)mantissa, exponent - 16383 - 63);
+        return (p[0] & 0x80) != 0 ? -value : value;
+    }
+
+    bool probeAiff(HeaderReader& reader, AudioFileInfo& info)
+    {
+        if (!reader.matches(8, "AIFF") && !reader.matches(8, "AIFC"))
+            return false;
+
+        juce::uint32 numFrames = 0;
+        bool haveCommon = false;
+
+        juce::int64 pos = 12;
+
+        while (pos + 8 <= reader.getLength())
+        {
+            juce::uint8 header[8];
+            if (!reader.read(pos, header, sizeof(header)))
+                break;
+
+            auto chunkSize = be32(header + 4);
+            auto body = pos + 8;
+
+            if (hasId(header, "COMM") && chunkSize >= 18)
+            {
+                juce::uint8 common[18];
+                if (!reader.read(body, common, sizeof(common)))
+                    return false;
+
+                info.numChannels = be16(common);
+                numFrames = be32(common + 2);
+                info.sampleRate = fromExtended(common + 8);
+                haveCommon = true;
+            }
+            else if ((hasId(header, "NAME") || hasId(header, "AUTH")) && chunkSize > 0 && chunkSize < 4096)
+            {
+                auto data = reader.readBlock(body, chunkSize);
+                if (!data.empty())
+                    applyTag(info, hasId(header, "NAME") ? "TITLE" : "ARTIST", fromUTF8OrLatin1(data.data(), data.size()));
+            }
+            else if (hasId(header, "ID3 "))
+            {
+                parseId3v2(reader, body, info);
+            }
+
+            pos = body + (juce::int64)chunkSize + (chunkSize & 1);
+        }
+
+        if (!haveCommon || info.sampleRate <= 0.0)
+            return false;
+
+        info.durationInSeconds = numFrames / info.sampleRate;
+        return info.isValid();
+    }
+
+    //==========================================================================
+    bool probeFlac(HeaderReader& reader, juce::int64 pos, AudioFileInfo& info)
+    {
+        juce::uint64 totalSamples = 0;
+        bool haveStreamInfo = false, isLast = false;
+
+        pos += 4; // "fLaC"
+
+        while (!isLast && pos + 4 <= reader.getLength())
+        {
+            juce::uint8 header[4];
+            if (!reader.read(pos, header, sizeof(header)))
+                break;
+
+            isLast = (header[0] & 0x80) != 0;
+            auto type = header[0] & 0x7f;
+            auto size = ((juce::uint32)header[1] << 16) | ((juce::uint32)header[2] << 8) | header[3];
+            auto body = pos + 4;
+
+            if (type == 0 && size >= 18)
+            {
+                juce::uint8 streamInfo[18];
+                if (!reader.read(body, streamInfo, sizeof(streamInfo)))
+                    return false;
+
+                info.sampleRate = ((juce::uint32)streamInfo[10] << 12) | ((juce::uint32)streamInfo[11] << 4) | (streamInfo[12] >> 4);
+                info.numChannels = ((streamInfo[12] >> 1) & 7) + 1;
+                totalSamples = ((juce::uint64)(streamInfo[13] & 0x0f) << 32) | be32(streamInfo + 14);
+                haveStreamInfo = true;
+            }
+            else if (type == 4)
+            {
+                auto comments = reader.readBlock(body, juce::jmin((size_t)size, (size_t)65536));
+                parseVorbisComments(comments.data(), comments.size(), info);
+            }
+            else if (type == 127)
+            {
+                return false;
+            }
+
+            pos = body + size;
+        }
+
+        if (!haveStreamInfo || info.sampleRate <= 0.0)
+            return false;
+
+        info.durationInSeconds = (double)totalSamples / info.sampleRate;
+        return info.isValid();
+    }
+
+    //==========================================================================
+    // Reassembles the first packets of the first logical stream. Packets are
+    // truncated to maxPacketBytes, which only ever cuts off embedded pictures.
+    bool readOggPackets(HeaderReader& reader, size_t numPackets, std::vector<std::vector<juce::uint8>>& packets, juce::uint32& serial)
+    {
+        constexpr size_t maxPacketBytes = 65536;
+
+        std::vector<juce::uint8> current;
+        juce::int64 pos = 0;
+        bool firstPage = true;
+
+        while (packets.size() < numPackets && pos + 27 <= reader.getLength())
+        {
+            juce::uint8 header[27], segments[255];
+            if (!reader.read(pos, header, sizeof(header)) || !hasId(header, "OggS"))
+                return false;
+
+            auto numSegments = (size_t)header[26];
+            if (!reader.read(pos + 27, segments, numSegments))
+                return false;
+
+            auto pageSerial = le32(header + 14);
+            if (firstPage)
+            {
+                serial = pageSerial;
+                firstPage = false;
+            }
+
+            auto body = pos + 27 + (juce::int64)numSegments;
+            auto segmentPos = body;
+
+            for (size_t i = 0; i < numSegments; ++i)
+            {
+                auto segmentSize = (size_t)segments[i];
+
+                if (pageSerial == serial && packets.size() < numPackets)
+                {
+                    if (current.size() + segmentSize <= maxPacketBytes)
+                    {
+                        auto oldSize = current.size();
+                        current.resize(oldSize + segmentSize);
+                        if (!reader.read(segmentPos, current.data() + oldSize, segmentSize))
+                            return false;
+                    }
+
+                    if (segmentSize < 255)
+                    {
+                        packets.push_back(std::move(current));
+                        current.clear();
+                    }
+                }
+
+                segmentPos += (juce::int64)segmentSize;
+            }
+
+            pos = segmentPos;
+        }
+
+        return packets.size() >= numPackets;
+    }
+
+    juce::int64 findLastGranule(HeaderReader& reader, juce::uint32 serial)
+    {
+        auto tailSize = (size_t)juce::jmin(reader.getLength(), (juce::int64)65536);
+        auto tail = reader.readBlock(reader.getLength() - (juce::int64)tailSize, tailSize);
+
+        for (auto i = (juce::int64)tail.size() - 27; i >= 0; --i)
+        {
+            auto* page = tail.data() + i;
+            if (!hasId(page, "OggS") || le32(page + 14) != serial)
+                continue;
+
+            // -1 means no packet finishes on this page
+            auto granule = (juce::int64)le64(page + 6);
+            if (granule >= 0)
+                return granule;
+        }
+
+        return -1;
+    }
+
+    bool probeOgg(HeaderReader& reader, AudioFileInfo& info)
+    {
+        std::vector<std::vector<juce::uint8>> packets;
+        juce::uint32 serial = 0;
+
+        if (!readOggPackets(reader, 2, packets, serial))
+            return false;
+
+        const auto& identification = packets[0];
+        const auto& comments = packets[1];
+
+        double granuleRate = 0.0;
+        juce::int64 preSkip = 0;
+
+        if (identification.size() >= 16 && std::memcmp(identification.data(), "\x01vorbis", 7) == 0)
+        {
+            info.numChannels = identification[11];
+            info.sampleRate = le32(identification.data() + 12);
+            granuleRate = info.sampleRate;
+
+            if (comments.size() > 7 && std::memcmp(comments.data(), "\x03vorbis", 7) == 0)
+                parseVorbisComments(comments.data() + 7, comments.size() - 7, info);
+        }
+        else if (identification.size() >= 19 && std::memcmp(identification.data(), "OpusHead", 8) == 0)
+        {
+            // Opus always runs at 48kHz; the header only records the input rate
+            info.numChannels = identification[9];
+            preSkip = le16(identification.data() + 10);
+            info.sampleRate = 48000.0;
+            granuleRate = 48000.0;
+
+            if (comments.size() > 8 && std::memcmp(comments.data(), "OpusTags", 8) == 0)
+                parseVorbisComments(comments.data() + 8, comments.size() - 8, info);
+        }
+        else
+        {
+            return false;
+        }
+
+        auto granule = findLastGranule(reader, serial);
+        if (granule <= preSkip || granuleRate <= 0.0)
+            return false;
+
+        info.durationInSeconds = (double)(granule - preSkip) / granuleRate;
+        return info.isValid();
+    }
+
+    //==========================================================================
+    struct MpegHeader
+    {
+        int sampleRate = 0;
+        int bitrate = 0;            // bits per second
+        int numChannels = 0;
+        int samplesPerFrame = 0;
+        int frameLength = 0;        // bytes
+        int sideInfoSize = 0;
+        bool isLayer3 = false;
+    };
+
+    bool parseMpegHeader(const juce::uint8* p, MpegHeader& header)
+    {
+        if (p[0] != 0xff || (p[1] & 0xe0) != 0xe0)
+            return false;
+
+        auto version = (p[1] >> 3) & 3;         // 0 = 2.5, 1 = reserved, 2 = 2, 3 = 1
+        auto layerBits = (p[1] >> 1) & 3;       // 1 = III, 2 = II, 3 = I
+        auto bitrateIndex = p[2] >> 4;
+        auto rateIndex = (p[2] >> 2) & 3;
+
+        if (version == 1 || layerBits == 0 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3)
+            return false;
+
+        static const int bitrates[5][15] =
+        {
+            { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },   // MPEG-1 layer I
+            { 0, 32, 48, 56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320, 384 },   // MPEG-1 layer II
+            { 0, 32, 40, 48,  56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320 },   // MPEG-1 layer III
+            { 0, 32, 48, 56,  64,  80,  96, 112, 128, 144, 160, 176, 192, 224, 256 },   // MPEG-2/2.5 layer I
+            { 0,  8, 16, 24,  32,  40,  48,  56,  64,  80,  96, 112, 128, 144, 160 }    // MPEG-2/2.5 layers II & III
+        };
+
+        static const int sampleRates[3] = { 44100, 48000, 32000 };
+
+        auto isMpeg1 = version == 3;
+        auto layer = 4 - layerBits;
+        auto table = isMpeg1 ? layer - 1 : (layer == 1 ? 3 : 4);
+
+        header.bitrate = bitrates[table][bitrateIndex] * 1000;
+        header.sampleRate = sampleRates[rateIndex] >> (isMpeg1 ? 0 : (version == 2 ? 1 : 2));
+        header.numChannels = (p[3] >> 6) == 3 ? 1 : 2;
+        header.samplesPerFrame = layer == 1 ? 384 : ((layer == 3 && !isMpeg1) ? 576 : 1152);
+        header.isLayer3 = layer == 3;
+
+        auto padding = (p[2] >> 1) & 1;
+        header.frameLength = layer == 1 ? (12 * header.bitrate / header.sampleRate + padding) * 4
+                                        : header.samplesPerFrame / 8 * header.bitrate / header.sampleRate + padding;
+
+        header.sideInfoSize = isMpeg1 ? (header.numChannels == 1 ? 17 : 32)
+                                      : (header.numChannels == 1 ? 9 : 17);
+
+        return header.frameLength > 4;
+    }
+
+    bool probeMpeg(HeaderReader& reader, juce::int64 audioStart, AudioFileInfo& info)
+    {
+        auto searchSize = (size_t)juce::jmin(reader.getLength() - audioStart, (juce::int64)65536);
+        auto search = reader.readBlock(audioStart, searchSize);
+
+        MpegHeader header;
+        juce::int64 frameStart = -1;
+
+        for (size_t i = 0; i + 4 <= search.size(); ++i)
+        {
+            if (!parseMpegHeader(search.data() + i, header))
+                continue;
+
+            // Insist on a second frame where the first one says it ends, to
+            // avoid locking onto a stray sync pattern
+            MpegHeader next;
+            auto nextPos = i + (size_t)header.frameLength;
+            if (nextPos + 4 <= search.size() && !parseMpegHeader(search.data() + nextPos, next))
+                continue;
+
+            frameStart = audioStart + (juce::int64)i;
+            break;
+        }
+
+        if (frameStart < 0)
+            return false;
+
+        info.sampleRate = header.sampleRate;
+        info.numChannels = header.numChannels;
+
+        auto hasId3v1 = parseId3v1(reader, info);
+
+        // VBR files carry a frame count in a Xing/Info or VBRI header
+        juce::uint32 numFrames = 0;
+        juce::uint8 tag[18];
+
+        if (header.isLayer3 && reader.read(frameStart + 4 + header.sideInfoSize, tag, 12)
+             && (hasId(tag, "Xing") || hasId(tag, "Info")) && (be32(tag + 4) & 1) != 0)
+        {
+            numFrames = be32(tag + 8);
+        }
+        else if (reader.read(frameStart + 36, tag, 18) && hasId(tag, "VBRI"))
+        {
+            numFrames = be32(tag + 14);
+        }
+
+        if (numFrames > 0)
+        {
+            info.durationInSeconds = (double)numFrames * header.samplesPerFrame / header.sampleRate;
+        }
+        else
+        {
+            auto audioEnd = reader.getLength() - (hasId3v1 ? 128 : 0);
+            info.durationInSeconds = (double)(audioEnd - frameStart) * 8.0 / header.bitrate;
+        }
+
+        return info.isValid();
+    }
+}
+
+//==============================================================================
+bool AudioFileProbe::probe(const juce::File& file, AudioFileInfo& info)
+{
+    HeaderReader reader(file);
+    if (!reader.isOpen())
+        return false;
+
+    info = {};
+    bool recognised = false;
+
+    if (reader.matches(0, "RIFF") || reader.matches(0, "RF64"))
+    {
+        recognised = probeWav(reader, info);
+    }
+    else if (reader.matches(0, "FORM"))
+    {
+        recognised = probeAiff(reader, info);
+    }
+    else if (reader.matches(0, "OggS"))
+    {
+        recognised = probeOgg(reader, info);
+    }
+    else
+    {
+        // FLAC or MPEG audio, either of which may sit behind an ID3v2 tag
+        auto audioStart = parseId3v2(reader, 0, info);
+
+        if (reader.matches(audioStart, "fLaC"))
+            recognised = probeFlac(reader, audioStart, info);
+        else if (audioStart > 0 || file.hasFileExtension("mp3;mp2;mpga"))
+            recognised = probeMpeg(reader, audioStart, info);
+    }
+
+    if (!recognised)
+        info = {};
+
+    return recognised;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+struct AudioFileInfo
+{
+    double sampleRate = 0.0;
+    int numChannels = 0;
+    double durationInSeconds = 0.0;
+
+    // Embedded tags, empty/0 when the file has none
+    juce::String title;
+    juce::String artist;
+    juce::String genre;
+    int trackNumber = 0;
+
+    bool isValid() const noexcept   { return sampleRate > 0.0 && numChannels > 0 && durationInSeconds > 0.0; }
+};
+
+//==============================================================================
+/**
+    Reads format information and embedded tags straight from the headers of
+    WAV (RIFF/RF64), AIFF, FLAC, Ogg Vorbis/Opus and MP3 files, without
+    creating an AudioFormatReader.
+
+    Only the structures needed are read: chunk and block headers are walked
+    by seeking, large embedded pictures are skipped, and durations come from
+    header fields (data chunk size, STREAMINFO, the last Ogg page's granule
+    position or the MP3 Xing/VBRI frame count). RIFF LIST/INFO, AIFF NAME/AUTH,
+    ID3v2/ID3v1 and Vorbis comments are used for the tags.
+*/
+struct AudioFileProbe
+{
+    /** Returns false if the format isn't recognised or the headers are broken,
+        in which case the caller should fall back to a full reader.
+    */
+    static bool probe(const juce::File& file, AudioFileInfo& info);
+};
\ No newline at end of file
@@ -15,6 +15,7 @@ juce::ValueTree Recording::toValueTree() const
     vt.setProperty("timestamp", (juce::int64)timestamp.toMilliseconds(), nullptr);
     vt.setProperty("sampleRate", sampleRate, nullptr);
     vt.setProperty("numChannels", numChannels, nullptr);
+    vt.setProperty("fileSize", fileSize, nullptr);
     vt.setProperty("artist", artist, nullptr);
     vt.setProperty("genre", genre, nullptr);
     vt.setProperty("trackNumber", trackNumber, nullptr);
@@ -32,6 +33,7 @@ Recording Recording::fromValueTree(const juce::ValueTree& vt)
     r.durationInSeconds = (double)vt.getProperty("duration");
     r.sampleRate = (double)vt.getProperty("sampleRate");
     r.numChannels = (int)vt.getProperty("numChannels");
+    r.fileSize = (juce::int64)vt.getProperty("fileSize", 0);
     r.timestamp = juce::Time((juce::int64)vt.getProperty("timestamp"));
     
     // Load metadata fields (with defaults for backward compatibility)
@@ -83,6 +85,7 @@ bool AudioRecorder::startLoopbackRecording()
 
     currentRecordingUID = Recording::generateUID();
     currentRecordingFile = recordingsDirectory.getChildFile(currentRecordingUID + ".wav");
+    livePeaks.reset();
     
     // Start the loopback capture
     bool success = loopbackCapture.start([this](const float** channelData, int numChannels, int numFrames, double sampleRate)
@@ -178,6 +181,8 @@ void AudioRecorder::handleIncomingAudioData(const float** channelData, int numCh
         
         audioWriter->writeFromAudioSampleBuffer(buffer, 0, numFrames);
         samplesRecorded += numFrames;
+        
+        livePeaks.addSamples(channelData, numChannels, numFrames, sampleRate);
     }
 }
 
@@ -222,6 +227,7 @@ void AudioRecorder::finalizeRecording()
         newRecording.timestamp = recordingStartTime;
         newRecording.sampleRate = recordingSampleRate.load();
         newRecording.numChannels = recordingChannels.load();
+        newRecording.fileSize = currentRecordingFile.getSize();
         newRecording.tags.add("Loopback");
         newRecording.tags.add("Internal");
         
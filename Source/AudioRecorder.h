@@ -2,6 +2,7 @@
 
 #include <JuceHeader.h>
 #include "LoopbackCapture.h"
+#include "LivePeaks.h"
 
 //==============================================================================
 struct Recording
@@ -14,6 +15,7 @@ struct Recording
     juce::Time timestamp;
     double sampleRate = 0.0;
     int numChannels = 0;
+    juce::int64 fileSize = 0;   // bytes, as read when the file was probed
     
     // Metadata fields
     juce::String artist;
@@ -38,6 +40,9 @@ public:
     void stopRecording();
     bool isRecording() const;
     
+    // Peaks of the current recording so far; pull() them on the message thread
+    LivePeaks& getLivePeaks() noexcept { return livePeaks; }
+    
     // Callbacks
     std::function<void(const juce::String&)> onStatusChanged;
     std::function<void(const Recording&)> onRecordingComplete;
@@ -59,6 +64,7 @@ private:
     std::atomic<int> recordingChannels{ 0 };
     std::atomic<juce::int64> samplesRecorded{ 0 };
     juce::Time recordingStartTime;
+    LivePeaks livePeaks;
     
     juce::AudioFormatManager formatManager;
     juce::File recordingsDirectory;
@@ -0,0 +1,66 @@
+#include "CellTextCache.h"
+
+CellTextCache::CellTextCache(size_t cellsToKeep)
+    : maxCells(juce::jmax((size_t)1, cellsToKeep))
+{
+    lookup.reserve(maxCells);
+}
+
+void CellTextCache::draw(juce::Graphics& g, LibraryRow row, int column, int width, int height,
+                         const std::function<juce::String()>& format)
+{
+    auto key = makeKey(row, column);
+    auto found = lookup.find(key);
+
+    if (found != lookup.end())
+    {
+        cells.splice(cells.begin(), cells, found->second);
+    }
+    else
+    {
+        if (cells.size() >= maxCells)
+        {
+            lookup.erase(cells.back().key);
+            cells.pop_back();
+        }
+
+        cells.emplace_front();
+        cells.front().key = key;
+        cells.front().text = format();
+        lookup[key] = cells.begin();
+    }
+
+    auto& cell = cells.front();
+
+    // Same layout as Graphics::drawText() with ellipses, done once per size
+    if (cell.width != width || cell.height != height)
+    {
+        cell.glyphs.clear();
+        cell.glyphs.addCurtailedLineOfText(font, cell.text, 0.0f, 0.0f, (float)(width - 4), true);
+        cell.glyphs.justifyGlyphs(0, cell.glyphs.getNumGlyphs(), 2.0f, 0.0f, (float)(width - 4), (float)height,
+                                  juce::Justification::centredLeft);
+        cell.width = width;
+        cell.height = height;
+    }
+
+    cell.glyphs.draw(g);
+}
+
+void CellTextCache::invalidate(LibraryRow row)
+{
+    for (int column = 0; column < maxColumns; ++column)
+    {
+        auto found = lookup.find(makeKey(row, column));
+        if (found != lookup.end())
+        {
+            cells.erase(found->second);
+            lookup.erase(found);
+        }
+    }
+}
+
+void CellTextCache::clear()
+{
+    cells.clear();
+    lookup.clear();
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LibraryTypes.h"
+
+//==============================================================================
+/**
+    Formatted and laid-out text for table cells, keyed by library row and
+    column, with least-recently-used eviction.
+
+    A cell is formatted once and its glyphs are laid out once per column
+    width, so repainting or scrolling back over rows costs a glyph draw per
+    cell. Rows are never reused, so an entry stays right until its recording
+    changes, at which point the owner calls invalidate().
+*/
+class CellTextCache
+{
+public:
+    explicit CellTextCache(size_t maxCells = 4096);
+
+    /** Draws the cell's text left-aligned and vertically centred, calling
+        format() to produce it only if the cell isn't cached.
+    */
+    void draw(juce::Graphics& g, LibraryRow row, int column, int width, int height,
+              const std::function<juce::String()>& format);
+
+    void invalidate(LibraryRow row);
+    void clear();
+
+    const juce::Font& getFont() const noexcept      { return font; }
+
+private:
+    struct Cell
+    {
+        juce::uint64 key = 0;
+        juce::String text;
+        juce::GlyphArrangement glyphs;
+        int width = -1, height = -1;
+    };
+
+    static juce::uint64 makeKey(LibraryRow row, int column) noexcept
+    {
+        return ((juce::uint64)row << 8) | (juce::uint64)(column & 0xff);
+    }
+
+    std::list<Cell> cells;     // most recently drawn first
+    std::unordered_map<juce::uint64, std::list<Cell>::iterator> lookup;
+    size_t maxCells;
+    juce::Font font { juce::FontOptions(14.0f) };
+
+    static constexpr int maxColumns = 16;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CellTextCache)
+};
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "DecodedBlockCache.h"
+
+DecodedBlockCache::DecodedBlockCache(size_t memoryBudgetBytes)
+    : memoryBudget(memoryBudgetBytes)
+{
+    formatManager.registerBasicFormats();
+}
+
+DecodedBlockCache::~DecodedBlockCache() = default;
+
+std::unique_ptr<DecodedBlockCache::Source> DecodedBlockCache::open(const juce::File& file)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader;
+
+    {
+        std::lock_guard<std::mutex> sl(formatLock);
+        reader.reset(formatManager.createReaderFor(file));
+    }
+
+    if (reader == nullptr || reader->sampleRate <= 0.0 || reader->numChannels == 0)
+        return nullptr;
+
+    // The same file, unchanged, shares its blocks whoever opens it
+    auto fingerprint = (juce::uint64)file.getFullPathName().hashCode64();
+    fingerprint = fingerprint * 31 + (juce::uint64)file.getSize();
+    fingerprint = fingerprint * 31 + (juce::uint64)file.getLastModificationTime().toMilliseconds();
+
+    return std::unique_ptr<Source>(new Source(*this, std::move(reader), fingerprint));
+}
+
+void DecodedBlockCache::setMemoryBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> sl(lock);
+    memoryBudget = bytes;
+    evict(0);
+}
+
+size_t DecodedBlockCache::getMemoryBudget() const
+{
+    std::lock_guard<std::mutex> sl(lock);
+    return memoryBudget;
+}
+
+size_t DecodedBlockCache::getMemoryUsed() const
+{
+    std::lock_guard<std::mutex> sl(lock);
+    return memoryUsed;
+}
+
+size_t DecodedBlockCache::getBytes(const Block& block) noexcept
+{
+    return sizeof(Block) + (size_t)block.audio.getNumChannels() * (size_t)block.getNumFrames() * sizeof(float);
+}
+
+//==============================================================================
+DecodedBlockCache::BlockPtr DecodedBlockCache::find(const Key& key)
+{
+    std::lock_guard<std::mutex> sl(lock);
+
+    auto it = index.find(key);
+    if (it == index.end())
+        return nullptr;
+
+    auto& entry = entries[it->second];
+    entry.referenced = true;
+    return entry.block;
+}
+
+DecodedBlockCache::BlockPtr DecodedBlockCache::insert(const Key& key, BlockPtr block)
+{
+    std::lock_guard<std::mutex> sl(lock);
+
+    // Someone else decoded it while we were
+    auto existing = index.find(key);
+    if (existing != index.end())
+        return entries[existing->second].block;
+
+    auto bytes = getBytes(*block);
+    evict(bytes);
+
+    size_t slot;
+
+    if (!freeEntries.empty())
+    {
+        slot = freeEntries.back();
+        freeEntries.pop_back();
+    }
+    else
+    {
+        slot = entries.size();
+        entries.emplace_back();
+    }
+
+    auto& entry = entries[slot];
+    entry.key = key;
+    entry.block = block;
+    entry.bytes = bytes;
+    entry.referenced = false;   // earns its second chance by being read again
+
+    index[key] = slot;
+    memoryUsed += bytes;
+    return block;
+}
+
+void DecodedBlockCache::evict(size_t bytesNeeded)
+{
+    // Two full turns clear every reference bit; past that, everything left is pinned
+    auto stepsLeft = entries.size() * 2;
+
+    while (memoryUsed + bytesNeeded > memoryBudget && stepsLeft-- > 0)
+    {
+        hand = (hand + 1) % entries.size();
+        auto& entry = entries[hand];
+
+        if (entry.block == nullptr || entry.block.use_count() > 1)
+            continue;
+
+        if (entry.referenced)
+        {
+            entry.referenced = false;
+            continue;
+        }
+
+        index.erase(entry.key);
+        memoryUsed -= entry.bytes;
+        entry = {};
+        freeEntries.push_back(hand);
+    }
+}
+
+//==============================================================================
+DecodedBlockCache::Source::Source(DecodedBlockCache& owner, std::unique_ptr<juce::AudioFormatReader> r, juce::uint64 fp)
+    : cache(owner),
+      reader(std::move(r)),
+      fingerprint(fp),
+      sampleRate(reader->sampleRate),
+      numChannels((int)reader->numChannels),
+      lengthInSamples(reader->lengthInSamples)
+{
+}
+
+DecodedBlockCache::Source::~Source() = default;
+
+DecodedBlockCache::BlockPtr DecodedBlockCache::Source::getBlock(juce::int64 blockIndex)
+{
+    if (blockIndex < 0 || blockIndex >= getNumBlocks())
+        return nullptr;
+
+    if (lastBlock != nullptr && lastBlock->startSample == blockIndex * framesPerBlock)
+        return lastBlock;
+
+    Key key { fingerprint, blockIndex };
+
+    if (auto block = cache.find(key))
+        return lastBlock = block;
+
+    auto startSample = blockIndex * framesPerBlock;
+    auto numFrames = (int)juce::jmin((juce::int64)framesPerBlock, lengthInSamples - startSample);
+
+    auto block = std::make_shared<Block>();
+    block->audio.setSize(numChannels, numFrames);
+    block->startSample = startSample;
+
+    if (!reader->read(&block->audio, 0, numFrames, startSample, true, true))
+        return nullptr;
+
+    return lastBlock = cache.insert(key, std::move(block));
+}
+
+bool DecodedBlockCache::Source::read(juce::AudioBuffer<float>& dest, int destStartSample, int numSamples, juce::int64 startSample)
+{
+    auto ok = true;
+
+    while (numSamples > 0)
+    {
+        BlockPtr block;
+        int offset = 0, numToCopy = numSamples;
+
+        if (startSample < 0)
+        {
+            numToCopy = (int)juce::jmin((juce::int64)numSamples, -startSample);
+        }
+        else if (startSample < lengthInSamples)
+        {
+            auto blockIndex = startSample / framesPerBlock;
+            offset = (int)(startSample - blockIndex * framesPerBlock);
+            numToCopy = juce::jmin(numSamples, framesPerBlock - offset);
+
+            block = getBlock(blockIndex);
+            ok = ok && block != nullptr;
+
+            if (block != nullptr)
+                numToCopy = juce::jmin(numToCopy, block->getNumFrames() - offset);
+        }
+
+        for (int c = 0; c < dest.getNumChannels(); ++c)
+        {
+            if (block != nullptr && c < numChannels)
+                dest.copyFrom(c, destStartSample, block->audio, c, offset, numToCopy);
+            else
+                dest.clear(c, destStartSample, numToCopy);
+        }
+
+        destStartSample += numToCopy;
+        startSample += numToCopy;
+        numSamples -= numToCopy;
+    }
+
+    return ok;
+}
\ No newline at end of file
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Decoded PCM shared by everything that reads audio files.
+
+    Files are decoded in fixed-size blocks of framesPerBlock frames, which
+    are kept in memory keyed by the file's fingerprint (path, size and
+    modification time) and block index, up to a memory budget. Blocks are
+    handed out as shared pointers to immutable buffers, so any number of
+    readers can use the same decode without copying; a block is pinned for
+    as long as someone holds it and is never evicted while pinned.
+
+    Eviction uses the CLOCK algorithm. A block only gets its second chance
+    once it has been read again after being decoded, so a single pass over a
+    long file (building peaks, say) can't push out the blocks that are being
+    played.
+*/
+class DecodedBlockCache
+{
+public:
+    static constexpr int framesPerBlock = 1 << 15;
+    static constexpr size_t defaultMemoryBudget = (size_t)256 << 20;
+
+    explicit DecodedBlockCache(size_t memoryBudgetBytes = defaultMemoryBudget);
+    ~DecodedBlockCache();
+
+    struct Block
+    {
+        juce::AudioBuffer<float> audio;     // every channel of the file, numFrames long
+        juce::int64 startSample = 0;
+
+        int getNumFrames() const noexcept   { return audio.getNumSamples(); }
+    };
+
+    using BlockPtr = std::shared_ptr<const Block>;
+
+    //==============================================================================
+    /**
+        One open file. A Source is meant to be used by one thread at a time,
+        but the blocks it returns can be shared freely.
+    */
+    class Source
+    {
+    public:
+        ~Source();
+
+        double getSampleRate() const noexcept           { return sampleRate; }
+        int getNumChannels() const noexcept             { return numChannels; }
+        juce::int64 getLengthInSamples() const noexcept { return lengthInSamples; }
+        juce::int64 getNumBlocks() const noexcept       { return (lengthInSamples + framesPerBlock - 1) / framesPerBlock; }
+
+        // Returns the block from the cache, decoding it on a miss; null if it can't be read
+        BlockPtr getBlock(juce::int64 index);
+
+        /** Copies samples into dest, for readers that need them contiguous.
+            Missing channels and anything past the end of the file are cleared.
+        */
+        bool read(juce::AudioBuffer<float>& dest, int destStartSample, int numSamples, juce::int64 startSample);
+
+    private:
+        friend class DecodedBlockCache;
+        Source(DecodedBlockCache& owner, std::unique_ptr<juce::AudioFormatReader> reader, juce::uint64 fingerprint);
+
+        DecodedBlockCache& cache;
+        std::unique_ptr<juce::AudioFormatReader> reader;
+        juce::uint64 fingerprint;
+        double sampleRate;
+        int numChannels;
+        juce::int64 lengthInSamples;
+        BlockPtr lastBlock;         // pinned, so sequential reads don't touch the cache lock
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Source)
+    };
+
+    // Any thread. Returns null if the file can't be opened as audio.
+    std::unique_ptr<Source> open(const juce::File& file);
+
+    void setMemoryBudget(size_t bytes);
+    size_t getMemoryBudget() const;
+    size_t getMemoryUsed() const;
+
+private:
+    struct Key
+    {
+        juce::uint64 fingerprint;
+        juce::int64 index;
+
+        bool operator==(const Key& other) const noexcept   { return fingerprint == other.fingerprint && index == other.index; }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const noexcept
+        {
+            return std::hash<juce::uint64>()(key.fingerprint ^ ((juce::uint64)key.index * 0x9e3779b97f4a7c15ull));
+        }
+    };
+
+    struct Entry
+    {
+        Key key;
+        BlockPtr block;             // null for a free entry
+        size_t bytes = 0;
+        bool referenced = false;
+    };
+
+    BlockPtr find(const Key& key);
+    BlockPtr insert(const Key& key, BlockPtr block);
+    void evict(size_t bytesNeeded);
+
+    static size_t getBytes(const Block& block) noexcept;
+
+    mutable std::mutex lock;
+    std::vector<Entry> entries;             // the clock
+    std::vector<size_t> freeEntries;
+    std::unordered_map<Key, size_t, KeyHash> index;
+    size_t hand = 0;
+    size_t memoryBudget;
+    size_t memoryUsed = 0;
+
+    std::mutex formatLock;
+    juce::AudioFormatManager formatManager;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DecodedBlockCache)
+};
\ No newline at end of file
@@ -0,0 +1,310 @@
+#include "FuzzyIndex.h"
+#include "TextIndex.h"
+
+namespace
+{
+    const float fieldWeights[FuzzyIndex::numFields] = { 3.0f, 2.0f, 1.5f };
+
+    // Match quality by kind: exact, prefix, one edit, two edits
+    constexpr float exactMatch = 1.0f;
+    constexpr float prefixMatch = 0.8f;
+    constexpr float distanceMatch[] = { 1.0f, 0.6f, 0.35f };
+
+    // Bonus for a recording made today, halving every 90 days
+    constexpr float recencyBonus = 0.5f;
+    constexpr double recencyHalfLifeDays = 90.0;
+}
+
+//==============================================================================
+std::vector<std::string> FuzzyIndex::splitWords(const juce::String& text)
+{
+    std::vector<std::string> words;
+    auto folded = TextIndex::fold(text);
+
+    // Anything outside ASCII is kept as part of a word, so UTF-8 sequences stay whole
+    auto isWordByte = [](char c) { return (juce::uint8)c >= 0x80 || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'); };
+
+    for (size_t i = 0; i < folded.size();)
+    {
+        while (i < folded.size() && !isWordByte(folded[i]))
+            ++i;
+
+        auto start = i;
+
+        while (i < folded.size() && isWordByte(folded[i]))
+            ++i;
+
+        if (i - start >= 2)
+            words.push_back(folded.substr(start, i - start));
+    }
+
+    return words;
+}
+
+std::vector<FuzzyIndex::Bigram> FuzzyIndex::extractBigrams(const std::string& word)
+{
+    // Padded with a 0 at each end so that the first and last letters count too
+    std::vector<Bigram> bigrams;
+    bigrams.reserve(word.size() + 1);
+
+    juce::uint8 previous = 0;
+
+    for (auto c : word)
+    {
+        bigrams.push_back((Bigram)((previous << 8) | (juce::uint8)c));
+        previous = (juce::uint8)c;
+    }
+
+    bigrams.push_back((Bigram)(previous << 8));
+
+    std::sort(bigrams.begin(), bigrams.end());
+    bigrams.erase(std::unique(bigrams.begin(), bigrams.end()), bigrams.end());
+    return bigrams;
+}
+
+int FuzzyIndex::getMaxDistance(size_t wordLength) noexcept
+{
+    if (wordLength <= 2)
+        return 0;
+
+    return wordLength <= 4 ? 1 : 2;
+}
+
+int FuzzyIndex::getDistance(const std::string& a, const std::string& b, int maxDistance)
+{
+    auto n = a.size();
+    auto m = b.size();
+
+    if ((int)(n > m ? n - m : m - n) > maxDistance)
+        return maxDistance + 1;
+
+    std::vector<int> previous2(m + 1), previous(m + 1), current(m + 1);
+
+    for (size_t j = 0; j <= m; ++j)
+        previous[j] = (int)j;
+
+    for (size_t i = 1; i <= n; ++i)
+    {
+        current[0] = (int)i;
+        auto rowMinimum = current[0];
+
+        for (size_t j = 1; j <= m; ++j)
+        {
+            auto cost = a[i - 1] == b[j - 1] ? 0 : 1;
+            auto d = std::min({ previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost });
+
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+                d = std::min(d, previous2[j - 2] + 1);
+
+            current[j] = d;
+            rowMinimum = std::min(rowMinimum, d);
+        }
+
+        if (rowMinimum > maxDistance)
+            return maxDistance + 1;
+
+        std::swap(previous2, previous);
+        std::swap(previous, current);
+    }
+
+    return std::min(previous[m], maxDistance + 1);
+}
+
+//==============================================================================
+FuzzyIndex::TermId FuzzyIndex::getOrAddTerm(const std::string& word)
+{
+    auto existing = termIds.find(word);
+    if (existing != termIds.end())
+        return existing->second;
+
+    // Words stay in the vocabulary once seen; unused ones simply have no postings
+    auto id = (TermId)terms.size();
+    terms.push_back({ word, {} });
+    termIds.emplace(word, id);
+
+    for (auto bigram : extractBigrams(word))
+        termsByBigram[bigram].push_back(id);
+
+    return id;
+}
+
+void FuzzyIndex::add(LibraryRow row, const Recording& recording)
+{
+    if (row >= rows.size())
+        rows.resize((size_t)row + 1);
+
+    auto& entry = rows[row];
+    if (entry.live)
+        return;
+
+    auto addWords = [this, &entry](const juce::String& text, Field field)
+    {
+        for (const auto& word : splitWords(text))
+            entry.terms.emplace_back(getOrAddTerm(word), (juce::uint8)field);
+    };
+
+    addWords(recording.name, nameField);
+    addWords(recording.artist, artistField);
+
+    for (const auto& tag : recording.tags)
+        addWords(tag, tagsField);
+
+    std::sort(entry.terms.begin(), entry.terms.end());
+    entry.terms.erase(std::unique(entry.terms.begin(), entry.terms.end()), entry.terms.end());
+
+    for (const auto& [term, field] : entry.terms)
+        terms[term].postings.push_back({ row, field });
+
+    entry.timestamp = recording.timestamp.toMilliseconds();
+    entry.live = true;
+}
+
+void FuzzyIndex::update(LibraryRow row, const Recording& recording)
+{
+    remove(row);
+    add(row, recording);
+}
+
+void FuzzyIndex::remove(LibraryRow row)
+{
+    if (row >= rows.size() || !rows[row].live)
+        return;
+
+    auto& entry = rows[row];
+
+    for (const auto& [term, field] : entry.terms)
+    {
+        auto& postings = terms[term].postings;
+        auto found = std::find_if(postings.begin(), postings.end(),
+                                  [row, f = field](const Posting& p) { return p.row == row && p.field == f; });
+
+        if (found != postings.end())
+        {
+            *found = postings.back();
+            postings.pop_back();
+        }
+    }
+
+    entry = {};
+}
+
+void FuzzyIndex::clear()
+{
+    termIds.clear();
+    terms.clear();
+    termsByBigram.clear();
+    rows.clear();
+}
+
+//==============================================================================
+std::unordered_map<FuzzyIndex::TermId, float> FuzzyIndex::findTerms(const std::string& word) const
+{
+    std::unordered_map<TermId, float> found;
+
+    auto consider = [&found](TermId id, float quality)
+    {
+        auto& best = found[id];
+        best = std::max(best, quality);
+    };
+
+    // Exact and prefix matches come straight out of the ordered vocabulary
+    size_t expansions = 0;
+
+    for (auto it = termIds.lower_bound(word); it != termIds.end() && expansions < maxPrefixExpansions; ++it, ++expansions)
+    {
+        if (it->first.compare(0, word.size(), word) != 0)
+            break;
+
+        consider(it->second, it->first.size() == word.size() ? exactMatch : prefixMatch);
+    }
+
+    auto maxDistance = getMaxDistance(word.size());
+    if (maxDistance == 0)
+        return found;
+
+    // An edit changes at most three of the word's bigrams (a transposition), so a
+    // vocabulary word needs this many in common to be within range
+    auto queryBigrams = extractBigrams(word);
+    auto required = (int)queryBigrams.size() - 3 * maxDistance;
+
+    std::unordered_map<TermId, int> shared;
+
+    for (auto bigram : queryBigrams)
+    {
+        auto list = termsByBigram.find(bigram);
+        if (list != termsByBigram.end())
+            for (auto id : list->second)
+                ++shared[id];
+    }
+
+    for (const auto& [id, count] : shared)
+    {
+        if (count < required)
+            continue;
+
+        auto distance = getDistance(word, terms[id].text, maxDistance);
+        if (distance <= maxDistance)
+            consider(id, distanceMatch[distance]);
+    }
+
+    return found;
+}
+
+std::vector<FuzzyIndex::Match> FuzzyIndex::search(const juce::String& query, size_t maxResults, juce::int64 now) const
+{
+    auto words = splitWords(query);
+    if (words.empty())
+        return {};
+
+    // Running score per row, only kept while the row has matched every word so far
+    std::unordered_map<LibraryRow, float> scores;
+
+    for (size_t w = 0; w < words.size(); ++w)
+    {
+        std::unordered_map<LibraryRow, float> wordScores;
+
+        for (const auto& [id, quality] : findTerms(words[w]))
+        {
+            for (const auto& posting : terms[id].postings)
+            {
+                if (w > 0 && scores.count(posting.row) == 0)
+                    continue;
+
+                auto& best = wordScores[posting.row];
+                best = std::max(best, quality * fieldWeights[posting.field]);
+            }
+        }
+
+        if (w > 0)
+            for (auto& [row, score] : wordScores)
+                score += scores[row];
+
+        scores = std::move(wordScores);
+
+        if (scores.empty())
+            return {};
+    }
+
+    std::vector<Match> matches;
+    matches.reserve(scores.size());
+
+    for (const auto& [row, score] : scores)
+    {
+        auto ageInDays = (double)juce::jmax((juce::int64)0, now - rows[row].timestamp) / 86400000.0;
+        matches.push_back({ row, score + recencyBonus * (float)std::exp2(-ageInDays / recencyHalfLifeDays) });
+    }
+
+    auto better = [](const Match& a, const Match& b) { return a.score != b.score ? a.score > b.score : a.row < b.row; };
+
+    if (matches.size() > maxResults)
+    {
+        std::partial_sort(matches.begin(), matches.begin() + (std::ptrdiff_t)maxResults, matches.end(), better);
+        matches.resize(maxResults);
+    }
+    else
+    {
+        std::sort(matches.begin(), matches.end(), better);
+    }
+
+    return matches;
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioRecorder.h"
+#include "LibraryTypes.h"
+
+//==============================================================================
+/**
+    Typo-tolerant word index over recording names, artists and tags.
+
+    Every distinct folded word is stored once in a vocabulary, with the rows
+    (and fields) it occurs in. Each vocabulary word is also listed under its
+    bigrams (padded at both ends), so a query word only computes an edit
+    distance against the words that share enough bigrams with it to possibly
+    be within range, rather than against the whole vocabulary.
+
+    Query words match exactly, as a prefix, or within an edit distance of 1
+    (words of up to 4 characters) or 2, counting adjacent transpositions as
+    one edit. Rows must match every query word and are ranked by how well and
+    in which field each word matched, plus a bonus for recent recordings.
+*/
+class FuzzyIndex
+{
+public:
+    enum Field
+    {
+        nameField = 0,
+        artistField,
+        tagsField,
+        numFields
+    };
+
+    struct Match
+    {
+        LibraryRow row;
+        float score;
+    };
+
+    FuzzyIndex() = default;
+
+    void add(LibraryRow row, const Recording& recording);
+    void update(LibraryRow row, const Recording& recording);
+    void remove(LibraryRow row);
+    void clear();
+
+    // Best match first; now is used for the recency bonus (milliseconds since the epoch)
+    std::vector<Match> search(const juce::String& query, size_t maxResults, juce::int64 now) const;
+
+    // Optimal string alignment distance, or maxDistance + 1 once it's known to be larger
+    static int getDistance(const std::string& a, const std::string& b, int maxDistance);
+
+private:
+    using TermId = juce::uint32;
+    using Bigram = juce::uint16;
+
+    struct Posting
+    {
+        LibraryRow row;
+        juce::uint8 field;
+    };
+
+    struct Term
+    {
+        std::string text;
+        std::vector<Posting> postings;
+    };
+
+    struct RowTerms
+    {
+        std::vector<std::pair<TermId, juce::uint8>> terms;
+        juce::int64 timestamp = 0;
+        bool live = false;
+    };
+
+    static std::vector<std::string> splitWords(const juce::String& text);
+    static std::vector<Bigram> extractBigrams(const std::string& word);
+    static int getMaxDistance(size_t wordLength) noexcept;
+
+    TermId getOrAddTerm(const std::string& word);
+    std::unordered_map<TermId, float> findTerms(const std::string& word) const;
+
+    std::map<std::string, TermId> termIds;      // ordered, for prefix lookups
+    std::vector<Term> terms;
+    std::unordered_map<Bigram, std::vector<TermId>> termsByBigram;
+    std::vector<RowTerms> rows;
+
+    static constexpr size_t maxPrefixExpansions = 64;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FuzzyIndex)
+};
\ No newline at end of file
@@ -0,0 +1,339 @@
+#include "ImportPipeline.h"
+#include "LibraryManager.h"
+
+//==============================================================================
+juce::String ImportProgress::describe() const
+{
+    juce::String text;
+
+    if (finished)
+    {
+        if (filesFound == 0)
+            return cancelled ? "Import cancelled" : "No audio files found";
+
+        text << (cancelled ? "Import cancelled: " : "Import finished: ")
+             << filesImported << " imported";
+
+        if (filesSkipped > 0)
+            text << ", " << filesSkipped << " already in library";
+        if (filesFailed > 0)
+            text << ", " << filesFailed << " failed";
+
+        return text;
+    }
+
+    if (!enumerationFinished && filesQueued == 0)
+        return "Scanning for audio files... " + juce::String(filesFound) + " found";
+
+    text << "Importing " << filesProbed << " of " << filesQueued << (enumerationFinished ? "" : "+")
+         << " files (" << juce::roundToInt(filesPerSecond) << " files/s";
+
+    if (secondsRemaining >= 0.0)
+    {
+        auto seconds = juce::roundToInt(secondsRemaining);
+        text << ", " << seconds / 60 << ":" << juce::String(seconds % 60).paddedLeft('0', 2) << " left";
+    }
+
+    return text + ")";
+}
+
+//==============================================================================
+class ImportPipeline::ProbeWorker : public juce::ThreadPoolJob
+{
+public:
+    explicit ProbeWorker(ImportPipeline& owner) : ThreadPoolJob("Import probe"), pipeline(owner)
+    {
+        formatManager.registerBasicFormats();
+    }
+
+    JobStatus runJob() override
+    {
+        juce::File file;
+
+        while (!shouldExit() && pipeline.dequeue(file))
+            pipeline.addResult(probe(file));
+
+        --pipeline.activeWorkers;
+        return jobHasFinished;
+    }
+
+private:
+    ProbeResult probe(const juce::File& source)
+    {
+        ProbeResult result;
+        result.file = source;
+
+        auto file = source;
+
+        if (pipeline.copyToLibrary)
+        {
+            file = pipeline.recordingsDirectory.getChildFile(source.getFileName());
+            if (!source.copyFileTo(file))
+            {
+                result.error = "Couldn't copy the file into the library folder";
+                return result;
+            }
+        }
+
+        result.recording = LibraryManager::createRecordingFromFile(file, formatManager);
+
+        if (result.recording.durationInSeconds <= 0)
+            result.error = "Not a readable audio file";
+
+        return result;
+    }
+
+    ImportPipeline& pipeline;
+    juce::AudioFormatManager formatManager; // One each, so workers never share reader state
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProbeWorker)
+};
+
+//==============================================================================
+ImportPipeline::ImportPipeline(LibraryManager& libraryToImportInto)
+    : Thread("Import enumerator"),
+      library(libraryToImportInto),
+      workers(juce::jlimit(2, 8, juce::SystemStats::getNumCpus())),
+      recordingsDirectory(libraryToImportInto.getRecordingsDirectory())
+{
+}
+
+ImportPipeline::~ImportPipeline()
+{
+    if (importing)
+    {
+        cancel();
+        stopTimer();
+        stopWorkers();
+    }
+}
+
+bool ImportPipeline::start(const juce::Array<juce::File>& filesOrFolders, bool recursive, bool copyFilesToLibrary)
+{
+    if (importing)
+        return false;
+
+    roots = filesOrFolders;
+    recursiveImport = recursive;
+    copyToLibrary = copyFilesToLibrary;
+    knownFiles = library.getKnownPathKeys();
+
+    queue.clear();
+    results.clear();
+    errors.clear();
+    enumerationDone = false;
+    cancelled = false;
+    filesFound = filesQueued = filesProbed = filesSkipped = 0;
+    filesImported = filesFailed = 0;
+
+    importing = true;
+    startTime = lastCommitTime = juce::Time::getMillisecondCounter();
+
+    auto numWorkers = workers.getNumThreads();
+    activeWorkers = numWorkers;
+
+    for (int i = 0; i < numWorkers; ++i)
+        workers.addJob(new ProbeWorker(*this), true);
+
+    startThread();
+    startTimer(progressIntervalMs);
+    return true;
+}
+
+void ImportPipeline::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+        cancelled = true;
+        queue.clear();
+    }
+
+    queueNotEmpty.notify_all();
+    queueNotFull.notify_all();
+    signalThreadShouldExit();
+}
+
+ImportProgress ImportPipeline::getProgress() const
+{
+    ImportProgress progress;
+    progress.filesFound = filesFound;
+    progress.filesQueued = filesQueued;
+    progress.filesProbed = filesProbed;
+    progress.filesImported = filesImported;
+    progress.filesSkipped = filesSkipped;
+    progress.filesFailed = filesFailed;
+    progress.enumerationFinished = enumerationDone;
+    progress.finished = !importing;
+    progress.cancelled = cancelled;
+
+    progress.elapsedSeconds = (juce::Time::getMillisecondCounter() - startTime) / 1000.0;
+
+    if (progress.elapsedSeconds > 0.0)
+        progress.filesPerSecond = progress.filesProbed / progress.elapsedSeconds;
+
+    if (progress.enumerationFinished && progress.filesPerSecond > 0.0)
+        progress.secondsRemaining = (progress.filesQueued - progress.filesProbed) / progress.filesPerSecond;
+
+    return progress;
+}
+
+//==============================================================================
+void ImportPipeline::run()
+{
+    for (const auto& root : roots)
+    {
+        if (threadShouldExit())
+            break;
+
+        enumerate(root, recursiveImport);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+        enumerationDone = true;
+    }
+
+    queueNotEmpty.notify_all();
+}
+
+void ImportPipeline::enumerate(const juce::File& root, bool recurse)
+{
+    // Returns false once the import has been cancelled
+    auto consider = [this](const juce::File& file)
+    {
+        if (!LibraryManager::isAudioFile(file))
+            return true;
+
+        ++filesFound;
+
+        auto sourceKey = LibraryManager::getPathKey(file);
+        auto targetKey = copyToLibrary ? LibraryManager::getPathKey(recordingsDirectory.getChildFile(file.getFileName()))
+                                       : sourceKey;
+
+        if (knownFiles.count(sourceKey) > 0 || knownFiles.count(targetKey) > 0)
+        {
+            ++filesSkipped;
+            return true;
+        }
+
+        knownFiles.insert(sourceKey);
+        knownFiles.insert(targetKey);
+        ++filesQueued;
+        return enqueue(file);
+    };
+
+    if (root.isDirectory())
+    {
+        for (const auto& entry : juce::RangedDirectoryIterator(root, recurse, "*", juce::File::findFiles))
+            if (threadShouldExit() || !consider(entry.getFile()))
+                return;
+    }
+    else if (root.existsAsFile())
+    {
+        consider(root);
+    }
+}
+
+bool ImportPipeline::enqueue(const juce::File& file)
+{
+    std::unique_lock<std::mutex> lock(queueLock);
+    queueNotFull.wait(lock, [this] { return queue.size() < maxQueuedFiles || cancelled; });
+
+    if (cancelled)
+        return false;
+
+    queue.push_back(file);
+    lock.unlock();
+    queueNotEmpty.notify_one();
+    return true;
+}
+
+bool ImportPipeline::dequeue(juce::File& file)
+{
+    std::unique_lock<std::mutex> lock(queueLock);
+    queueNotEmpty.wait(lock, [this] { return !queue.empty() || enumerationDone || cancelled; });
+
+    if (cancelled || queue.empty())
+        return false;
+
+    file = queue.front();
+    queue.pop_front();
+    lock.unlock();
+    queueNotFull.notify_one();
+    return true;
+}
+
+void ImportPipeline::addResult(ProbeResult result)
+{
+    std::lock_guard<std::mutex> lock(resultLock);
+    results.push_back(std::move(result));
+    ++filesProbed;
+}
+
+//==============================================================================
+void ImportPipeline::timerCallback()
+{
+    // Workers only stop once the queue has drained after enumeration, or on
+    // cancellation, and they publish their last result before doing so
+    bool allProbed = activeWorkers == 0;
+
+    if (allProbed || juce::Time::getMillisecondCounter() - lastCommitTime >= (juce::uint32)commitIntervalMs)
+        commitPending();
+
+    if (allProbed)
+        finish();
+    else if (onProgress)
+        onProgress(getProgress());
+}
+
+void ImportPipeline::commitPending()
+{
+    std::vector<ProbeResult> batch;
+
+    {
+        std::lock_guard<std::mutex> lock(resultLock);
+        batch.swap(results);
+    }
+
+    lastCommitTime = juce::Time::getMillisecondCounter();
+
+    std::vector<Recording> recordings;
+    recordings.reserve(batch.size());
+
+    for (auto& result : batch)
+    {
+        if (result.error.isNotEmpty())
+        {
+            errors.push_back({ result.file, result.error });
+            ++filesFailed;
+        }
+        else
+        {
+            recordings.push_back(std::move(result.recording));
+        }
+    }
+
+    if (recordings.empty())
+        return;
+
+    // The library may have picked some of these up since enumeration started
+    auto added = library.addRecordings(recordings);
+    filesImported += added;
+    filesSkipped += (int)recordings.size() - added;
+}
+
+void ImportPipeline::finish()
+{
+    stopTimer();
+    stopWorkers();
+    importing = false;
+
+    if (onFinished)
+        onFinished(getProgress());
+}
+
+void ImportPipeline::stopWorkers()
+{
+    stopThread(5000);
+    workers.removeAllJobs(true, 5000);
+}
\ No newline at end of file
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioRecorder.h"
+
+class LibraryManager;
+
+//==============================================================================
+struct ImportProgress
+{
+    int filesFound = 0;         // audio files enumerated so far
+    int filesQueued = 0;        // those not already in the library
+    int filesProbed = 0;
+    int filesImported = 0;
+    int filesSkipped = 0;       // already in the library, or a duplicate
+    int filesFailed = 0;
+
+    double elapsedSeconds = 0.0;
+    double filesPerSecond = 0.0;
+    double secondsRemaining = -1.0; // negative while the total isn't known yet
+
+    bool enumerationFinished = false;
+    bool finished = false;
+    bool cancelled = false;
+
+    juce::String describe() const;
+};
+
+struct ImportError
+{
+    juce::File file;
+    juce::String message;
+};
+
+//==============================================================================
+/**
+    Imports files and folders into the library without blocking the message
+    thread.
+
+    A background thread walks the directories and queues new audio files, a
+    pool of workers probes them (copying them into the library first if asked
+    to), and a timer on the message thread commits the probed recordings in
+    batches, so the library is saved and broadcasts a change once per batch
+    rather than once per file. The queue between the stages is bounded, so a
+    huge tree never has to be held in memory at once.
+*/
+class ImportPipeline : private juce::Thread,
+                       private juce::Timer
+{
+public:
+    explicit ImportPipeline(LibraryManager& library);
+    ~ImportPipeline() override;
+
+    /** Starts importing the given files and folders. Returns false if an
+        import is already running.
+    */
+    bool start(const juce::Array<juce::File>& filesOrFolders, bool recursive, bool copyToLibrary);
+
+    /** Stops enumerating and probing. Recordings that were already probed are
+        still committed, then onFinished is called.
+    */
+    void cancel();
+
+    bool isImporting() const noexcept           { return importing; }
+    ImportProgress getProgress() const;
+
+    // Files that couldn't be imported during the current or last import
+    const std::vector<ImportError>& getErrors() const noexcept  { return errors; }
+
+    // Both called on the message thread
+    std::function<void(const ImportProgress&)> onProgress;
+    std::function<void(const ImportProgress&)> onFinished;
+
+private:
+    class ProbeWorker;
+
+    struct ProbeResult
+    {
+        juce::File file;
+        Recording recording;
+        juce::String error;
+    };
+
+    void run() override;
+    void timerCallback() override;
+
+    void enumerate(const juce::File& file, bool recurse);
+    bool enqueue(const juce::File& file);
+    bool dequeue(juce::File& file);
+    void addResult(ProbeResult result);
+    void commitPending();
+    void finish();
+    void stopWorkers();
+
+    LibraryManager& library;
+    juce::ThreadPool workers;
+    juce::File recordingsDirectory;
+
+    juce::Array<juce::File> roots;
+    bool recursiveImport = true;
+    bool copyToLibrary = false;
+
+    // Path keys of everything already in the library or queued; only the
+    // enumerator touches this once an import has started
+    std::unordered_set<std::string> knownFiles;
+
+    std::mutex queueLock;
+    std::condition_variable queueNotEmpty, queueNotFull;
+    std::deque<juce::File> queue;
+    std::atomic<bool> enumerationDone { false };
+
+    std::mutex resultLock;
+    std::vector<ProbeResult> results;
+
+    std::atomic<bool> cancelled { false };
+    std::atomic<int> filesFound { 0 }, filesQueued { 0 }, filesProbed { 0 }, filesSkipped { 0 }, activeWorkers { 0 };
+    int filesImported = 0, filesFailed = 0;
+
+    bool importing = false;
+    juce::uint32 startTime = 0, lastCommitTime = 0;
+    std::vector<ImportError> errors;
+
+    static constexpr size_t maxQueuedFiles = 1024;
+    static constexpr int commitIntervalMs = 1000;
+    static constexpr int progressIntervalMs = 200;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ImportPipeline)
+};
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "LibraryAggregates.h"
+
+//==============================================================================
+LibraryAggregates::Contribution LibraryAggregates::makeContribution(const Recording& recording)
+{
+    Contribution contribution;
+    contribution.tags = recording.tags;
+    contribution.genre = recording.genre.trim();
+    contribution.artist = recording.artist.trim();
+    contribution.folder = recording.file.getParentDirectory().getFullPathName();
+    contribution.sampleRate = juce::roundToInt(recording.sampleRate);
+    contribution.numChannels = recording.numChannels;
+    contribution.seconds = recording.durationInSeconds;
+    contribution.bytes = recording.fileSize;
+    contribution.live = true;
+    return contribution;
+}
+
+void LibraryAggregates::adjust(Dimension dimension, const juce::String& value, const Contribution& contribution, int sign)
+{
+    if (value.isEmpty())
+        return;
+
+    auto& map = buckets[(size_t)dimension];
+    auto key = (dimension == folderDimension && juce::File::areFileNamesCaseSensitive() ? value
+                                                                                        : value.toLowerCase()).toStdString();
+
+    auto& bucket = map[key];
+
+    if (bucket.totals.count == 0)
+        bucket.value = value;
+
+    bucket.totals.count += sign;
+    bucket.totals.seconds += sign * contribution.seconds;
+    bucket.totals.bytes += sign * contribution.bytes;
+
+    if (bucket.totals.count <= 0)
+        map.erase(key);
+}
+
+void LibraryAggregates::apply(const Contribution& contribution, int sign, int fields)
+{
+    // Every bucket holds seconds and bytes, so a change to either touches them all
+    if ((fields & (LibraryDelta::durationField | LibraryDelta::fileField)) != 0)
+        fields = allFields;
+
+    if (fields == allFields)
+    {
+        totals.count += sign;
+        totals.seconds += sign * contribution.seconds;
+        totals.bytes += sign * contribution.bytes;
+    }
+
+    if ((fields & LibraryDelta::tagsField) != 0)
+    {
+        juce::StringArray tags;
+        for (const auto& tag : contribution.tags)
+            tags.addIfNotAlreadyThere(tag.trim(), true);
+
+        for (const auto& tag : tags)
+            adjust(tagDimension, tag, contribution, sign);
+    }
+
+    if ((fields & LibraryDelta::genreField) != 0)
+        adjust(genreDimension, contribution.genre, contribution, sign);
+
+    if ((fields & LibraryDelta::artistField) != 0)
+        adjust(artistDimension, contribution.artist, contribution, sign);
+
+    if ((fields & LibraryDelta::sampleRateField) != 0)
+        adjust(sampleRateDimension, contribution.sampleRate > 0 ? juce::String(contribution.sampleRate) : juce::String(), contribution, sign);
+
+    if ((fields & LibraryDelta::channelsField) != 0)
+        adjust(channelsDimension, contribution.numChannels > 0 ? juce::String(contribution.numChannels) : juce::String(), contribution, sign);
+
+    if ((fields & LibraryDelta::fileField) != 0)
+        adjust(folderDimension, contribution.folder, contribution, sign);
+}
+
+void LibraryAggregates::addContribution(LibraryRow row, Contribution contribution)
+{
+    if (row >= rows.size())
+        rows.resize((size_t)row + 1);
+
+    apply(contribution, 1);
+    rows[row] = std::move(contribution);
+}
+
+void LibraryAggregates::add(LibraryRow row, const Recording& recording)
+{
+    if (row < rows.size() && rows[row].live)
+        return;
+
+    addContribution(row, makeContribution(recording));
+}
+
+void LibraryAggregates::update(LibraryRow row, const Recording& recording, int changedFields)
+{
+    if (row >= rows.size() || !rows[row].live || (changedFields & allFields) == 0)
+        return;
+
+    apply(rows[row], -1, changedFields & allFields);
+    rows[row] = makeContribution(recording);
+    apply(rows[row], 1, changedFields & allFields);
+}
+
+void LibraryAggregates::remove(LibraryRow row)
+{
+    if (row >= rows.size() || !rows[row].live)
+        return;
+
+    apply(rows[row], -1);
+    rows[row] = {};
+}
+
+bool LibraryAggregates::isInFolder(LibraryRow row, const juce::File& folder) const
+{
+    return row < rows.size() && rows[row].live && juce::File(rows[row].folder) == folder;
+}
+
+void LibraryAggregates::clear()
+{
+    rows.clear();
+
+    for (auto& map : buckets)
+        map.clear();
+
+    totals = {};
+}
+
+//==============================================================================
+std::vector<LibraryAggregates::Bucket> LibraryAggregates::getBuckets(Dimension dimension, size_t maxBuckets) const
+{
+    std::vector<Bucket> result;
+    const auto& map = buckets[(size_t)dimension];
+    result.reserve(map.size());
+
+    for (const auto& entry : map)
+        result.push_back(entry.second);
+
+    auto larger = [](const Bucket& a, const Bucket& b)
+    {
+        if (a.totals.count != b.totals.count)
+            return a.totals.count > b.totals.count;
+
+        return a.value.compareNatural(b.value) < 0;
+    };
+
+    if (maxBuckets > 0 && result.size() > maxBuckets)
+    {
+        std::partial_sort(result.begin(), result.begin() + (std::ptrdiff_t)maxBuckets, result.end(), larger);
+        result.resize(maxBuckets);
+    }
+    else
+    {
+        std::sort(result.begin(), result.end(), larger);
+    }
+
+    return result;
+}
+
+std::unique_ptr<LibraryAggregates> LibraryAggregates::createSubset(const std::vector<LibraryRow>& subsetRows) const
+{
+    auto subset = std::make_unique<LibraryAggregates>();
+
+    for (auto row : subsetRows)
+        if (row < rows.size() && rows[row].live)
+            subset->addContribution(row, rows[row]);
+
+    return subset;
+}
+
+//==============================================================================
+juce::String LibraryAggregates::getDimensionName(Dimension dimension)
+{
+    switch (dimension)
+    {
+        case tagDimension:          return "Tags";
+        case genreDimension:        return "Genres";
+        case artistDimension:       return "Artists";
+        case sampleRateDimension:   return "Sample Rates";
+        case channelsDimension:     return "Channels";
+        case folderDimension:       return "Folders";
+        case numDimensions:         break;
+    }
+
+    return {};
+}
+
+juce::String LibraryAggregates::getBucketLabel(Dimension dimension, const Bucket& bucket)
+{
+    juce::String label;
+
+    switch (dimension)
+    {
+        case sampleRateDimension:
+            label = juce::String(bucket.value.getIntValue() / 1000.0, 1) + " kHz";
+            break;
+
+        case channelsDimension:
+        {
+            auto channels = bucket.value.getIntValue();
+            label = channels == 1 ? "Mono" : (channels == 2 ? "Stereo" : bucket.value + " channels");
+            break;
+        }
+
+        default:
+            label = bucket.value;
+            break;
+    }
+
+    return label + "  (" + describe(bucket.totals) + ")";
+}
+
+juce::String LibraryAggregates::getFilterTerm(Dimension dimension, const Bucket& bucket)
+{
+    // Whole-field matches, so "Rock" doesn't also pick up "Hard Rock"
+    auto quoted = "\"" + bucket.value.replace("\\", "\\\\").replace("\"", "\\\"") + "\"";
+
+    switch (dimension)
+    {
+        case tagDimension:          return "tag:" + quoted;
+        case genreDimension:        return "genre=" + quoted;
+        case artistDimension:       return "artist=" + quoted;
+        case sampleRateDimension:   return "rate=" + bucket.value;
+        case channelsDimension:     return "channels=" + bucket.value;
+        case folderDimension:       return "folder:" + quoted;
+        case numDimensions:         break;
+    }
+
+    return {};
+}
+
+juce::String LibraryAggregates::describe(const Totals& t)
+{
+    auto hours = t.seconds / 3600.0;
+
+    return juce::String(t.count) + (t.count == 1 ? " recording, " : " recordings, ")
+         + (hours >= 1.0 ? juce::String(hours, 1) + " h" : juce::String(t.seconds / 60.0, 1) + " min")
+         + ", " + juce::File::descriptionOfSizeInBytes(t.bytes);
+}
\ No newline at end of file
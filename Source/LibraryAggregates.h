@@ -0,0 +1,96 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioRecorder.h"
+#include "LibraryTypes.h"
+
+//==============================================================================
+/**
+    Running totals over the library: recording count, hours of audio and bytes
+    on disk, overall and per facet (tag, genre, artist, sample rate, channel
+    count and folder).
+
+    Each row's contribution is remembered, so removing or updating a recording
+    subtracts exactly what it added without looking at any other recording.
+    Byte counts come from Recording::fileSize, filled in by whoever probed the
+    file, so nothing here touches the disk.
+*/
+class LibraryAggregates
+{
+public:
+    enum Dimension
+    {
+        tagDimension = 0,
+        genreDimension,
+        artistDimension,
+        sampleRateDimension,
+        channelsDimension,
+        folderDimension,
+        numDimensions
+    };
+
+    struct Totals
+    {
+        int count = 0;
+        double seconds = 0.0;
+        juce::int64 bytes = 0;
+    };
+
+    struct Bucket
+    {
+        juce::String value;     // as written in a query term
+        Totals totals;
+    };
+
+    LibraryAggregates() = default;
+
+    void add(LibraryRow row, const Recording& recording);
+    // Only the dimensions that depend on changedFields (LibraryDelta bits) are re-bucketed
+    void update(LibraryRow row, const Recording& recording, int changedFields);
+    void remove(LibraryRow row);
+    void clear();
+
+    const Totals& getTotals() const noexcept        { return totals; }
+
+    // True if the row's file is directly inside folder, not in a subfolder of it
+    bool isInFolder(LibraryRow row, const juce::File& folder) const;
+
+    // Largest count first; maxBuckets 0 returns them all
+    std::vector<Bucket> getBuckets(Dimension dimension, size_t maxBuckets = 0) const;
+
+    // The same aggregates restricted to some rows, from the remembered contributions
+    std::unique_ptr<LibraryAggregates> createSubset(const std::vector<LibraryRow>& rows) const;
+
+    static juce::String getDimensionName(Dimension dimension);
+    static juce::String getBucketLabel(Dimension dimension, const Bucket& bucket);
+    static juce::String getFilterTerm(Dimension dimension, const Bucket& bucket);   // for drilling down
+    static juce::String describe(const Totals& totals);
+
+private:
+    struct Contribution
+    {
+        juce::StringArray tags;
+        juce::String genre, artist, folder;
+        int sampleRate = 0;
+        int numChannels = 0;
+        double seconds = 0.0;
+        juce::int64 bytes = 0;
+        bool live = false;
+    };
+
+    void apply(const Contribution& contribution, int sign, int fields = allFields);
+    void adjust(Dimension dimension, const juce::String& value, const Contribution& contribution, int sign);
+    void addContribution(LibraryRow row, Contribution contribution);
+    static Contribution makeContribution(const Recording& recording);
+
+    // LibraryDelta bits that a contribution is built from
+    static constexpr int allFields = LibraryDelta::tagsField | LibraryDelta::genreField | LibraryDelta::artistField
+                                   | LibraryDelta::sampleRateField | LibraryDelta::channelsField
+                                   | LibraryDelta::fileField | LibraryDelta::durationField;
+
+    std::vector<Contribution> rows;
+    std::array<std::unordered_map<std::string, Bucket>, numDimensions> buckets;
+    Totals totals;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryAggregates)
+};
\ No newline at end of file
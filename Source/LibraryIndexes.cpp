@@ -0,0 +1,44 @@
+#include "LibraryIndexes.h"
+
+void LibraryIndexes::add(LibraryRow row, const Recording& recording)
+{
+    text.add(row, recording);
+    fuzzy.add(row, recording);
+    tags.add(row, recording.tags);
+    numeric.set(row, recording);
+    sortOrders.add(row);
+    aggregates.add(row, recording);
+    liveRows.add(row);
+}
+
+void LibraryIndexes::update(LibraryRow row, const Recording& recording, int changedFields)
+{
+    text.update(row, recording);
+    fuzzy.update(row, recording);
+    tags.update(row, recording.tags);
+    numeric.set(row, recording);
+    sortOrders.update(row, changedFields);
+    aggregates.update(row, recording, changedFields);
+}
+
+void LibraryIndexes::remove(LibraryRow row)
+{
+    text.remove(row);
+    fuzzy.remove(row);
+    tags.remove(row);
+    numeric.remove(row);
+    sortOrders.remove(row);
+    aggregates.remove(row);
+    liveRows.remove(row);
+}
+
+void LibraryIndexes::clear()
+{
+    text.clear();
+    fuzzy.clear();
+    tags.clear();
+    numeric.clear();
+    sortOrders.clear();
+    aggregates.clear();
+    liveRows.clear();
+}
\ No newline at end of file
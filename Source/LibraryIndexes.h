@@ -0,0 +1,35 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioRecorder.h"
+#include "LibraryTypes.h"
+#include "RowBitmap.h"
+#include "TextIndex.h"
+#include "FuzzyIndex.h"
+#include "TagIndex.h"
+#include "NumericColumns.h"
+#include "SortOrders.h"
+#include "LibraryAggregates.h"
+
+//==============================================================================
+/**
+    The secondary indexes the library keeps over its recordings, maintained
+    together so that every mutation updates all of them.
+*/
+struct LibraryIndexes
+{
+    void add(LibraryRow row, const Recording& recording);
+    void update(LibraryRow row, const Recording& recording, int changedFields);
+    void remove(LibraryRow row);
+    void clear();
+
+    size_t getNumRows() const       { return liveRows.size(); }
+
+    TextIndex text;
+    FuzzyIndex fuzzy;
+    TagIndex tags;
+    NumericColumns numeric;
+    SortOrders sortOrders;
+    LibraryAggregates aggregates;
+    RowBitmap liveRows;
+};
\ No newline at end of file
@@ -1,15 +1,29 @@
 #include "LibraryManager.h"
+#include "AudioFileProbe.h"
 
 LibraryManager::LibraryManager()
 {
-    formatManager.registerBasicFormats();
     ensureDirectoriesExist();
     loadLibrary();
+    publishSnapshot();
+    persistence = std::make_unique<LibraryPersistence>(libraryFile);
+    persistence->onSaveFailed = [this](const juce::String& error)
+    {
+        if (onSaveFailed != nullptr)
+            onSaveFailed(error);
+    };
+    
+    today = getDayNumber(juce::Time::getCurrentTime());
+    startTimer(60 * 1000);
 }
 
 LibraryManager::~LibraryManager()
 {
+    stopTimer();
+    
+    // Blocks until the final save is on disk
     saveLibrary();
+    persistence->flush();
 }
 
 void LibraryManager::ensureDirectoriesExist()
@@ -24,137 +38,524 @@ void LibraryManager::ensureDirectoriesExist()
     recordingsDirectory.createDirectory();
 }
 
-void LibraryManager::addRecording(const Recording& recording)
+std::string LibraryManager::getPathKey(const juce::File& file)
 {
-    recordings.add(recording);
-    saveLibrary();
-    sendChangeMessage();
+    auto path = file.getFullPathName();
+    if (!juce::File::areFileNamesCaseSensitive())
+        path = path.toLowerCase();
+    return path.toStdString();
+}
+
+RecordingHandle LibraryManager::appendRecording(Recording recording)
+{
+    // generateUID() only has second resolution plus a small random suffix, so
+    // a fast import can produce the same uid twice
+    while (recording.uid.isEmpty() || rowsByUid.count(recording.uid.toStdString()) > 0)
+        recording.uid = Recording::generateUID() + "_" + juce::String(nextRow);
+    
+    auto row = nextRow++;
+    
+    rowsByUid[recording.uid.toStdString()] = row;
+    rowsByPath.emplace(getPathKey(recording.file), row);
+    indexes.add(row, recording);
+    recordings.set(row, std::move(recording));
+    noteInserted(row);
+    
+    return { row };
+}
+
+void LibraryManager::clearRecordings()
+{
+    recordings.clear();
+    rowsByUid.clear();
+    rowsByPath.clear();
+    indexes.clear();
+    
+    pendingChanges.clear();
+    pendingOrder.clear();
+    pendingReset = true;
 }
 
-void LibraryManager::removeRecording(int index)
+void LibraryManager::libraryChanged()
 {
-    if (juce::isPositiveAndBelow(index, recordings.size()))
+    if (batchDepth > 0)
     {
-        recordings.remove(index);
-        saveLibrary();
-        sendChangeMessage();
+        batchChanged = true;
+        return;
     }
+    
+    publishSnapshot();
+    saveLibrary();
+    notifyListeners();
+    sendChangeMessage();
+}
+
+int LibraryManager::getDayNumber(juce::Time time)
+{
+    return time.getYear() * 366 + time.getDayOfYear();
+}
+
+void LibraryManager::timerCallback()
+{
+    auto day = getDayNumber(juce::Time::getCurrentTime());
+    if (day == today)
+        return;
+    
+    today = day;
+    
+    if (!smartPlaylists.refreshRelativeDates(getQueryRunner()))
+        return;
+    
+    LibraryDelta delta;
+    delta.playlistsChanged = true;
+    listeners.call([&delta](Listener& l) { l.libraryUpdated(delta); });
+    sendChangeMessage();
 }
 
-void LibraryManager::updateRecording(int index, const Recording& recording)
+void LibraryManager::endBatch()
 {
-    if (juce::isPositiveAndBelow(index, recordings.size()))
+    if (--batchDepth == 0 && batchChanged)
     {
-        recordings.set(index, recording);
+        batchChanged = false;
+        publishSnapshot();
         saveLibrary();
+        notifyListeners();
         sendChangeMessage();
     }
 }
 
-const Recording* LibraryManager::getRecording(int index) const
+void LibraryManager::publishSnapshot()
 {
-    if (juce::isPositiveAndBelow(index, recordings.size()))
-        return &recordings.getReference(index);
-    return nullptr;
+    snapshots.publish(recordings.build(++snapshotVersion));
 }
 
-juce::Array<Recording> LibraryManager::getFilteredRecordings(const juce::String& filter) const
+void LibraryManager::noteInserted(LibraryRow row)
 {
-    if (filter.isEmpty())
-        return recordings;
+    if (pendingReset)
+        return;
     
-    juce::Array<Recording> filtered;
-    auto filterLower = filter.toLowerCase();
+    pendingChanges[row] = { PendingChange::Kind::inserted };
+    pendingOrder.push_back(row);
+}
+
+void LibraryManager::noteUpdated(LibraryRow row, int fields)
+{
+    if (pendingReset || fields == 0)
+        return;
     
-    for (const auto& recording : recordings)
+    auto existing = pendingChanges.find(row);
+    
+    if (existing == pendingChanges.end())
     {
-        if (recording.name.toLowerCase().contains(filterLower) ||
-            recording.uid.toLowerCase().contains(filterLower))
-        {
-            filtered.add(recording);
-            continue;
-        }
-        
-        // Check tags
-        for (const auto& tag : recording.tags)
-        {
-            if (tag.toLowerCase().contains(filterLower))
-            {
-                filtered.add(recording);
-                break;
-            }
-        }
+        pendingChanges[row] = { PendingChange::Kind::updated, fields };
+        pendingOrder.push_back(row);
     }
+    else if (existing->second.kind == PendingChange::Kind::updated)
+    {
+        existing->second.fields |= fields;
+    }
+}
+
+void LibraryManager::noteRemoved(LibraryRow row)
+{
+    if (pendingReset)
+        return;
     
-    return filtered;
+    auto existing = pendingChanges.find(row);
+    
+    if (existing == pendingChanges.end())
+    {
+        pendingChanges[row] = { PendingChange::Kind::removed };
+        pendingOrder.push_back(row);
+    }
+    else if (existing->second.kind == PendingChange::Kind::inserted)
+    {
+        // Nobody has seen it yet
+        pendingChanges.erase(existing);
+    }
+    else
+    {
+        existing->second = { PendingChange::Kind::removed };
+    }
 }
 
-juce::Array<int> LibraryManager::findRecordingsByTag(const juce::String& tag) const
+void LibraryManager::notifyListeners()
 {
-    juce::Array<int> indices;
-    auto tagLower = tag.toLowerCase();
+    LibraryDelta delta;
+    delta.reset = pendingReset;
     
-    for (int i = 0; i < recordings.size(); ++i)
+    if (!pendingReset)
     {
-        for (const auto& recordingTag : recordings.getReference(i).tags)
+        for (auto row : pendingOrder)
         {
-            if (recordingTag.toLowerCase() == tagLower)
+            auto change = pendingChanges.find(row);
+            if (change == pendingChanges.end())
+                continue;
+            
+            switch (change->second.kind)
             {
-                indices.add(i);
-                break;
+                case PendingChange::Kind::inserted: delta.inserted.push_back({ row }); break;
+                case PendingChange::Kind::updated:  delta.updated.push_back({ { row }, change->second.fields }); break;
+                case PendingChange::Kind::removed:  delta.removed.push_back({ row }); break;
             }
         }
     }
     
-    return indices;
+    pendingChanges.clear();
+    pendingOrder.clear();
+    pendingReset = false;
+    
+    // Resets only come from loadLibrary, which restores the playlists itself
+    if (!delta.isEmpty() && !delta.reset)
+        smartPlaylists.apply(delta, getRecordingLookup(), getQueryRunner());
+    
+    if (!delta.isEmpty())
+        listeners.call([&delta](Listener& l) { l.libraryUpdated(delta); });
+}
+
+SmartPlaylists::RecordingLookup LibraryManager::getRecordingLookup() const
+{
+    return [this](LibraryRow row) { return getRecordingForRow(row); };
+}
+
+SmartPlaylists::QueryRunner LibraryManager::getQueryRunner() const
+{
+    return [this](const LibraryQuery& query) { return runQuery(query).rows; };
+}
+
+int LibraryManager::addSmartPlaylist(const juce::String& name, const juce::String& queryText)
+{
+    auto index = smartPlaylists.add(name, queryText, getQueryRunner());
+    libraryChanged();
+    return index;
+}
+
+bool LibraryManager::editSmartPlaylist(int index, const juce::String& name, const juce::String& queryText)
+{
+    if (!smartPlaylists.edit(index, name, queryText, getQueryRunner()))
+        return false;
+    
+    libraryChanged();
+    return true;
+}
+
+bool LibraryManager::removeSmartPlaylist(int index)
+{
+    if (!smartPlaylists.remove(index))
+        return false;
+    
+    libraryChanged();
+    return true;
 }
 
-juce::Array<int> LibraryManager::searchRecordings(const juce::String& searchTerm) const
+juce::Array<RecordingHandle> LibraryManager::getSmartPlaylistHandles(int index) const
 {
-    juce::Array<int> indices;
-    auto searchLower = searchTerm.toLowerCase();
+    juce::Array<RecordingHandle> handles;
     
-    for (int i = 0; i < recordings.size(); ++i)
+    if (auto* playlist = smartPlaylists.get(index))
+        playlist->members.forEach([&handles](LibraryRow row) { handles.add({ row }); });
+    
+    return handles;
+}
+
+int LibraryManager::getChangedFields(const Recording& before, const Recording& after)
+{
+    int fields = 0;
+    
+    if (before.name != after.name)                              fields |= LibraryDelta::nameField;
+    if (before.file != after.file || before.fileSize != after.fileSize)
+                                                                fields |= LibraryDelta::fileField;
+    if (before.durationInSeconds != after.durationInSeconds)    fields |= LibraryDelta::durationField;
+    if (before.tags != after.tags)                              fields |= LibraryDelta::tagsField;
+    if (before.timestamp != after.timestamp)                    fields |= LibraryDelta::timestampField;
+    if (before.sampleRate != after.sampleRate)                  fields |= LibraryDelta::sampleRateField;
+    if (before.numChannels != after.numChannels)                fields |= LibraryDelta::channelsField;
+    if (before.artist != after.artist)                          fields |= LibraryDelta::artistField;
+    if (before.genre != after.genre)                            fields |= LibraryDelta::genreField;
+    if (before.trackNumber != after.trackNumber)                fields |= LibraryDelta::trackNumberField;
+    
+    return fields;
+}
+
+const Recording* LibraryManager::getRecordingForRow(LibraryRow row) const
+{
+    return recordings.get(row);
+}
+
+RecordingHandle LibraryManager::addRecording(const Recording& recording)
+{
+    auto handle = appendRecording(recording);
+    libraryChanged();
+    return handle;
+}
+
+int LibraryManager::addRecordings(const std::vector<Recording>& batch)
+{
+    int added = 0;
+    
+    for (const auto& recording : batch)
     {
-        const auto& recording = recordings.getReference(i);
-        
-        if (recording.name.toLowerCase().contains(searchLower) ||
-            recording.uid.toLowerCase().contains(searchLower))
-        {
-            indices.add(i);
+        if (findRecordingByFile(recording.file).isValid())
             continue;
-        }
         
-        // Check tags
-        for (const auto& tag : recording.tags)
-        {
-            if (tag.toLowerCase().contains(searchLower))
-            {
-                indices.add(i);
-                break;
-            }
-        }
+        appendRecording(recording);
+        ++added;
     }
     
-    return indices;
+    if (added > 0)
+    {
+        libraryChanged();
+    }
+    
+    return added;
 }
 
-void LibraryManager::saveLibrary()
+bool LibraryManager::removeRecording(RecordingHandle handle)
+{
+    if (getRecording(handle) == nullptr)
+        return false;
+    
+    auto row = handle.row;
+    const auto& recording = *recordings.get(row);
+    
+    rowsByUid.erase(recording.uid.toStdString());
+    
+    auto path = rowsByPath.find(getPathKey(recording.file));
+    if (path != rowsByPath.end() && path->second == row)
+        rowsByPath.erase(path);
+    
+    indexes.remove(row);
+    recordings.remove(row);
+    noteRemoved(row);
+    
+    libraryChanged();
+    return true;
+}
+
+bool LibraryManager::updateRecording(RecordingHandle handle, const Recording& recording)
 {
-    juce::ValueTree libraryTree("LIBRARY");
-    libraryTree.setProperty("version", "1.0", nullptr);
-    libraryTree.setProperty("created", juce::Time::getCurrentTime().toISO8601(false), nullptr);
+    auto* current = getRecording(handle);
+    if (current == nullptr)
+        return false;
+    
+    auto row = handle.row;
+    auto oldPathKey = getPathKey(current->file);
+    auto newPathKey = getPathKey(recording.file);
     
-    for (const auto& recording : recordings)
+    // Two rows never share a file; the caller has to decide what happens to the other one
+    if (oldPathKey != newPathKey)
     {
-        libraryTree.addChild(recording.toValueTree(), -1, nullptr);
+        auto owner = rowsByPath.find(newPathKey);
+        if (owner != rowsByPath.end() && owner->second != row)
+            return false;
     }
     
-    auto xml = libraryTree.createXml();
-    if (xml)
+    auto& existing = *recordings.getForWriting(row);
+    
+    if (oldPathKey != newPathKey)
     {
-        xml->writeTo(libraryFile);
+        auto path = rowsByPath.find(oldPathKey);
+        if (path != rowsByPath.end() && path->second == row)
+            rowsByPath.erase(path);
+        
+        rowsByPath.emplace(newPathKey, row);
     }
+    
+    // The uid is what identifies a recording, so it never changes
+    auto fields = getChangedFields(existing, recording);
+    auto uid = existing.uid;
+    existing = recording;
+    existing.uid = uid;
+    indexes.update(row, existing, fields);
+    noteUpdated(row, fields);
+    
+    libraryChanged();
+    return true;
+}
+
+const Recording* LibraryManager::getRecording(RecordingHandle handle) const
+{
+    return handle.isValid() ? getRecordingForRow(handle.row) : nullptr;
+}
+
+RecordingHandle LibraryManager::findRecordingByUid(const juce::String& uid) const
+{
+    auto it = rowsByUid.find(uid.toStdString());
+    return it != rowsByUid.end() ? RecordingHandle { it->second } : RecordingHandle {};
+}
+
+RecordingHandle LibraryManager::findRecordingByFile(const juce::File& file) const
+{
+    auto it = rowsByPath.find(getPathKey(file));
+    return it != rowsByPath.end() ? RecordingHandle { it->second } : RecordingHandle {};
+}
+
+std::unordered_set<std::string> LibraryManager::getKnownPathKeys() const
+{
+    std::unordered_set<std::string> keys;
+    keys.reserve(rowsByPath.size());
+    
+    for (const auto& entry : rowsByPath)
+        keys.insert(entry.first);
+    
+    return keys;
+}
+
+juce::Array<RecordingHandle> LibraryManager::getAllHandles() const
+{
+    juce::Array<RecordingHandle> handles;
+    handles.ensureStorageAllocated(getNumRecordings());
+    indexes.liveRows.forEach([&handles](LibraryRow row) { handles.add({ row }); });
+    return handles;
+}
+
+juce::Array<RecordingHandle> LibraryManager::getFilteredHandles(const juce::String& query) const
+{
+    if (query.isEmpty())
+        return getAllHandles();
+    
+    return handlesForRows(runQuery(query).rows);
+}
+
+juce::Array<RecordingHandle> LibraryManager::getFilteredHandles(const juce::String& queryText,
+                                                                const std::vector<LibraryQuery::SortKey>& sortKeys,
+                                                                int limit, int offset) const
+{
+    auto query = LibraryQuery::parse(queryText);
+    
+    if (!sortKeys.empty())
+        query.sortKeys = sortKeys;
+    
+    if (limit >= 0)
+        query.limit = limit;
+    
+    if (offset > 0)
+        query.offset = offset;
+    
+    if (query.isEmpty())
+        return getAllHandles();
+    
+    return handlesForRows(runQuery(query).rows);
+}
+
+juce::Array<RecordingHandle> LibraryManager::fuzzySearch(const juce::String& text, int maxResults) const
+{
+    juce::Array<RecordingHandle> handles;
+    
+    for (const auto& match : indexes.fuzzy.search(text, (size_t)juce::jmax(0, maxResults), juce::Time::currentTimeMillis()))
+        handles.add({ match.row });
+    
+    return handles;
+}
+
+QueryResult LibraryManager::runQuery(const juce::String& queryText) const
+{
+    return runQuery(LibraryQuery::parse(queryText));
+}
+
+QueryResult LibraryManager::runQuery(const LibraryQuery& query) const
+{
+    QueryPlan plan(query, indexes);
+    return plan.execute([this](LibraryRow row) { return getRecordingForRow(row); });
+}
+
+LibrarySearch::Request LibraryManager::prepareSearch(const LibraryQuery& query, const RowBitmap* within) const
+{
+    QueryPlan plan(query, indexes);
+    auto matches = plan.findMatches();
+    
+    if (within != nullptr)
+        matches &= *within;
+    
+    LibrarySearch::Request request;
+    request.query = query;
+    request.snapshot = getSnapshot();
+    request.primaryOrder = plan.getPrimaryOrder(matches.size(), getRecordingLookup());
+    request.matches = std::make_shared<const RowBitmap>(std::move(matches));
+    return request;
+}
+
+juce::String LibraryManager::explainQuery(const juce::String& queryText) const
+{
+    auto query = LibraryQuery::parse(queryText);
+    QueryPlan plan(query, indexes);
+    plan.execute([this](LibraryRow row) { return getRecordingForRow(row); });
+    return plan.explain();
+}
+
+juce::Array<RecordingHandle> LibraryManager::handlesForRows(const std::vector<LibraryRow>& rows)
+{
+    juce::Array<RecordingHandle> handles;
+    handles.ensureStorageAllocated((int)rows.size());
+    
+    for (auto row : rows)
+        handles.add({ row });
+    
+    return handles;
+}
+
+juce::Array<RecordingHandle> LibraryManager::findRecordingsByTag(const juce::String& tag) const
+{
+    return handlesForRows(indexes.tags.getRows(indexes.tags.findTag(tag)).toVector());
+}
+
+juce::Array<RecordingHandle> LibraryManager::findRecordingsByTagExpression(const juce::String& expression) const
+{
+    return handlesForRows(indexes.tags.evaluate(expression, indexes.liveRows).toVector());
+}
+
+juce::Array<RecordingHandle> LibraryManager::searchRecordings(const juce::String& searchTerm) const
+{
+    return handlesForRows(indexes.text.search(searchTerm));
+}
+
+juce::Array<RecordingHandle> LibraryManager::findRecordingsInRanges(const std::vector<NumericColumns::Predicate>& predicates) const
+{
+    return handlesForRows(indexes.numeric.select(predicates).toRows());
+}
+
+int LibraryManager::getTagCount(const juce::String& tag) const
+{
+    return indexes.tags.getCount(indexes.tags.findTag(tag));
+}
+
+bool LibraryManager::renameTag(const juce::String& oldName, const juce::String& newName)
+{
+    auto oldKey = TagIndex::fold(oldName);
+    auto affected = indexes.tags.rename(oldName, newName);
+    if (affected.isEmpty())
+        return false;
+    
+    // Only the members of the tag need their recordings patched
+    auto newTag = newName.trim();
+    
+    affected.forEach([this, &oldKey, &newTag](LibraryRow row)
+    {
+        auto* recording = recordings.getForWriting(row);
+        if (recording == nullptr)
+            return;
+        
+        for (auto& tag : recording->tags)
+            if (TagIndex::fold(tag) == oldKey)
+                tag = newTag;
+        
+        recording->tags.removeDuplicates(true);
+        indexes.text.update(row, *recording);
+        indexes.fuzzy.update(row, *recording);
+        indexes.sortOrders.update(row, LibraryDelta::tagsField);
+        indexes.aggregates.update(row, *recording, LibraryDelta::tagsField);
+        noteUpdated(row, LibraryDelta::tagsField);
+    });
+    
+    libraryChanged();
+    return true;
+}
+
+void LibraryManager::saveLibrary()
+{
+    // Written from the published snapshot by the persistence thread
+    if (persistence != nullptr)
+        persistence->save(snapshots.acquire(), smartPlaylists.getCopies());
 }
 
 void LibraryManager::loadLibrary()
@@ -170,7 +571,7 @@ void LibraryManager::loadLibrary()
     if (!libraryTree.hasType("LIBRARY"))
         return;
     
-    recordings.clear();
+    clearRecordings();
     
     for (auto recordingTree : libraryTree)
     {
@@ -180,109 +581,98 @@ void LibraryManager::loadLibrary()
             // Only add if the file still exists
             if (recording.file.existsAsFile())
             {
-                recordings.add(recording);
+                // Libraries saved before sizes were stored get them once here
+                if (recording.fileSize <= 0)
+                    recording.fileSize = recording.file.getSize();
+                
+                appendRecording(recording);
             }
         }
     }
     
+    smartPlaylists.restore(libraryTree.getChildWithName("SMART_PLAYLISTS"),
+                           [this](const juce::String& uid) { return findRecordingByUid(uid).row; },
+                           getQueryRunner());
+    
+    publishSnapshot();
+    notifyListeners();
     sendChangeMessage();
 }
 
-// Import functionality implementations
-bool LibraryManager::importAudioFile(const juce::File& file, bool copyToLibrary)
+void LibraryManager::mergeManifestEntry(const ManifestEntry& entry, ManifestImportResult& result)
 {
-    if (!file.existsAsFile() || !isAudioFile(file))
-        return false;
-    
-    // Check if already imported (check by full path to be more precise)
-    for (const auto& recording : recordings)
-    {
-        if (recording.file.getFullPathName() == file.getFullPathName())
-            return false; // Already exists
-    }
+    auto handle = entry.uid.isNotEmpty() ? findRecordingByUid(entry.uid) : RecordingHandle {};
     
-    juce::File targetFile = file;
+    if (!handle.isValid() && (entry.fields & LibraryDelta::fileField) != 0)
+        handle = findRecordingByFile(entry.recording.file);
     
-    if (copyToLibrary)
+    auto* existing = getRecording(handle);
+    if (existing == nullptr)
     {
-        // Copy file to recordings directory
-        targetFile = recordingsDirectory.getChildFile(file.getFileName());
-        if (!file.copyFileTo(targetFile))
-            return false;
+        ++result.unmatched;
+        return;
     }
     
-    auto recording = createRecordingFromFile(targetFile);
-    if (recording.durationInSeconds > 0)
-    {
-        // Add to recordings array directly (don't call addRecording to avoid duplicate saves)
-        recordings.add(recording);
-        return true;
-    }
+    // A manifest can come from anywhere, so it never repoints a row or overrides what was read from the file
+    auto merged = *existing;
+    const auto& r = entry.recording;
     
-    return false;
-}
-
-void LibraryManager::importAudioFiles(const juce::Array<juce::File>& files, bool copyToLibrary)
-{
-    int successCount = 0;
-    for (const auto& file : files)
-    {
-        if (importAudioFile(file, copyToLibrary))
-            successCount++;
-    }
+    if (entry.fields & LibraryDelta::nameField)         merged.name = r.name;
+    if (entry.fields & LibraryDelta::tagsField)         merged.tags = r.tags;
+    if (entry.fields & LibraryDelta::artistField)       merged.artist = r.artist;
+    if (entry.fields & LibraryDelta::genreField)        merged.genre = r.genre;
+    if (entry.fields & LibraryDelta::trackNumberField)  merged.trackNumber = r.trackNumber;
     
-    if (successCount > 0)
+    if (getChangedFields(*existing, merged) == 0)
     {
-        saveLibrary();
-        sendChangeMessage();
+        ++result.unchanged;
+        return;
     }
-}
-
-bool LibraryManager::importFolder(const juce::File& folder, bool recursive, bool copyToLibrary)
-{
-    if (!folder.isDirectory())
-        return false;
-    
-    juce::Array<juce::File> audioFiles;
-    
-    auto collectAudioFiles = [this, &audioFiles](const juce::File& dir, bool recurse)
-    {
-        for (juce::RangedDirectoryIterator i(dir, recurse, "*", juce::File::findFiles); i != juce::RangedDirectoryIterator{}; ++i)
-        {
-            auto file = i->getFile();
-            if (isAudioFile(file))
-                audioFiles.add(file);
-        }
-    };
     
-    collectAudioFiles(folder, recursive);
-    
-    if (audioFiles.size() > 0)
+    if (!updateRecording(handle, merged))
     {
-        importAudioFiles(audioFiles, copyToLibrary);
-        return true;
+        result.addError(existing->name + ": couldn't be updated");
+        return;
     }
     
-    return false;
+    ++result.updated;
 }
 
-Recording LibraryManager::createRecordingFromFile(const juce::File& file)
+Recording LibraryManager::createRecordingFromFile(const juce::File& file, juce::AudioFormatManager& formats)
 {
     Recording recording;
     recording.uid = Recording::generateUID();
     recording.file = file;
     recording.timestamp = juce::Time(file.getLastModificationTime());
+    recording.fileSize = file.getSize();
     
     // Extract name from filename (remove extension)
     recording.name = file.getFileNameWithoutExtension();
     
-    // Try to get audio file info
-    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
-    if (reader)
+    // Read the headers directly where we can, and only open a full reader
+    // for formats the probe doesn't understand
+    AudioFileInfo info;
+    if (AudioFileProbe::probe(file, info))
     {
-        recording.durationInSeconds = (double)reader->lengthInSamples / reader->sampleRate;
-        recording.sampleRate = reader->sampleRate;
-        recording.numChannels = (int)reader->numChannels;
+        recording.durationInSeconds = info.durationInSeconds;
+        recording.sampleRate = info.sampleRate;
+        recording.numChannels = info.numChannels;
+        recording.artist = info.artist;
+        recording.genre = info.genre;
+        recording.trackNumber = info.trackNumber;
+        
+        if (info.title.isNotEmpty())
+            recording.name = info.title;
+    }
+    else
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(file));
+        if (reader)
+        {
+            recording.durationInSeconds = (double)reader->lengthInSamples / reader->sampleRate;
+            recording.sampleRate = reader->sampleRate;
+            recording.numChannels = (int)reader->numChannels;
+        }
     }
     
     // Extract tags from filename/path
@@ -2,48 +2,173 @@
 
 #include <JuceHeader.h>
 #include "AudioRecorder.h"
+#include "LibraryTypes.h"
+#include "LibraryIndexes.h"
+#include "LibraryQuery.h"
+#include "LibrarySnapshot.h"
+#include "SmartPlaylists.h"
+#include "LibraryManifest.h"
+#include "LibraryPersistence.h"
+#include "LibrarySearch.h"
 
 //==============================================================================
-class LibraryManager : public juce::ChangeBroadcaster
+class LibraryManager : public juce::ChangeBroadcaster,
+                       private juce::Timer
 {
 public:
     LibraryManager();
     ~LibraryManager();
 
+    /** Defers saving and change notifications until the outermost batch ends,
+        so a burst of mutations costs one save and one notification.
+    */
+    class ScopedBatch
+    {
+    public:
+        explicit ScopedBatch(LibraryManager& libraryToBatch) : library(libraryToBatch) { ++library.batchDepth; }
+        ~ScopedBatch() { library.endBatch(); }
+
+    private:
+        LibraryManager& library;
+        JUCE_DECLARE_NON_COPYABLE(ScopedBatch)
+    };
+
+    /** Told exactly what changed, on the message thread, after each mutation or
+        outermost batch. The ChangeBroadcaster message is still sent as well.
+    */
+    class Listener
+    {
+    public:
+        virtual ~Listener() = default;
+        virtual void libraryUpdated(const LibraryDelta& delta) = 0;
+    };
+
+    void addListener(Listener* listener)        { listeners.add(listener); }
+    void removeListener(Listener* listener)     { listeners.remove(listener); }
+
     // Library operations
-    void addRecording(const Recording& recording);
-    void removeRecording(int index);
-    void updateRecording(int index, const Recording& recording);
+    RecordingHandle addRecording(const Recording& recording);
+    int addRecordings(const std::vector<Recording>& batch);
+    bool removeRecording(RecordingHandle handle);
+    bool updateRecording(RecordingHandle handle, const Recording& recording);  // false if the new file belongs to another row
     
-    // Import operations
-    bool importAudioFile(const juce::File& file, bool copyToLibrary = false);
-    void importAudioFiles(const juce::Array<juce::File>& files, bool copyToLibrary = false);
-    bool importFolder(const juce::File& folder, bool recursive = false, bool copyToLibrary = false);
+    // Imports go through ImportPipeline and ManifestImporter, which commit in batches
+    
+    /** Merges one manifest row into the recording it names, by uid or else by
+        path. Only the user's metadata (name, tags, artist, genre and track
+        number) is taken; the file and what was probed from it never are.
+    */
+    void mergeManifestEntry(const ManifestEntry& entry, ManifestImportResult& result);
+    const juce::File& getRecordingsDirectory() const { return recordingsDirectory; }
+    std::unordered_set<std::string> getKnownPathKeys() const;
+    
+    // Thread-safe, used by the ImportPipeline workers
+    static Recording createRecordingFromFile(const juce::File& file, juce::AudioFormatManager& formats);
+    static bool isAudioFile(const juce::File& file);
+    static std::string getPathKey(const juce::File& file);
     
     // Access
-    int getNumRecordings() const { return recordings.size(); }
-    const Recording* getRecording(int index) const;
-    const juce::Array<Recording>& getAllRecordings() const { return recordings; }
-    juce::Array<Recording> getFilteredRecordings(const juce::String& filter = {}) const;
+    int getNumRecordings() const { return (int)indexes.getNumRows(); }
+    const Recording* getRecording(RecordingHandle handle) const;
+    RecordingHandle findRecordingByUid(const juce::String& uid) const;
+    RecordingHandle findRecordingByFile(const juce::File& file) const;
+    juce::Array<RecordingHandle> getAllHandles() const;
+    juce::Array<RecordingHandle> getFilteredHandles(const juce::String& query = {}) const;
+    
+    // Sort keys, limit and offset given here override any in the query text. Only
+    // the requested page is put in order, using the cached per-field sort orders
+    juce::Array<RecordingHandle> getFilteredHandles(const juce::String& query,
+                                                    const std::vector<LibraryQuery::SortKey>& sortKeys,
+                                                    int limit = -1, int offset = 0) const;
+    
+    // Thread-safe: the library as of the last change (or batch), for readers off the message thread
+    LibrarySnapshot::Ptr getSnapshot() const { return snapshots.acquire(); }
     
-    // Persistence
+    // Structured queries (see LibraryQuery for the syntax)
+    QueryResult runQuery(const juce::String& queryText) const;
+    QueryResult runQuery(const LibraryQuery& query) const;
+    juce::String explainQuery(const juce::String& queryText) const;
+    
+    // Matches the query against the indexes now, leaving the ordering to a LibrarySearch
+    LibrarySearch::Request prepareSearch(const LibraryQuery& query, const RowBitmap* within = nullptr) const;
+    
+    // Persistence: saves are queued and written in the background
     void saveLibrary();
     void loadLibrary();
     
+    // Called on the message thread when the library can't be written to disk
+    std::function<void(const juce::String& error)> onSaveFailed;
+    
     // Search and filter
-    juce::Array<int> findRecordingsByTag(const juce::String& tag) const;
-    juce::Array<int> searchRecordings(const juce::String& searchTerm) const;
+    juce::Array<RecordingHandle> findRecordingsByTag(const juce::String& tag) const;
+    juce::Array<RecordingHandle> findRecordingsByTagExpression(const juce::String& expression) const;
+    juce::Array<RecordingHandle> searchRecordings(const juce::String& searchTerm) const;
+    juce::Array<RecordingHandle> fuzzySearch(const juce::String& text, int maxResults = 500) const;  // ranked, typo-tolerant
+    juce::Array<RecordingHandle> findRecordingsInRanges(const std::vector<NumericColumns::Predicate>& predicates) const;
+    
+    // Smart playlists: saved queries whose members are kept up to date
+    int getNumSmartPlaylists() const { return smartPlaylists.size(); }
+    const SmartPlaylist* getSmartPlaylist(int index) const { return smartPlaylists.get(index); }
+    int addSmartPlaylist(const juce::String& name, const juce::String& queryText);
+    bool editSmartPlaylist(int index, const juce::String& name, const juce::String& queryText);
+    bool removeSmartPlaylist(int index);
+    juce::Array<RecordingHandle> getSmartPlaylistHandles(int index) const;
+    
+    // Totals and facet counts, kept up to date with every change
+    const LibraryAggregates& getAggregates() const { return indexes.aggregates; }
+    
+    // Tags
+    std::vector<std::pair<juce::String, int>> getTagCounts() const { return indexes.tags.getTagCounts(); }
+    int getTagCount(const juce::String& tag) const;
+    bool renameTag(const juce::String& oldName, const juce::String& newName);
 
 private:
-    juce::Array<Recording> recordings;
+    LibrarySnapshot::Builder recordings;
+    LibrarySnapshotPublisher snapshots;
+    juce::uint64 snapshotVersion = 0;
+    
+    struct PendingChange
+    {
+        enum class Kind { inserted, updated, removed };
+        
+        Kind kind;
+        int fields = 0;
+    };
+    
+    std::unordered_map<LibraryRow, PendingChange> pendingChanges;
+    std::vector<LibraryRow> pendingOrder;
+    bool pendingReset = false;
+    juce::ListenerList<Listener> listeners;
+    std::unordered_map<std::string, LibraryRow> rowsByUid;
+    std::unordered_map<std::string, LibraryRow> rowsByPath;
+    LibraryRow nextRow = 0; // Never reset, so stale handles can't alias new recordings
+    int batchDepth = 0;
+    int today = 0;          // day number, for noticing when relative dates move on
+    bool batchChanged = false;
+    LibraryIndexes indexes;
+    SmartPlaylists smartPlaylists;
     juce::File libraryFile;
+    std::unique_ptr<LibraryPersistence> persistence;
     juce::File recordingsDirectory;
-    juce::AudioFormatManager formatManager;
     
     void ensureDirectoriesExist();
-    Recording createRecordingFromFile(const juce::File& file);
-    bool isAudioFile(const juce::File& file);
-    juce::StringArray extractTagsFromFilename(const juce::String& filename);
+    RecordingHandle appendRecording(Recording recording);
+    void clearRecordings();
+    void libraryChanged();
+    void timerCallback() override;
+    static int getDayNumber(juce::Time time);
+    void endBatch();
+    void publishSnapshot();
+    void noteInserted(LibraryRow row);
+    void noteUpdated(LibraryRow row, int fields);
+    void noteRemoved(LibraryRow row);
+    void notifyListeners();
+    SmartPlaylists::RecordingLookup getRecordingLookup() const;
+    SmartPlaylists::QueryRunner getQueryRunner() const;
+    static int getChangedFields(const Recording& before, const Recording& after);
+    const Recording* getRecordingForRow(LibraryRow row) const;
+    static juce::Array<RecordingHandle> handlesForRows(const std::vector<LibraryRow>& rows);
+    static juce::StringArray extractTagsFromFilename(const juce::String& filename);
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryManager)
 };
\ No newline at end of file
@@ -0,0 +1,676 @@
+#include "LibraryManifest.h"
+
+namespace
+{
+    const char* const columnNames[] = { "uid", "path", "name", "duration", "sample_rate", "channels",
+                                        "tags", "artist", "genre", "track", "timestamp" };
+
+    // CSV keeps all the tags in one column, separated by ';', with '\' escaping a ';' or '\' inside a tag
+    juce::String joinTags(const juce::StringArray& tags)
+    {
+        juce::StringArray escaped;
+
+        for (const auto& tag : tags)
+            escaped.add(tag.replace("\\", "\\\\").replace(";", "\\;"));
+
+        return escaped.joinIntoString(";");
+    }
+
+    juce::StringArray splitTags(const juce::String& text)
+    {
+        juce::StringArray tags;
+        juce::String tag;
+
+        for (auto p = text.getCharPointer(); !p.isEmpty(); ++p)
+        {
+            if (*p == '\\' && p[1] != 0)
+            {
+                ++p;
+                tag += *p;
+            }
+            else if (*p == ';')
+            {
+                tags.add(tag);
+                tag.clear();
+            }
+            else
+            {
+                tag += *p;
+            }
+        }
+
+        tags.add(tag);
+        return tags;
+    }
+
+    void appendNumber(std::string& out, double value)
+    {
+        if (!std::isfinite(value))
+            value = 0.0;
+
+        char text[32];
+        auto length = std::snprintf(text, sizeof(text), "%.10g", value);
+        out.append(text, (size_t)juce::jmax(0, length));
+    }
+
+    void appendUtf8(std::string& out, juce::uint32 codePoint)
+    {
+        if (codePoint < 0x80)
+        {
+            out += (char)codePoint;
+        }
+        else if (codePoint < 0x800)
+        {
+            out += (char)(0xc0 | (codePoint >> 6));
+            out += (char)(0x80 | (codePoint & 0x3f));
+        }
+        else if (codePoint < 0x10000)
+        {
+            out += (char)(0xe0 | (codePoint >> 12));
+            out += (char)(0x80 | ((codePoint >> 6) & 0x3f));
+            out += (char)(0x80 | (codePoint & 0x3f));
+        }
+        else
+        {
+            out += (char)(0xf0 | (codePoint >> 18));
+            out += (char)(0x80 | ((codePoint >> 12) & 0x3f));
+            out += (char)(0x80 | ((codePoint >> 6) & 0x3f));
+            out += (char)(0x80 | (codePoint & 0x3f));
+        }
+    }
+
+    juce::String toString(const std::string& utf8)
+    {
+        return juce::String::fromUTF8(utf8.data(), (int)utf8.size());
+    }
+
+    //==============================================================================
+    // Minimal scanner for the flat JSON objects the manifest uses
+    struct JsonScanner
+    {
+        const char* p;
+        const char* end;
+
+        void skipWhitespace() noexcept
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+                ++p;
+        }
+
+        bool consume(char c) noexcept
+        {
+            skipWhitespace();
+
+            if (p < end && *p == c)
+            {
+                ++p;
+                return true;
+            }
+
+            return false;
+        }
+
+        bool readHex4(juce::uint32& value) noexcept
+        {
+            if (end - p < 4)
+                return false;
+
+            value = 0;
+
+            for (int i = 0; i < 4; ++i)
+            {
+                auto digit = juce::CharacterFunctions::getHexDigitValue((juce::juce_wchar)(juce::uint8)*p++);
+                if (digit < 0)
+                    return false;
+
+                value = (value << 4) | (juce::uint32)digit;
+            }
+
+            return true;
+        }
+
+        bool readString(std::string& out)
+        {
+            out.clear();
+
+            if (!consume('"'))
+                return false;
+
+            while (p < end)
+            {
+                auto c = *p++;
+
+                if (c == '"')
+                    return true;
+
+                if (c != '\\')
+                {
+                    out += c;
+                    continue;
+                }
+
+                if (p >= end)
+                    return false;
+
+                switch (*p++)
+                {
+                    case '"':   out += '"'; break;
+                    case '\\':  out += '\\'; break;
+                    case '/':   out += '/'; break;
+                    case 'b':   out += '\b'; break;
+                    case 'f':   out += '\f'; break;
+                    case 'n':   out += '\n'; break;
+                    case 'r':   out += '\r'; break;
+                    case 't':   out += '\t'; break;
+
+                    case 'u':
+                    {
+                        juce::uint32 codePoint;
+                        if (!readHex4(codePoint))
+                            return false;
+
+                        // Surrogate pair
+                        if (codePoint >= 0xd800 && codePoint < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+                        {
+                            p += 2;
+                            juce::uint32 low;
+                            if (!readHex4(low))
+                                return false;
+
+                            codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                        }
+
+                        appendUtf8(out, codePoint);
+                        break;
+                    }
+
+                    default:
+                        return false;
+                }
+            }
+
+            return false;
+        }
+
+        // Numbers and true/false/null, returned as their text
+        bool readScalar(std::string& out)
+        {
+            skipWhitespace();
+            out.clear();
+
+            while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+                out += *p++;
+
+            return !out.empty();
+        }
+
+        bool readValue(std::string& out)
+        {
+            skipWhitespace();
+            return p < end && *p == '"' ? readString(out) : readScalar(out);
+        }
+    };
+}
+
+//==============================================================================
+juce::String ManifestImportResult::describe() const
+{
+    juce::String text;
+    text << "Read " << rowsRead << " rows: " << updated << " updated, " << unchanged << " unchanged, "
+         << unmatched << " not in the library";
+
+    if (!errors.isEmpty())
+        text << " (" << errors.size() << (errors.size() >= maxReportedErrors ? "+" : "") << " errors)";
+
+    return text;
+}
+
+LibraryManifest::Format LibraryManifest::getFormatForFile(const juce::File& file)
+{
+    return file.hasFileExtension("csv") ? Format::csv : Format::jsonLines;
+}
+
+//==============================================================================
+void LibraryManifest::appendJson(std::string& out, const juce::String& text)
+{
+    out += '"';
+
+    for (auto* s = text.toRawUTF8(); *s != 0; ++s)
+    {
+        auto c = (juce::uint8)*s;
+
+        switch (c)
+        {
+            case '"':   out += "\\\""; break;
+            case '\\':  out += "\\\\"; break;
+            case '\n':  out += "\\n"; break;
+            case '\r':  out += "\\r"; break;
+            case '\t':  out += "\\t"; break;
+
+            default:
+                if (c < 0x20)
+                {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+                    out += escaped;
+                }
+                else
+                {
+                    out += (char)c;
+                }
+                break;
+        }
+    }
+
+    out += '"';
+}
+
+void LibraryManifest::appendCsv(std::string& out, const juce::String& text)
+{
+    auto* s = text.toRawUTF8();
+
+    if (std::strpbrk(s, ",\"\r\n") == nullptr)
+    {
+        out += s;
+        return;
+    }
+
+    out += '"';
+
+    for (; *s != 0; ++s)
+    {
+        if (*s == '"')
+            out += '"';
+
+        out += *s;
+    }
+
+    out += '"';
+}
+
+LibraryManifest::Writer::Writer(juce::OutputStream& output, Format f)
+    : stream(output), format(f)
+{
+    line.reserve(1024);
+
+    if (format == Format::csv)
+    {
+        line.clear();
+
+        for (auto* name : columnNames)
+        {
+            if (!line.empty())
+                line += ',';
+
+            line += name;
+        }
+
+        line += '\n';
+        stream.write(line.data(), line.size());
+    }
+}
+
+void LibraryManifest::Writer::write(const Recording& r)
+{
+    line.clear();
+
+    if (format == Format::jsonLines)
+    {
+        line += "{\"uid\":";            appendJson(line, r.uid);
+        line += ",\"path\":";           appendJson(line, r.file.getFullPathName());
+        line += ",\"name\":";           appendJson(line, r.name);
+        line += ",\"duration\":";       appendNumber(line, r.durationInSeconds);
+        line += ",\"sample_rate\":";    appendNumber(line, r.sampleRate);
+        line += ",\"channels\":";       appendNumber(line, r.numChannels);
+        line += ",\"tags\":[";
+
+        for (int i = 0; i < r.tags.size(); ++i)
+        {
+            if (i > 0)
+                line += ',';
+
+            appendJson(line, r.tags[i]);
+        }
+
+        line += "],\"artist\":";        appendJson(line, r.artist);
+        line += ",\"genre\":";          appendJson(line, r.genre);
+        line += ",\"track\":";          appendNumber(line, r.trackNumber);
+        line += ",\"timestamp\":";      appendJson(line, r.timestamp.toISO8601(true));
+        line += "}\n";
+    }
+    else
+    {
+        appendCsv(line, r.uid);                                 line += ',';
+        appendCsv(line, r.file.getFullPathName());              line += ',';
+        appendCsv(line, r.name);                                line += ',';
+        appendNumber(line, r.durationInSeconds);                line += ',';
+        appendNumber(line, r.sampleRate);                       line += ',';
+        appendNumber(line, r.numChannels);                      line += ',';
+        appendCsv(line, joinTags(r.tags));                      line += ',';
+        appendCsv(line, r.artist);                              line += ',';
+        appendCsv(line, r.genre);                               line += ',';
+        appendNumber(line, r.trackNumber);                      line += ',';
+        appendCsv(line, r.timestamp.toISO8601(true));
+        line += '\n';
+    }
+
+    stream.write(line.data(), line.size());
+    ++numWritten;
+}
+
+bool LibraryManifest::write(const LibrarySnapshot& snapshot, const juce::Array<RecordingHandle>& handles,
+                            const juce::File& file, juce::String& error)
+{
+    juce::TemporaryFile temp(file);
+
+    {
+        juce::FileOutputStream output(temp.getFile(), 1 << 16);
+        if (!output.openedOk())
+        {
+            error = "Couldn't write " + file.getFullPathName();
+            return false;
+        }
+
+        Writer writer(output, getFormatForFile(file));
+
+        for (auto handle : handles)
+            if (auto* recording = snapshot.getRecording(handle))
+                writer.write(*recording);
+
+        output.flush();
+        if (output.getStatus().failed())
+        {
+            error = output.getStatus().getErrorMessage();
+            return false;
+        }
+    }
+
+    if (!temp.overwriteTargetFileWithTemporary())
+    {
+        error = "Couldn't replace " + file.getFullPathName();
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+void LibraryManifest::applyColumn(ManifestEntry& entry, const std::string& column, const juce::String& value,
+                                  const juce::StringArray* list)
+{
+    auto& r = entry.recording;
+
+    if (column == "uid" || column == "id")
+    {
+        entry.uid = value;
+    }
+    else if (column == "path" || column == "file")
+    {
+        // Relative paths can't name a library file
+        if (juce::File::isAbsolutePath(value))
+        {
+            r.file = juce::File(value);
+            entry.fields |= LibraryDelta::fileField;
+        }
+    }
+    else if (column == "name" || column == "title")
+    {
+        r.name = value;
+        entry.fields |= LibraryDelta::nameField;
+    }
+    else if (column == "duration" || column == "duration_seconds")
+    {
+        r.durationInSeconds = value.getDoubleValue();
+        entry.fields |= LibraryDelta::durationField;
+    }
+    else if (column == "sample_rate" || column == "samplerate" || column == "rate")
+    {
+        r.sampleRate = value.getDoubleValue();
+        entry.fields |= LibraryDelta::sampleRateField;
+    }
+    else if (column == "channels" || column == "num_channels")
+    {
+        r.numChannels = value.getIntValue();
+        entry.fields |= LibraryDelta::channelsField;
+    }
+    else if (column == "tags" || column == "labels")
+    {
+        if (list != nullptr)
+            r.tags = *list;
+        else
+            r.tags = splitTags(value);
+
+        r.tags.trim();
+        r.tags.removeEmptyStrings();
+        entry.fields |= LibraryDelta::tagsField;
+    }
+    else if (column == "artist")
+    {
+        r.artist = value;
+        entry.fields |= LibraryDelta::artistField;
+    }
+    else if (column == "genre")
+    {
+        r.genre = value;
+        entry.fields |= LibraryDelta::genreField;
+    }
+    else if (column == "track" || column == "track_number")
+    {
+        r.trackNumber = value.getIntValue();
+        entry.fields |= LibraryDelta::trackNumberField;
+    }
+    else if (column == "timestamp")
+    {
+        // ISO 8601 as written, or milliseconds since the epoch
+        r.timestamp = value.containsChar('-') ? juce::Time::fromISO8601(value)
+                                              : juce::Time(value.getLargeIntValue());
+        entry.fields |= LibraryDelta::timestampField;
+    }
+}
+
+bool LibraryManifest::parseJsonLine(const char* p, const char* end, ManifestEntry& entry)
+{
+    JsonScanner json { p, end };
+    std::string key, value;
+
+    if (!json.consume('{'))
+        return false;
+
+    if (json.consume('}'))
+        return true;
+
+    for (;;)
+    {
+        if (!json.readString(key) || !json.consume(':'))
+            return false;
+
+        for (auto& c : key)
+            c = (char)std::tolower((unsigned char)c);
+
+        json.skipWhitespace();
+
+        if (json.p < json.end && *json.p == '[')
+        {
+            ++json.p;
+            juce::StringArray list;
+
+            if (!json.consume(']'))
+            {
+                do
+                {
+                    if (!json.readValue(value))
+                        return false;
+
+                    list.add(toString(value));
+                }
+                while (json.consume(','));
+
+                if (!json.consume(']'))
+                    return false;
+            }
+
+            applyColumn(entry, key, {}, &list);
+        }
+        else
+        {
+            if (!json.readValue(value))
+                return false;
+
+            if (value != "null")
+                applyColumn(entry, key, toString(value), nullptr);
+        }
+
+        if (json.consume('}'))
+            return true;
+
+        if (!json.consume(','))
+            return false;
+    }
+}
+
+int LibraryManifest::read(juce::InputStream& input, Format format,
+                          const std::function<bool (const ManifestEntry&)>& onEntry,
+                          juce::StringArray& errors)
+{
+    std::string buffer;
+    std::vector<char> block((size_t)1 << 16);
+    std::vector<std::string> header, fields;
+    size_t scanned = 0;
+    bool inQuotes = false;
+    int delivered = 0, recordNumber = 0;
+    bool stopped = false;
+
+    auto reportError = [&errors, &recordNumber](const juce::String& message)
+    {
+        if (errors.size() < ManifestImportResult::maxReportedErrors)
+            errors.add("Row " + juce::String(recordNumber) + ": " + message);
+    };
+
+    auto splitCsv = [&fields](const char* p, const char* end)
+    {
+        fields.clear();
+        fields.emplace_back();
+
+        for (bool quoted = false; p < end; ++p)
+        {
+            if (quoted)
+            {
+                if (*p != '"')
+                    fields.back() += *p;
+                else if (p + 1 < end && p[1] == '"')
+                    fields.back() += *p++;
+                else
+                    quoted = false;
+            }
+            else if (*p == '"')
+            {
+                quoted = true;
+            }
+            else if (*p == ',')
+            {
+                fields.emplace_back();
+            }
+            else
+            {
+                fields.back() += *p;
+            }
+        }
+    };
+
+    auto handleRecord = [&](const char* p, const char* end)
+    {
+        ++recordNumber;
+
+        if (recordNumber == 1 && end - p >= 3 && std::memcmp(p, "\xef\xbb\xbf", 3) == 0)
+            p += 3;
+
+        while (end > p && (end[-1] == '\r' || end[-1] == ' '))
+            --end;
+
+        if (p == end)
+            return;
+
+        ManifestEntry entry;
+
+        if (format == Format::jsonLines)
+        {
+            if (!parseJsonLine(p, end, entry))
+            {
+                reportError("not a flat JSON object");
+                return;
+            }
+        }
+        else
+        {
+            splitCsv(p, end);
+
+            if (header.empty())
+            {
+                for (auto name : fields)
+                {
+                    for (auto& c : name)
+                        c = (char)std::tolower((unsigned char)c);
+
+                    header.push_back(juce::String(name).trim().toStdString());
+                }
+
+                return;
+            }
+
+            if (fields.size() != header.size())
+            {
+                reportError("expected " + juce::String((int)header.size()) + " columns, found " + juce::String((int)fields.size()));
+                return;
+            }
+
+            for (size_t i = 0; i < juce::jmin(fields.size(), header.size()); ++i)
+                applyColumn(entry, header[i], toString(fields[i]), nullptr);
+        }
+
+        stopped = !onEntry(entry);
+        ++delivered;
+    };
+
+    for (;;)
+    {
+        auto numRead = input.read(block.data(), (int)block.size());
+        auto atEnd = numRead <= 0;
+
+        if (!atEnd)
+            buffer.append(block.data(), (size_t)numRead);
+
+        // A CSV record only ends at a newline outside quotes
+        size_t start = 0;
+
+        for (auto i = scanned; i < buffer.size() && !stopped; ++i)
+        {
+            auto c = buffer[i];
+
+            if (c == '"' && format == Format::csv)
+            {
+                inQuotes = !inQuotes;
+            }
+            else if (c == '\n' && !inQuotes)
+            {
+                handleRecord(buffer.data() + start, buffer.data() + i);
+                start = i + 1;
+            }
+        }
+
+        if (stopped)
+            break;
+
+        buffer.erase(0, start);
+        scanned = buffer.size();
+
+        if (atEnd)
+        {
+            if (!buffer.empty())
+                handleRecord(buffer.data(), buffer.data() + buffer.size());
+
+            break;
+        }
+    }
+
+    return delivered;
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioRecorder.h"
+#include "LibraryTypes.h"
+#include "LibrarySnapshot.h"
+
+//==============================================================================
+// One row of a manifest. Only the fields present in the file are set.
+struct ManifestEntry
+{
+    juce::String uid;
+    Recording recording;
+    int fields = 0;     // LibraryDelta field bits
+};
+
+struct ManifestImportResult
+{
+    static constexpr int maxReportedErrors = 100;
+
+    int rowsRead = 0;
+    int updated = 0;
+    int unchanged = 0;
+    int unmatched = 0;
+    juce::StringArray errors;       // the first maxReportedErrors of them
+
+    void addError(const juce::String& error)    { if (errors.size() < maxReportedErrors) errors.add(error); }
+    juce::String describe() const;
+};
+
+//==============================================================================
+/**
+    Streaming manifests of recordings for external tools, as JSON Lines (one
+    object per line) or CSV with a header row.
+
+    The writer emits one row at a time and the reader hands back one entry at
+    a time from a buffered scan of the stream, so neither ever holds the whole
+    document. The reader expects the flat shape the writer produces (strings,
+    numbers and, in JSON, arrays of strings) and skips columns it doesn't
+    know, so files that other tools have added columns to still import.
+*/
+class LibraryManifest
+{
+public:
+    enum class Format
+    {
+        jsonLines,
+        csv
+    };
+
+    static Format getFormatForFile(const juce::File& file);
+
+    //==============================================================================
+    class Writer
+    {
+    public:
+        Writer(juce::OutputStream& output, Format format);
+
+        void write(const Recording& recording);
+        int getNumWritten() const noexcept      { return numWritten; }
+
+    private:
+        juce::OutputStream& stream;
+        Format format;
+        std::string line;
+        int numWritten = 0;
+
+        JUCE_DECLARE_NON_COPYABLE(Writer)
+    };
+
+    // Thread-safe: reads only the snapshot, so it can run off the message thread
+    static bool write(const LibrarySnapshot& snapshot, const juce::Array<RecordingHandle>& handles,
+                      const juce::File& file, juce::String& error);
+
+    //==============================================================================
+    /** Calls onEntry for every row in the stream, in order, until it returns
+        false. Malformed rows are skipped and the first few reported in errors;
+        returns the number of rows delivered.
+    */
+    static int read(juce::InputStream& input, Format format,
+                    const std::function<bool (const ManifestEntry&)>& onEntry,
+                    juce::StringArray& errors);
+
+private:
+    static void appendJson(std::string& out, const juce::String& text);
+    static void appendCsv(std::string& out, const juce::String& text);
+
+    static bool parseJsonLine(const char* p, const char* end, ManifestEntry& entry);
+    static void applyColumn(ManifestEntry& entry, const std::string& column, const juce::String& value,
+                            const juce::StringArray* list);
+};
\ No newline at end of file
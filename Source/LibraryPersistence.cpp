@@ -0,0 +1,156 @@
+#include "LibraryPersistence.h"
+
+LibraryPersistence::LibraryPersistence(const juce::File& libraryFile)
+    : juce::Thread("Library Saver"), file(libraryFile)
+{
+    startThread();
+}
+
+LibraryPersistence::~LibraryPersistence()
+{
+    flush();
+
+    {
+        std::lock_guard<std::mutex> sl(lock);
+        stopping = true;
+    }
+
+    wakeUp.notify_all();
+    stopThread(5000);
+    cancelPendingUpdate();
+}
+
+void LibraryPersistence::save(LibrarySnapshot::Ptr snapshot, std::vector<SmartPlaylist> playlists)
+{
+    {
+        std::lock_guard<std::mutex> sl(lock);
+
+        auto now = Clock::now();
+        if (pending == nullptr)
+            firstQueued = now;
+
+        lastQueued = now;
+
+        // Anything still waiting is superseded by this one
+        pending = std::make_unique<Job>();
+        pending->snapshot = std::move(snapshot);
+        pending->playlists = std::move(playlists);
+        pending->generation = ++queuedGeneration;
+    }
+
+    wakeUp.notify_all();
+}
+
+void LibraryPersistence::flush()
+{
+    std::unique_lock<std::mutex> sl(lock);
+
+    auto target = queuedGeneration;
+    flushRequested = true;
+    wakeUp.notify_all();
+
+    written.wait(sl, [this, target] { return writtenGeneration >= target; });
+    flushRequested = false;
+}
+
+void LibraryPersistence::run()
+{
+    for (;;)
+    {
+        std::unique_ptr<Job> job;
+
+        {
+            std::unique_lock<std::mutex> sl(lock);
+            wakeUp.wait(sl, [this] { return pending != nullptr || stopping; });
+
+            if (pending == nullptr)
+                return;
+
+            // Let a burst of changes settle, unless someone is waiting on the write
+            while (!flushRequested && !stopping)
+            {
+                auto deadline = juce::jmin(lastQueued + std::chrono::milliseconds(debounceMs),
+                                           firstQueued + std::chrono::milliseconds(maxDelayMs));
+
+                if (Clock::now() >= deadline)
+                    break;
+
+                wakeUp.wait_until(sl, deadline);
+            }
+
+            job = std::move(pending);
+        }
+
+        auto result = write(*job);
+        auto newlyFailing = result.failed() && !failing;
+        failing = result.failed();
+
+        {
+            std::lock_guard<std::mutex> sl(lock);
+            writtenGeneration = job->generation;
+
+            if (newlyFailing)
+                failure = "Couldn't save the library to " + file.getFullPathName() + "\n\n" + result.getErrorMessage();
+        }
+
+        written.notify_all();
+
+        if (newlyFailing)
+            triggerAsyncUpdate();
+    }
+}
+
+void LibraryPersistence::handleAsyncUpdate()
+{
+    juce::String error;
+
+    {
+        std::lock_guard<std::mutex> sl(lock);
+        error = failure;
+    }
+
+    if (onSaveFailed != nullptr)
+        onSaveFailed(error);
+}
+
+juce::Result LibraryPersistence::write(const Job& job)
+{
+    juce::ValueTree libraryTree("LIBRARY");
+    libraryTree.setProperty("version", "1.0", nullptr);
+    libraryTree.setProperty("created", juce::Time::getCurrentTime().toISO8601(false), nullptr);
+
+    job.snapshot->forEach([&libraryTree](RecordingHandle, const Recording& recording)
+    {
+        libraryTree.addChild(recording.toValueTree(), -1, nullptr);
+    });
+
+    const auto& snapshot = *job.snapshot;
+    libraryTree.addChild(SmartPlaylists::toValueTree(job.playlists, [&snapshot](LibraryRow row)
+    {
+        return snapshot.getRecording({ row });
+    }), -1, nullptr);
+
+    auto xml = libraryTree.createXml();
+    if (xml == nullptr)
+        return juce::Result::fail("The library couldn't be converted to XML");
+
+    juce::TemporaryFile temp(file);
+
+    {
+        juce::FileOutputStream output(temp.getFile(), 1 << 16);
+        if (!output.openedOk())
+            return output.getStatus();
+
+        xml->writeTo(output);
+
+        // FileOutputStream::flush() syncs the file to disk before the rename
+        output.flush();
+        if (output.getStatus().failed())
+            return output.getStatus();
+    }
+
+    if (!temp.overwriteTargetFileWithTemporary())
+        return juce::Result::fail("The old library file couldn't be replaced");
+
+    return juce::Result::ok();
+}
\ No newline at end of file
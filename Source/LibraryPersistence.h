@@ -0,0 +1,67 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LibrarySnapshot.h"
+#include "SmartPlaylists.h"
+
+//==============================================================================
+/**
+    Writes library.xml on a background thread.
+
+    Saves are coalesced: each request replaces the one still waiting, and the
+    writer only starts once requests have stopped arriving for debounceMs (or
+    maxDelayMs after the first of a burst). The library is serialised from an
+    immutable snapshot, written to a temporary file, synced to disk and then
+    renamed over the old file, so a crash leaves either the old library or
+    the new one, never a partial file. A failed write is reported once, until
+    a later one succeeds.
+*/
+class LibraryPersistence : private juce::Thread,
+                           private juce::AsyncUpdater
+{
+public:
+    explicit LibraryPersistence(const juce::File& libraryFile);
+    ~LibraryPersistence() override;
+
+    // Message thread: queue the library as of this snapshot to be written
+    void save(LibrarySnapshot::Ptr snapshot, std::vector<SmartPlaylist> playlists);
+
+    // Message thread: blocks until everything queued so far is on disk
+    void flush();
+
+    // Called on the message thread when saving starts failing
+    std::function<void(const juce::String& error)> onSaveFailed;
+
+private:
+    struct Job
+    {
+        LibrarySnapshot::Ptr snapshot;
+        std::vector<SmartPlaylist> playlists;
+        juce::uint64 generation = 0;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    void run() override;
+    void handleAsyncUpdate() override;
+    juce::Result write(const Job& job);
+
+    const juce::File file;
+
+    std::mutex lock;
+    std::condition_variable wakeUp, written;
+    std::unique_ptr<Job> pending;
+    Clock::time_point firstQueued, lastQueued;
+    juce::uint64 queuedGeneration = 0, writtenGeneration = 0;
+    bool flushRequested = false;
+    bool stopping = false;
+    juce::String failure;
+
+    // Writer thread only
+    bool failing = false;
+
+    static constexpr int debounceMs = 500;
+    static constexpr int maxDelayMs = 5000;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryPersistence)
+};
\ No newline at end of file
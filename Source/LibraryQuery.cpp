@@ -0,0 +1,1287 @@
+#include "LibraryQuery.h"
+
+namespace
+{
+    constexpr double infinity = std::numeric_limits<double>::infinity();
+
+    //==============================================================================
+    struct Token
+    {
+        enum class Type { term, openParen, closeParen, andOp, orOp, notOp };
+
+        Type type = Type::term;
+        juce::String text;
+        bool quoted = false;
+    };
+
+    // Reads up to and past the closing quote. Only \" and \\ are escapes, so
+    // Windows paths can still be typed with single backslashes.
+    void readQuoted(juce::String::CharPointerType& p, juce::String& text)
+    {
+        while (!p.isEmpty() && *p != '"')
+        {
+            if (*p == '\\' && (p[1] == '"' || p[1] == '\\'))
+                ++p;
+
+            text += *p++;
+        }
+
+        if (!p.isEmpty())
+            ++p;
+    }
+
+    std::vector<Token> tokenise(const juce::String& input)
+    {
+        std::vector<Token> tokens;
+        auto p = input.getCharPointer();
+
+        auto isWordBreak = [](juce::juce_wchar c)
+        {
+            return c == 0 || juce::CharacterFunctions::isWhitespace(c) || c == '(' || c == ')';
+        };
+
+        while (!p.isEmpty())
+        {
+            auto c = *p;
+
+            if (juce::CharacterFunctions::isWhitespace(c))
+            {
+                ++p;
+            }
+            else if (c == '(' || c == ')')
+            {
+                tokens.push_back({ c == '(' ? Token::Type::openParen : Token::Type::closeParen, {}, false });
+                ++p;
+            }
+            else if ((c == '-' || c == '!') && !isWordBreak(p[1]))
+            {
+                tokens.push_back({ Token::Type::notOp, {}, false });
+                ++p;
+            }
+            else if (c == '"')
+            {
+                ++p;
+                juce::String phrase;
+                readQuoted(p, phrase);
+                tokens.push_back({ Token::Type::term, phrase, true });
+            }
+            else
+            {
+                // A word, which may contain a quoted value as in artist:"foo bar"
+                juce::String word;
+                while (!isWordBreak(*p))
+                {
+                    if (*p == '"')
+                    {
+                        ++p;
+                        readQuoted(p, word);
+                    }
+                    else
+                    {
+                        word += *p++;
+                    }
+                }
+
+                // Keywords ignore case like everything else; quote them to search for the words
+                if (word.equalsIgnoreCase("AND") || word == "&&")       tokens.push_back({ Token::Type::andOp, {}, false });
+                else if (word.equalsIgnoreCase("OR") || word == "||")   tokens.push_back({ Token::Type::orOp, {}, false });
+                else if (word.equalsIgnoreCase("NOT"))                  tokens.push_back({ Token::Type::notOp, {}, false });
+                else                                                    tokens.push_back({ Token::Type::term, word, false });
+            }
+        }
+
+        return tokens;
+    }
+
+    //==============================================================================
+    bool findSortField(const juce::String& name, LibraryQuery::SortField& field)
+    {
+        auto n = name.toLowerCase();
+
+        if (n == "name" || n == "title")                          field = LibraryQuery::SortField::name;
+        else if (n == "duration" || n == "length")                field = LibraryQuery::SortField::duration;
+        else if (n == "date" || n == "timestamp" || n == "recorded" || n == "time")
+                                                                  field = LibraryQuery::SortField::timestamp;
+        else if (n == "tag" || n == "tags")                       field = LibraryQuery::SortField::tags;
+        else if (n == "artist")                                   field = LibraryQuery::SortField::artist;
+        else if (n == "genre")                                    field = LibraryQuery::SortField::genre;
+        else if (n == "track" || n == "tracknumber")              field = LibraryQuery::SortField::trackNumber;
+        else if (n == "rate" || n == "samplerate")                field = LibraryQuery::SortField::sampleRate;
+        else if (n == "channels")                                 field = LibraryQuery::SortField::channels;
+        else return false;
+
+        return true;
+    }
+
+    bool findTextField(const juce::String& name, TextIndex::Field& field)
+    {
+        if (name == "name" || name == "title")          field = TextIndex::nameField;
+        else if (name == "uid" || name == "id")         field = TextIndex::uidField;
+        else if (name == "artist")                      field = TextIndex::artistField;
+        else if (name == "genre")                       field = TextIndex::genreField;
+        else if (name == "path" || name == "file")      field = TextIndex::pathField;
+        else if (name == "text" || name == "any")       field = TextIndex::anyField;
+        else return false;
+
+        return true;
+    }
+
+    bool findNumericColumn(const juce::String& name, NumericColumns::Column& column)
+    {
+        if (name == "duration" || name == "length" || name == "dur")                column = NumericColumns::durationColumn;
+        else if (name == "date" || name == "timestamp" || name == "recorded" || name == "time")
+                                                                                      column = NumericColumns::timestampColumn;
+        else if (name == "rate" || name == "samplerate" || name == "sr")            column = NumericColumns::sampleRateColumn;
+        else if (name == "channels" || name == "ch")                                column = NumericColumns::channelsColumn;
+        else if (name == "track" || name == "tracknumber")                          column = NumericColumns::trackNumberColumn;
+        else return false;
+
+        return true;
+    }
+
+    //==============================================================================
+    // Parses a value for a numeric column into the span it covers: a single
+    // point for plain numbers, a whole day/month/year for calendar dates.
+    bool parseDuration(juce::String text, double& seconds)
+    {
+        text = text.trim().toLowerCase();
+        if (text.isEmpty())
+            return false;
+
+        if (text.containsChar(':'))
+        {
+            // h:mm:ss or mm:ss
+            auto parts = juce::StringArray::fromTokens(text, ":", "");
+            seconds = 0.0;
+            for (auto& part : parts)
+                seconds = seconds * 60.0 + part.getDoubleValue();
+            return true;
+        }
+
+        double scale = 1.0;
+        if (text.endsWith("min"))           { scale = 60.0;   text = text.dropLastCharacters(3); }
+        else if (text.endsWithChar('h'))    { scale = 3600.0; text = text.dropLastCharacters(1); }
+        else if (text.endsWithChar('m'))    { scale = 60.0;   text = text.dropLastCharacters(1); }
+        else if (text.endsWithChar('s'))    { text = text.dropLastCharacters(1); }
+
+        if (!text.containsOnly("0123456789.") || text.isEmpty())
+            return false;
+
+        seconds = text.getDoubleValue() * scale;
+        return true;
+    }
+
+    bool parseSampleRate(juce::String text, double& rate)
+    {
+        text = text.trim().toLowerCase();
+        if (text.endsWith("hz"))
+            text = text.dropLastCharacters(2);
+
+        double scale = 1.0;
+        if (text.endsWithChar('k'))
+        {
+            scale = 1000.0;
+            text = text.dropLastCharacters(1);
+        }
+
+        if (!text.containsOnly("0123456789.") || text.isEmpty())
+            return false;
+
+        rate = text.getDoubleValue() * scale;
+        return true;
+    }
+
+    bool parseDate(juce::String text, double& start, double& end)
+    {
+        text = text.trim().toLowerCase();
+        auto now = juce::Time::getCurrentTime();
+        auto startOfToday = juce::Time(now.getYear(), now.getMonth(), now.getDayOfMonth(), 0, 0, 0, 0, true);
+        constexpr double dayMs = 24.0 * 60.0 * 60.0 * 1000.0;
+
+        if (text == "today" || text == "yesterday")
+        {
+            start = (double)startOfToday.toMilliseconds() - (text == "yesterday" ? dayMs : 0.0);
+            end = start + dayMs - 1.0;
+            return true;
+        }
+
+        if (text.startsWithChar('-'))
+        {
+            // Relative: -30d, -2w, -6mo, -1y. Not -6m, which would read as minutes in a duration
+            auto number = text.substring(1).initialSectionContainingOnly("0123456789");
+            auto unit = text.substring(1 + number.length());
+            auto amount = number.getIntValue();
+            auto t = now;
+
+            if (number.isEmpty())                   return false;
+            if (unit == "d")                        t = now - juce::RelativeTime::days(amount);
+            else if (unit == "w")                   t = now - juce::RelativeTime::weeks(amount);
+            else if (unit == "mo")                  t = now - juce::RelativeTime::days(30.4375 * amount);
+            else if (unit == "y")                   t = now - juce::RelativeTime::days(365.25 * amount);
+            else return false;
+
+            start = end = (double)t.toMilliseconds();
+            return true;
+        }
+
+        auto parts = juce::StringArray::fromTokens(text, "-/", "");
+        if (parts.isEmpty() || parts.size() > 3 || !text.containsOnly("0123456789-/"))
+            return false;
+
+        auto year = parts[0].getIntValue();
+        if (year < 1900)
+            return false;
+
+        if (parts.size() == 1)
+        {
+            start = (double)juce::Time(year, 0, 1, 0, 0).toMilliseconds();
+            end = (double)juce::Time(year + 1, 0, 1, 0, 0).toMilliseconds() - 1.0;
+            return true;
+        }
+
+        auto month = juce::jlimit(1, 12, parts[1].getIntValue()) - 1;
+
+        if (parts.size() == 2)
+        {
+            start = (double)juce::Time(year, month, 1, 0, 0).toMilliseconds();
+            end = (double)(month == 11 ? juce::Time(year + 1, 0, 1, 0, 0)
+                                       : juce::Time(year, month + 1, 1, 0, 0)).toMilliseconds() - 1.0;
+            return true;
+        }
+
+        auto day = juce::jlimit(1, 31, parts[2].getIntValue());
+        start = (double)juce::Time(year, month, day, 0, 0).toMilliseconds();
+        end = start + dayMs - 1.0;
+        return true;
+    }
+
+    bool isRelativeDate(const juce::String& text)
+    {
+        auto date = text.trim().toLowerCase();
+        return date == "today" || date == "yesterday" || date.startsWithChar('-');
+    }
+
+    bool parseNumericValue(NumericColumns::Column column, const juce::String& text, double& start, double& end)
+    {
+        switch (column)
+        {
+            case NumericColumns::durationColumn:
+                if (!parseDuration(text, start)) return false;
+                end = start;
+                return true;
+
+            case NumericColumns::sampleRateColumn:
+                if (!parseSampleRate(text, start)) return false;
+                end = start;
+                return true;
+
+            case NumericColumns::timestampColumn:
+                return parseDate(text, start, end);
+
+            case NumericColumns::channelsColumn:
+            case NumericColumns::trackNumberColumn:
+                if (!text.trim().containsOnly("0123456789") || text.trim().isEmpty()) return false;
+                start = end = (double)text.getIntValue();
+                return true;
+
+            case NumericColumns::numColumns:
+                break;
+        }
+
+        return false;
+    }
+
+    //==============================================================================
+    class QueryParser
+    {
+    public:
+        QueryParser(LibraryQuery& q, std::vector<Token> t) : query(q), tokens(std::move(t)) {}
+
+        LibraryQuery::Node parse()
+        {
+            auto node = parseOr();
+
+            while (!atEnd())
+            {
+                query.errors.add("Unexpected ')'");
+                ++position;
+                node = makeConjunction({ node, parseOr() });
+            }
+
+            return node;
+        }
+
+    private:
+        using Node = LibraryQuery::Node;
+
+        bool atEnd() const              { return position >= tokens.size(); }
+        Token::Type peekType() const    { return tokens[position].type; }
+
+        static Node makeConjunction(std::vector<Node> parts)
+        {
+            Node node;
+            node.type = Node::Type::conjunction;
+
+            for (auto& part : parts)
+            {
+                if (part.type == Node::Type::all)
+                    continue;
+
+                if (part.type == Node::Type::conjunction)
+                    for (auto& child : part.children)
+                        node.children.push_back(std::move(child));
+                else
+                    node.children.push_back(std::move(part));
+            }
+
+            if (node.children.empty())
+                return {};
+
+            if (node.children.size() == 1)
+                return std::move(node.children.front());
+
+            return node;
+        }
+
+        Node parseOr()
+        {
+            std::vector<Node> alternatives;
+            alternatives.push_back(parseAnd());
+
+            while (!atEnd() && peekType() == Token::Type::orOp)
+            {
+                ++position;
+                alternatives.push_back(parseAnd());
+            }
+
+            if (alternatives.size() == 1)
+                return std::move(alternatives.front());
+
+            Node node;
+            node.type = Node::Type::disjunction;
+
+            for (auto& alternative : alternatives)
+            {
+                // "x OR <nothing>" matches everything
+                if (alternative.type == Node::Type::all)
+                    return {};
+
+                node.children.push_back(std::move(alternative));
+            }
+
+            return node;
+        }
+
+        Node parseAnd()
+        {
+            std::vector<Node> parts;
+
+            while (!atEnd() && peekType() != Token::Type::orOp && peekType() != Token::Type::closeParen)
+            {
+                if (peekType() == Token::Type::andOp)
+                {
+                    ++position;
+                    continue;
+                }
+
+                parts.push_back(parseUnary());
+            }
+
+            return makeConjunction(std::move(parts));
+        }
+
+        Node parseUnary()
+        {
+            const auto& token = tokens[position++];
+
+            switch (token.type)
+            {
+                case Token::Type::notOp:
+                {
+                    if (atEnd())
+                        return {};
+
+                    auto operand = parseUnary();
+                    if (operand.type == Node::Type::all)
+                        return {};
+
+                    if (operand.type == Node::Type::negation)
+                        return std::move(operand.children.front());
+
+                    Node node;
+                    node.type = Node::Type::negation;
+                    node.children.push_back(std::move(operand));
+                    return node;
+                }
+
+                case Token::Type::openParen:
+                {
+                    auto inner = parseOr();
+                    if (!atEnd() && peekType() == Token::Type::closeParen)
+                        ++position;
+                    else
+                        query.errors.add("Missing ')'");
+                    return inner;
+                }
+
+                case Token::Type::term:
+                    return parseTerm(token);
+
+                case Token::Type::closeParen:
+                case Token::Type::andOp:
+                case Token::Type::orOp:
+                    break;
+            }
+
+            return {};
+        }
+
+        static Node makeText(const juce::String& value, TextIndex::Field field, bool exact = false)
+        {
+            Node node;
+            node.type = Node::Type::text;
+            node.field = field;
+            node.value = value;
+            node.foldedValue = TextIndex::fold(value);
+            node.exact = exact;
+            return node;
+        }
+
+        Node parseTerm(const Token& token)
+        {
+            if (token.quoted)
+                return makeText(token.text, TextIndex::anyField);
+
+            auto& text = token.text;
+            auto opIndex = text.indexOfAnyOf(":<>=");
+
+            if (opIndex <= 0)
+                return makeText(text, TextIndex::anyField);
+
+            auto fieldName = text.substring(0, opIndex).toLowerCase();
+            auto rest = text.substring(opIndex);
+
+            // Operator: ':' optionally followed by a comparison, or a bare comparison
+            if (rest.startsWithChar(':') && rest.length() > 1 && juce::String("<>=").containsChar(rest[1]))
+                rest = rest.substring(1);
+
+            juce::String op;
+            if (rest.startsWith("<=") || rest.startsWith(">="))
+                op = rest.substring(0, 2);
+            else
+                op = rest.substring(0, 1);
+
+            auto value = rest.substring(op.length()).trim();
+
+            if (fieldName == "sort")
+            {
+                for (auto& key : juce::StringArray::fromTokens(value, ",", ""))
+                {
+                    LibraryQuery::SortKey sortKey { LibraryQuery::SortField::name, key.startsWithChar('-') };
+
+                    if (findSortField(key.trimCharactersAtStart("-+"), sortKey.field))
+                        query.sortKeys.push_back(sortKey);
+                    else
+                        query.errors.add("Unknown sort field '" + key + "'");
+                }
+
+                return {};
+            }
+
+            if (fieldName == "limit" || fieldName == "offset")
+            {
+                if (!value.containsOnly("0123456789") || value.isEmpty())
+                    query.errors.add("Invalid " + fieldName + " '" + value + "'");
+                else if (fieldName == "limit")
+                    query.limit = value.getIntValue();
+                else
+                    query.offset = value.getIntValue();
+
+                return {};
+            }
+
+            if (fieldName == "folder" || fieldName == "dir")
+            {
+                if (value.isEmpty())
+                    return {};
+
+                if (!juce::File::isAbsolutePath(value))
+                {
+                    query.errors.add("'" + fieldName + "' needs a full path");
+                    return {};
+                }
+
+                Node node;
+                node.type = Node::Type::folder;
+                node.value = value;
+                node.foldedValue = TextIndex::fold(value);
+                return node;
+            }
+
+            if (fieldName == "tag" || fieldName == "tags")
+            {
+                if (value.isEmpty())
+                    return {};
+
+                Node node;
+                node.type = Node::Type::tag;
+                node.value = value;
+                return node;
+            }
+
+            TextIndex::Field textField;
+            if (findTextField(fieldName, textField))
+            {
+                if (op != ":" && op != "=")
+                    query.errors.add("'" + fieldName + "' only supports ':' and '='");
+
+                if (value.isEmpty())
+                    return {};
+
+                return makeText(value, textField, op == "=");
+            }
+
+            NumericColumns::Column column;
+            if (findNumericColumn(fieldName, column))
+                return parseNumericTerm(fieldName, column, op, value);
+
+            // Not a field we know, e.g. "12:30" - search for it literally
+            return makeText(text, TextIndex::anyField);
+        }
+
+        Node parseNumericTerm(const juce::String& fieldName, NumericColumns::Column column,
+                              const juce::String& op, const juce::String& value)
+        {
+            Node node;
+            node.type = Node::Type::numeric;
+            node.predicate.column = column;
+
+            double start = 0.0, end = 0.0;
+
+            if ((op == ":" || op == "=") && value.contains(".."))
+            {
+                double ignored = 0.0;
+                auto lowText = value.upToFirstOccurrenceOf("..", false, false);
+                auto highText = value.fromFirstOccurrenceOf("..", false, false);
+
+                if (column == NumericColumns::timestampColumn && (isRelativeDate(lowText) || isRelativeDate(highText)))
+                    query.relativeToNow = true;
+
+                if ((lowText.isNotEmpty() && !parseNumericValue(column, lowText, start, ignored))
+                     || (highText.isNotEmpty() && !parseNumericValue(column, highText, ignored, end)))
+                {
+                    query.errors.add("Invalid range for " + fieldName + ": '" + value + "'");
+                    return {};
+                }
+
+                node.predicate.minimum = lowText.isNotEmpty() ? start : -infinity;
+                node.predicate.maximum = highText.isNotEmpty() ? end : infinity;
+                return node;
+            }
+
+            if (!parseNumericValue(column, value, start, end))
+            {
+                query.errors.add("Invalid value for " + fieldName + ": '" + value + "'");
+                return {};
+            }
+
+            if (column == NumericColumns::timestampColumn && isRelativeDate(value))
+                query.relativeToNow = true;
+
+            if (op == ">")          { node.predicate.minimum = std::nextafter(end, infinity); }
+            else if (op == ">=")    { node.predicate.minimum = start; }
+            else if (op == "<")     { node.predicate.maximum = std::nextafter(start, -infinity); }
+            else if (op == "<=")    { node.predicate.maximum = end; }
+            else                    { node.predicate.minimum = start; node.predicate.maximum = end; }
+
+            return node;
+        }
+
+        LibraryQuery& query;
+        std::vector<Token> tokens;
+        size_t position = 0;
+    };
+
+    juce::String formatBound(NumericColumns::Column column, double value)
+    {
+        if (std::isinf(value))
+            return value < 0 ? "-inf" : "inf";
+
+        if (column == NumericColumns::timestampColumn)
+            return juce::Time((juce::int64)value).toISO8601(true);
+
+        if (value == std::floor(value))
+            return juce::String((juce::int64)value);
+
+        return juce::String(value, 2);
+    }
+}
+
+//==============================================================================
+LibraryQuery LibraryQuery::parse(const juce::String& text)
+{
+    LibraryQuery query;
+    query.root = QueryParser(query, tokenise(text)).parse();
+    return query;
+}
+
+juce::String LibraryQuery::Node::describe() const
+{
+    switch (type)
+    {
+        case Type::all:         return "all recordings";
+        case Type::conjunction: return "AND";
+        case Type::disjunction: return "OR";
+        case Type::negation:    return "NOT";
+        case Type::tag:         return "tag = \"" + value + "\"";
+        case Type::folder:      return "folder = \"" + value + "\"";
+
+        case Type::text:
+        {
+            static const char* const fieldNames[] = { "name", "uid", "artist", "genre", "path", "tags" };
+            auto where = field == TextIndex::anyField ? juce::String("any field") : juce::String(fieldNames[(int)field]);
+            return exact ? where + " = \"" + value + "\""
+                         : "\"" + value + "\" in " + where;
+        }
+
+        case Type::numeric:
+            return NumericColumns::getColumnName(predicate.column) + " in ["
+                    + formatBound(predicate.column, predicate.minimum) + ", "
+                    + formatBound(predicate.column, predicate.maximum) + "]";
+    }
+
+    return {};
+}
+
+bool LibraryQuery::matches(const Node& node, const Recording& recording)
+{
+    switch (node.type)
+    {
+        case Node::Type::all:
+            return true;
+
+        case Node::Type::conjunction:
+            for (const auto& child : node.children)
+                if (!matches(child, recording))
+                    return false;
+            return true;
+
+        case Node::Type::disjunction:
+            for (const auto& child : node.children)
+                if (matches(child, recording))
+                    return true;
+            return false;
+
+        case Node::Type::negation:
+            return !matches(node.children.front(), recording);
+
+        case Node::Type::tag:
+        {
+            auto key = TagIndex::fold(node.value);
+            for (const auto& tag : recording.tags)
+                if (TagIndex::fold(tag) == key)
+                    return true;
+            return false;
+        }
+
+        case Node::Type::folder:
+            return recording.file.getParentDirectory() == juce::File(node.value);
+
+        case Node::Type::text:
+        {
+            auto contains = [&node](const juce::String& text)
+            {
+                if (node.exact)
+                    return TextIndex::fold(text.trim()) == node.foldedValue;
+
+                return TextIndex::fold(text).find(node.foldedValue) != std::string::npos;
+            };
+
+            auto any = node.field == TextIndex::anyField;
+
+            if ((any || node.field == TextIndex::nameField) && contains(recording.name))                     return true;
+            if ((any || node.field == TextIndex::uidField) && contains(recording.uid))                       return true;
+            if ((any || node.field == TextIndex::artistField) && contains(recording.artist))                 return true;
+            if ((any || node.field == TextIndex::genreField) && contains(recording.genre))                   return true;
+            if ((any || node.field == TextIndex::pathField) && contains(recording.file.getFullPathName()))   return true;
+
+            if (any || node.field == TextIndex::tagsField)
+                for (const auto& tag : recording.tags)
+                    if (contains(tag))
+                        return true;
+
+            return false;
+        }
+
+        case Node::Type::numeric:
+        {
+            auto value = NumericColumns::getValue(node.predicate.column, recording);
+            return value >= node.predicate.minimum && value <= node.predicate.maximum;
+        }
+    }
+
+    return false;
+}
+
+int LibraryQuery::compare(const Recording& a, const Recording& b, SortField field)
+{
+    auto compareNumbers = [](double x, double y) { return x < y ? -1 : (y < x ? 1 : 0); };
+
+    switch (field)
+    {
+        case SortField::name:           return a.name.compareNatural(b.name);
+        case SortField::duration:       return compareNumbers(a.durationInSeconds, b.durationInSeconds);
+        case SortField::timestamp:      return compareNumbers((double)a.timestamp.toMilliseconds(), (double)b.timestamp.toMilliseconds());
+        case SortField::tags:           return a.tags.joinIntoString(", ").compareIgnoreCase(b.tags.joinIntoString(", "));
+        case SortField::artist:         return a.artist.compareNatural(b.artist);
+        case SortField::genre:          return a.genre.compareNatural(b.genre);
+        case SortField::trackNumber:    return compareNumbers(a.trackNumber, b.trackNumber);
+        case SortField::sampleRate:     return compareNumbers(a.sampleRate, b.sampleRate);
+        case SortField::channels:       return compareNumbers(a.numChannels, b.numChannels);
+    }
+
+    return 0;
+}
+
+bool LibraryQuery::isBefore(const Recording& a, LibraryRow rowA, const Recording& b, LibraryRow rowB) const
+{
+    for (const auto& key : sortKeys)
+    {
+        auto c = compare(a, b, key.field);
+        if (c != 0)
+            return key.descending ? c > 0 : c < 0;
+    }
+
+    return rowA < rowB;
+}
+
+int LibraryQuery::getSortedFields() const
+{
+    int fields = 0;
+
+    for (const auto& key : sortKeys)
+        fields |= getDeltaField(key.field);
+
+    return fields;
+}
+
+int LibraryQuery::getDeltaField(SortField field)
+{
+    switch (field)
+    {
+        case SortField::name:           return LibraryDelta::nameField;
+        case SortField::duration:       return LibraryDelta::durationField;
+        case SortField::timestamp:      return LibraryDelta::timestampField;
+        case SortField::tags:           return LibraryDelta::tagsField;
+        case SortField::artist:         return LibraryDelta::artistField;
+        case SortField::genre:          return LibraryDelta::genreField;
+        case SortField::trackNumber:    return LibraryDelta::trackNumberField;
+        case SortField::sampleRate:     return LibraryDelta::sampleRateField;
+        case SortField::channels:       return LibraryDelta::channelsField;
+    }
+
+    return 0;
+}
+
+juce::String LibraryQuery::getSortFieldName(SortField field)
+{
+    switch (field)
+    {
+        case SortField::name:           return "name";
+        case SortField::duration:       return "duration";
+        case SortField::timestamp:      return "timestamp";
+        case SortField::tags:           return "tags";
+        case SortField::artist:         return "artist";
+        case SortField::genre:          return "genre";
+        case SortField::trackNumber:    return "track";
+        case SortField::sampleRate:     return "rate";
+        case SortField::channels:       return "channels";
+    }
+
+    return {};
+}
+
+//==============================================================================
+QueryPlan::QueryPlan(const LibraryQuery& q, const LibraryIndexes& i)
+    : query(q), indexes(i)
+{
+    root = compile(query.root);
+}
+
+QueryPlan::Step QueryPlan::compile(const LibraryQuery::Node& node) const
+{
+    using Type = LibraryQuery::Node::Type;
+
+    Step step;
+    step.node = &node;
+    auto numRows = indexes.getNumRows();
+
+    switch (node.type)
+    {
+        case Type::all:
+            step.strategy = Strategy::everything;
+            step.estimate = numRows;
+            break;
+
+        case Type::text:
+            // Terms shorter than a trigram can't use the postings
+            step.strategy = node.foldedValue.size() >= 3 ? Strategy::textIndex : Strategy::textScan;
+            step.estimate = indexes.text.estimateMatches(node.foldedValue);
+            break;
+
+        case Type::folder:
+            // The trigram postings narrow it to paths containing the folder, which are then checked exactly
+            step.strategy = Strategy::folderLookup;
+            step.estimate = indexes.text.estimateMatches(node.foldedValue);
+            break;
+
+        case Type::tag:
+            step.strategy = Strategy::tagBitmap;
+            step.estimate = (size_t)indexes.tags.getCount(indexes.tags.findTag(node.value));
+            break;
+
+        case Type::numeric:
+        {
+            // No histogram to go on: assume points are rarer than ranges
+            step.strategy = Strategy::columnScan;
+            auto bounded = !std::isinf(node.predicate.minimum) && !std::isinf(node.predicate.maximum);
+            step.estimate = node.predicate.minimum == node.predicate.maximum ? numRows / 10
+                          : bounded ? numRows / 4 : numRows / 3;
+            break;
+        }
+
+        case Type::conjunction:
+        {
+            step.strategy = Strategy::intersect;
+
+            for (const auto& child : node.children)
+                step.children.push_back(compile(child));
+
+            // Most selective positive predicate first; negations only ever
+            // filter, so they go last
+            std::stable_sort(step.children.begin(), step.children.end(), [](const Step& a, const Step& b)
+            {
+                auto aNegated = a.strategy == Strategy::complement;
+                auto bNegated = b.strategy == Strategy::complement;
+
+                if (aNegated != bNegated)
+                    return bNegated;
+
+                return a.estimate < b.estimate;
+            });
+
+            step.estimate = step.children.front().strategy == Strategy::complement ? numRows
+                                                                                   : step.children.front().estimate;
+            break;
+        }
+
+        case Type::disjunction:
+            step.strategy = Strategy::unite;
+            step.estimate = 0;
+
+            for (const auto& child : node.children)
+            {
+                step.children.push_back(compile(child));
+                step.estimate += step.children.back().estimate;
+            }
+
+            step.estimate = juce::jmin(step.estimate, numRows);
+            break;
+
+        case Type::negation:
+            step.strategy = Strategy::complement;
+            step.children.push_back(compile(node.children.front()));
+            step.estimate = numRows - juce::jmin(numRows, step.children.front().estimate);
+            break;
+    }
+
+    return step;
+}
+
+RowBitmap QueryPlan::evaluate(Step& step)
+{
+    auto startTime = juce::Time::getMillisecondCounterHiRes();
+    const auto& node = *step.node;
+    RowBitmap result;
+
+    switch (step.strategy)
+    {
+        case Strategy::everything:
+            result = indexes.liveRows;
+            break;
+
+        case Strategy::textIndex:
+        case Strategy::textScan:
+            result = RowBitmap::fromSortedRows(indexes.text.search(node.value, node.field, node.exact));
+            break;
+
+        case Strategy::tagBitmap:
+            result = indexes.tags.getRows(indexes.tags.findTag(node.value));
+            break;
+
+        case Strategy::folderLookup:
+        {
+            std::vector<LibraryRow> rows;
+            juce::File folder(node.value);
+
+            for (auto row : indexes.text.search(node.value, TextIndex::pathField))
+                if (indexes.aggregates.isInFolder(row, folder))
+                    rows.push_back(row);
+
+            result = RowBitmap::fromSortedRows(rows);
+            break;
+        }
+
+        case Strategy::columnScan:
+            result = indexes.numeric.select(node.predicate).toRowBitmap();
+            break;
+
+        case Strategy::intersect:
+            result = evaluate(step.children.front());
+
+            for (size_t i = 1; i < step.children.size() && !result.isEmpty(); ++i)
+                result = filter(step.children[i], result);
+            break;
+
+        case Strategy::unite:
+            for (auto& child : step.children)
+                result |= evaluate(child);
+            break;
+
+        case Strategy::complement:
+            result = indexes.liveRows - evaluate(step.children.front());
+            break;
+    }
+
+    step.actualRows += result.size();
+    step.milliseconds += juce::Time::getMillisecondCounterHiRes() - startTime;
+    return result;
+}
+
+RowBitmap QueryPlan::filter(Step& step, const RowBitmap& candidates)
+{
+    auto startTime = juce::Time::getMillisecondCounterHiRes();
+    const auto& node = *step.node;
+    RowBitmap result;
+
+    auto verifyEachRow = [&candidates](auto&& predicate)
+    {
+        std::vector<LibraryRow> rows;
+        candidates.forEach([&rows, &predicate](LibraryRow row)
+        {
+            if (predicate(row))
+                rows.push_back(row);
+        });
+        return RowBitmap::fromSortedRows(rows);
+    };
+
+    switch (step.strategy)
+    {
+        case Strategy::everything:
+            result = candidates;
+            break;
+
+        case Strategy::textIndex:
+            // Checking a few candidates beats walking the postings
+            if (candidates.size() <= step.estimate)
+                result = verifyEachRow([this, &node](LibraryRow row) { return indexes.text.matches(row, node.foldedValue, node.field, node.exact); });
+            else
+                result = candidates & RowBitmap::fromSortedRows(indexes.text.search(node.value, node.field, node.exact));
+            break;
+
+        case Strategy::textScan:
+            result = verifyEachRow([this, &node](LibraryRow row) { return indexes.text.matches(row, node.foldedValue, node.field, node.exact); });
+            break;
+
+        case Strategy::tagBitmap:
+            result = candidates & indexes.tags.getRows(indexes.tags.findTag(node.value));
+            break;
+
+        case Strategy::folderLookup:
+        {
+            juce::File folder(node.value);
+            result = verifyEachRow([this, &folder](LibraryRow row) { return indexes.aggregates.isInFolder(row, folder); });
+            break;
+        }
+
+        case Strategy::columnScan:
+            if (candidates.size() * 8 < indexes.getNumRows())
+            {
+                result = verifyEachRow([this, &node](LibraryRow row)
+                {
+                    auto value = indexes.numeric.getValue(node.predicate.column, row);
+                    return value >= node.predicate.minimum && value <= node.predicate.maximum;
+                });
+            }
+            else
+            {
+                result = candidates & indexes.numeric.select(node.predicate).toRowBitmap();
+            }
+            break;
+
+        case Strategy::intersect:
+            result = candidates;
+            for (auto& child : step.children)
+                if (!result.isEmpty())
+                    result = filter(child, result);
+            break;
+
+        case Strategy::unite:
+            for (auto& child : step.children)
+                result |= filter(child, candidates);
+            break;
+
+        case Strategy::complement:
+            result = candidates - filter(step.children.front(), candidates);
+            break;
+    }
+
+    step.filtered = true;
+    step.actualRows += result.size();
+    step.milliseconds += juce::Time::getMillisecondCounterHiRes() - startTime;
+    return result;
+}
+
+void QueryPlan::sortAndWindow(const LibraryQuery& query, std::vector<LibraryRow>& rows, const RecordingLookup& lookup)
+{
+    auto offset = (size_t)juce::jmax(0, query.offset);
+    auto end = query.limit >= 0 ? juce::jmin(rows.size(), offset + (size_t)query.limit) : rows.size();
+
+    if (offset >= rows.size())
+    {
+        rows.clear();
+        return;
+    }
+
+    if (!query.sortKeys.empty())
+    {
+        auto less = [&query, &lookup](LibraryRow a, LibraryRow b)
+        {
+            auto* ra = lookup(a);
+            auto* rb = lookup(b);
+
+            if (ra != nullptr && rb != nullptr)
+                return query.isBefore(*ra, a, *rb, b);
+
+            return a < b;
+        };
+
+        // Only the requested window has to be in order
+        if (end < rows.size())
+            std::partial_sort(rows.begin(), rows.begin() + (std::ptrdiff_t)end, rows.end(), less);
+        else
+            std::sort(rows.begin(), rows.end(), less);
+    }
+
+    rows.erase(rows.begin() + (std::ptrdiff_t)end, rows.end());
+    rows.erase(rows.begin(), rows.begin() + (std::ptrdiff_t)offset);
+}
+
+bool QueryPlan::shouldUseSortOrder(size_t numMatches) const
+{
+    // A handful of matches is always quicker to sort than any walk of the library
+    if (query.sortKeys.empty() || numMatches < minMatchesForSortOrder)
+        return false;
+
+    auto numRows = indexes.getNumRows();
+
+    // Enough matches to be worth building the order if it isn't cached
+    if (numMatches * 8 >= numRows)
+        return true;
+
+    if (!indexes.sortOrders.hasOrder(query.sortKeys.front().field))
+        return false;
+
+    // A cached order still costs a step per row walked, up to the end of the
+    // window, against a few comparisons per match for each level of a sort
+    auto wanted = query.limit >= 0 ? juce::jmin(numMatches, (size_t)juce::jmax(0, query.offset) + (size_t)query.limit) : numMatches;
+    auto walkSteps = (double)numRows * (double)juce::jmax((size_t)1, wanted) / (double)numMatches;
+    auto sortSteps = 8.0 * (double)numMatches * std::log2((double)numMatches);
+
+    return walkSteps < sortSteps;
+}
+
+std::vector<LibraryRow> QueryPlan::selectInSortOrder(const LibraryQuery& query, const std::vector<LibraryRow>& order,
+                                                     const RowBitmap& matches, size_t numMatches,
+                                                     const RecordingLookup& lookup)
+{
+    const auto& primary = query.sortKeys.front();
+
+    auto offset = (size_t)juce::jmax(0, query.offset);
+    auto end = query.limit >= 0 ? offset + (size_t)query.limit : numMatches;
+    bool everythingMatches = numMatches == order.size();
+
+    auto isMatch = [&](LibraryRow row) { return everythingMatches || matches.contains(row); };
+
+    std::vector<LibraryRow> rows;
+    rows.reserve(juce::jmin(end, numMatches));
+
+    auto n = order.size();
+
+    if (!primary.descending && query.sortKeys.size() == 1)
+    {
+        for (size_t i = 0; i < n && rows.size() < end; ++i)
+            if (isMatch(order[i]))
+                rows.push_back(order[i]);
+    }
+    else
+    {
+        // Rows with equal primary values form a group that the remaining keys (or,
+        // walking backwards, ascending row order) have to put in order
+        auto at = [&](size_t i) { return primary.descending ? order[n - 1 - i] : order[i]; };
+        std::vector<LibraryRow> group;
+
+        for (size_t i = 0; i < n && rows.size() < end;)
+        {
+            auto* first = lookup(at(i));
+            group.clear();
+
+            do
+            {
+                if (isMatch(at(i)))
+                    group.push_back(at(i));
+                ++i;
+            }
+            while (i < n && first != nullptr && lookup(at(i)) != nullptr
+                   && LibraryQuery::compare(*first, *lookup(at(i)), primary.field) == 0);
+
+            if (query.sortKeys.size() > 1)
+            {
+                std::sort(group.begin(), group.end(), [&lookup, &query](LibraryRow a, LibraryRow b)
+                {
+                    return query.isBefore(*lookup(a), a, *lookup(b), b);
+                });
+            }
+            else
+            {
+                std::reverse(group.begin(), group.end());
+            }
+
+            rows.insert(rows.end(), group.begin(), group.end());
+        }
+    }
+
+    if (offset >= rows.size())
+        return {};
+
+    rows.erase(rows.begin() + (std::ptrdiff_t)juce::jmin(end, rows.size()), rows.end());
+    rows.erase(rows.begin(), rows.begin() + (std::ptrdiff_t)offset);
+    return rows;
+}
+
+QueryResult QueryPlan::execute(const RecordingLookup& lookup)
+{
+    auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+    QueryResult result;
+    auto matches = findMatches();
+    result.totalMatches = matches.size();
+
+    auto order = getPrimaryOrder(result.totalMatches, lookup);
+    result.rows = orderMatches(query, matches, result.totalMatches, order.get(), lookup);
+    result.milliseconds = juce::Time::getMillisecondCounterHiRes() - startTime;
+
+    totalMilliseconds = result.milliseconds;
+    return result;
+}
+
+RowBitmap QueryPlan::findMatches()
+{
+    auto matches = evaluate(root);
+    totalMatches = matches.size();
+    executed = true;
+    return matches;
+}
+
+SortOrders::OrderPtr QueryPlan::getPrimaryOrder(size_t numMatches, const RecordingLookup& lookup)
+{
+    usedSortOrder = shouldUseSortOrder(numMatches);
+
+    if (!usedSortOrder)
+        return nullptr;
+
+    return indexes.sortOrders.getOrder(query.sortKeys.front().field, indexes.liveRows, lookup);
+}
+
+std::vector<LibraryRow> QueryPlan::orderMatches(const LibraryQuery& query, const RowBitmap& matches, size_t numMatches,
+                                                const std::vector<LibraryRow>* primaryOrder, const RecordingLookup& lookup)
+{
+    if (primaryOrder != nullptr && !query.sortKeys.empty())
+        return selectInSortOrder(query, *primaryOrder, matches, numMatches, lookup);
+
+    auto rows = matches.toVector();
+    sortAndWindow(query, rows, lookup);
+    return rows;
+}
+
+//==============================================================================
+juce::String QueryPlan::getStrategyName(Strategy strategy)
+{
+    switch (strategy)
+    {
+        case Strategy::everything:  return "ALL ROWS";
+        case Strategy::textIndex:   return "TRIGRAM LOOKUP";
+        case Strategy::textScan:    return "TEXT SCAN";
+        case Strategy::tagBitmap:   return "TAG BITMAP";
+        case Strategy::folderLookup: return "FOLDER LOOKUP";
+        case Strategy::columnScan:  return "COLUMN SCAN";
+        case Strategy::intersect:   return "INTERSECT";
+        case Strategy::unite:       return "UNION";
+        case Strategy::complement:  return "EXCLUDE";
+    }
+
+    return {};
+}
+
+void QueryPlan::explainStep(const Step& step, int depth, juce::String& out) const
+{
+    out << juce::String::repeatedString("  ", depth + 1)
+        << getStrategyName(step.strategy);
+
+    if (step.strategy != Strategy::intersect && step.strategy != Strategy::unite && step.strategy != Strategy::complement)
+        out << " " << step.node->describe();
+
+    if (step.filtered)
+        out << " (filtering candidates)";
+
+    out << "  est " << (int)step.estimate;
+
+    if (executed)
+        out << ", got " << (int)step.actualRows << " in " << juce::String(step.milliseconds, 3) << " ms";
+
+    out << "\n";
+
+    for (const auto& child : step.children)
+        explainStep(child, depth + 1, out);
+}
+
+juce::String QueryPlan::explain() const
+{
+    juce::String out;
+    out << "Plan:\n";
+    explainStep(root, 0, out);
+
+    if (!query.sortKeys.empty())
+    {
+        out << "Sort:";
+        for (const auto& key : query.sortKeys)
+            out << " " << (key.descending ? "-" : "") << LibraryQuery::getSortFieldName(key.field);
+
+        if (executed)
+            out << (usedSortOrder ? "  (cached order)" : "  (sorted matches)");
+
+        out << "\n";
+    }
+
+    if (query.limit >= 0 || query.offset > 0)
+        out << "Window: offset " << query.offset << ", limit " << (query.limit >= 0 ? juce::String(query.limit) : juce::String("none")) << "\n";
+
+    for (const auto& error : query.errors)
+        out << "Warning: " << error << "\n";
+
+    if (executed)
+        out << "Total: " << (int)totalMatches << " matches in "
+            << juce::String(totalMilliseconds, 3) << " ms\n";
+
+    return out;
+}
\ No newline at end of file
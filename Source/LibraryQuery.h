@@ -0,0 +1,173 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioRecorder.h"
+#include "LibraryIndexes.h"
+
+//==============================================================================
+/**
+    Parsed form of a library query such as
+
+        tag:Live AND duration>120 artist:"foo" -tag:Demo sort:-timestamp limit:100
+
+    Bare words are substring matches over every text field, field:value
+    restricts the match to one field and field=value matches the whole field.
+    Numeric fields accept <, <=, >, >=, = and a..b ranges. Durations take an
+    s, m (or min) or h suffix, or h:mm:ss; dates are 2024, 2024-05,
+    2024-05-17, today, yesterday, or relative: -30d, -2w, -6mo (months), -1y.
+    AND/OR/NOT, in any case, or a leading '-' combine terms. Adjacent terms
+    are ANDed. Inside quotes, \" and \\ stand for a quote and a backslash.
+    folder:"/full/path" matches files directly in that folder, not its
+    subfolders. sort:, limit: and offset: set the result ordering and window.
+*/
+class LibraryQuery
+{
+public:
+    struct Node
+    {
+        enum class Type
+        {
+            all,
+            conjunction,
+            disjunction,
+            negation,
+            text,
+            tag,
+            folder,
+            numeric
+        };
+
+        Type type = Type::all;
+        std::vector<Node> children;
+
+        TextIndex::Field field = TextIndex::anyField;   // text
+        juce::String value;                             // text, tag and folder
+        std::string foldedValue;                        // text and folder
+        bool exact = false;                             // text: the whole field, not a substring
+        NumericColumns::Predicate predicate { NumericColumns::durationColumn };
+
+        juce::String describe() const;
+    };
+
+    using SortField = LibrarySortField;
+
+    struct SortKey
+    {
+        SortField field;
+        bool descending = false;
+    };
+
+    static LibraryQuery parse(const juce::String& text);
+
+    bool isEmpty() const        { return root.type == Node::Type::all && sortKeys.empty() && limit < 0 && offset == 0; }
+    bool matches(const Recording& recording) const      { return matches(root, recording); }
+
+    static bool matches(const Node& node, const Recording& recording);
+    static int compare(const Recording& a, const Recording& b, SortField field);
+    static juce::String getSortFieldName(SortField field);
+
+    // The result order: by the sort keys, then by row (i.e. library order)
+    bool isBefore(const Recording& a, LibraryRow rowA, const Recording& b, LibraryRow rowB) const;
+
+    // LibraryDelta fields that the sort keys depend on
+    int getSortedFields() const;
+    static int getDeltaField(SortField field);
+
+    Node root;
+    std::vector<SortKey> sortKeys;
+    int limit = -1;
+    int offset = 0;
+    juce::StringArray errors;
+    bool relativeToNow = false;     // has dates like -30d or today, resolved when parsed
+};
+
+//==============================================================================
+struct QueryResult
+{
+    std::vector<LibraryRow> rows;   // sorted and windowed
+    size_t totalMatches = 0;        // before limit/offset
+    double milliseconds = 0.0;
+};
+
+//==============================================================================
+/**
+    Execution plan for a LibraryQuery over a set of LibraryIndexes.
+
+    Each predicate is mapped onto the cheapest structure that can answer it:
+    trigram postings for text, tag bitmaps for tags and SIMD column scans for
+    numeric ranges. Conjunctions evaluate their most selective child first and
+    then only filter the surviving candidates through the others, verifying
+    individual rows when the candidate set is smaller than the index lookup
+    would be. Predicates no index can narrow fall back to a scan.
+*/
+class QueryPlan
+{
+public:
+    using RecordingLookup = std::function<const Recording* (LibraryRow)>;
+
+    QueryPlan(const LibraryQuery& query, const LibraryIndexes& indexes);
+
+    QueryResult execute(const RecordingLookup& lookup);
+
+    /** execute() in two halves, so the index lookups can run on the thread
+        that owns the indexes and the ordering elsewhere. getPrimaryOrder()
+        returns the cached order of the first sort key when walking it beats
+        sorting the matches, otherwise nullptr.
+    */
+    RowBitmap findMatches();
+    SortOrders::OrderPtr getPrimaryOrder(size_t numMatches, const RecordingLookup& lookup);
+
+    // Sorts and windows the matches; needs only the recordings, e.g. from a LibrarySnapshot
+    static std::vector<LibraryRow> orderMatches(const LibraryQuery& query, const RowBitmap& matches, size_t numMatches,
+                                                const std::vector<LibraryRow>* primaryOrder, const RecordingLookup& lookup);
+
+    // The plan tree with estimates, and actual row counts and timings once executed
+    juce::String explain() const;
+
+private:
+    enum class Strategy
+    {
+        everything,
+        textIndex,
+        textScan,
+        tagBitmap,
+        folderLookup,
+        columnScan,
+        intersect,
+        unite,
+        complement
+    };
+
+    struct Step
+    {
+        const LibraryQuery::Node* node = nullptr;
+        Strategy strategy = Strategy::everything;
+        size_t estimate = 0;
+        std::vector<Step> children;
+
+        size_t actualRows = 0;
+        double milliseconds = 0.0;
+        bool filtered = false;
+    };
+
+    Step compile(const LibraryQuery::Node& node) const;
+    RowBitmap evaluate(Step& step);
+    RowBitmap filter(Step& step, const RowBitmap& candidates);
+    static void sortAndWindow(const LibraryQuery& query, std::vector<LibraryRow>& rows, const RecordingLookup& lookup);
+    static std::vector<LibraryRow> selectInSortOrder(const LibraryQuery& query, const std::vector<LibraryRow>& order,
+                                                     const RowBitmap& matches, size_t numMatches, const RecordingLookup& lookup);
+    bool shouldUseSortOrder(size_t numMatches) const;
+
+    static constexpr size_t minMatchesForSortOrder = 256;
+
+    static juce::String getStrategyName(Strategy strategy);
+    void explainStep(const Step& step, int depth, juce::String& out) const;
+
+    const LibraryQuery& query;
+    const LibraryIndexes& indexes;
+    Step root;
+    size_t totalMatches = 0;
+    double totalMilliseconds = 0.0;
+    bool executed = false;
+    bool usedSortOrder = false;
+};
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "LibrarySearch.h"
+
+LibrarySearch::LibrarySearch()
+    : juce::Thread("Library Search")
+{
+    startThread();
+}
+
+LibrarySearch::~LibrarySearch()
+{
+    cancel();
+    stopThread(5000);
+}
+
+void LibrarySearch::start(Request request, int delayMs)
+{
+    auto job = std::make_unique<Job>();
+    job->request = std::move(request);
+    job->generation = ++latestGeneration;
+    job->startTime = juce::Time::getMillisecondCounter() + (juce::uint32)juce::jmax(0, delayMs);
+
+    {
+        std::lock_guard<std::mutex> sl(lock);
+        pending = std::move(job);
+    }
+
+    searching = true;
+    notify();
+}
+
+void LibrarySearch::cancel()
+{
+    ++latestGeneration;
+    searching = false;
+
+    std::lock_guard<std::mutex> sl(lock);
+    pending.reset();
+}
+
+void LibrarySearch::run()
+{
+    while (!threadShouldExit())
+    {
+        std::unique_ptr<Job> job;
+
+        {
+            std::lock_guard<std::mutex> sl(lock);
+            job = std::move(pending);
+        }
+
+        if (job == nullptr)
+        {
+            wait(-1);
+            continue;
+        }
+
+        // Debounce: a newer search started during the delay replaces this one
+        for (;;)
+        {
+            auto now = juce::Time::getMillisecondCounter();
+            if (isSuperseded(job->generation) || now >= job->startTime)
+                break;
+
+            wait((int)(job->startTime - now));
+        }
+
+        Result result;
+
+        if (!execute(*job, result))
+            continue;
+
+        {
+            std::lock_guard<std::mutex> sl(lock);
+            finished = std::make_unique<Result>(std::move(result));
+            finishedGeneration = job->generation;
+        }
+
+        triggerAsyncUpdate();
+    }
+}
+
+bool LibrarySearch::execute(const Job& job, Result& result) const
+{
+    if (isSuperseded(job.generation))
+        return false;
+
+    auto startTime = juce::Time::getMillisecondCounterHiRes();
+    const auto& request = job.request;
+    const auto& snapshot = *request.snapshot;
+
+    auto rows = QueryPlan::orderMatches(request.query, *request.matches, request.matches->size(),
+                                        request.primaryOrder.get(),
+                                        [&snapshot](LibraryRow row) { return snapshot.getRecording({ row }); });
+
+    if (isSuperseded(job.generation))
+        return false;
+
+    result.handles.ensureStorageAllocated((int)rows.size());
+
+    for (auto row : rows)
+        result.handles.add({ row });
+
+    result.snapshotVersion = snapshot.getVersion();
+    result.milliseconds = juce::Time::getMillisecondCounterHiRes() - startTime;
+    return true;
+}
+
+void LibrarySearch::handleAsyncUpdate()
+{
+    std::unique_ptr<Result> result;
+
+    {
+        std::lock_guard<std::mutex> sl(lock);
+
+        // Anything started since then makes this result stale
+        if (finishedGeneration != latestGeneration.load())
+            return;
+
+        result = std::move(finished);
+    }
+
+    if (result == nullptr)
+        return;
+
+    searching = false;
+
+    if (onResult != nullptr)
+        onResult(*result);
+}
\ No newline at end of file
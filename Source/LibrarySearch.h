@@ -0,0 +1,74 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LibraryQuery.h"
+#include "LibrarySnapshot.h"
+
+//==============================================================================
+/**
+    Puts the matches of library queries in order on a background thread,
+    against a LibrarySnapshot.
+
+    The matching itself is done beforehand through the query's plan and the
+    library's indexes (see LibraryManager::prepareSearch), which belong to the
+    message thread; what's left, sorting and windowing the matches, needs only
+    the recordings and is what can take a while on a large library. Each
+    search supersedes the one before it: a search still waiting out its delay
+    is dropped, and one that's running stops at its next check. Only the
+    result of the most recent search is ever delivered, on the message thread,
+    so typing can start a search per keystroke.
+*/
+class LibrarySearch : private juce::Thread,
+                      private juce::AsyncUpdater
+{
+public:
+    struct Request
+    {
+        LibraryQuery query;
+        LibrarySnapshot::Ptr snapshot;
+        std::shared_ptr<const RowBitmap> matches;           // every row matching the query, as of the snapshot
+        SortOrders::OrderPtr primaryOrder;                  // optional, the first sort key's cached order
+    };
+
+    struct Result
+    {
+        juce::Array<RecordingHandle> handles;       // in the query's order
+        juce::uint64 snapshotVersion = 0;
+        double milliseconds = 0.0;
+    };
+
+    LibrarySearch();
+    ~LibrarySearch() override;
+
+    // Starts the search once delayMs has passed without another one being started
+    void start(Request request, int delayMs);
+    void cancel();
+
+    bool isSearching() const noexcept           { return searching; }
+
+    // Called on the message thread with the latest search's result
+    std::function<void(Result&)> onResult;
+
+private:
+    struct Job
+    {
+        Request request;
+        juce::uint64 generation = 0;
+        juce::uint32 startTime = 0;     // Time::getMillisecondCounter()
+    };
+
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    bool execute(const Job& job, Result& result) const;
+    bool isSuperseded(juce::uint64 generation) const noexcept   { return generation != latestGeneration.load() || threadShouldExit(); }
+
+    std::mutex lock;
+    std::unique_ptr<Job> pending;
+    std::unique_ptr<Result> finished;
+    juce::uint64 finishedGeneration = 0;
+    std::atomic<juce::uint64> latestGeneration { 0 };
+    bool searching = false;     // message thread
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibrarySearch)
+};
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "LibrarySnapshot.h"
+
+//==============================================================================
+const Recording* LibrarySnapshot::getRecording(RecordingHandle handle) const noexcept
+{
+    auto c = (size_t)(handle.row >> chunkBits);
+    auto i = handle.row & (chunkSize - 1);
+
+    if (!handle.isValid() || c >= chunks.size() || chunks[c] == nullptr || !chunks[c]->live[i])
+        return nullptr;
+
+    return &chunks[c]->recordings[i];
+}
+
+//==============================================================================
+const Recording* LibrarySnapshot::Builder::get(LibraryRow row) const noexcept
+{
+    auto c = (size_t)(row >> chunkBits);
+    auto i = row & (chunkSize - 1);
+
+    if (c >= chunks.size() || chunks[c] == nullptr || !chunks[c]->live[i])
+        return nullptr;
+
+    return &chunks[c]->recordings[i];
+}
+
+Recording* LibrarySnapshot::Builder::getForWriting(LibraryRow row)
+{
+    if (get(row) == nullptr)
+        return nullptr;
+
+    return &getChunkForWriting(row).recordings[row & (chunkSize - 1)];
+}
+
+void LibrarySnapshot::Builder::set(LibraryRow row, Recording recording)
+{
+    auto& chunk = getChunkForWriting(row);
+    auto i = row & (chunkSize - 1);
+
+    if (!chunk.live[i])
+    {
+        chunk.live[i] = true;
+        ++numRecordings;
+    }
+
+    chunk.recordings[i] = std::move(recording);
+}
+
+void LibrarySnapshot::Builder::remove(LibraryRow row)
+{
+    if (get(row) == nullptr)
+        return;
+
+    auto& chunk = getChunkForWriting(row);
+    auto i = row & (chunkSize - 1);
+
+    chunk.live[i] = false;
+    chunk.recordings[i] = {};
+    --numRecordings;
+}
+
+void LibrarySnapshot::Builder::clear()
+{
+    chunks.clear();
+    shared.clear();
+    numRecordings = 0;
+}
+
+LibrarySnapshot::Ptr LibrarySnapshot::Builder::build(juce::uint64 newVersion)
+{
+    Ptr snapshot (new LibrarySnapshot());
+    snapshot->version = newVersion;
+    snapshot->numRecordings = numRecordings;
+    snapshot->chunks.assign(chunks.begin(), chunks.end());
+
+    // From now on the snapshot owns these, so the next write to any of them copies it first
+    std::fill(shared.begin(), shared.end(), true);
+
+    return snapshot;
+}
+
+LibrarySnapshot::Chunk& LibrarySnapshot::Builder::getChunkForWriting(LibraryRow row)
+{
+    auto c = (size_t)(row >> chunkBits);
+
+    if (c >= chunks.size())
+    {
+        chunks.resize(c + 1);
+        shared.resize(c + 1, false);
+    }
+
+    if (chunks[c] == nullptr)
+    {
+        chunks[c] = std::make_shared<Chunk>();
+        shared[c] = false;
+    }
+    else if (shared[c])
+    {
+        chunks[c] = std::make_shared<Chunk>(*chunks[c]);
+        shared[c] = false;
+    }
+
+    return *chunks[c];
+}
+
+//==============================================================================
+LibrarySnapshotPublisher::~LibrarySnapshotPublisher()
+{
+    if (auto* last = current.exchange(nullptr))
+        retired.push_back(last);
+
+    while (pinnedReaders.load() != 0)
+        juce::Thread::yield();
+
+    reclaim();
+}
+
+LibrarySnapshot::Ptr LibrarySnapshotPublisher::acquire() const noexcept
+{
+    ++pinnedReaders;
+    LibrarySnapshot::Ptr snapshot (current.load());
+    --pinnedReaders;
+
+    return snapshot;
+}
+
+void LibrarySnapshotPublisher::publish(LibrarySnapshot::Ptr snapshot)
+{
+    if (snapshot != nullptr)
+        snapshot->incReferenceCount();
+
+    if (auto* previous = current.exchange(snapshot.get()))
+        retired.push_back(previous);
+
+    reclaim();
+}
+
+void LibrarySnapshotPublisher::reclaim()
+{
+    // A reader that loaded a retired pointer is still pinned until it holds its own reference
+    if (retired.empty() || pinnedReaders.load() != 0)
+        return;
+
+    for (auto* snapshot : retired)
+        snapshot->decReferenceCount();
+
+    retired.clear();
+}
\ No newline at end of file
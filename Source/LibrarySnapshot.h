@@ -0,0 +1,129 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <bitset>
+#include "AudioRecorder.h"
+#include "LibraryTypes.h"
+
+//==============================================================================
+/**
+    An immutable, versioned view of every recording in the library.
+
+    Recordings are stored by row in fixed-size chunks that successive
+    snapshots share: publishing a change to one recording copies only its
+    chunk and the table of chunk pointers, never the whole library. A
+    snapshot stays valid for as long as someone holds a Ptr to it, so it can
+    be read from any thread while the library moves on.
+*/
+class LibrarySnapshot : public juce::ReferenceCountedObject
+{
+    struct Chunk;
+
+public:
+    using Ptr = juce::ReferenceCountedObjectPtr<LibrarySnapshot>;
+
+    static constexpr int chunkBits = 8;
+    static constexpr LibraryRow chunkSize = 1u << chunkBits;
+
+    juce::uint64 getVersion() const noexcept        { return version; }
+    int getNumRecordings() const noexcept           { return numRecordings; }
+
+    const Recording* getRecording(RecordingHandle handle) const noexcept;
+
+    /** Calls fn(RecordingHandle, const Recording&) for every recording, in
+        library order.
+    */
+    template <typename Fn>
+    void forEach(Fn&& fn) const
+    {
+        for (size_t c = 0; c < chunks.size(); ++c)
+        {
+            if (chunks[c] == nullptr)
+                continue;
+
+            const auto& chunk = *chunks[c];
+
+            for (LibraryRow i = 0; i < chunkSize; ++i)
+                if (chunk.live[i])
+                    fn(RecordingHandle { ((LibraryRow)c << chunkBits) | i }, chunk.recordings[i]);
+        }
+    }
+
+    //==============================================================================
+    /**
+        The writer's mutable copy of the next snapshot. Chunks are cloned the
+        first time they're modified after a build(), and build() then shares
+        all of them with the snapshot it returns.
+    */
+    class Builder
+    {
+    public:
+        Builder() = default;
+
+        const Recording* get(LibraryRow row) const noexcept;
+        Recording* getForWriting(LibraryRow row);
+
+        void set(LibraryRow row, Recording recording);
+        void remove(LibraryRow row);
+        void clear();
+
+        int getNumRecordings() const noexcept       { return numRecordings; }
+
+        Ptr build(juce::uint64 version);
+
+    private:
+        Chunk& getChunkForWriting(LibraryRow row);
+
+        std::vector<std::shared_ptr<Chunk>> chunks;
+        std::vector<bool> shared;   // per chunk: still referenced by a built snapshot
+        int numRecordings = 0;
+
+        JUCE_DECLARE_NON_COPYABLE(Builder)
+    };
+
+private:
+    struct Chunk
+    {
+        std::array<Recording, chunkSize> recordings;
+        std::bitset<chunkSize> live;
+    };
+
+    LibrarySnapshot() = default;
+
+    std::vector<std::shared_ptr<const Chunk>> chunks;
+    juce::uint64 version = 0;
+    int numRecordings = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibrarySnapshot)
+};
+
+//==============================================================================
+/**
+    Hands the current LibrarySnapshot to readers on any thread without locks.
+
+    Readers pin themselves for the few instructions it takes to load the
+    pointer and take a reference; the writer only releases its reference to a
+    replaced snapshot once no reader is pinned, so a reader can never take a
+    reference to a snapshot that is being deleted.
+*/
+class LibrarySnapshotPublisher
+{
+public:
+    LibrarySnapshotPublisher() = default;
+    ~LibrarySnapshotPublisher();
+
+    // Any thread
+    LibrarySnapshot::Ptr acquire() const noexcept;
+
+    // Writer thread only
+    void publish(LibrarySnapshot::Ptr snapshot);
+
+private:
+    void reclaim();
+
+    std::atomic<LibrarySnapshot*> current { nullptr };
+    mutable std::atomic<int> pinnedReaders { 0 };
+    std::vector<LibrarySnapshot*> retired;
+
+    JUCE_DECLARE_NON_COPYABLE(LibrarySnapshotPublisher)
+};
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+// Rows identify recordings inside the library indexes. They are handed out in
+// increasing order as recordings are added and are never reused within a session,
+// so ascending row order is also library (insertion) order.
+using LibraryRow = juce::uint32;
+
+constexpr LibraryRow invalidLibraryRow = 0xffffffffu;
+
+//==============================================================================
+/**
+    Stable reference to a recording held by the LibraryManager.
+
+    Unlike a position in the library or in a filtered view, a handle keeps
+    referring to the same recording while others are added and removed, and
+    simply stops resolving once its recording has gone.
+*/
+struct RecordingHandle
+{
+    LibraryRow row = invalidLibraryRow;
+
+    bool isValid() const noexcept                           { return row != invalidLibraryRow; }
+    bool operator== (RecordingHandle other) const noexcept  { return row == other.row; }
+    bool operator!= (RecordingHandle other) const noexcept  { return row != other.row; }
+};
+
+//==============================================================================
+// Fields the library can be ordered by
+enum class LibrarySortField
+{
+    name,
+    duration,
+    timestamp,
+    tags,
+    artist,
+    genre,
+    trackNumber,
+    sampleRate,
+    channels
+};
+
+constexpr int numLibrarySortFields = 9;
+
+//==============================================================================
+/**
+    The changes made to the library by one mutation or one batch of them.
+
+    Changes within a batch are merged per recording: one that was added and
+    then edited is only reported as inserted, and one that was added and
+    removed again isn't reported at all.
+*/
+struct LibraryDelta
+{
+    // Bits for Update::fields
+    enum Field
+    {
+        nameField           = 1 << 0,
+        fileField           = 1 << 1,
+        durationField       = 1 << 2,
+        tagsField           = 1 << 3,
+        timestampField      = 1 << 4,
+        sampleRateField     = 1 << 5,
+        channelsField       = 1 << 6,
+        artistField         = 1 << 7,
+        genreField          = 1 << 8,
+        trackNumberField    = 1 << 9
+    };
+
+    struct Update
+    {
+        RecordingHandle handle;
+        int fields = 0;
+    };
+
+    std::vector<RecordingHandle> inserted, removed;
+    std::vector<Update> updated;
+    bool reset = false;     // the whole library was replaced, so anything may have changed
+    bool playlistsChanged = false;  // smart playlist membership was recomputed, with no recording changing
+
+    bool isEmpty() const noexcept   { return !reset && !playlistsChanged && inserted.empty() && removed.empty() && updated.empty(); }
+};
+
+//==============================================================================
+inline int findLowestSetBit(juce::uint64 word) noexcept
+{
+   #if JUCE_MSVC
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (int)index;
+   #else
+    return __builtin_ctzll(word);
+   #endif
+}
\ No newline at end of file
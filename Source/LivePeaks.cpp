@@ -0,0 +1,115 @@
+#include "LivePeaks.h"
+
+void LivePeaks::reset()
+{
+    fifo.reset();
+    accumulators = {};
+    samplesInBlock = 0;
+    numChannels = 0;
+    sampleRate = 0.0;
+    droppedBlocks = 0;
+
+    history.clear();
+    numBlocks = 0;
+    droppedInHistory = 0;
+}
+
+void LivePeaks::addSamples(const float* const* channelData, int channelsIn, int numFrames, double rate) noexcept
+{
+    if (numChannels.load(std::memory_order_relaxed) == 0)
+    {
+        sampleRate = rate;
+        numChannels = juce::jlimit(1, maxChannels, channelsIn);
+    }
+
+    auto channelsToUse = juce::jmin(numChannels.load(std::memory_order_relaxed), channelsIn);
+
+    for (int done = 0; done < numFrames;)
+    {
+        auto n = juce::jmin(numFrames - done, samplesPerBlock - samplesInBlock);
+
+        for (int c = 0; c < channelsToUse; ++c)
+        {
+            if (channelData[c] == nullptr)
+                continue;
+
+            auto& acc = accumulators[(size_t)c];
+            auto* samples = channelData[c] + done;
+            auto range = juce::FloatVectorOperations::findMinAndMax(samples, n);
+
+            acc.min = samplesInBlock == 0 ? range.getStart() : juce::jmin(acc.min, range.getStart());
+            acc.max = samplesInBlock == 0 ? range.getEnd() : juce::jmax(acc.max, range.getEnd());
+
+            for (int i = 0; i < n; ++i)
+                acc.sumOfSquares += (double)samples[i] * samples[i];
+        }
+
+        samplesInBlock += n;
+        done += n;
+
+        if (samplesInBlock == samplesPerBlock)
+            pushBlock();
+    }
+}
+
+void LivePeaks::pushBlock() noexcept
+{
+    const auto scope = fifo.write(1);
+
+    if (scope.blockSize1 > 0)
+    {
+        auto& block = blocks[(size_t)scope.startIndex1];
+
+        for (size_t c = 0; c < accumulators.size(); ++c)
+        {
+            const auto& acc = accumulators[c];
+            block.peaks[c] = PeakPyramid::createPeak(acc.min, acc.max, std::sqrt(acc.sumOfSquares / samplesPerBlock));
+        }
+
+        block.droppedBefore = droppedBlocks.load(std::memory_order_relaxed);
+    }
+    else
+    {
+        ++droppedBlocks;
+    }
+
+    accumulators = {};
+    samplesInBlock = 0;
+}
+
+int LivePeaks::pull()
+{
+    auto channels = (size_t)getNumChannels();
+    const auto scope = fifo.read(fifo.getNumReady());
+
+    const auto silence = PeakPyramid::createPeak(0.0f, 0.0f, 0.0f);
+    int numPulled = 0;
+
+    auto append = [&](int start, int size)
+    {
+        for (int i = 0; i < size; ++i)
+        {
+            const auto& block = blocks[(size_t)(start + i)];
+
+            // Blocks dropped since the last one keep their place in time
+            auto dropped = block.droppedBefore - droppedInHistory;
+            history.insert(history.end(), (size_t)dropped * channels, silence);
+            droppedInHistory = block.droppedBefore;
+
+            history.insert(history.end(), block.peaks.begin(), block.peaks.begin() + (std::ptrdiff_t)channels);
+            numPulled += dropped + 1;
+        }
+    };
+
+    append(scope.startIndex1, scope.blockSize1);
+    append(scope.startIndex2, scope.blockSize2);
+
+    numBlocks += numPulled;
+    return numPulled;
+}
+
+double LivePeaks::getLengthInSeconds() const noexcept
+{
+    auto rate = getSampleRate();
+    return rate > 0.0 ? (double)numBlocks * samplesPerBlock / rate : 0.0;
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PeakPyramid.h"
+
+//==============================================================================
+/**
+    Peaks of the audio being recorded, for drawing while it's captured.
+
+    The capture thread reduces every samplesPerBlock frames to one peak per
+    channel and pushes it through a lock-free FIFO; it never blocks or
+    allocates, and if the UI falls behind far enough for the FIFO to fill,
+    blocks are dropped rather than waited for. The message thread pulls them
+    into a growing history, which costs about 17 KB per minute of stereo;
+    dropped blocks take up a silent place in it, so the history stays in step
+    with the time axis.
+*/
+class LivePeaks
+{
+public:
+    LivePeaks() = default;
+
+    static constexpr int samplesPerBlock = 1024;
+    static constexpr int maxChannels = 8;
+
+    // Message thread, while nothing is being captured
+    void reset();
+
+    // Capture thread
+    void addSamples(const float* const* channelData, int numChannels, int numFrames, double sampleRate) noexcept;
+
+    // Message thread: moves any finished blocks into the history, returning how many arrived
+    int pull();
+
+    int getNumChannels() const noexcept         { return numChannels.load(); }
+    double getSampleRate() const noexcept       { return sampleRate.load(); }
+    int getNumBlocks() const noexcept           { return numBlocks; }
+    double getLengthInSeconds() const noexcept;
+
+    const PeakPyramid::Peak& getPeak(int block, int channel) const noexcept
+    {
+        return history[(size_t)block * (size_t)getNumChannels() + (size_t)channel];
+    }
+
+private:
+    struct Block
+    {
+        std::array<PeakPyramid::Peak, maxChannels> peaks;
+        int droppedBefore = 0;      // droppedBlocks as of this block
+    };
+
+    struct Accumulator
+    {
+        float min = 0.0f, max = 0.0f;
+        double sumOfSquares = 0.0;
+    };
+
+    void pushBlock() noexcept;
+
+    // Written by the capture thread before its first block, read after
+    std::atomic<int> numChannels { 0 };
+    std::atomic<double> sampleRate { 0.0 };
+
+    // Capture thread only
+    std::array<Accumulator, maxChannels> accumulators;
+    int samplesInBlock = 0;
+
+    static constexpr int fifoSize = 512;
+    juce::AbstractFifo fifo { fifoSize };
+    std::array<Block, fifoSize> blocks;
+    std::atomic<int> droppedBlocks { 0 };
+
+    // Message thread only
+    std::vector<PeakPyramid::Peak> history;
+    int numBlocks = 0;          // including the dropped ones
+    int droppedInHistory = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LivePeaks)
+};
\ No newline at end of file
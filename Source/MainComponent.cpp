@@ -60,39 +60,71 @@ void DarkLookAndFeel::drawButtonBackground(juce::Graphics& g, juce::Button& butt
 // Library Component Implementation
 //==============================================================================
 
-LibraryComponent::LibraryComponent(LibraryManager& library) : libraryManager(library)
+LibraryComponent::LibraryComponent(LibraryManager& library, SparklineStore& sparklineStore)
+    : libraryManager(library), sparklines(sparklineStore)
 {
     addAndMakeVisible(searchLabel);
     addAndMakeVisible(searchBox);
+    addAndMakeVisible(fuzzyToggle);
+    addAndMakeVisible(facetsButton);
+    addAndMakeVisible(totalsLabel);
+    addAndMakeVisible(playlistSelector);
+    addAndMakeVisible(playlistButton);
     addAndMakeVisible(table);
     
     searchLabel.setText("Search:", juce::dontSendNotification);
     searchLabel.setJustificationType(juce::Justification::centredRight);
     
-    searchBox.setTextToShowWhenEmpty("Search recordings...", juce::Colours::grey);
-    searchBox.onTextChange = [this]() { updateContent(); };
+    searchBox.setTextToShowWhenEmpty("Search, e.g. tag:Live duration>120 sort:-date", juce::Colours::grey);
+    searchBox.onTextChange = [this]() { updateContent(searchDebounceMs); };
+    
+    fuzzyToggle.setTooltip("Typo-tolerant search over names, artists and tags, best matches first");
+    fuzzyToggle.onClick = [this]() { updateContent(); };
+    
+    playlistSelector.onChange = [this]()
+    {
+        activePlaylist = playlistSelector.getSelectedId() - 2;
+        updateContent();
+    };
+    
+    facetsButton.setTooltip("Counts and totals by tag, genre, artist, format and folder; pick one to filter by it");
+    facetsButton.onClick = [this]() { showFacetsMenu(); };
+    
+    totalsLabel.setFont(juce::FontOptions(12.0f));
+    totalsLabel.setColour(juce::Label::textColourId, juce::Colours::grey);
+    
+    playlistButton.setTooltip("Smart playlists");
+    playlistButton.onClick = [this]() { showPlaylistMenu(); };
+    refreshPlaylistSelector();
     
     // Setup table
     table.getHeader().addColumn("Name", 1, 200, 100, 400);
     table.getHeader().addColumn("Duration", 2, 80, 60, 120);
     table.getHeader().addColumn("Date", 3, 120, 100, 200);
     table.getHeader().addColumn("Tags", 4, 150, 100, 300);
+    table.getHeader().addColumn("Waveform", sparklineColumn, 100, 60, 200,
+                                juce::TableHeaderComponent::defaultFlags & ~juce::TableHeaderComponent::sortable, 1);
     
     table.setModel(this);
     table.setMultipleSelectionEnabled(false);
     
-    libraryManager.addChangeListener(this);
+    search.onResult = [this](LibrarySearch::Result& result) { showSearchResult(result); };
+    sparklines.onSparklinesReady = [this]() { table.repaint(); };
+    sparklines.setLibrary(libraryManager.getSnapshot());
+    
+    libraryManager.addListener(this);
     updateContent();
 }
 
 LibraryComponent::~LibraryComponent()
 {
-    libraryManager.removeChangeListener(this);
+    libraryManager.removeListener(this);
+    sparklines.onSparklinesReady = nullptr;
 }
 
 int LibraryComponent::getNumRows()
 {
-    return currentRecordings.size();
+    return currentHandles.size();
 }
 
 void LibraryComponent::paintRowBackground(juce::Graphics& g, int rowNumber, int /*width*/, int /*height*/, bool rowIsSelected)
@@ -111,24 +143,43 @@ void LibraryComponent::paintRowBackground(juce::Graphics& g, int rowNumber, int
 
 void LibraryComponent::paintCell(juce::Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected)
 {
-    if (rowNumber >= currentRecordings.size())
+    auto handle = getHandleForRow(rowNumber);
+    if (!handle.isValid())
         return;
+    
+    if (columnId == sparklineColumn)
+    {
+        // Only ever a lookup; the first paint of a row without one moves it to the front of the builder's queue
+        auto* recording = libraryManager.getRecording(handle);
+        SparklineStore::Sparkline points;
+        
+        if (recording != nullptr && sparklines.get(recording->file, recording->fileSize, points))
+        {
+            g.setColour(juce::Colour(0xff1db954).withAlpha(rowIsSelected ? 1.0f : 0.7f));
+            SparklineStore::draw(g, points, juce::Rectangle<int>(width, height).reduced(2, 3).toFloat());
+        }
         
-    const auto& recording = currentRecordings.getReference(rowNumber);
+        return;
+    }
     
     g.setColour(rowIsSelected ? juce::Colours::white : juce::Colour(0xffffffff));
-    g.setFont(juce::FontOptions(14.0f));
     
-    juce::String text;
-    switch (columnId)
+    // Only formatted the first time the cell is painted after its recording changes
+    cellCache.draw(g, handle.row, columnId, width, height, [this, handle, columnId]
     {
-        case 1: text = recording.name; break;
-        case 2: text = juce::String(recording.durationInSeconds, 1) + "s"; break;
-        case 3: text = recording.timestamp.formatted("%d/%m %H:%M"); break;
-        case 4: text = recording.tags.joinIntoString(", "); break;
-    }
-    
-    g.drawText(text, 2, 0, width - 4, height, juce::Justification::centredLeft, true);
+        auto* recording = libraryManager.getRecording(handle);
+        if (recording == nullptr)
+            return juce::String();
+        
+        switch (columnId)
+        {
+            case 1: return recording->name;
+            case 2: return juce::String(recording->durationInSeconds, 1) + "s";
+            case 3: return recording->timestamp.formatted("%d/%m %H:%M");
+            case 4: return recording->tags.joinIntoString(", ");
+            default: return juce::String();
+        }
+    });
 }
 
 void LibraryComponent::selectedRowsChanged(int lastRowSelected)
@@ -137,41 +188,458 @@ void LibraryComponent::selectedRowsChanged(int lastRowSelected)
     table.repaint();
     
     if (onSelectionChanged)
-        onSelectionChanged(lastRowSelected);
+        onSelectionChanged(getHandleForRow(lastRowSelected));
+}
+
+void LibraryComponent::sortOrderChanged(int newSortColumnId, bool isForwards)
+{
+    using SortField = LibraryQuery::SortField;
+    
+    SortField field;
+    switch (newSortColumnId)
+    {
+        case 1: field = SortField::name; break;
+        case 2: field = SortField::duration; break;
+        case 3: field = SortField::timestamp; break;
+        case 4: field = SortField::tags; break;
+        default: return;
+    }
+    
+    // The previously sorted columns become tie-breakers
+    columnSortKeys.erase(std::remove_if(columnSortKeys.begin(), columnSortKeys.end(),
+                                        [field](const LibraryQuery::SortKey& key) { return key.field == field; }),
+                         columnSortKeys.end());
+    columnSortKeys.insert(columnSortKeys.begin(), LibraryQuery::SortKey { field, !isForwards });
+    
+    if (columnSortKeys.size() > 3)
+        columnSortKeys.resize(3);
+    
+    updateContent();
+}
+
+void LibraryComponent::cellDoubleClicked(int rowNumber, int /*columnId*/, const juce::MouseEvent& /*e*/)
+{
+    if (onRecordingPlay)
+        onRecordingPlay(getHandleForRow(rowNumber));
 }
 
 void LibraryComponent::resized()
 {
     auto area = getLocalBounds();
     
+    auto playlistArea = area.removeFromTop(30);
+    playlistButton.setBounds(playlistArea.removeFromRight(40).reduced(2));
+    playlistSelector.setBounds(playlistArea.reduced(2));
+    
     auto topArea = area.removeFromTop(30);
     searchLabel.setBounds(topArea.removeFromLeft(60));
     searchBox.setBounds(topArea.removeFromLeft(200));
+    fuzzyToggle.setBounds(topArea.removeFromLeft(70).reduced(4, 0));
+    facetsButton.setBounds(topArea.removeFromLeft(60).reduced(2));
+    
+    totalsLabel.setBounds(area.removeFromTop(20));
     
     area.removeFromTop(5);
     table.setBounds(area);
 }
 
-void LibraryComponent::changeListenerCallback(juce::ChangeBroadcaster*)
+void LibraryComponent::libraryUpdated(const LibraryDelta& delta)
 {
-    updateContent();
+    invalidateSparklines(delta);
+    
+    constexpr int displayedFields = LibraryDelta::nameField | LibraryDelta::durationField
+                                  | LibraryDelta::timestampField | LibraryDelta::tagsField;
+    
+    if (delta.reset)
+    {
+        cellCache.clear();
+        refreshPlaylistSelector();
+    }
+    
+    for (auto handle : delta.removed)
+        cellCache.invalidate(handle.row);
+    
+    for (const auto& update : delta.updated)
+        if ((update.fields & displayedFields) != 0)
+            cellCache.invalidate(update.handle.row);
+    
+    // Relative dates moved on with the day
+    if (delta.playlistsChanged && getActivePlaylist() != nullptr)
+    {
+        updateContent();
+        return;
+    }
+    
+    // The search in flight is rerun against the newer snapshot when its result lands
+    if (search.isSearching())
+        return;
+    
+    // A limit/offset window can pull in rows from anywhere, and a ranked fuzzy
+    // result depends on every match, so only a rerun keeps those right
+    auto* playlist = getActivePlaylist();
+    
+    if (delta.reset || activeQuery.limit >= 0 || activeQuery.offset > 0 || isFuzzySearch()
+         || (playlist != nullptr && playlist->isWindowed()))
+    {
+        updateContent();
+        return;
+    }
+    
+    auto selected = getSelectedHandle();
+    auto sortedFields = activeQuery.getSortedFields();
+    std::vector<RecordingHandle> toInsert;
+    std::vector<RecordingHandle> toRepaint;
+    std::unordered_set<LibraryRow> leaving;
+    
+    // A sorted view can only be searched linearly, so past a few changes it's indexed once instead
+    std::unordered_map<LibraryRow, int> rowsInView;
+    
+    if (!activeQuery.sortKeys.empty() && delta.removed.size() + delta.updated.size() > maxViewSearches)
+    {
+        rowsInView.reserve((size_t)currentHandles.size());
+        
+        for (int i = 0; i < currentHandles.size(); ++i)
+            rowsInView.emplace(currentHandles.getReference(i).row, i);
+    }
+    
+    auto findRow = [this, &rowsInView](RecordingHandle handle)
+    {
+        if (rowsInView.empty())
+            return findRowForHandle(handle);
+        
+        auto it = rowsInView.find(handle.row);
+        return it != rowsInView.end() ? it->second : -1;
+    };
+    
+    for (auto handle : delta.removed)
+        leaving.insert(handle.row);
+    
+    for (const auto& update : delta.updated)
+    {
+        auto* recording = libraryManager.getRecording(update.handle);
+        auto inView = findRow(update.handle) >= 0;
+        bool matches = recording != nullptr && isInView(update.handle, *recording);
+        
+        if (inView && matches && (update.fields & sortedFields) == 0)
+        {
+            toRepaint.push_back(update.handle);
+            continue;
+        }
+        
+        if (inView)
+            leaving.insert(update.handle.row);
+        
+        if (matches)
+            toInsert.push_back(update.handle);
+    }
+    
+    for (auto handle : delta.inserted)
+        if (auto* recording = libraryManager.getRecording(handle))
+            if (isInView(handle, *recording))
+                toInsert.push_back(handle);
+    
+    // Whatever has to move or go is taken out in one pass...
+    auto rowsMoved = !leaving.empty()
+                  && currentHandles.removeIf([&leaving](RecordingHandle handle) { return leaving.count(handle.row) > 0; }) > 0;
+    
+    // ...and what's left is still in order, so the newcomers are merged back in another
+    if (!toInsert.empty())
+    {
+        auto isBefore = [this](RecordingHandle a, RecordingHandle b) { return isBeforeInView(a, b); };
+        std::sort(toInsert.begin(), toInsert.end(), isBefore);
+        
+        juce::Array<RecordingHandle> merged;
+        merged.resize(currentHandles.size() + (int)toInsert.size());
+        std::merge(currentHandles.begin(), currentHandles.end(), toInsert.begin(), toInsert.end(), merged.begin(), isBefore);
+        currentHandles.swapWith(merged);
+    }
+    
+    updateTotals();
+    
+    if (!rowsMoved && toInsert.empty())
+    {
+        for (auto handle : toRepaint)
+            table.repaintRow(findRow(handle));
+        
+        return;
+    }
+    
+    table.updateContent();
+    restoreSelection(selected);
+    table.repaint();
+}
+
+void LibraryComponent::invalidateSparklines(const LibraryDelta& delta)
+{
+    // Nothing is built here: rows are queued as they're painted
+    sparklines.setLibrary(libraryManager.getSnapshot());
+    
+    std::vector<juce::File> files;
+    
+    for (const auto& update : delta.updated)
+        if ((update.fields & LibraryDelta::fileField) != 0)
+            if (auto* recording = libraryManager.getRecording(update.handle))
+                files.push_back(recording->file);
+    
+    sparklines.invalidate(files);
 }
 
-void LibraryComponent::updateContent()
+void LibraryComponent::updateContent(int searchDelayMs)
 {
     auto searchTerm = searchBox.getText();
-    currentRecordings = libraryManager.getFilteredRecordings(searchTerm);
+    
+    if (isFuzzySearch())
+    {
+        // The fuzzy index belongs to the message thread, and its results are capped
+        search.cancel();
+        activeQuery = {};
+        
+        auto handles = libraryManager.fuzzySearch(searchTerm);
+        
+        if (auto* playlist = getActivePlaylist())
+            handles.removeIf([playlist](RecordingHandle h) { return !playlist->members.contains(h.row); });
+        
+        showHandles(std::move(handles));
+        return;
+    }
+    
+    activeQuery = LibraryQuery::parse(searchTerm);
+    
+    // A sort: in the search text wins over the column headers
+    if (activeQuery.sortKeys.empty())
+        activeQuery.sortKeys = columnSortKeys;
+    
+    // The index lookups are quick enough to run here; only ordering the matches goes to the search thread
+    auto* playlist = getActivePlaylist();
+    search.start(libraryManager.prepareSearch(activeQuery, playlist != nullptr ? &playlist->members : nullptr),
+                 searchDelayMs);
+}
+
+void LibraryComponent::showSearchResult(LibrarySearch::Result& result)
+{
+    showHandles(std::move(result.handles));
+    
+    // The library changed while the search ran
+    if (result.snapshotVersion != libraryManager.getSnapshot()->getVersion())
+        updateContent();
+}
+
+void LibraryComponent::showHandles(juce::Array<RecordingHandle> handles)
+{
+    auto selected = getSelectedHandle();
+    currentHandles = std::move(handles);
+    
     table.updateContent();
+    restoreSelection(selected);
+    updateTotals();
     repaint();
 }
 
+void LibraryComponent::updateTotals()
+{
+    const auto& totals = libraryManager.getAggregates().getTotals();
+    
+    auto text = LibraryAggregates::describe(totals);
+    if (currentHandles.size() != totals.count)
+        text = juce::String(currentHandles.size()) + " shown of " + text;
+    
+    totalsLabel.setText(text, juce::dontSendNotification);
+}
+
+void LibraryComponent::showFacetsMenu()
+{
+    const auto& aggregates = libraryManager.getAggregates();
+    
+    // Facets of what's on screen, so each pick narrows the current view
+    std::unique_ptr<LibraryAggregates> subset;
+    if (currentHandles.size() != aggregates.getTotals().count)
+    {
+        std::vector<LibraryRow> rows;
+        rows.reserve((size_t)currentHandles.size());
+        
+        for (auto handle : currentHandles)
+            rows.push_back(handle.row);
+        
+        subset = aggregates.createSubset(rows);
+    }
+    
+    const auto& source = subset != nullptr ? *subset : aggregates;
+    
+    juce::PopupMenu menu;
+    std::vector<juce::String> terms;
+    
+    for (int d = 0; d < LibraryAggregates::numDimensions; ++d)
+    {
+        auto dimension = (LibraryAggregates::Dimension)d;
+        juce::PopupMenu subMenu;
+        
+        for (const auto& bucket : source.getBuckets(dimension, 25))
+        {
+            terms.push_back(LibraryAggregates::getFilterTerm(dimension, bucket));
+            subMenu.addItem((int)terms.size(), LibraryAggregates::getBucketLabel(dimension, bucket));
+        }
+        
+        menu.addSubMenu(LibraryAggregates::getDimensionName(dimension), subMenu, subMenu.getNumItems() > 0);
+    }
+    
+    menu.showMenuAsync(juce::PopupMenu::Options{}.withTargetComponent(&facetsButton), [this, terms](int result)
+    {
+        if (result <= 0 || result > (int)terms.size())
+            return;
+        
+        // Facet terms are query syntax, which fuzzy mode doesn't read
+        fuzzyToggle.setToggleState(false, juce::dontSendNotification);
+        searchBox.setText((searchBox.getText().trim() + " " + terms[(size_t)result - 1]).trim(), true);
+    });
+}
+
+bool LibraryComponent::isInView(RecordingHandle handle, const Recording& recording) const
+{
+    // The library updates playlist membership before telling its listeners
+    auto* playlist = getActivePlaylist();
+    return (playlist == nullptr || playlist->members.contains(handle.row)) && activeQuery.matches(recording);
+}
+
+const SmartPlaylist* LibraryComponent::getActivePlaylist() const
+{
+    return libraryManager.getSmartPlaylist(activePlaylist);
+}
+
+void LibraryComponent::refreshPlaylistSelector()
+{
+    playlistSelector.clear(juce::dontSendNotification);
+    playlistSelector.addItem("All Recordings", 1);
+    
+    for (int i = 0; i < libraryManager.getNumSmartPlaylists(); ++i)
+        playlistSelector.addItem(libraryManager.getSmartPlaylist(i)->name, i + 2);
+    
+    if (getActivePlaylist() == nullptr)
+        activePlaylist = -1;
+    
+    playlistSelector.setSelectedId(activePlaylist + 2, juce::dontSendNotification);
+}
+
+void LibraryComponent::showPlaylistMenu()
+{
+    bool canSave = searchBox.getText().trim().isNotEmpty() && !fuzzyToggle.getToggleState();
+    auto* playlist = getActivePlaylist();
+    
+    juce::PopupMenu menu;
+    menu.addItem(1, "Save Search as Smart Playlist...", canSave);
+    
+    if (playlist != nullptr)
+    {
+        menu.addItem(2, "Update \"" + playlist->name + "\" to the Current Search", canSave);
+        menu.addItem(3, "Delete \"" + playlist->name + "\"");
+    }
+    
+    menu.showMenuAsync(juce::PopupMenu::Options{}.withTargetComponent(&playlistButton), [this](int result)
+    {
+        auto* current = getActivePlaylist();
+        
+        if (result == 1)
+        {
+            saveSearchAsPlaylist();
+        }
+        else if (result == 2 && current != nullptr)
+        {
+            // The search then only narrows the view within the new membership
+            libraryManager.editSmartPlaylist(activePlaylist, current->name, searchBox.getText().trim());
+            searchBox.clear();
+            updateContent();
+        }
+        else if (result == 3 && current != nullptr)
+        {
+            libraryManager.removeSmartPlaylist(activePlaylist);
+            activePlaylist = -1;
+            refreshPlaylistSelector();
+            updateContent();
+        }
+    });
+}
+
+void LibraryComponent::saveSearchAsPlaylist()
+{
+    auto queryText = searchBox.getText().trim();
+    
+    auto* window = new juce::AlertWindow("Save Smart Playlist",
+                                         "The playlist keeps itself up to date with: " + queryText,
+                                         juce::AlertWindow::NoIcon);
+    window->addTextEditor("name", queryText, "Name:");
+    window->addButton("Save", 1, juce::KeyPress(juce::KeyPress::returnKey));
+    window->addButton("Cancel", 0, juce::KeyPress(juce::KeyPress::escapeKey));
+    
+    window->enterModalState(true, juce::ModalCallbackFunction::create([this, window, queryText](int result)
+    {
+        auto name = window->getTextEditorContents("name").trim();
+        if (result != 1 || name.isEmpty())
+            return;
+        
+        activePlaylist = libraryManager.addSmartPlaylist(name, queryText);
+        refreshPlaylistSelector();
+        searchBox.clear();
+        updateContent();
+    }), true);
+}
+
+bool LibraryComponent::isFuzzySearch() const
+{
+    return fuzzyToggle.getToggleState() && searchBox.getText().trim().isNotEmpty();
+}
+
+int LibraryComponent::findRowForHandle(RecordingHandle handle) const
+{
+    // Library order is row order, so an unsorted view can be searched by row
+    if (activeQuery.sortKeys.empty() && !isFuzzySearch())
+    {
+        auto* end = currentHandles.end();
+        auto* found = std::lower_bound(currentHandles.begin(), end, handle,
+                                       [](RecordingHandle a, RecordingHandle b) { return a.row < b.row; });
+        
+        return found != end && *found == handle ? (int)(found - currentHandles.begin()) : -1;
+    }
+    
+    // The recording may already hold its new sort values, so it can't be found by them
+    return currentHandles.indexOf(handle);
+}
+
+bool LibraryComponent::isBeforeInView(RecordingHandle a, RecordingHandle b) const
+{
+    auto* ra = libraryManager.getRecording(a);
+    auto* rb = libraryManager.getRecording(b);
+    
+    if (ra == nullptr || rb == nullptr)
+        return a.row < b.row;
+    
+    return activeQuery.isBefore(*ra, a.row, *rb, b.row);
+}
+
+RecordingHandle LibraryComponent::getSelectedHandle() const
+{
+    auto selectedRow = table.getSelectedRow();
+    return juce::isPositiveAndBelow(selectedRow, currentHandles.size()) ? currentHandles.getReference(selectedRow)
+                                                                       : RecordingHandle();
+}
+
+void LibraryComponent::restoreSelection(RecordingHandle handle)
+{
+    // Rows move as the view changes; keep the same recording selected without re-announcing it
+    juce::SparseSet<int> rows;
+    
+    auto index = handle.isValid() ? findRowForHandle(handle) : -1;
+    if (index >= 0)
+        rows.addRange({ index, index + 1 });
+    
+    table.setSelectedRows(rows, juce::dontSendNotification);
+}
+
 void LibraryComponent::mouseDown(const juce::MouseEvent& e)
 {
     if (e.mods.isRightButtonDown())
     {
         // Find which row was clicked
         auto rowClicked = table.getRowContainingPosition(e.getMouseDownX(), e.getMouseDownY() - table.getY());
-        if (juce::isPositiveAndBelow(rowClicked, currentRecordings.size()))
+        if (juce::isPositiveAndBelow(rowClicked, currentHandles.size()))
         {
             // Select the row first
             table.selectRow(rowClicked);
@@ -186,10 +654,12 @@ void LibraryComponent::mouseDown(const juce::MouseEvent& e)
 
 void LibraryComponent::showContextMenu(int rowNumber, const juce::MouseEvent& /*e*/)
 {
-    if (!juce::isPositiveAndBelow(rowNumber, currentRecordings.size()))
+    auto handle = getHandleForRow(rowNumber);
+    auto* found = libraryManager.getRecording(handle);
+    if (found == nullptr)
         return;
         
-    const auto& recording = currentRecordings.getReference(rowNumber);
+    auto recording = *found;
     
     juce::PopupMenu menu;
     menu.addItem(1, "Edit Info...");
@@ -199,18 +669,18 @@ void LibraryComponent::showContextMenu(int rowNumber, const juce::MouseEvent& /*
     menu.addItem(4, "Copy Path");
     menu.addItem(5, "Show in Explorer");
     
-    menu.showMenuAsync(juce::PopupMenu::Options{}, [this, rowNumber, recording](int result)
+    menu.showMenuAsync(juce::PopupMenu::Options{}, [this, handle, recording](int result)
     {
         switch (result)
         {
             case 1: // Edit Info
                 if (onRecordingEdit)
-                    onRecordingEdit(recording);
+                    onRecordingEdit(handle);
                 break;
                 
             case 2: // Delete from Library
                 if (onRecordingRemove)
-                    onRecordingRemove(rowNumber);
+                    onRecordingRemove(handle);
                 break;
                 
             case 3: // Export Audio
@@ -333,20 +803,16 @@ Recording MetadataEditorComponent::getEditedRecording() const
 // Waveform Component Implementation  
 //==============================================================================
 
-WaveformComponent::WaveformComponent() : cache(5), thumbnail(512, formatManager, cache)
+WaveformComponent::WaveformComponent(PeakStore& store, DecodedBlockCache& cache)
+    : peakStore(store), tiles(cache)
 {
-    formatManager.registerBasicFormats();
-    thumbnail.addChangeListener(this);
-}
-
-void WaveformComponent::changeListenerCallback(juce::ChangeBroadcaster*)
-{
-    repaint();
+    peakStore.addListener(this);
+    tiles.onTilesReady = [this]() { repaint(getWaveformArea()); };
 }
 
 WaveformComponent::~WaveformComponent()
 {
-    thumbnail.removeChangeListener(this);
+    peakStore.removeListener(this);
 }
 
 void WaveformComponent::setAudioFile(const juce::File& file)
@@ -354,104 +820,518 @@ void WaveformComponent::setAudioFile(const juce::File& file)
     if (currentFile != file)
     {
         currentFile = file;
-        needsToLoadFile = true;
+        peaks = file.existsAsFile() ? peakStore.getPeaks(file) : nullptr;
+        tiles.setSource(currentFile, peaks);
+        samplesPerPixel = 0.0;
+        viewStart = 0.0;
+        viewChanged();
+        repaint();
+    }
+}
+
+void WaveformComponent::peaksReady(const juce::File& audioFile)
+{
+    if (audioFile == currentFile)
+    {
+        peaks = peakStore.getPeaks(audioFile);
+        tiles.setSource(currentFile, peaks);
+        samplesPerPixel = 0.0;
+        viewStart = 0.0;
+        viewChanged();
+        repaint();
+    }
+}
+
+void WaveformComponent::setLivePeaks(LivePeaks* peaksBeingRecorded)
+{
+    livePeaks = peaksBeingRecorded;
+    
+    if (livePeaks != nullptr)
+        startTimerHz(30);
+    else
+        stopTimer();
+    
+    repaint();
+}
+
+void WaveformComponent::setPlayhead(juce::int64 sample)
+{
+    if (playhead == sample)
+        return;
+    
+    auto oldX = getPlayheadX();
+    playhead = sample;
+    auto newX = getPlayheadX();
+    
+    // When zoomed in, turn the page as the playhead runs off the right edge
+    if (samplesPerPixel > 0.0 && oldX >= 0 && newX < 0 && (double)playhead > viewStart)
+    {
+        setView(samplesPerPixel, (double)playhead);
+        return;
+    }
+    
+    if (oldX != newX)
+    {
+        // Only the columns under the old and new lines need redrawing
+        auto area = getWaveformArea();
         
-        if (file == juce::File() || !file.existsAsFile())
+        for (auto x : { oldX, newX })
+            if (x >= 0)
+                repaint(x - 1, area.getY(), 3, area.getHeight());
+    }
+}
+
+int WaveformComponent::getPlayheadX() const
+{
+    if (playhead < 0 || peaks == nullptr || peaks->getNumSamples() <= 0 || livePeaks != nullptr)
+        return -1;
+    
+    auto area = getWaveformArea();
+    auto x = area.getX() + (int)std::floor(((double)playhead - viewStart) / getSamplesPerPixel());
+    
+    return x >= area.getX() && x < area.getRight() ? x : -1;
+}
+
+double WaveformComponent::getSamplesPerPixel() const
+{
+    if (peaks == nullptr)
+        return 1.0;
+    
+    auto fit = (double)peaks->getNumSamples() / (double)juce::jmax(1, getWaveformArea().getWidth());
+    return samplesPerPixel > 0.0 ? juce::jmin(samplesPerPixel, fit) : fit;
+}
+
+void WaveformComponent::setView(double newSamplesPerPixel, double newViewStart)
+{
+    if (peaks == nullptr)
+        return;
+    
+    auto width = juce::jmax(1, getWaveformArea().getWidth());
+    auto numSamples = (double)peaks->getNumSamples();
+    auto minimum = WaveformTiles::getSamplesPerPixel(WaveformTiles::minLevel);
+    
+    // Zooming all the way out fits the file, and keeps it fitted through resizes
+    samplesPerPixel = newSamplesPerPixel <= 0.0 || newSamplesPerPixel >= numSamples / width
+                        ? 0.0 : juce::jmax(minimum, newSamplesPerPixel);
+    viewStart = juce::jlimit(0.0, juce::jmax(0.0, numSamples - getSamplesPerPixel() * width), newViewStart);
+    viewChanged();
+    repaint();
+}
+
+void WaveformComponent::viewChanged()
+{
+    if (onViewChanged != nullptr)
+        onViewChanged(viewStart, getSamplesPerPixel());
+}
+
+void WaveformComponent::zoomAround(int x, double newSamplesPerPixel)
+{
+    auto offset = (double)(x - getWaveformArea().getX());
+    auto anchor = viewStart + offset * getSamplesPerPixel();
+    
+    setView(newSamplesPerPixel, viewStart);
+    setView(samplesPerPixel, anchor - offset * getSamplesPerPixel());
+}
+
+void WaveformComponent::seekToX(int x)
+{
+    if (peaks == nullptr || livePeaks != nullptr || onSeek == nullptr)
+        return;
+    
+    auto sample = viewStart + (double)(x - getWaveformArea().getX()) * getSamplesPerPixel();
+    onSeek(currentFile, juce::jlimit((juce::int64)0, peaks->getNumSamples(), (juce::int64)sample));
+}
+
+void WaveformComponent::mouseDown(const juce::MouseEvent& e)
+{
+    dragStartViewStart = viewStart;
+    
+    if (!e.mods.isShiftDown())
+        seekToX(e.x);
+}
+
+void WaveformComponent::mouseDrag(const juce::MouseEvent& e)
+{
+    if (e.mods.isShiftDown())
+        setView(samplesPerPixel, dragStartViewStart - e.getDistanceFromDragStartX() * getSamplesPerPixel());
+    else
+        seekToX(e.x);
+}
+
+void WaveformComponent::mouseDoubleClick(const juce::MouseEvent& /*e*/)
+{
+    setView(0.0, 0.0);
+}
+
+void WaveformComponent::mouseWheelMove(const juce::MouseEvent& e, const juce::MouseWheelDetails& wheel)
+{
+    if (peaks == nullptr || livePeaks != nullptr)
+    {
+        juce::Component::mouseWheelMove(e, wheel);
+        return;
+    }
+    
+    auto deltaX = wheel.deltaX != 0.0f ? wheel.deltaX : (e.mods.isShiftDown() ? wheel.deltaY : 0.0f);
+    
+    if (deltaX != 0.0f)
+        setView(samplesPerPixel, viewStart - deltaX * 0.5 * getWaveformArea().getWidth() * getSamplesPerPixel());
+    else if (wheel.deltaY != 0.0f)
+        zoomAround(e.x, getSamplesPerPixel() * std::exp2(-wheel.deltaY * 4.0));
+}
+
+void WaveformComponent::mouseMagnify(const juce::MouseEvent& e, float scaleFactor)
+{
+    if (peaks != nullptr && livePeaks == nullptr && scaleFactor > 0.0f)
+        zoomAround(e.x, getSamplesPerPixel() / scaleFactor);
+}
+
+void WaveformComponent::timerCallback()
+{
+    if (livePeaks != nullptr && livePeaks->pull() > 0)
+        repaint();
+}
+
+void WaveformComponent::paint(juce::Graphics& g)
+{
+    g.fillAll(juce::Colour(0xff1a1a1a));
+    
+    auto area = getLocalBounds().reduced(10);
+    
+    if (livePeaks != nullptr)
+    {
+        drawLivePeaks(g, area);
+        
+        g.setColour(juce::Colour(0xff404040));
+        g.drawRect(area, 1);
+        
+        g.setColour(juce::Colours::white.withAlpha(0.8f));
+        g.setFont(juce::FontOptions(12.0f));
+        auto seconds = (int)livePeaks->getLengthInSeconds();
+        g.drawText("Recording " + juce::String::formatted("%d:%02d", seconds / 60, seconds % 60),
+                   area.removeFromBottom(20), juce::Justification::centredLeft);
+    }
+    else if (peaks != nullptr && peaks->getNumSamples() > 0)
+    {
+        // Draw waveform
+        drawTiles(g, area);
+        
+        auto playheadX = getPlayheadX();
+        if (playheadX >= 0)
         {
-            thumbnail.clear();
-            repaint();
+            g.setColour(juce::Colours::white);
+            g.fillRect(playheadX, area.getY(), 1, area.getHeight());
         }
+        
+        // Add border
+        g.setColour(juce::Colour(0xff404040));
+        g.drawRect(area, 1);
+        
+        // Show file info at the bottom
+        if (currentFile != juce::File())
+        {
+            g.setColour(juce::Colours::white.withAlpha(0.8f));
+            g.setFont(juce::FontOptions(12.0f));
+            auto infoText = currentFile.getFileNameWithoutExtension() + " (" + 
+                           juce::String(peaks->getLengthInSeconds(), 1) + "s)";
+            g.drawText(infoText, area.removeFromBottom(20), juce::Justification::centredLeft);
+        }
+    }
+    else if (currentFile != juce::File() && peakStore.isBuilding(currentFile))
+    {
+        g.setColour(juce::Colours::white.withAlpha(0.6f));
+        g.setFont(juce::FontOptions(16.0f));
+        g.drawText("Building waveform...", area, juce::Justification::centred);
+        
+        g.setColour(juce::Colour(0xff404040));
+        g.drawRect(area, 1);
+    }
+    else if (currentFile != juce::File() && !currentFile.existsAsFile())
+    {
+        g.setColour(juce::Colours::red.withAlpha(0.6f));
+        g.setFont(juce::FontOptions(16.0f));
+        g.drawText("Audio file not found", area, juce::Justification::centred);
+        
+        g.setColour(juce::Colour(0xff404040));
+        g.drawRect(area, 1);
+    }
+    else if (currentFile != juce::File())
+    {
+        g.setColour(juce::Colours::red.withAlpha(0.6f));
+        g.setFont(juce::FontOptions(16.0f));
+        g.drawText("Couldn't read audio file", area, juce::Justification::centred);
+        
+        g.setColour(juce::Colour(0xff404040));
+        g.drawRect(area, 1);
+    }
+    else
+    {
+        g.setColour(juce::Colours::white.withAlpha(0.6f));
+        g.setFont(juce::FontOptions(16.0f));
+        g.drawText("No audio file selected", area, juce::Justification::centred);
+        
+        g.setColour(juce::Colour(0xff404040));
+        g.drawRect(area, 1);
+    }
+}
+
+void WaveformComponent::drawTiles(juce::Graphics& g, juce::Rectangle<int> area)
+{
+    auto spp = getSamplesPerPixel();
+    auto level = WaveformTiles::getLevelFor(spp);
+    auto tileSamples = WaveformTiles::tileWidth * WaveformTiles::getSamplesPerPixel(level);
+    auto numTiles = (juce::int64)std::ceil((double)peaks->getNumSamples() / tileSamples);
+    auto firstTile = (juce::int64)std::floor(viewStart / tileSamples);
+    auto lastTile = juce::jmin(numTiles - 1, (juce::int64)std::floor((viewStart + spp * area.getWidth()) / tileSamples));
+    
+    auto getX = [&](double sample) { return area.getX() + juce::roundToInt((sample - viewStart) / spp); };
+    
+    std::vector<WaveformTiles::TileKey> wanted;
+    
+    g.saveState();
+    g.reduceClipRegion(area);
+    g.setImageResamplingQuality(juce::Graphics::lowResamplingQuality);
+    
+    // Tiles are rendered at the nearest finer level and squeezed slightly to fit
+    for (auto t = firstTile; t <= lastTile; ++t)
+    {
+        WaveformTiles::TileKey key { level, t };
+        auto x = getX((double)t * tileSamples);
+        juce::Rectangle<int> dest(x, area.getY(), getX((double)(t + 1) * tileSamples) - x, area.getHeight());
+        auto image = tiles.getTile(key);
+        
+        if (image.isValid())
+            g.drawImage(image, dest.toFloat());
         else
+            drawStandIn(g, key, dest);
+        
+        if (image.getHeight() != area.getHeight())
+            wanted.push_back(key);
+    }
+    
+    g.restoreState();
+    
+    // One more each side, so panning finds them ready
+    if (firstTile > 0)
+        wanted.push_back({ level, firstTile - 1 });
+    if (lastTile + 1 < numTiles)
+        wanted.push_back({ level, lastTile + 1 });
+    
+    tiles.request(wanted, area.getHeight());
+}
+
+void WaveformComponent::drawStandIn(juce::Graphics& g, WaveformTiles::TileKey key, juce::Rectangle<int> dest)
+{
+    // Until the tile arrives, stretch the part of a coarser one that covers it
+    for (auto level = key.level + 1; level <= key.level + 4 * WaveformTiles::stepsPerOctave; ++level)
+    {
+        auto ratio = WaveformTiles::getSamplesPerPixel(key.level) / WaveformTiles::getSamplesPerPixel(level);
+        auto startPixel = (double)(key.index * WaveformTiles::tileWidth) * ratio;
+        auto index = (juce::int64)std::floor(startPixel / WaveformTiles::tileWidth);
+        auto image = tiles.getTile({ level, index });
+        
+        if (!image.isValid())
+            continue;
+        
+        auto sourceX = (int)(startPixel - (double)(index * WaveformTiles::tileWidth));
+        auto sourceWidth = juce::jmax(1, juce::jmin(image.getWidth() - sourceX, juce::roundToInt(WaveformTiles::tileWidth * ratio)));
+        auto destWidth = juce::roundToInt(dest.getWidth() * sourceWidth / (WaveformTiles::tileWidth * ratio));
+        
+        g.drawImage(image, dest.getX(), dest.getY(), destWidth, dest.getHeight(),
+                    sourceX, 0, sourceWidth, image.getHeight());
+        return;
+    }
+}
+
+void WaveformComponent::drawLivePeaks(juce::Graphics& g, juce::Rectangle<int> area) const
+{
+    auto numChannels = livePeaks->getNumChannels();
+    auto numBlocks = livePeaks->getNumBlocks();
+    
+    if (numChannels == 0 || area.isEmpty())
+        return;
+    
+    // One block per pixel: grows from the left, then scrolls once it fills the width
+    auto firstBlock = juce::jmax(0, numBlocks - area.getWidth());
+    auto laneHeight = (float)area.getHeight() / (float)numChannels;
+    juce::RectangleList<float> extents, levels;
+    
+    for (int c = 0; c < numChannels; ++c)
+    {
+        auto centre = (float)area.getY() + laneHeight * ((float)c + 0.5f);
+        auto halfHeight = laneHeight * 0.5f;
+        
+        for (int block = firstBlock; block < numBlocks; ++block)
         {
-            startTimer(100);
+            const auto& peak = livePeaks->getPeak(block, c);
+            auto x = (float)(area.getX() + block - firstBlock);
+            auto top = centre - (float)peak.max / 127.0f * halfHeight;
+            auto bottom = centre - (float)peak.min / 127.0f * halfHeight;
+            extents.addWithoutMerging({ x, top, 1.0f, juce::jmax(1.0f, bottom - top) });
+            
+            auto rms = (float)peak.rms / 255.0f * halfHeight;
+            levels.addWithoutMerging({ x, centre - rms, 1.0f, rms * 2.0f });
         }
     }
+    
+    g.setColour(juce::Colour(0xffe53e3e));
+    g.fillRectList(extents);
+    
+    g.setColour(juce::Colour(0xfff87171));
+    g.fillRectList(levels);
+}
+
+void WaveformComponent::resized()
+{
+    // Keep the same zoom, or the fit, within the new width
+    setView(samplesPerPixel, viewStart);
+}
+
+//==============================================================================
+// Spectrogram Component Implementation
+//==============================================================================
+
+SpectrogramComponent::SpectrogramComponent(DecodedBlockCache& cache) : tiles(cache)
+{
+    tiles.onTilesReady = [this]() { repaint(); };
+}
+
+void SpectrogramComponent::setAudioFile(const juce::File& file, juce::int64 lengthInSamples, double fileSampleRate)
+{
+    if (currentFile == file && numSamples == lengthInSamples)
+        return;
+    
+    currentFile = file;
+    numSamples = lengthInSamples;
+    sampleRate = fileSampleRate;
+    tiles.setSource(file);
+    repaint();
+}
+
+void SpectrogramComponent::setView(double newViewStart, double newSamplesPerPixel)
+{
+    if (viewStart != newViewStart || samplesPerPixel != newSamplesPerPixel)
+    {
+        viewStart = newViewStart;
+        samplesPerPixel = newSamplesPerPixel;
+        repaint();
+    }
 }
 
-void WaveformComponent::paint(juce::Graphics& g)
+void SpectrogramComponent::paint(juce::Graphics& g)
 {
     g.fillAll(juce::Colour(0xff1a1a1a));
     
-    auto area = getLocalBounds().reduced(10);
+    auto area = getSpectrogramArea();
     
-    if (thumbnail.getTotalLength() > 0)
+    if (currentFile != juce::File() && numSamples > 0 && samplesPerPixel > 0.0 && !area.isEmpty())
     {
-        // Draw waveform
-        g.setColour(juce::Colour(0xff1db954));
-        thumbnail.drawChannels(g, area, 0.0, thumbnail.getTotalLength(), 1.0f);
+        // Columns at least as close together as pixels, so a tile is never stretched wider than it was computed
+        auto hopLog2 = SpectrogramTiles::getHopLog2For(samplesPerPixel);
+        auto tileSamples = (double)((juce::int64)SpectrogramTiles::tileColumns << hopLog2);
+        auto numTiles = (juce::int64)std::ceil((double)numSamples / tileSamples);
+        auto firstTile = (juce::int64)std::floor(viewStart / tileSamples);
+        auto lastTile = juce::jmin(numTiles - 1, (juce::int64)std::floor((viewStart + samplesPerPixel * area.getWidth()) / tileSamples));
         
-        // Add border
-        g.setColour(juce::Colour(0xff404040));
-        g.drawRect(area, 1);
+        auto getX = [&](double sample) { return area.getX() + juce::roundToInt((sample - viewStart) / samplesPerPixel); };
         
-        // Show file info at the bottom
-        if (currentFile != juce::File())
+        std::vector<SpectrogramTiles::TileKey> wanted;
+        
+        g.saveState();
+        g.reduceClipRegion(area);
+        g.setImageResamplingQuality(juce::Graphics::mediumResamplingQuality);
+        
+        for (auto t = firstTile; t <= lastTile; ++t)
         {
-            g.setColour(juce::Colours::white.withAlpha(0.8f));
-            g.setFont(juce::FontOptions(12.0f));
-            auto infoText = currentFile.getFileNameWithoutExtension() + " (" + 
-                           juce::String(thumbnail.getTotalLength(), 1) + "s)";
-            g.drawText(infoText, area.removeFromBottom(20), juce::Justification::centredLeft);
+            SpectrogramTiles::TileKey key { fftOrder, hopLog2, t };
+            auto x = getX((double)t * tileSamples);
+            juce::Rectangle<int> dest(x, area.getY(), getX((double)(t + 1) * tileSamples) - x, area.getHeight());
+            auto image = tiles.getTile(key);
+            
+            if (image.isValid())
+            {
+                g.drawImage(image, dest.toFloat());
+            }
+            else
+            {
+                drawStandIn(g, key, dest);
+                wanted.push_back(key);
+            }
         }
-    }
-    else if (needsToLoadFile)
-    {
-        g.setColour(juce::Colours::white.withAlpha(0.6f));
-        g.setFont(juce::FontOptions(16.0f));
-        g.drawText("Loading audio file...", area, juce::Justification::centred);
         
-        g.setColour(juce::Colour(0xff404040));
-        g.drawRect(area, 1);
-    }
-    else if (currentFile != juce::File() && !currentFile.existsAsFile())
-    {
-        g.setColour(juce::Colours::red.withAlpha(0.6f));
-        g.setFont(juce::FontOptions(16.0f));
-        g.drawText("Audio file not found", area, juce::Justification::centred);
+        g.restoreState();
         
-        g.setColour(juce::Colour(0xff404040));
-        g.drawRect(area, 1);
-    }
-    else
-    {
+        if (firstTile > 0)
+            wanted.push_back({ fftOrder, hopLog2, firstTile - 1 });
+        if (lastTile + 1 < numTiles)
+            wanted.push_back({ fftOrder, hopLog2, lastTile + 1 });
+        
+        tiles.request(wanted);
+        
+        // Frequency scale, linear up to Nyquist
         g.setColour(juce::Colours::white.withAlpha(0.6f));
-        g.setFont(juce::FontOptions(16.0f));
-        g.drawText("No audio file selected", area, juce::Justification::centred);
+        g.setFont(juce::FontOptions(11.0f));
         
-        g.setColour(juce::Colour(0xff404040));
-        g.drawRect(area, 1);
+        for (int i = 1; i < 4; ++i)
+        {
+            auto y = area.getBottom() - area.getHeight() * i / 4;
+            g.drawText(juce::String(sampleRate / 2000.0 * i / 4.0, 1) + " kHz",
+                       area.getX() + 4, y - 7, 80, 14, juce::Justification::centredLeft);
+        }
+        
+        auto info = "FFT " + juce::String(1 << fftOrder) + (tiles.isBusy() ? "  (computing...)" : "");
+        g.drawText(info, area.reduced(4, 2), juce::Justification::bottomLeft);
     }
+    
+    g.setColour(juce::Colour(0xff404040));
+    g.drawRect(area, 1);
 }
 
-void WaveformComponent::resized()
-{
-    // Nothing special needed for resize
-}
-
-void WaveformComponent::timerCallback()
+void SpectrogramComponent::drawStandIn(juce::Graphics& g, SpectrogramTiles::TileKey key, juce::Rectangle<int> dest)
 {
-    if (needsToLoadFile)
+    // Until the tile arrives, stretch the part of a coarser one that covers it
+    for (auto hopLog2 = key.hopLog2 + 1; hopLog2 <= key.hopLog2 + 8; ++hopLog2)
     {
-        loadAudioFile();
-        needsToLoadFile = false;
-        stopTimer();
+        auto shift = hopLog2 - key.hopLog2;
+        auto index = key.index >> shift;
+        auto image = tiles.getTile({ key.fftOrder, hopLog2, index });
+        
+        if (!image.isValid())
+            continue;
+        
+        auto sourceWidth = juce::jmax(1, SpectrogramTiles::tileColumns >> shift);
+        auto sourceX = (int)((key.index - (index << shift)) * sourceWidth);
+        
+        g.drawImage(image, dest.getX(), dest.getY(), dest.getWidth(), dest.getHeight(),
+                    sourceX, 0, sourceWidth, image.getHeight());
+        return;
     }
 }
 
-void WaveformComponent::loadAudioFile()
+void SpectrogramComponent::mouseDown(const juce::MouseEvent& e)
 {
-    if (currentFile.existsAsFile())
-    {
-        auto* inputSource = new juce::FileInputSource(currentFile);
-        thumbnail.setSource(inputSource);
-        
-        // The thumbnail will update automatically via the change listener
-    }
-    else
+    if (!e.mods.isPopupMenu())
+        return;
+    
+    juce::PopupMenu menu;
+    
+    for (int order = SpectrogramTiles::minFftOrder; order <= SpectrogramTiles::maxFftOrder; ++order)
+        menu.addItem(order, "FFT Size " + juce::String(1 << order), true, order == fftOrder);
+    
+    menu.addSeparator();
+    menu.addItem(100, "Cache Tiles on Disk", true, tiles.isDiskCacheEnabled());
+    
+    menu.showMenuAsync(juce::PopupMenu::Options{}, [this](int result)
     {
-        thumbnail.clear();
-    }
-    repaint();
+        if (result == 100)
+        {
+            tiles.setDiskCacheEnabled(!tiles.isDiskCacheEnabled());
+        }
+        else if (result >= SpectrogramTiles::minFftOrder && result <= SpectrogramTiles::maxFftOrder)
+        {
+            fftOrder = result;
+            repaint();
+        }
+    });
 }
 
 //==============================================================================
@@ -464,11 +1344,19 @@ MainComponent::MainComponent()
     
     // Initialize core components
     libraryManager = std::make_unique<LibraryManager>();
+    blockCache = std::make_unique<DecodedBlockCache>();
     audioRecorder = std::make_unique<AudioRecorder>();
+    importPipeline = std::make_unique<ImportPipeline>(*libraryManager);
+    manifestImporter = std::make_unique<ManifestImporter>(*libraryManager);
+    watchedFolders = std::make_unique<WatchedFolders>(*libraryManager);
+    playbackEngine = std::make_unique<PlaybackEngine>(*blockCache);
     
     // Initialize UI components
-    libraryComponent = std::make_unique<LibraryComponent>(*libraryManager);
-    waveformComponent = std::make_unique<WaveformComponent>();
+    sparklineStore = std::make_unique<SparklineStore>();
+    libraryComponent = std::make_unique<LibraryComponent>(*libraryManager, *sparklineStore);
+    peakStore = std::make_unique<PeakStore>(*blockCache);
+    waveformComponent = std::make_unique<WaveformComponent>(*peakStore, *blockCache);
+    spectrogramComponent = std::make_unique<SpectrogramComponent>(*blockCache);
     
     setupUI();
     
@@ -494,19 +1382,55 @@ MainComponent::MainComponent()
         });
     };
     
-    libraryComponent->onSelectionChanged = [this](int index)
+    libraryManager->onSaveFailed = [this](const juce::String& error)
+    {
+        statusLabel.setText("Error: the library couldn't be saved", juce::dontSendNotification);
+        juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon, "Library Not Saved", error);
+    };
+    
+    libraryComponent->onSelectionChanged = [this](RecordingHandle handle)
+    {
+        onLibrarySelectionChanged(handle);
+    };
+    
+    libraryComponent->onRecordingRemove = [this](RecordingHandle handle)
+    {
+        onRecordingRemove(handle);
+    };
+    
+    libraryComponent->onRecordingEdit = [this](RecordingHandle handle)
+    {
+        showMetadataEditor(handle);
+    };
+    
+    libraryComponent->onRecordingPlay = [this](RecordingHandle handle)
+    {
+        playRecording(handle);
+    };
+    
+    waveformComponent->onViewChanged = [this](double viewStart, double samplesPerPixel)
     {
-        onLibrarySelectionChanged(index);
+        const auto& peaks = waveformComponent->getPeaks();
+        
+        if (peaks != nullptr)
+            spectrogramComponent->setAudioFile(waveformComponent->getAudioFile(), peaks->getNumSamples(), peaks->getSampleRate());
+        else
+            spectrogramComponent->setAudioFile({}, 0, 0.0);
+        
+        spectrogramComponent->setView(viewStart, samplesPerPixel);
     };
     
-    libraryComponent->onRecordingRemove = [this](int index)
+    playbackEngine->onLoadFailed = [this](const juce::File& file)
     {
-        onRecordingRemove(index);
+        statusLabel.setText("Couldn't open " + file.getFileName() + " for playback", juce::dontSendNotification);
     };
     
-    libraryComponent->onRecordingEdit = [this](const Recording& recording)
+    waveformComponent->onSeek = [this](const juce::File& file, juce::int64 sample)
     {
-        showMetadataEditor(recording);
+        if (playbackEngine->getCurrentFile() != file)
+            playbackEngine->load(file);
+        
+        playbackEngine->seek(sample);
     };
     
     libraryComponent->onRecordingExport = [this](const Recording& recording)
@@ -514,17 +1438,75 @@ MainComponent::MainComponent()
         onRecordingExport(recording);
     };
     
-    libraryManager->addChangeListener(this);
+    importPipeline->onProgress = [this](const ImportProgress& progress)
+    {
+        statusLabel.setText(progress.describe(), juce::dontSendNotification);
+    };
+    
+    manifestImporter->onProgress = [this](const ManifestImportResult& result)
+    {
+        statusLabel.setText("Importing manifest... " + result.describe(), juce::dontSendNotification);
+    };
+    
+    manifestImporter->onFinished = [this](const ManifestImportResult& result)
+    {
+        statusLabel.setText(result.describe(), juce::dontSendNotification);
+        
+        if (result.errors.isEmpty())
+            return;
+        
+        // The first few are enough to see what's wrong with the file
+        constexpr int maxShown = 10;
+        auto shown = result.errors;
+        shown.removeRange(maxShown, shown.size());
+        
+        auto message = result.describe() + "\n\n" + shown.joinIntoString("\n");
+        if (result.errors.size() > maxShown)
+            message << "\n...and " << (result.errors.size() - maxShown) << " more";
+        
+        juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon, "Manifest Import", message);
+    };
+    
+    importPipeline->onFinished = [this](const ImportProgress& progress)
+    {
+        auto text = progress.describe();
+        const auto& errors = importPipeline->getErrors();
+        
+        for (const auto& error : errors)
+            juce::Logger::writeToLog("Import failed: " + error.file.getFullPathName() + " - " + error.message);
+        
+        if (!errors.empty())
+            text << " (e.g. " << errors.front().file.getFileName() << ": " << errors.front().message << ")";
+        
+        statusLabel.setText(text, juce::dontSendNotification);
+        updateImportButtons();
+    };
+    
+    watchedFolders->onChangesApplied = [this](const juce::String& summary)
+    {
+        if (!importPipeline->isImporting())
+            statusLabel.setText(summary, juce::dontSendNotification);
+    };
     
     setSize(1200, 800);
     setAudioChannels(0, 2);
+    startTimerHz(30);
 }
 
 MainComponent::~MainComponent()
 {
-    libraryManager->removeChangeListener(this);
+    stopTimer();
+    importPipeline = nullptr;
+    manifestImporter = nullptr;
+    watchedFolders = nullptr;
     audioRecorder->stopRecording();
     shutdownAudio();
+    
+    // The views are declared before the services they listen to, so they have to go first
+    spectrogramComponent = nullptr;
+    waveformComponent = nullptr;
+    libraryComponent = nullptr;
+    
     setLookAndFeel(nullptr);
 }
 
@@ -532,11 +1514,17 @@ void MainComponent::setupUI()
 {
     addAndMakeVisible(titleLabel);
     addAndMakeVisible(recordButton);
+    addAndMakeVisible(playButton);
     addAndMakeVisible(importFilesButton);
     addAndMakeVisible(importFolderButton);
+    addAndMakeVisible(watchedFoldersButton);
+    addAndMakeVisible(manifestButton);
+    addAndMakeVisible(spectrogramButton);
+    addChildComponent(cancelImportButton);
     addAndMakeVisible(statusLabel);
     addAndMakeVisible(*libraryComponent);
     addAndMakeVisible(*waveformComponent);
+    addChildComponent(*spectrogramComponent);
     
     titleLabel.setText("CapSure - Internal Audio Recorder", juce::dontSendNotification);
     titleLabel.setFont(juce::FontOptions(24.0f, juce::Font::bold));
@@ -549,6 +1537,7 @@ void MainComponent::setupUI()
         if (audioRecorder->isRecording())
         {
             audioRecorder->stopRecording();
+            waveformComponent->setLivePeaks(nullptr);
             recordButton.setButtonText("Record Internal Audio");
             recordButton.setColour(juce::TextButton::buttonColourId, juce::Colour(0xff1db954));
         }
@@ -556,12 +1545,18 @@ void MainComponent::setupUI()
         {
             if (audioRecorder->startLoopbackRecording())
             {
+                waveformComponent->setLivePeaks(&audioRecorder->getLivePeaks());
                 recordButton.setButtonText("Stop Recording");
                 recordButton.setColour(juce::TextButton::buttonColourId, juce::Colour(0xffe53e3e));
             }
         }
     };
     
+    playButton.setButtonText("Play");
+    playButton.setColour(juce::TextButton::buttonColourId, juce::Colour(0xff1db954));
+    playButton.setTooltip("Play the selected recording; selecting another while playing queues it next");
+    playButton.onClick = [this]() { togglePlayback(); };
+    
     importFilesButton.setButtonText("Import Audio Files");
     importFilesButton.setColour(juce::TextButton::buttonColourId, juce::Colour(0xff0ea5e9));
     importFilesButton.onClick = [this]() { importAudioFiles(); };
@@ -570,22 +1565,47 @@ void MainComponent::setupUI()
     importFolderButton.setColour(juce::TextButton::buttonColourId, juce::Colour(0xff8b5cf6));
     importFolderButton.onClick = [this]() { importAudioFolder(); };
     
+    watchedFoldersButton.setButtonText("Watched Folders");
+    watchedFoldersButton.setColour(juce::TextButton::buttonColourId, juce::Colour(0xff8b5cf6));
+    watchedFoldersButton.onClick = [this]() { showWatchedFoldersMenu(); };
+    
+    manifestButton.setButtonText("Manifest");
+    manifestButton.setColour(juce::TextButton::buttonColourId, juce::Colour(0xff0ea5e9));
+    manifestButton.setTooltip("Export the current view as JSON Lines or CSV, or merge a manifest back in");
+    manifestButton.onClick = [this]() { showManifestMenu(); };
+    
+    spectrogramButton.setButtonText("Spectrogram");
+    spectrogramButton.setColour(juce::TextButton::buttonColourId, juce::Colour(0xff0ea5e9));
+    spectrogramButton.setColour(juce::TextButton::buttonOnColourId, juce::Colour(0xff1db954));
+    spectrogramButton.setClickingTogglesState(true);
+    spectrogramButton.setTooltip("Show the spectrogram under the waveform; right-click it for FFT size and disk caching");
+    spectrogramButton.onClick = [this]()
+    {
+        spectrogramComponent->setVisible(spectrogramButton.getToggleState());
+        resized();
+    };
+    
+    cancelImportButton.setButtonText("Cancel Import");
+    cancelImportButton.setColour(juce::TextButton::buttonColourId, juce::Colour(0xffe53e3e));
+    cancelImportButton.onClick = [this]() { importPipeline->cancel(); };
+    
     statusLabel.setText("Ready to record internal audio or import existing files", juce::dontSendNotification);
     statusLabel.setJustificationType(juce::Justification::centred);
 }
 
 void MainComponent::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
 {
-    juce::ignoreUnused(samplesPerBlockExpected, sampleRate);
+    playbackEngine->prepareToPlay(samplesPerBlockExpected, sampleRate);
 }
 
 void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
 {
-    bufferToFill.clearActiveBufferRegion();
+    playbackEngine->getNextAudioBlock(bufferToFill);
 }
 
 void MainComponent::releaseResources()
 {
+    playbackEngine->releaseResources();
 }
 
 void MainComponent::paint(juce::Graphics& g)
@@ -608,9 +1628,19 @@ void MainComponent::resized()
     auto buttonRow = controlsArea.removeFromTop(40);
     recordButton.setBounds(buttonRow.removeFromLeft(200));
     buttonRow.removeFromLeft(10);
+    playButton.setBounds(buttonRow.removeFromLeft(80));
+    buttonRow.removeFromLeft(10);
     importFilesButton.setBounds(buttonRow.removeFromLeft(150));
     buttonRow.removeFromLeft(10);
     importFolderButton.setBounds(buttonRow.removeFromLeft(130));
+    buttonRow.removeFromLeft(10);
+    watchedFoldersButton.setBounds(buttonRow.removeFromLeft(140));
+    buttonRow.removeFromLeft(10);
+    manifestButton.setBounds(buttonRow.removeFromLeft(100));
+    buttonRow.removeFromLeft(10);
+    spectrogramButton.setBounds(buttonRow.removeFromLeft(110));
+    buttonRow.removeFromLeft(10);
+    cancelImportButton.setBounds(buttonRow.removeFromLeft(120));
     
     controlsArea.removeFromTop(10);
     statusLabel.setBounds(controlsArea.removeFromTop(30));
@@ -622,14 +1652,13 @@ void MainComponent::resized()
     area.removeFromLeft(10); // spacing
     
     libraryComponent->setBounds(libraryArea);
+    
+    if (spectrogramComponent->isVisible())
+        spectrogramComponent->setBounds(area.removeFromBottom(area.getHeight() / 2));
+    
     waveformComponent->setBounds(area);
 }
 
-void MainComponent::changeListenerCallback(juce::ChangeBroadcaster*)
-{
-    // Library updated, refresh display
-}
-
 void MainComponent::updateRecordingStatus()
 {
     if (audioRecorder->isRecording())
@@ -647,6 +1676,14 @@ void MainComponent::onRecordingComplete(const Recording& recording)
     juce::MessageManager::callAsync([this, recording]()
     {
         libraryManager->addRecording(recording);
+        peakStore->prepare(recording.file);
+        
+        if (!audioRecorder->isRecording())
+        {
+            waveformComponent->setLivePeaks(nullptr);
+            waveformComponent->setAudioFile(recording.file);
+        }
+        
         statusLabel.setText("Recording saved: " + recording.name, juce::dontSendNotification);
         
         // Reset button
@@ -655,28 +1692,34 @@ void MainComponent::onRecordingComplete(const Recording& recording)
     });
 }
 
-void MainComponent::onLibrarySelectionChanged(int selectedIndex)
+void MainComponent::onLibrarySelectionChanged(RecordingHandle handle)
 {
-    selectedRecordingIndex = selectedIndex;
+    selectedRecording = handle;
     
-    if (selectedIndex >= 0)
+    if (auto* recording = libraryManager->getRecording(handle))
     {
-        auto recordings = libraryManager->getFilteredRecordings(libraryComponent->searchBox.getText());
-        if (juce::isPositiveAndBelow(selectedIndex, recordings.size()))
+        // Ensure the file exists before attempting to load
+        if (recording->file.existsAsFile())
         {
-            const auto& recording = recordings.getReference(selectedIndex);
-            // Ensure the file exists before attempting to load
-            if (recording.file.existsAsFile())
+            waveformComponent->setAudioFile(recording->file);
+            
+            // Opened and buffered now, so pressing play starts at once
+            if (playbackEngine->isPlaying())
             {
-                waveformComponent->setAudioFile(recording.file);
-                statusLabel.setText("Loaded: " + recording.name, juce::dontSendNotification);
+                playbackEngine->queueNext(recording->file);
+                statusLabel.setText("Up next: " + recording->name, juce::dontSendNotification);
             }
             else
             {
-                waveformComponent->setAudioFile(juce::File());
-                statusLabel.setText("File not found: " + recording.file.getFullPathName(), juce::dontSendNotification);
+                playbackEngine->load(recording->file);
+                statusLabel.setText("Loaded: " + recording->name, juce::dontSendNotification);
             }
         }
+        else
+        {
+            waveformComponent->setAudioFile(juce::File());
+            statusLabel.setText("File not found: " + recording->file.getFullPathName(), juce::dontSendNotification);
+        }
     }
     else
     {
@@ -685,43 +1728,76 @@ void MainComponent::onLibrarySelectionChanged(int selectedIndex)
     }
 }
 
+void MainComponent::playRecording(RecordingHandle handle)
+{
+    if (auto* recording = libraryManager->getRecording(handle))
+    {
+        // A paused file starts over; seeking keeps the source it already has open
+        if (playbackEngine->getCurrentFile() != recording->file)
+            playbackEngine->load(recording->file);
+        else if (!playbackEngine->isPlaying())
+            playbackEngine->seek(0);
+        
+        playbackEngine->play();
+        statusLabel.setText("Playing: " + recording->name, juce::dontSendNotification);
+    }
+}
+
+void MainComponent::togglePlayback()
+{
+    if (playbackEngine->isPlaying())
+    {
+        playbackEngine->pause();
+    }
+    else if (auto* recording = libraryManager->getRecording(selectedRecording))
+    {
+        // Resume where it was paused if the selection hasn't moved on
+        if (playbackEngine->getCurrentFile() != recording->file)
+            playbackEngine->load(recording->file);
+        
+        playbackEngine->play();
+    }
+}
+
+void MainComponent::timerCallback()
+{
+    auto playing = playbackEngine->isPlaying();
+    auto file = playbackEngine->getCurrentFile();
+    
+    playButton.setButtonText(playing ? "Pause" : "Play");
+    
+    // A queued file has started without a gap
+    if (playing && file != playingFile && playingFile != juce::File())
+    {
+        waveformComponent->setAudioFile(file);
+        
+        auto handle = libraryManager->findRecordingByFile(file);
+        if (auto* recording = libraryManager->getRecording(handle))
+            statusLabel.setText("Playing: " + recording->name, juce::dontSendNotification);
+    }
+    
+    if (playing)
+        playingFile = file;
+    
+    auto showingPlayingFile = file != juce::File() && waveformComponent->getAudioFile() == file;
+    waveformComponent->setPlayhead(showingPlayingFile ? playbackEngine->getPosition() : -1);
+}
+
 void MainComponent::importAudioFiles()
 {
     auto chooserFlags = juce::FileBrowserComponent::openMode
                       | juce::FileBrowserComponent::canSelectFiles
                       | juce::FileBrowserComponent::canSelectMultipleItems;
                       
-    juce::FileChooser chooser("Select audio files to import",
-                             juce::File(),
-                             "*.wav;*.mp3;*.flac;*.aiff;*.m4a;*.ogg");
+    fileChooser = std::make_unique<juce::FileChooser>("Select audio files to import",
+                                                      juce::File(),
+                                                      "*.wav;*.mp3;*.flac;*.aiff;*.m4a;*.ogg");
     
-    chooser.launchAsync(chooserFlags, [this](const juce::FileChooser& fc)
+    fileChooser->launchAsync(chooserFlags, [this](const juce::FileChooser& fc)
     {
         auto files = fc.getResults();
         if (!files.isEmpty())
-        {
-            juce::MessageManager::callAsync([this, files]()
-            {
-                statusLabel.setText("Importing " + juce::String(files.size()) + " files...", 
-                                   juce::dontSendNotification);
-                
-                int beforeCount = libraryManager->getNumRecordings();
-                libraryManager->importAudioFiles(files, false); // Don't copy to library by default
-                int afterCount = libraryManager->getNumRecordings();
-                int imported = afterCount - beforeCount;
-                
-                if (imported > 0)
-                {
-                    statusLabel.setText("Successfully imported " + juce::String(imported) + " audio files", 
-                                       juce::dontSendNotification);
-                }
-                else
-                {
-                    statusLabel.setText("No new audio files imported (files may already exist or be invalid)", 
-                                       juce::dontSendNotification);
-                }
-            });
-        }
+            startImport(files, false);
     });
 }
 
@@ -730,49 +1806,167 @@ void MainComponent::importAudioFolder()
     auto chooserFlags = juce::FileBrowserComponent::openMode
                       | juce::FileBrowserComponent::canSelectDirectories;
                       
-    juce::FileChooser chooser("Select folder containing audio files",
-                             juce::File());
+    fileChooser = std::make_unique<juce::FileChooser>("Select folder containing audio files",
+                                                      juce::File());
     
-    chooser.launchAsync(chooserFlags, [this](const juce::FileChooser& fc)
+    fileChooser->launchAsync(chooserFlags, [this](const juce::FileChooser& fc)
     {
         auto folder = fc.getResult();
         if (folder.exists())
+            startImport({ folder }, true); // Recursive
+    });
+}
+
+void MainComponent::startImport(const juce::Array<juce::File>& filesOrFolders, bool recursive)
+{
+    // Don't copy to library by default
+    if (importPipeline->start(filesOrFolders, recursive, false))
+    {
+        statusLabel.setText("Scanning for audio files...", juce::dontSendNotification);
+        updateImportButtons();
+    }
+}
+
+void MainComponent::updateImportButtons()
+{
+    auto importing = importPipeline->isImporting();
+    importFilesButton.setEnabled(!importing);
+    importFolderButton.setEnabled(!importing);
+    cancelImportButton.setVisible(importing);
+}
+
+void MainComponent::showWatchedFoldersMenu()
+{
+    auto folders = watchedFolders->getFolders();
+    
+    juce::PopupMenu menu;
+    menu.addItem(1, "Watch Folder...");
+    menu.addItem(2, "Rescan Now", !folders.isEmpty());
+    
+    if (!folders.isEmpty())
+    {
+        menu.addSeparator();
+        menu.addSectionHeader("Stop watching");
+        
+        for (int i = 0; i < folders.size(); ++i)
+            menu.addItem(100 + i, folders[i].getFullPathName());
+    }
+    
+    menu.showMenuAsync(juce::PopupMenu::Options{}.withTargetComponent(&watchedFoldersButton),
+                       [this, folders](int result)
+    {
+        if (result == 1)
         {
-            juce::MessageManager::callAsync([this, folder]()
+            fileChooser = std::make_unique<juce::FileChooser>("Select a folder to keep in sync with the library",
+                                                              juce::File());
+            
+            fileChooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectDirectories,
+                                     [this](const juce::FileChooser& fc)
             {
-                statusLabel.setText("Scanning folder for audio files...", juce::dontSendNotification);
-                
-                int beforeCount = libraryManager->getNumRecordings();
-                bool foundFiles = libraryManager->importFolder(folder, true, false); // Recursive, don't copy
-                int afterCount = libraryManager->getNumRecordings();
-                int imported = afterCount - beforeCount;
-                
-                if (imported > 0)
-                {
-                    statusLabel.setText("Successfully imported " + juce::String(imported) + " audio files from folder", 
-                                       juce::dontSendNotification);
-                }
-                else if (foundFiles)
-                {
-                    statusLabel.setText("Found audio files but none were new (may already exist in library)", 
-                                       juce::dontSendNotification);
-                }
-                else
+                auto folder = fc.getResult();
+                if (folder.isDirectory())
                 {
-                    statusLabel.setText("No audio files found in selected folder", 
-                                       juce::dontSendNotification);
+                    watchedFolders->addFolder(folder);
+                    statusLabel.setText("Watching " + folder.getFullPathName(), juce::dontSendNotification);
                 }
             });
         }
+        else if (result == 2)
+        {
+            watchedFolders->rescanAll();
+        }
+        else if (juce::isPositiveAndBelow(result - 100, folders.size()))
+        {
+            watchedFolders->removeFolder(folders[result - 100]);
+            statusLabel.setText("Stopped watching " + folders[result - 100].getFullPathName(), juce::dontSendNotification);
+        }
+    });
+}
+
+void MainComponent::showManifestMenu()
+{
+    juce::PopupMenu menu;
+    menu.addItem(1, "Export View as JSON Lines...", !libraryComponent->getVisibleHandles().isEmpty());
+    menu.addItem(2, "Export View as CSV...", !libraryComponent->getVisibleHandles().isEmpty());
+    menu.addSeparator();
+    menu.addItem(3, "Import Manifest...");
+    
+    menu.showMenuAsync(juce::PopupMenu::Options{}.withTargetComponent(&manifestButton), [this](int result)
+    {
+        if (result == 1)
+            exportManifest(LibraryManifest::Format::jsonLines);
+        else if (result == 2)
+            exportManifest(LibraryManifest::Format::csv);
+        else if (result == 3)
+            importManifest();
+    });
+}
+
+void MainComponent::exportManifest(LibraryManifest::Format format)
+{
+    auto extension = format == LibraryManifest::Format::csv ? ".csv" : ".jsonl";
+    
+    fileChooser = std::make_unique<juce::FileChooser>("Export manifest",
+                                                      juce::File::getSpecialLocation(juce::File::userDesktopDirectory)
+                                                          .getChildFile(juce::String("manifest") + extension),
+                                                      juce::String("*") + extension);
+    
+    fileChooser->launchAsync(juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting,
+                             [this, extension](const juce::FileChooser& fc)
+    {
+        auto targetFile = fc.getResult();
+        if (targetFile == juce::File{})
+            return;
+        
+        targetFile = targetFile.withFileExtension(extension);
+        
+        // The snapshot stays valid while the library moves on, so the rows can be written off the message thread
+        auto snapshot = libraryManager->getSnapshot();
+        auto handles = libraryComponent->getVisibleHandles();
+        juce::Component::SafePointer<MainComponent> safeThis(this);
+        
+        statusLabel.setText("Exporting " + juce::String(handles.size()) + " recordings...", juce::dontSendNotification);
+        
+        juce::Thread::launch([safeThis, snapshot, handles, targetFile]()
+        {
+            juce::String error;
+            auto ok = LibraryManifest::write(*snapshot, handles, targetFile, error);
+            
+            juce::MessageManager::callAsync([safeThis, ok, error, targetFile, numRows = handles.size()]()
+            {
+                if (safeThis != nullptr)
+                    safeThis->statusLabel.setText(ok ? "Exported " + juce::String(numRows) + " recordings to " + targetFile.getFullPathName()
+                                                     : "Manifest export failed: " + error,
+                                                  juce::dontSendNotification);
+            });
+        });
+    });
+}
+
+void MainComponent::importManifest()
+{
+    fileChooser = std::make_unique<juce::FileChooser>("Import manifest",
+                                                      juce::File::getSpecialLocation(juce::File::userDesktopDirectory),
+                                                      "*.jsonl;*.json;*.csv");
+    
+    fileChooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                             [this](const juce::FileChooser& fc)
+    {
+        auto file = fc.getResult();
+        if (!file.existsAsFile())
+            return;
+        
+        // Read in the background and merged in batches as it arrives
+        if (!manifestImporter->start(file))
+            statusLabel.setText("A manifest is already being imported", juce::dontSendNotification);
     });
 }
 
-void MainComponent::onRecordingRemove(int index)
+void MainComponent::onRecordingRemove(RecordingHandle handle)
 {
-    auto recordings = libraryManager->getFilteredRecordings(libraryComponent->searchBox.getText());
-    if (juce::isPositiveAndBelow(index, recordings.size()))
+    if (auto* found = libraryManager->getRecording(handle))
     {
-        const auto& recording = recordings.getReference(index);
+        auto recording = *found;
         
         // Show confirmation dialog
         juce::AlertWindow::showYesNoCancelBox(juce::AlertWindow::QuestionIcon,
@@ -781,57 +1975,42 @@ void MainComponent::onRecordingRemove(int index)
                                              "The audio file will remain on disk.",
                                              "Delete", "Cancel", {},
                                              this,
-                                             juce::ModalCallbackFunction::create([this, recording](int result)
+                                             juce::ModalCallbackFunction::create([this, handle, recording](int result)
                                              {
-                                                 if (result == 1) // Yes
+                                                 if (result == 1 && libraryManager->removeRecording(handle)) // Yes
                                                  {
-                                                     // Find the actual index in the main recordings array and remove
-                                                     auto allRecordings = libraryManager->getAllRecordings();
-                                                     for (int i = 0; i < allRecordings.size(); ++i)
+                                                     statusLabel.setText("Removed \\\"" + recording.name + "\\\" from library", juce::dontSendNotification);
+                                                     
+                                                     // Clear waveform if this was the selected recording
+                                                     if (selectedRecording == handle)
                                                      {
-                                                         if (allRecordings[i].uid == recording.uid)
-                                                         {
-                                                             libraryManager->removeRecording(i);
-                                                             statusLabel.setText("Removed \\\"" + recording.name + "\\\" from library", juce::dontSendNotification);
-                                                             
-                                                             // Clear waveform if this was the selected recording
-                                                             if (selectedRecordingIndex == i)
-                                                             {
-                                                                 waveformComponent->setAudioFile(juce::File());
-                                                                 selectedRecordingIndex = -1;
-                                                             }
-                                                             break;
-                                                         }
+                                                         waveformComponent->setAudioFile(juce::File());
+                                                         selectedRecording = {};
                                                      }
                                                  }
                                              }));
     }
 }
 
-void MainComponent::showMetadataEditor(const Recording& recording)
+void MainComponent::showMetadataEditor(RecordingHandle handle)
 {
+    auto* recording = libraryManager->getRecording(handle);
+    if (recording == nullptr)
+        return;
+    
     auto editorWindow = std::make_unique<juce::DocumentWindow>("Edit Recording Info", 
                                                               juce::Colour(0xff1e1e1e), 
                                                               juce::DocumentWindow::closeButton);
     
-    auto editor = std::make_unique<MetadataEditorComponent>(recording);
+    auto editor = std::make_unique<MetadataEditorComponent>(*recording);
     auto* editorPtr = editor.get();
     
-    editor->onSave = [this, editorPtr, recording]() 
+    editor->onSave = [this, editorPtr, handle]() 
     {
         auto editedRecording = editorPtr->getEditedRecording();
         
-        // Find and update the recording in the library
-        auto allRecordings = libraryManager->getAllRecordings();
-        for (int i = 0; i < allRecordings.size(); ++i)
-        {
-            if (allRecordings[i].uid == recording.uid)
-            {
-                libraryManager->updateRecording(i, editedRecording);
-                statusLabel.setText("Updated info for \"" + editedRecording.name + "\"", juce::dontSendNotification);
-                break;
-            }
-        }
+        if (libraryManager->updateRecording(handle, editedRecording))
+            statusLabel.setText("Updated info for \"" + editedRecording.name + "\"", juce::dontSendNotification);
         
         if (auto* window = editorPtr->findParentComponentOfClass<juce::DocumentWindow>())
             window->closeButtonPressed();
@@ -856,11 +2035,11 @@ void MainComponent::onRecordingExport(const Recording& recording)
 {
     auto chooserFlags = juce::FileBrowserComponent::saveMode;
     
-    juce::FileChooser chooser("Export audio file",
-                             juce::File::getSpecialLocation(juce::File::userDesktopDirectory),
-                             "*" + recording.file.getFileExtension());
+    fileChooser = std::make_unique<juce::FileChooser>("Export audio file",
+                                                      juce::File::getSpecialLocation(juce::File::userDesktopDirectory),
+                                                      "*" + recording.file.getFileExtension());
     
-    chooser.launchAsync(chooserFlags, [this, recording](const juce::FileChooser& fc)
+    fileChooser->launchAsync(chooserFlags, [this, recording](const juce::FileChooser& fc)
     {
         auto targetFile = fc.getResult();
         if (targetFile != juce::File{})
@@ -3,6 +3,16 @@
 #include <JuceHeader.h>
 #include "AudioRecorder.h"
 #include "LibraryManager.h"
+#include "ImportPipeline.h"
+#include "ManifestImporter.h"
+#include "WatchedFolders.h"
+#include "PeakStore.h"
+#include "CellTextCache.h"
+#include "LibrarySearch.h"
+#include "PlaybackEngine.h"
+#include "WaveformTiles.h"
+#include "SpectrogramTiles.h"
+#include "SparklineStore.h"
 
 //==============================================================================
 class DarkLookAndFeel : public juce::LookAndFeel_V4
@@ -19,10 +29,10 @@ public:
 //==============================================================================
 class LibraryComponent : public juce::Component, 
                         public juce::TableListBoxModel,
-                        private juce::ChangeListener
+                        private LibraryManager::Listener
 {
 public:
-    LibraryComponent(LibraryManager& library);
+    LibraryComponent(LibraryManager& library, SparklineStore& sparklineStore);
     ~LibraryComponent() override;
 
     // TableListBoxModel
@@ -30,55 +40,161 @@ public:
     void paintRowBackground(juce::Graphics& g, int rowNumber, int width, int height, bool rowIsSelected) override;
     void paintCell(juce::Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected) override;
     void selectedRowsChanged(int lastRowSelected) override;
+    void sortOrderChanged(int newSortColumnId, bool isForwards) override;
+    void cellDoubleClicked(int rowNumber, int columnId, const juce::MouseEvent& e) override;
 
     void resized() override;
     void mouseDown(const juce::MouseEvent& e) override;
     
-    std::function<void(int)> onSelectionChanged;
-    std::function<void(int)> onRecordingRemove;
-    std::function<void(const Recording&)> onRecordingEdit;
+    RecordingHandle getHandleForRow(int rowNumber) const { return currentHandles[rowNumber]; }
+    const juce::Array<RecordingHandle>& getVisibleHandles() const { return currentHandles; }
+    
+    std::function<void(RecordingHandle)> onSelectionChanged;
+    std::function<void(RecordingHandle)> onRecordingRemove;
+    std::function<void(RecordingHandle)> onRecordingEdit;
     std::function<void(const Recording&)> onRecordingExport;
+    std::function<void(RecordingHandle)> onRecordingPlay;
     
     juce::TextEditor searchBox;
 
 private:
-    void changeListenerCallback(juce::ChangeBroadcaster* source) override;
-    void updateContent();
+    void libraryUpdated(const LibraryDelta& delta) override;
+    void updateContent(int searchDelayMs = 0);
+    void showHandles(juce::Array<RecordingHandle> handles);
+    void showSearchResult(LibrarySearch::Result& result);
     void showContextMenu(int rowNumber, const juce::MouseEvent& e);
+    
+    bool isFuzzySearch() const;
+    bool isInView(RecordingHandle handle, const Recording& recording) const;
+    const SmartPlaylist* getActivePlaylist() const;
+    void refreshPlaylistSelector();
+    void showPlaylistMenu();
+    void saveSearchAsPlaylist();
+    void showFacetsMenu();
+    void updateTotals();
+    int findRowForHandle(RecordingHandle handle) const;
+    bool isBeforeInView(RecordingHandle a, RecordingHandle b) const;
+    RecordingHandle getSelectedHandle() const;
+    void restoreSelection(RecordingHandle handle);
+    void invalidateSparklines(const LibraryDelta& delta);
 
     LibraryManager& libraryManager;
+    SparklineStore& sparklines;
     juce::TableListBox table;
     juce::Label searchLabel;
-    juce::Array<Recording> currentRecordings;
+    juce::ToggleButton fuzzyToggle { "Fuzzy" };
+    juce::TextButton facetsButton { "Facets" };
+    juce::Label totalsLabel;
+    juce::ComboBox playlistSelector;
+    juce::TextButton playlistButton { "..." };
+    int activePlaylist = -1;                        // index into the library's smart playlists
+    juce::Array<RecordingHandle> currentHandles;    // in activeQuery's order
+    LibraryQuery activeQuery;
+    std::vector<LibraryQuery::SortKey> columnSortKeys;   // most recently clicked column first
+    CellTextCache cellCache;                        // only the rows that have been painted
+    LibrarySearch search;
+    
+    static constexpr int searchDebounceMs = 150;
+    static constexpr int sparklineColumn = 5;
+    static constexpr size_t maxViewSearches = 8;     // per delta, before a sorted view is indexed instead
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryComponent)
 };
 
 //==============================================================================
-class WaveformComponent : public juce::Component, private juce::Timer, private juce::ChangeListener
+class WaveformComponent : public juce::Component, private PeakStore::Listener, private juce::Timer
 {
 public:
-    WaveformComponent();
+    WaveformComponent(PeakStore& store, DecodedBlockCache& cache);
     ~WaveformComponent() override;
     
     void setAudioFile(const juce::File& file);
+    const juce::File& getAudioFile() const noexcept     { return currentFile; }
+    const std::shared_ptr<const PeakPyramid>& getPeaks() const noexcept   { return peaks; }
     void paint(juce::Graphics& g) override;
     void resized() override;
+    
+    // While set, shows the recording in progress instead of the file
+    void setLivePeaks(LivePeaks* peaksBeingRecorded);
+    
+    // Sample position in the current file to mark, or -1 for none
+    void setPlayhead(juce::int64 sample);
+    
+    // Clicking or dragging seeks, shift-dragging or scrolling sideways pans,
+    // the wheel and pinch zoom, and a double-click fits the whole file again
+    void mouseDown(const juce::MouseEvent& e) override;
+    void mouseDrag(const juce::MouseEvent& e) override;
+    void mouseDoubleClick(const juce::MouseEvent& e) override;
+    void mouseWheelMove(const juce::MouseEvent& e, const juce::MouseWheelDetails& wheel) override;
+    void mouseMagnify(const juce::MouseEvent& e, float scaleFactor) override;
+    
+    // Called with the sample clicked on in the current file
+    std::function<void(const juce::File&, juce::int64)> onSeek;
+    
+    // Called with the sample at the left edge and the samples per pixel whenever they change
+    std::function<void(double, double)> onViewChanged;
 
 private:
+    void peaksReady(const juce::File& audioFile) override;
     void timerCallback() override;
-    void changeListenerCallback(juce::ChangeBroadcaster* source) override;
-    void loadAudioFile();
+    void drawTiles(juce::Graphics& g, juce::Rectangle<int> area);
+    void drawStandIn(juce::Graphics& g, WaveformTiles::TileKey key, juce::Rectangle<int> dest);
+    void drawLivePeaks(juce::Graphics& g, juce::Rectangle<int> area) const;
+    juce::Rectangle<int> getWaveformArea() const     { return getLocalBounds().reduced(10); }
+    int getPlayheadX() const;
+    
+    double getSamplesPerPixel() const;
+    void setView(double newSamplesPerPixel, double newViewStart);
+    void zoomAround(int x, double newSamplesPerPixel);
+    void seekToX(int x);
+    void viewChanged();
 
-    juce::AudioFormatManager formatManager;
-    juce::AudioThumbnailCache cache;
-    juce::AudioThumbnail thumbnail;
+    PeakStore& peakStore;
+    std::shared_ptr<const PeakPyramid> peaks;
     juce::File currentFile;
-    bool needsToLoadFile = false;
+    LivePeaks* livePeaks = nullptr;
+    juce::int64 playhead = -1;
+    
+    WaveformTiles tiles;
+    double samplesPerPixel = 0.0;   // 0 while the whole file is fitted to the width
+    double viewStart = 0.0;         // sample at the left edge
+    double dragStartViewStart = 0.0;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformComponent)
 };
 
+//==============================================================================
+/**
+    The current file's spectrogram, scrolled and zoomed along with the
+    waveform above it. Right-click to change the FFT size or cache tiles on
+    disk.
+*/
+class SpectrogramComponent : public juce::Component
+{
+public:
+    explicit SpectrogramComponent(DecodedBlockCache& cache);
+    
+    void setAudioFile(const juce::File& file, juce::int64 lengthInSamples, double fileSampleRate);
+    void setView(double newViewStart, double newSamplesPerPixel);
+    
+    void paint(juce::Graphics& g) override;
+    void mouseDown(const juce::MouseEvent& e) override;
+
+private:
+    void drawStandIn(juce::Graphics& g, SpectrogramTiles::TileKey key, juce::Rectangle<int> dest);
+    juce::Rectangle<int> getSpectrogramArea() const     { return getLocalBounds().reduced(10); }
+    
+    SpectrogramTiles tiles;
+    juce::File currentFile;
+    juce::int64 numSamples = 0;
+    double sampleRate = 0.0;
+    double viewStart = 0.0;
+    double samplesPerPixel = 0.0;
+    int fftOrder = 11;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectrogramComponent)
+};
+
 //==============================================================================
 class MetadataEditorComponent : public juce::Component
 {
@@ -108,7 +224,7 @@ private:
 /*
     Professional audio capture application with iTunes-style dark interface
 */
-class MainComponent : public juce::AudioAppComponent, private juce::ChangeListener
+class MainComponent : public juce::AudioAppComponent, private juce::Timer
 {
 public:
     //==============================================================================
@@ -126,36 +242,61 @@ public:
 
 private:
     //==============================================================================
-    void changeListenerCallback(juce::ChangeBroadcaster* source) override;
+    void timerCallback() override;
     void setupUI();
     void updateRecordingStatus();
     void onRecordingComplete(const Recording& recording);
-    void onLibrarySelectionChanged(int selectedIndex);
-    void onRecordingRemove(int index);
+    void onLibrarySelectionChanged(RecordingHandle handle);
+    void onRecordingRemove(RecordingHandle handle);
     void onRecordingExport(const Recording& recording);
-    void showMetadataEditor(const Recording& recording);
+    void showMetadataEditor(RecordingHandle handle);
     void importAudioFiles();
     void importAudioFolder();
+    void startImport(const juce::Array<juce::File>& filesOrFolders, bool recursive);
+    void updateImportButtons();
+    void showWatchedFoldersMenu();
+    void showManifestMenu();
+    void exportManifest(LibraryManifest::Format format);
+    void importManifest();
     void exportAudioFile(const Recording& recording);
+    void playRecording(RecordingHandle handle);
+    void togglePlayback();
     
     // UI Components
     juce::TextButton recordButton;
+    juce::TextButton playButton;
     juce::TextButton importFilesButton;
     juce::TextButton importFolderButton;
+    juce::TextButton watchedFoldersButton;
+    juce::TextButton manifestButton;
+    juce::TextButton cancelImportButton;
+    juce::TextButton spectrogramButton;
     juce::Label statusLabel;
     juce::Label titleLabel;
+    std::unique_ptr<DecodedBlockCache> blockCache;  // shared by everything that decodes, so it outlives them all
+    std::unique_ptr<PeakStore> peakStore;     // declared first, so it outlives the views listening to it
+    std::unique_ptr<SparklineStore> sparklineStore;
     std::unique_ptr<LibraryComponent> libraryComponent;
     std::unique_ptr<WaveformComponent> waveformComponent;
+    std::unique_ptr<SpectrogramComponent> spectrogramComponent;
     
     // Core functionality
     std::unique_ptr<AudioRecorder> audioRecorder;
     std::unique_ptr<LibraryManager> libraryManager;
+    std::unique_ptr<ImportPipeline> importPipeline;
+    std::unique_ptr<ManifestImporter> manifestImporter;
+    std::unique_ptr<WatchedFolders> watchedFolders;
+    std::unique_ptr<PlaybackEngine> playbackEngine;
+    
+    // Must outlive its asynchronous dialog
+    std::unique_ptr<juce::FileChooser> fileChooser;
     
     // Look and feel
     DarkLookAndFeel darkLookAndFeel;
     
     // State
-    int selectedRecordingIndex = -1;
+    RecordingHandle selectedRecording;
+    juce::File playingFile;     // as last seen by the timer, to notice gapless advances
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainComponent)
 };
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "ManifestImporter.h"
+#include "LibraryManager.h"
+
+ManifestImporter::ManifestImporter(LibraryManager& libraryToMergeInto)
+    : Thread("Manifest reader"),
+      library(libraryToMergeInto)
+{
+}
+
+ManifestImporter::~ManifestImporter()
+{
+    if (importing)
+    {
+        cancel();
+        stopTimer();
+        stopThread(5000);
+    }
+}
+
+bool ManifestImporter::start(const juce::File& manifest)
+{
+    if (importing)
+        return false;
+
+    file = manifest;
+    pending.clear();
+    readErrors.clear();
+    readFinished = false;
+    cancelled = false;
+    result = {};
+
+    importing = true;
+    startThread();
+    startTimer(commitIntervalMs);
+    return true;
+}
+
+void ManifestImporter::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+        cancelled = true;
+    }
+
+    queueNotFull.notify_all();
+    signalThreadShouldExit();
+}
+
+//==============================================================================
+void ManifestImporter::run()
+{
+    juce::StringArray errors;
+    juce::FileInputStream input(file);
+
+    if (input.openedOk())
+    {
+        LibraryManifest::read(input, LibraryManifest::getFormatForFile(file),
+            [this](const ManifestEntry& entry)
+            {
+                std::unique_lock<std::mutex> lock(queueLock);
+                queueNotFull.wait(lock, [this] { return pending.size() < maxPendingEntries || cancelled; });
+
+                if (cancelled)
+                    return false;
+
+                pending.push_back(entry);
+                return true;
+            },
+            errors);
+    }
+    else
+    {
+        errors.add("Couldn't open " + file.getFullPathName());
+    }
+
+    std::lock_guard<std::mutex> lock(queueLock);
+    readErrors = errors;
+    readFinished = true;
+}
+
+void ManifestImporter::timerCallback()
+{
+    // The reader publishes its last entries before it says it's finished
+    bool allRead;
+
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+        allRead = readFinished;
+    }
+
+    commitPending();
+
+    if (allRead)
+        finish();
+    else if (onProgress)
+        onProgress(result);
+}
+
+void ManifestImporter::commitPending()
+{
+    std::vector<ManifestEntry> batch;
+
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+        batch.swap(pending);
+    }
+
+    queueNotFull.notify_all();
+
+    if (batch.empty())
+        return;
+
+    LibraryManager::ScopedBatch scopedBatch(library);
+
+    for (const auto& entry : batch)
+        library.mergeManifestEntry(entry, result);
+
+    result.rowsRead += (int)batch.size();
+}
+
+void ManifestImporter::finish()
+{
+    stopTimer();
+    stopThread(5000);
+    importing = false;
+
+    // Rows the reader rejected come after the ones that failed to merge, under the same cap
+    for (const auto& error : readErrors)
+        result.addError(error);
+
+    if (onFinished)
+        onFinished(result);
+}
\ No newline at end of file
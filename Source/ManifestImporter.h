@@ -0,0 +1,60 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LibraryManifest.h"
+
+class LibraryManager;
+
+//==============================================================================
+/**
+    Merges a manifest into the library without blocking the message thread.
+
+    A background thread parses the file into a bounded queue of entries, and
+    a timer on the message thread merges whatever has arrived in one batch,
+    so the library is saved and broadcasts a change once per batch rather
+    than once per row. Only the user's metadata is merged; see
+    LibraryManager::mergeManifestEntry().
+*/
+class ManifestImporter : private juce::Thread,
+                         private juce::Timer
+{
+public:
+    explicit ManifestImporter(LibraryManager& library);
+    ~ManifestImporter() override;
+
+    // Starts reading the file. Returns false if an import is already running.
+    bool start(const juce::File& manifest);
+    void cancel();
+
+    bool isImporting() const noexcept               { return importing; }
+    const ManifestImportResult& getResult() const noexcept  { return result; }
+
+    // Both called on the message thread
+    std::function<void(const ManifestImportResult&)> onProgress;
+    std::function<void(const ManifestImportResult&)> onFinished;
+
+private:
+    void run() override;
+    void timerCallback() override;
+
+    void commitPending();
+    void finish();
+
+    LibraryManager& library;
+    juce::File file;
+
+    std::mutex queueLock;
+    std::condition_variable queueNotFull;
+    std::vector<ManifestEntry> pending;
+    juce::StringArray readErrors;
+    bool readFinished = false;
+    std::atomic<bool> cancelled { false };
+
+    bool importing = false;
+    ManifestImportResult result;
+
+    static constexpr size_t maxPendingEntries = 4096;
+    static constexpr int commitIntervalMs = 100;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ManifestImporter)
+};
\ No newline at end of file
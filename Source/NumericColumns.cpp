@@ -0,0 +1,272 @@
+#include "NumericColumns.h"
+
+#if defined (__AVX__)
+ #include <immintrin.h>
+ #define CAPSURE_COLUMNS_AVX 1
+#elif defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define CAPSURE_COLUMNS_SSE2 1
+#endif
+
+//==============================================================================
+SelectionMask& SelectionMask::operator&= (const SelectionMask& other)
+{
+    auto common = juce::jmin(words.size(), other.words.size());
+
+    for (size_t i = 0; i < common; ++i)
+        words[i] &= other.words[i];
+
+    std::fill(words.begin() + (std::ptrdiff_t)common, words.end(), (juce::uint64)0);
+    return *this;
+}
+
+SelectionMask& SelectionMask::operator|= (const SelectionMask& other)
+{
+    if (words.size() < other.words.size())
+        words.resize(other.words.size(), 0);
+
+    for (size_t i = 0; i < other.words.size(); ++i)
+        words[i] |= other.words[i];
+
+    return *this;
+}
+
+size_t SelectionMask::count() const noexcept
+{
+    size_t total = 0;
+    for (auto word : words)
+        total += (size_t)juce::countNumberOfBits(word);
+    return total;
+}
+
+std::vector<LibraryRow> SelectionMask::toRows() const
+{
+    std::vector<LibraryRow> rows;
+    rows.reserve(count());
+
+    for (size_t w = 0; w < words.size(); ++w)
+    {
+        for (auto word = words[w]; word != 0; word &= word - 1)
+            rows.push_back((LibraryRow)(w * 64 + (size_t)findLowestSetBit(word)));
+    }
+
+    return rows;
+}
+
+//==============================================================================
+void NumericColumns::ensureCapacity(LibraryRow row)
+{
+    auto wordsNeeded = (size_t)(row >> 6) + 1;
+    if (wordsNeeded <= liveWords.size())
+        return;
+
+    // Grow geometrically so a bulk import doesn't reallocate every 64 rows
+    auto newWords = juce::jmax(wordsNeeded, liveWords.size() * 2);
+    auto newRows = newWords * 64;
+
+    durations.resize(newRows, 0.0);
+    timestamps.resize(newRows, 0.0);
+    sampleRates.resize(newRows, 0);
+    channels.resize(newRows, 0);
+    trackNumbers.resize(newRows, 0);
+    liveWords.resize(newWords, 0);
+}
+
+void NumericColumns::set(LibraryRow row, const Recording& recording)
+{
+    ensureCapacity(row);
+
+    durations[row]    = getValue(durationColumn, recording);
+    timestamps[row]   = getValue(timestampColumn, recording);
+    sampleRates[row]  = (juce::int32)getValue(sampleRateColumn, recording);
+    channels[row]     = (juce::int32)getValue(channelsColumn, recording);
+    trackNumbers[row] = (juce::int32)getValue(trackNumberColumn, recording);
+    liveWords[row >> 6] |= (juce::uint64)1 << (row & 63);
+}
+
+void NumericColumns::remove(LibraryRow row)
+{
+    if ((size_t)(row >> 6) < liveWords.size())
+        liveWords[row >> 6] &= ~((juce::uint64)1 << (row & 63));
+}
+
+void NumericColumns::clear()
+{
+    durations.clear();
+    timestamps.clear();
+    sampleRates.clear();
+    channels.clear();
+    trackNumbers.clear();
+    liveWords.clear();
+}
+
+double NumericColumns::getValue(Column column, LibraryRow row) const
+{
+    if ((size_t)row >= durations.size())
+        return 0.0;
+
+    switch (column)
+    {
+        case durationColumn:    return durations[row];
+        case timestampColumn:   return timestamps[row];
+        case sampleRateColumn:  return sampleRates[row];
+        case channelsColumn:    return channels[row];
+        case trackNumberColumn: return trackNumbers[row];
+        case numColumns:        break;
+    }
+
+    return 0.0;
+}
+
+double NumericColumns::getValue(Column column, const Recording& recording)
+{
+    switch (column)
+    {
+        case durationColumn:    return recording.durationInSeconds;
+        case timestampColumn:   return (double)recording.timestamp.toMilliseconds();
+        case sampleRateColumn:  return (double)juce::roundToInt(recording.sampleRate);
+        case channelsColumn:    return (double)recording.numChannels;
+        case trackNumberColumn: return (double)recording.trackNumber;
+        case numColumns:        break;
+    }
+
+    return 0.0;
+}
+
+juce::String NumericColumns::getColumnName(Column column)
+{
+    switch (column)
+    {
+        case durationColumn:    return "duration";
+        case timestampColumn:   return "timestamp";
+        case sampleRateColumn:  return "rate";
+        case channelsColumn:    return "channels";
+        case trackNumberColumn: return "track";
+        case numColumns:        break;
+    }
+
+    return {};
+}
+
+//==============================================================================
+void NumericColumns::selectRange(const double* values, size_t numWords, double lo, double hi, juce::uint64* out)
+{
+    for (size_t w = 0; w < numWords; ++w)
+    {
+        const double* v = values + w * 64;
+        juce::uint64 word = 0;
+
+       #if defined (CAPSURE_COLUMNS_AVX)
+        auto low = _mm256_set1_pd(lo);
+        auto high = _mm256_set1_pd(hi);
+
+        for (int i = 0; i < 64; i += 4)
+        {
+            auto x = _mm256_loadu_pd(v + i);
+            auto inRange = _mm256_and_pd(_mm256_cmp_pd(x, low, _CMP_GE_OQ), _mm256_cmp_pd(x, high, _CMP_LE_OQ));
+            word |= (juce::uint64)_mm256_movemask_pd(inRange) << i;
+        }
+       #elif defined (CAPSURE_COLUMNS_SSE2)
+        auto low = _mm_set1_pd(lo);
+        auto high = _mm_set1_pd(hi);
+
+        for (int i = 0; i < 64; i += 2)
+        {
+            auto x = _mm_loadu_pd(v + i);
+            auto inRange = _mm_and_pd(_mm_cmpge_pd(x, low), _mm_cmple_pd(x, high));
+            word |= (juce::uint64)_mm_movemask_pd(inRange) << i;
+        }
+       #else
+        for (int i = 0; i < 64; ++i)
+            word |= (juce::uint64)(v[i] >= lo && v[i] <= hi) << i;
+       #endif
+
+        out[w] = word;
+    }
+}
+
+void NumericColumns::selectRange(const juce::int32* values, size_t numWords, juce::int32 lo, juce::int32 hi, juce::uint64* out)
+{
+    for (size_t w = 0; w < numWords; ++w)
+    {
+        const juce::int32* v = values + w * 64;
+        juce::uint64 word = 0;
+
+       #if defined (CAPSURE_COLUMNS_AVX) || defined (CAPSURE_COLUMNS_SSE2)
+        // SSE2 only has a signed greater-than, so test for "outside" and invert
+        auto low = _mm_set1_epi32(lo);
+        auto high = _mm_set1_epi32(hi);
+
+        for (int i = 0; i < 64; i += 4)
+        {
+            auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+            auto outside = _mm_or_si128(_mm_cmpgt_epi32(low, x), _mm_cmpgt_epi32(x, high));
+            auto bits = (juce::uint64)(~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xf);
+            word |= bits << i;
+        }
+       #else
+        for (int i = 0; i < 64; ++i)
+            word |= (juce::uint64)(v[i] >= lo && v[i] <= hi) << i;
+       #endif
+
+        out[w] = word;
+    }
+}
+
+SelectionMask NumericColumns::selectAll() const
+{
+    SelectionMask mask;
+    mask.words = liveWords;
+    return mask;
+}
+
+SelectionMask NumericColumns::select(const Predicate& predicate) const
+{
+    SelectionMask mask(getNumWords());
+
+    if (predicate.minimum > predicate.maximum || getNumWords() == 0)
+        return mask;
+
+    auto selectIntegers = [&](const std::vector<juce::int32>& column)
+    {
+        // Integer columns: narrow the bounds to the integers they contain
+        constexpr double intMin = (double)std::numeric_limits<juce::int32>::min();
+        constexpr double intMax = (double)std::numeric_limits<juce::int32>::max();
+
+        auto lo = (juce::int32)juce::jlimit(intMin, intMax, std::ceil(predicate.minimum));
+        auto hi = (juce::int32)juce::jlimit(intMin, intMax, std::floor(predicate.maximum));
+        selectRange(column.data(), getNumWords(), lo, hi, mask.words.data());
+    };
+
+    switch (predicate.column)
+    {
+        case durationColumn:
+            selectRange(durations.data(), getNumWords(), predicate.minimum, predicate.maximum, mask.words.data());
+            break;
+        case timestampColumn:
+            selectRange(timestamps.data(), getNumWords(), predicate.minimum, predicate.maximum, mask.words.data());
+            break;
+        case sampleRateColumn:  selectIntegers(sampleRates); break;
+        case channelsColumn:    selectIntegers(channels); break;
+        case trackNumberColumn: selectIntegers(trackNumbers); break;
+        case numColumns:        break;
+    }
+
+    for (size_t w = 0; w < mask.words.size(); ++w)
+        mask.words[w] &= liveWords[w];
+
+    return mask;
+}
+
+SelectionMask NumericColumns::select(const std::vector<Predicate>& predicates) const
+{
+    if (predicates.empty())
+        return selectAll();
+
+    auto mask = select(predicates.front());
+
+    for (size_t i = 1; i < predicates.size(); ++i)
+        mask &= select(predicates[i]);
+
+    return mask;
+}
\ No newline at end of file
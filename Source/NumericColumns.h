@@ -0,0 +1,91 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioRecorder.h"
+#include "LibraryTypes.h"
+#include "RowBitmap.h"
+
+//==============================================================================
+/**
+    Dense selection bitmap with one bit per library row, as produced by the
+    column range filters.
+*/
+class SelectionMask
+{
+public:
+    SelectionMask() = default;
+    explicit SelectionMask(size_t numWords) : words(numWords, 0) {}
+
+    SelectionMask& operator&= (const SelectionMask& other);
+    SelectionMask& operator|= (const SelectionMask& other);
+
+    bool contains(LibraryRow row) const noexcept
+    {
+        auto w = (size_t)(row >> 6);
+        return w < words.size() && ((words[w] >> (row & 63)) & 1) != 0;
+    }
+
+    size_t count() const noexcept;
+    std::vector<LibraryRow> toRows() const;
+    RowBitmap toRowBitmap() const                  { return RowBitmap::fromWords(words); }
+
+    std::vector<juce::uint64> words;
+};
+
+//==============================================================================
+/**
+    Structure-of-arrays copy of the numeric fields of every recording, indexed
+    by row. Range predicates run over the contiguous columns with SIMD
+    comparisons and produce SelectionMasks, so they never have to touch the
+    Recording objects.
+*/
+class NumericColumns
+{
+public:
+    enum Column
+    {
+        durationColumn = 0,     // seconds
+        timestampColumn,        // milliseconds since the epoch
+        sampleRateColumn,       // Hz
+        channelsColumn,
+        trackNumberColumn,
+        numColumns
+    };
+
+    struct Predicate
+    {
+        Column column;
+        double minimum = -std::numeric_limits<double>::infinity();
+        double maximum =  std::numeric_limits<double>::infinity();   // both inclusive
+    };
+
+    NumericColumns() = default;
+
+    void set(LibraryRow row, const Recording& recording);
+    void remove(LibraryRow row);
+    void clear();
+
+    double getValue(Column column, LibraryRow row) const;
+    static double getValue(Column column, const Recording& recording);
+
+    SelectionMask selectAll() const;
+    SelectionMask select(const Predicate& predicate) const;
+    SelectionMask select(const std::vector<Predicate>& predicates) const;
+
+    static juce::String getColumnName(Column column);
+
+private:
+    void ensureCapacity(LibraryRow row);
+    size_t getNumWords() const noexcept             { return liveWords.size(); }
+
+    static void selectRange(const double* values, size_t numWords, double lo, double hi, juce::uint64* out);
+    static void selectRange(const juce::int32* values, size_t numWords, juce::int32 lo, juce::int32 hi, juce::uint64* out);
+
+    // Capacity is always a whole number of 64-row words so the kernels never
+    // need a tail loop; unused slots are masked out by liveWords
+    std::vector<double> durations, timestamps;
+    std::vector<juce::int32> sampleRates, channels, trackNumbers;
+    std::vector<juce::uint64> liveWords;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NumericColumns)
+};
\ No newline at end of file
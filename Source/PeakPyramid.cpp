@@ -0,0 +1,244 @@
+#include "PeakPyramid.h"
+
+namespace
+{
+    constexpr int sidecarMagic = 0x314b5043;   // "CPK1"
+    constexpr int sidecarVersion = 1;
+
+    static_assert(sizeof(PeakPyramid::Peak) == 3, "Peaks are written to disk as raw bytes");
+
+    juce::int8 toPeakValue(float sample) noexcept
+    {
+        return (juce::int8)juce::roundToInt(juce::jlimit(-1.0f, 1.0f, sample) * 127.0f);
+    }
+}
+
+//==============================================================================
+PeakPyramid::Peak PeakPyramid::createPeak(float min, float max, double rms) noexcept
+{
+    Peak peak;
+    peak.min = toPeakValue(min);
+    peak.max = toPeakValue(max);
+    peak.rms = (juce::uint8)juce::roundToInt(juce::jlimit(0.0, 1.0, rms) * 255.0);
+    return peak;
+}
+
+PeakPyramid::Range PeakPyramid::getRange(int channel, juce::int64 startSample, juce::int64 endSample) const noexcept
+{
+    if (levels.empty() || !juce::isPositiveAndBelow(channel, numChannels) || startSample >= numSamples)
+        return {};
+
+    auto span = juce::jmax((juce::int64)1, endSample - startSample);
+    int level = 0;
+
+    while (level + 1 < getNumLevels() && getSamplesPerPeak(level + 1) <= span)
+        ++level;
+
+    const auto& peaks = levels[(size_t)level];
+    auto samplesPerPeak = (juce::int64)getSamplesPerPeak(level);
+    auto numPeaks = (juce::int64)(peaks.size() / (size_t)numChannels);
+
+    auto first = juce::jlimit((juce::int64)0, numPeaks - 1, juce::jmax((juce::int64)0, startSample) / samplesPerPeak);
+    auto last = juce::jlimit(first + 1, numPeaks, (endSample + samplesPerPeak - 1) / samplesPerPeak);
+
+    int low = 127, high = -127;
+    float sumOfSquares = 0.0f;
+
+    for (auto p = first; p < last; ++p)
+    {
+        const auto& peak = peaks[(size_t)(p * numChannels + channel)];
+        low = juce::jmin(low, (int)peak.min);
+        high = juce::jmax(high, (int)peak.max);
+        sumOfSquares += (float)peak.rms * (float)peak.rms;
+    }
+
+    return { (float)low / 127.0f, (float)high / 127.0f, std::sqrt(sumOfSquares / (float)(last - first)) / 255.0f };
+}
+
+void PeakPyramid::buildLevels()
+{
+    levels.resize(1);
+
+    // Each level merges pairs of peaks from the one below
+    for (;;)
+    {
+        const auto& below = levels.back();
+        auto numBelow = below.size() / (size_t)juce::jmax(1, numChannels);
+
+        if (numBelow <= (size_t)minPeaksInLevel)
+            break;
+
+        std::vector<Peak> level(((numBelow + 1) / 2) * (size_t)numChannels);
+
+        for (size_t p = 0; p < numBelow; p += 2)
+        {
+            for (int c = 0; c < numChannels; ++c)
+            {
+                const auto& a = below[p * (size_t)numChannels + (size_t)c];
+                const auto& b = p + 1 < numBelow ? below[(p + 1) * (size_t)numChannels + (size_t)c] : a;
+                auto& merged = level[(p / 2) * (size_t)numChannels + (size_t)c];
+
+                merged.min = juce::jmin(a.min, b.min);
+                merged.max = juce::jmax(a.max, b.max);
+                merged.rms = (juce::uint8)juce::roundToInt(std::sqrt(((float)a.rms * (float)a.rms + (float)b.rms * (float)b.rms) * 0.5f));
+            }
+        }
+
+        levels.push_back(std::move(level));
+    }
+}
+
+//==============================================================================
+PeakPyramid::Builder::Builder(double rate, int channels)
+    : sampleRate(rate), numChannels(juce::jmax(1, channels)), accumulators((size_t)numChannels)
+{
+}
+
+void PeakPyramid::Builder::addSamples(const float* const* channelData, int numToAdd)
+{
+    for (int done = 0; done < numToAdd;)
+    {
+        auto n = juce::jmin(numToAdd - done, baseSamplesPerPeak - samplesInPeak);
+
+        for (int c = 0; c < numChannels; ++c)
+        {
+            auto& acc = accumulators[(size_t)c];
+            auto* samples = channelData[c] + done;
+            auto range = juce::FloatVectorOperations::findMinAndMax(samples, n);
+
+            if (samplesInPeak == 0)
+            {
+                acc.min = range.getStart();
+                acc.max = range.getEnd();
+            }
+            else
+            {
+                acc.min = juce::jmin(acc.min, range.getStart());
+                acc.max = juce::jmax(acc.max, range.getEnd());
+            }
+
+            for (int i = 0; i < n; ++i)
+                acc.sumOfSquares += (double)samples[i] * samples[i];
+        }
+
+        samplesInPeak += n;
+        numSamples += n;
+        done += n;
+
+        if (samplesInPeak == baseSamplesPerPeak)
+            flushPeak();
+    }
+}
+
+void PeakPyramid::Builder::flushPeak()
+{
+    for (auto& acc : accumulators)
+    {
+        peaks.push_back(createPeak(acc.min, acc.max, std::sqrt(acc.sumOfSquares / samplesInPeak)));
+        acc = {};
+    }
+
+    samplesInPeak = 0;
+}
+
+std::unique_ptr<PeakPyramid> PeakPyramid::Builder::build()
+{
+    if (samplesInPeak > 0)
+        flushPeak();
+
+    std::unique_ptr<PeakPyramid> pyramid(new PeakPyramid());
+    pyramid->sampleRate = sampleRate;
+    pyramid->numChannels = numChannels;
+    pyramid->numSamples = numSamples;
+    pyramid->levels.push_back(std::move(peaks));
+    pyramid->buildLevels();
+
+    peaks.clear();
+    numSamples = 0;
+    return pyramid;
+}
+
+std::unique_ptr<PeakPyramid> PeakPyramid::createFromSource(DecodedBlockCache::Source& source,
+                                                           const std::function<bool()>& shouldStop)
+{
+    Builder builder(source.getSampleRate(), source.getNumChannels());
+
+    for (juce::int64 i = 0; i < source.getNumBlocks(); ++i)
+    {
+        if (shouldStop != nullptr && shouldStop())
+            return nullptr;
+
+        auto block = source.getBlock(i);
+        if (block == nullptr)
+            return nullptr;
+
+        builder.addSamples(block->audio.getArrayOfReadPointers(), block->getNumFrames());
+    }
+
+    return builder.build();
+}
+
+//==============================================================================
+bool PeakPyramid::save(const juce::File& sidecar, juce::int64 sourceSize, juce::int64 sourceModified) const
+{
+    if (levels.empty())
+        return false;
+
+    juce::TemporaryFile temp(sidecar);
+
+    {
+        juce::FileOutputStream output(temp.getFile(), 1 << 16);
+        if (!output.openedOk())
+            return false;
+
+        const auto& base = levels.front();
+
+        output.writeInt(sidecarMagic);
+        output.writeInt(sidecarVersion);
+        output.writeInt64(sourceSize);
+        output.writeInt64(sourceModified);
+        output.writeDouble(sampleRate);
+        output.writeInt(numChannels);
+        output.writeInt64(numSamples);
+        output.writeInt64((juce::int64)base.size());
+        output.write(base.data(), base.size() * sizeof(Peak));
+
+        output.flush();
+        if (output.getStatus().failed())
+            return false;
+    }
+
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+std::unique_ptr<PeakPyramid> PeakPyramid::load(const juce::File& sidecar, juce::int64 sourceSize, juce::int64 sourceModified)
+{
+    juce::FileInputStream input(sidecar);
+    if (!input.openedOk())
+        return nullptr;
+
+    if (input.readInt() != sidecarMagic || input.readInt() != sidecarVersion
+         || input.readInt64() != sourceSize || input.readInt64() != sourceModified)
+        return nullptr;
+
+    std::unique_ptr<PeakPyramid> pyramid(new PeakPyramid());
+    pyramid->sampleRate = input.readDouble();
+    pyramid->numChannels = input.readInt();
+    pyramid->numSamples = input.readInt64();
+    auto numPeaks = input.readInt64();
+
+    if (pyramid->sampleRate <= 0.0 || pyramid->numChannels <= 0 || numPeaks <= 0
+         || numPeaks % pyramid->numChannels != 0
+         || numPeaks * (juce::int64)sizeof(Peak) != input.getNumBytesRemaining())
+        return nullptr;
+
+    std::vector<Peak> base((size_t)numPeaks);
+    auto numBytes = base.size() * sizeof(Peak);
+
+    if ((size_t)input.read(base.data(), numBytes) != numBytes)
+        return nullptr;
+
+    pyramid->levels.push_back(std::move(base));
+    pyramid->buildLevels();
+    return pyramid;
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "DecodedBlockCache.h"
+
+//==============================================================================
+/**
+    Min/max/RMS peaks of an audio file at power-of-two resolutions.
+
+    Level 0 summarises every baseSamplesPerPeak samples per channel, and each
+    level above halves the one below it, so a waveform of any length can be
+    drawn at any zoom by reading at most a few peaks per pixel. Only level 0
+    is stored in the sidecar file; the coarser levels are rebuilt on load.
+*/
+class PeakPyramid
+{
+public:
+    struct Peak
+    {
+        juce::int8 min = 0, max = 0;    // scaled by 127
+        juce::uint8 rms = 0;            // scaled by 255
+    };
+
+    struct Range
+    {
+        float min = 0.0f, max = 0.0f, rms = 0.0f;
+    };
+
+    static constexpr int baseSamplesPerPeak = 256;
+
+    static Peak createPeak(float min, float max, double rms) noexcept;
+
+    double getSampleRate() const noexcept           { return sampleRate; }
+    int getNumChannels() const noexcept             { return numChannels; }
+    juce::int64 getNumSamples() const noexcept      { return numSamples; }
+    double getLengthInSeconds() const noexcept      { return sampleRate > 0.0 ? (double)numSamples / sampleRate : 0.0; }
+
+    int getNumLevels() const noexcept               { return (int)levels.size(); }
+    static int getSamplesPerPeak(int level) noexcept    { return baseSamplesPerPeak << level; }
+
+    /** Summarises one channel over [startSample, endSample), reading from the
+        coarsest level that still has a peak boundary inside the range.
+    */
+    Range getRange(int channel, juce::int64 startSample, juce::int64 endSample) const noexcept;
+
+    //==============================================================================
+    // Accumulates peaks from blocks of samples as they're decoded or recorded
+    class Builder
+    {
+    public:
+        Builder(double sampleRate, int numChannels);
+
+        void addSamples(const float* const* channelData, int numSamples);
+        std::unique_ptr<PeakPyramid> build();
+
+    private:
+        struct Accumulator
+        {
+            float min = 0.0f, max = 0.0f;
+            double sumOfSquares = 0.0;
+        };
+
+        void flushPeak();
+
+        double sampleRate;
+        int numChannels;
+        juce::int64 numSamples = 0;
+        int samplesInPeak = 0;
+        std::vector<Accumulator> accumulators;
+        std::vector<Peak> peaks;
+
+        JUCE_DECLARE_NON_COPYABLE(Builder)
+    };
+
+    // Reads the whole file through the block cache; shouldStop is polled between blocks
+    static std::unique_ptr<PeakPyramid> createFromSource(DecodedBlockCache::Source& source,
+                                                         const std::function<bool()>& shouldStop);
+
+    //==============================================================================
+    // The source's size and modification time are stored, so a stale sidecar is never used
+    bool save(const juce::File& sidecar, juce::int64 sourceSize, juce::int64 sourceModified) const;
+    static std::unique_ptr<PeakPyramid> load(const juce::File& sidecar, juce::int64 sourceSize, juce::int64 sourceModified);
+
+private:
+    PeakPyramid() = default;
+
+    void buildLevels();
+
+    double sampleRate = 0.0;
+    int numChannels = 0;
+    juce::int64 numSamples = 0;
+    std::vector<std::vector<Peak>> levels;     // [level][peak * numChannels + channel]
+
+    static constexpr int minPeaksInLevel = 64;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PeakPyramid)
+};
\ No newline at end of file
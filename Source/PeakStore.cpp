@@ -0,0 +1,199 @@
+#include "PeakStore.h"
+
+namespace
+{
+    std::string getKey(const juce::File& file)
+    {
+        return file.getFullPathName().toStdString();
+    }
+}
+
+PeakStore::PeakStore(DecodedBlockCache& cache)
+    : juce::Thread("Peak Builder"),
+      blockCache(cache)
+{
+    directory = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                    .getChildFile("CapSure")
+                    .getChildFile("Peaks");
+    directory.createDirectory();
+
+    startThread();
+}
+
+PeakStore::~PeakStore()
+{
+    cancelPendingUpdate();
+    stopThread(5000);
+}
+
+juce::File PeakStore::getSidecarFor(const juce::File& audioFile) const
+{
+    return directory.getChildFile(juce::String::toHexString(audioFile.getFullPathName().hashCode64()) + ".peaks");
+}
+
+std::shared_ptr<const PeakPyramid> PeakStore::getPeaks(const juce::File& audioFile)
+{
+    auto size = audioFile.getSize();
+    auto modified = audioFile.getLastModificationTime().toMilliseconds();
+    auto path = audioFile.getFullPathName();
+
+    for (auto it = loaded.begin(); it != loaded.end(); ++it)
+    {
+        if (it->path != path)
+            continue;
+
+        if (it->size == size && it->modified == modified)
+        {
+            loaded.splice(loaded.begin(), loaded, it);
+            return it->pyramid;
+        }
+
+        loaded.erase(it);
+        break;
+    }
+
+    if (std::shared_ptr<const PeakPyramid> pyramid = PeakPyramid::load(getSidecarFor(audioFile), size, modified))
+    {
+        remember(audioFile, pyramid);
+        return pyramid;
+    }
+
+    if (failed.count(getKey(audioFile)) == 0)
+        enqueue(audioFile, true);
+
+    return nullptr;
+}
+
+void PeakStore::prepare(const juce::File& audioFile)
+{
+    failed.erase(getKey(audioFile));
+    enqueue(audioFile, false);
+}
+
+bool PeakStore::isBuilding(const juce::File& audioFile) const
+{
+    return building.count(getKey(audioFile)) > 0;
+}
+
+void PeakStore::enqueue(const juce::File& audioFile, bool urgent)
+{
+    auto key = getKey(audioFile);
+    auto alreadyQueued = !building.insert(key).second;
+
+    {
+        std::lock_guard<std::mutex> sl(queueLock);
+
+        // An urgent request jumps ahead of the background ones
+        if (alreadyQueued)
+        {
+            if (!urgent)
+                return;
+
+            auto it = std::find(queue.begin(), queue.end(), audioFile);
+            if (it == queue.end())
+                return;     // already being built
+
+            queue.erase(it);
+        }
+
+        if (urgent)
+            queue.push_front(audioFile);
+        else
+            queue.push_back(audioFile);
+    }
+
+    notify();
+}
+
+void PeakStore::remember(const juce::File& audioFile, std::shared_ptr<const PeakPyramid> pyramid)
+{
+    Loaded entry;
+    entry.path = audioFile.getFullPathName();
+    entry.size = audioFile.getSize();
+    entry.modified = audioFile.getLastModificationTime().toMilliseconds();
+    entry.pyramid = std::move(pyramid);
+
+    loaded.remove_if([&entry](const Loaded& l) { return l.path == entry.path; });
+    loaded.push_front(std::move(entry));
+
+    if (loaded.size() > maxLoaded)
+        loaded.pop_back();
+}
+
+//==============================================================================
+void PeakStore::run()
+{
+    while (!threadShouldExit())
+    {
+        juce::File file;
+
+        {
+            std::lock_guard<std::mutex> sl(queueLock);
+
+            if (!queue.empty())
+            {
+                file = queue.front();
+                queue.pop_front();
+            }
+        }
+
+        if (file == juce::File())
+        {
+            wait(-1);
+            continue;
+        }
+
+        auto size = file.getSize();
+        auto modified = file.getLastModificationTime().toMilliseconds();
+        auto sidecar = getSidecarFor(file);
+
+        std::shared_ptr<const PeakPyramid> pyramid = PeakPyramid::load(sidecar, size, modified);
+
+        if (pyramid == nullptr)
+        {
+            if (auto source = blockCache.open(file))
+            {
+                auto built = PeakPyramid::createFromSource(*source, [this] { return threadShouldExit(); });
+
+                if (threadShouldExit())
+                    return;
+
+                if (built != nullptr)
+                {
+                    built->save(sidecar, size, modified);
+                    pyramid = std::move(built);
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> sl(queueLock);
+            finished.push_back({ file, pyramid });
+        }
+
+        triggerAsyncUpdate();
+    }
+}
+
+void PeakStore::handleAsyncUpdate()
+{
+    std::vector<Finished> done;
+
+    {
+        std::lock_guard<std::mutex> sl(queueLock);
+        done.swap(finished);
+    }
+
+    for (auto& result : done)
+    {
+        auto key = getKey(result.file);
+        building.erase(key);
+
+        if (result.pyramid != nullptr)
+            remember(result.file, result.pyramid);
+        else
+            failed.insert(key);
+
+        listeners.call([&result](Listener& l) { l.peaksReady(result.file); });
+    }
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PeakPyramid.h"
+
+//==============================================================================
+/**
+    Keeps a PeakPyramid sidecar for each audio file, in the app data folder.
+
+    Sidecars are read on the message thread, which takes milliseconds even
+    for hours of audio. Files without a valid sidecar are read once through
+    the decoded block cache on a background thread, most recently requested
+    first, and listeners are told when their peaks are ready. The last few
+    pyramids used stay in memory.
+*/
+class PeakStore : private juce::Thread,
+                  private juce::AsyncUpdater
+{
+public:
+    explicit PeakStore(DecodedBlockCache& cache);
+    ~PeakStore() override;
+
+    class Listener
+    {
+    public:
+        virtual ~Listener() = default;
+        virtual void peaksReady(const juce::File& audioFile) = 0;
+    };
+
+    void addListener(Listener* listener)        { listeners.add(listener); }
+    void removeListener(Listener* listener)     { listeners.remove(listener); }
+
+    /** Returns the file's peaks if they're in memory or have a valid sidecar.
+        Otherwise queues them to be built and returns nullptr.
+    */
+    std::shared_ptr<const PeakPyramid> getPeaks(const juce::File& audioFile);
+
+    // Builds the sidecar in the background if there isn't a valid one yet
+    void prepare(const juce::File& audioFile);
+
+    bool isBuilding(const juce::File& audioFile) const;
+
+private:
+    struct Loaded
+    {
+        juce::String path;
+        juce::int64 size = 0, modified = 0;
+        std::shared_ptr<const PeakPyramid> pyramid;
+    };
+
+    struct Finished
+    {
+        juce::File file;
+        std::shared_ptr<const PeakPyramid> pyramid;    // null if the file couldn't be decoded
+    };
+
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    void enqueue(const juce::File& audioFile, bool urgent);
+    void remember(const juce::File& audioFile, std::shared_ptr<const PeakPyramid> pyramid);
+    juce::File getSidecarFor(const juce::File& audioFile) const;
+
+    DecodedBlockCache& blockCache;
+    juce::File directory;
+
+    // Message thread only
+    std::list<Loaded> loaded;                       // most recently used first
+    std::unordered_set<std::string> building, failed;
+    juce::ListenerList<Listener> listeners;
+
+    // Shared with the builder thread
+    std::mutex queueLock;
+    std::deque<juce::File> queue;
+    std::vector<Finished> finished;
+
+    static constexpr size_t maxLoaded = 16;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PeakStore)
+};
\ No newline at end of file
@@ -0,0 +1,392 @@
+#include "PlaybackEngine.h"
+
+PlaybackEngine::PlaybackEngine(DecodedBlockCache& cache)
+    : juce::Thread("Playback Decoder"),
+      blockCache(cache)
+{
+    startThread(juce::Thread::Priority::high);
+}
+
+PlaybackEngine::~PlaybackEngine()
+{
+    cancelPendingUpdate();
+    stopThread(5000);
+}
+
+//==============================================================================
+void PlaybackEngine::load(const juce::File& file)
+{
+    {
+        std::lock_guard<std::mutex> sl(requestLock);
+        request = {};
+        request.load = true;
+        request.file = file;
+        loadedFile = file;
+        loadedSerial = std::numeric_limits<int>::max();
+        ++generation;
+    }
+
+    playing = false;
+    reachedEnd = false;
+    position = 0;
+    notify();
+}
+
+void PlaybackEngine::play()
+{
+    if (reachedEnd.load())
+        seek(0);
+
+    reachedEnd = false;
+    playing = true;
+}
+
+void PlaybackEngine::pause()
+{
+    playing = false;
+}
+
+void PlaybackEngine::seek(juce::int64 sourceSample)
+{
+    {
+        std::lock_guard<std::mutex> sl(requestLock);
+        request.seekPosition = juce::jmax((juce::int64)0, sourceSample);
+        ++generation;
+    }
+
+    reachedEnd = false;
+    position = juce::jmax((juce::int64)0, sourceSample);
+    notify();
+}
+
+void PlaybackEngine::queueNext(const juce::File& file)
+{
+    {
+        std::lock_guard<std::mutex> sl(requestLock);
+        request.queueNext = true;
+        request.nextFile = file;
+    }
+
+    notify();
+}
+
+juce::File PlaybackEngine::getCurrentFile() const
+{
+    auto serial = playingSerial.load();
+    std::lock_guard<std::mutex> sl(requestLock);
+
+    // Until the audio thread reaches the loaded file, that's the one to report,
+    // so a click straight after load() doesn't load it all over again
+    if (serial < loadedSerial)
+        return loadedFile;
+
+    for (auto it = filesBySerial.rbegin(); it != filesBySerial.rend(); ++it)
+        if (it->first == serial)
+            return it->second;
+
+    return loadedFile;
+}
+
+//==============================================================================
+void PlaybackEngine::prepareToPlay(int, double sampleRate)
+{
+    deviceSampleRate = sampleRate;
+    notify();
+}
+
+void PlaybackEngine::releaseResources()
+{
+}
+
+void PlaybackEngine::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    bufferToFill.clearActiveBufferRegion();
+
+    auto currentGeneration = generation.load();
+    auto* output = bufferToFill.buffer;
+    int written = 0;
+
+    for (;;)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(1, start1, size1, start2, size2);
+
+        if (size1 == 0)
+        {
+            // Out of audio: either the end, or the decoder hasn't caught up with a seek yet
+            if (playing.load() && endedGeneration.load() == currentGeneration)
+            {
+                playing = false;
+                reachedEnd = true;
+            }
+
+            break;
+        }
+
+        auto& slot = slots[(size_t)start1];
+
+        // Stale slots are dropped even while paused, so the decoder can refill behind them
+        if (slot.generation != currentGeneration)
+        {
+            fifo.finishedRead(1);
+            readOffset = 0;
+            continue;
+        }
+
+        if (!playing.load() || written == bufferToFill.numSamples)
+        {
+            if (written == 0)
+            {
+                position = slot.sourcePosition + (juce::int64)(readOffset * slot.sourceSamplesPerFrame);
+                playingSerial = slot.trackSerial;
+            }
+
+            break;
+        }
+
+        auto numFrames = juce::jmin(slot.numFrames - readOffset, bufferToFill.numSamples - written);
+
+        for (int c = 0; c < output->getNumChannels(); ++c)
+            output->copyFrom(c, bufferToFill.startSample + written, slot.audio, juce::jmin(c, 1), readOffset, numFrames);
+
+        readOffset += numFrames;
+        written += numFrames;
+
+        position = slot.sourcePosition + (juce::int64)(readOffset * slot.sourceSamplesPerFrame);
+        playingSerial = slot.trackSerial;
+
+        if (readOffset >= slot.numFrames)
+        {
+            fifo.finishedRead(1);
+            readOffset = 0;
+        }
+    }
+}
+
+//==============================================================================
+void PlaybackEngine::handleAsyncUpdate()
+{
+    juce::File file;
+
+    {
+        std::lock_guard<std::mutex> sl(requestLock);
+        file = std::exchange(failedFile, {});
+    }
+
+    if (file != juce::File() && onLoadFailed != nullptr)
+        onLoadFailed(file);
+}
+
+void PlaybackEngine::run()
+{
+    while (!threadShouldExit())
+    {
+        handleRequests();
+
+        auto hasWork = current.source != nullptr && decodingRate > 0.0
+                        && endedGeneration.load() != decodingGeneration;
+
+        if (!hasWork)
+        {
+            wait(-1);
+            continue;
+        }
+
+        // The audio thread can't wake us without risking a lock, so poll while the ring is full
+        if (fifo.getFreeSpace() == 0)
+        {
+            wait(5);
+            continue;
+        }
+
+        decodeSlot();
+    }
+}
+
+void PlaybackEngine::handleRequests()
+{
+    Request r;
+    juce::uint32 requestGeneration;
+
+    {
+        std::lock_guard<std::mutex> sl(requestLock);
+        r = std::move(request);
+        request = {};
+
+        // A new device rate means re-decoding from where playback is
+        if (!r.load && r.seekPosition < 0 && current.source != nullptr
+             && deviceSampleRate.load() != decodingRate)
+        {
+            r.seekPosition = position.load();
+            ++generation;
+        }
+
+        requestGeneration = generation.load();
+    }
+
+    decodingRate = deviceSampleRate.load();
+
+    if (r.load)
+    {
+        current = openTrack(r.file);
+        next = {};
+        startDecoding(requestGeneration, 0);
+
+        {
+            std::lock_guard<std::mutex> sl(requestLock);
+
+            // Unless another load has come in since
+            if (!request.load)
+            {
+                if (current.source != nullptr)
+                    loadedSerial = current.serial;
+                else
+                    failedFile = r.file;
+            }
+        }
+
+        if (current.source == nullptr)
+        {
+            playing = false;
+            reachedEnd = true;
+            triggerAsyncUpdate();
+        }
+    }
+
+    if (r.seekPosition >= 0 && current.source != nullptr)
+        startDecoding(requestGeneration, r.seekPosition);
+
+    if (r.queueNext)
+    {
+        next = openTrack(r.nextFile);
+
+        // Already past the end of the current file: carry straight on with the next
+        if (endedGeneration.load() == decodingGeneration && next.source != nullptr)
+        {
+            current = std::move(next);
+            next = {};
+            startDecoding(decodingGeneration, 0);
+            endedGeneration = 0;
+
+            // The audio thread may already have stopped at the end
+            if (reachedEnd.exchange(false))
+                playing = true;
+        }
+    }
+
+    // Nothing to decode, so whatever was asked for has ended; otherwise a play()
+    // after a failed load would wait for audio forever
+    if (current.source == nullptr)
+        endedGeneration = requestGeneration;
+}
+
+PlaybackEngine::Track PlaybackEngine::openTrack(const juce::File& file)
+{
+    Track track;
+    track.source = blockCache.open(file);
+
+    if (track.source == nullptr)
+        return {};
+
+    track.serial = nextSerial++;
+
+    std::lock_guard<std::mutex> sl(requestLock);
+    filesBySerial.emplace_back(track.serial, file);
+
+    if (filesBySerial.size() > 8)
+        filesBySerial.erase(filesBySerial.begin());
+
+    return track;
+}
+
+void PlaybackEngine::startDecoding(juce::uint32 newGeneration, juce::int64 sourceSample)
+{
+    decodingGeneration = newGeneration;
+    sourcePosition = current.source != nullptr ? juce::jmin(sourceSample, current.source->getLengthInSamples()) : 0;
+    numStaged = 0;
+
+    for (auto& interpolator : interpolators)
+        interpolator.reset();
+}
+
+void PlaybackEngine::decodeSlot()
+{
+    auto& source = *current.source;
+    auto ratio = source.getSampleRate() / decodingRate;
+    auto realLeft = source.getLengthInSamples() - sourcePosition;   // including what's already staged
+
+    if (realLeft <= 0)
+    {
+        // Gapless: the next file's first slot follows this file's last one
+        if (next.source != nullptr)
+        {
+            current = std::move(next);
+            next = {};
+            startDecoding(decodingGeneration, 0);
+        }
+        else
+        {
+            endedGeneration = decodingGeneration;
+        }
+
+        return;
+    }
+
+    auto numFrames = (int)juce::jlimit(1.0, (double)framesPerSlot, std::ceil((double)realLeft / ratio));
+
+    // Enough input for the interpolator, padded with silence past the end of the file
+    auto needed = (int)std::ceil(numFrames * ratio) + 4;
+
+    if (staging.getNumSamples() < needed)
+        staging.setSize(2, needed, true, false, true);
+
+    if (numStaged < needed)
+    {
+        auto numToRead = (int)juce::jmax((juce::int64)0, juce::jmin((juce::int64)needed, realLeft) - numStaged);
+
+        if (numToRead > 0)
+        {
+            source.read(staging, numStaged, numToRead, sourcePosition + numStaged);
+
+            if (source.getNumChannels() == 1)
+                staging.copyFrom(1, numStaged, staging, 0, numStaged, numToRead);
+        }
+
+        for (int c = 0; c < 2; ++c)
+            staging.clear(c, numStaged + numToRead, needed - numStaged - numToRead);
+
+        numStaged = needed;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 == 0)
+        return;
+
+    auto& slot = slots[(size_t)start1];
+    int used = 0;
+
+    for (int c = 0; c < 2; ++c)
+        used = interpolators[c].process(ratio, staging.getReadPointer(c), slot.audio.getWritePointer(c), numFrames, numStaged, 0);
+
+    slot.numFrames = numFrames;
+    slot.generation = decodingGeneration;
+    slot.trackSerial = current.serial;
+    slot.sourcePosition = sourcePosition;
+    slot.sourceSamplesPerFrame = ratio;
+
+    fifo.finishedWrite(1);
+
+    // Keep whatever input the interpolator hasn't consumed yet
+    used = juce::jmin(used, numStaged);
+
+    for (int c = 0; c < 2; ++c)
+    {
+        auto* data = staging.getWritePointer(c);
+        std::memmove(data, data + used, (size_t)(numStaged - used) * sizeof(float));
+    }
+
+    numStaged -= used;
+    sourcePosition += used;
+}
\ No newline at end of file
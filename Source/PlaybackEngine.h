@@ -0,0 +1,129 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "DecodedBlockCache.h"
+
+//==============================================================================
+/**
+    Plays audio files through the app's audio device.
+
+    A decoder thread reads ahead through the decoded block cache, resamples to
+    the device rate and fills a ring of fixed-size slots; the audio callback
+    only copies out of the ring and publishes its position through atomics, so
+    it never allocates or locks. Every load and seek bumps a generation
+    number, and the callback skips slots decoded for an older one, which makes
+    seeks take effect on the next callback at exactly the requested sample. A
+    queued file is opened in advance and decoded straight after the current
+    one ends, in the same stream, so there is no gap between them.
+*/
+class PlaybackEngine : public juce::AudioSource,
+                       private juce::Thread,
+                       private juce::AsyncUpdater
+{
+public:
+    explicit PlaybackEngine(DecodedBlockCache& cache);
+    ~PlaybackEngine() override;
+
+    //==============================================================================
+    // Message thread
+
+    // Opens the file and buffers its start, paused, so play() starts at once
+    void load(const juce::File& file);
+    void play();
+    void pause();
+    void seek(juce::int64 sourceSample);
+
+    /** Plays the file straight after the current one. If the current one has
+        already ended, playback carries on with this one.
+    */
+    void queueNext(const juce::File& file);
+
+    bool isPlaying() const noexcept             { return playing.load(); }
+    bool hasReachedEnd() const noexcept         { return reachedEnd.load(); }
+
+    // The file being heard (or last loaded), and the position in its own samples
+    juce::File getCurrentFile() const;
+    juce::int64 getPosition() const noexcept    { return position.load(); }
+
+    // Called on the message thread when a loaded file couldn't be opened
+    std::function<void(const juce::File& file)> onLoadFailed;
+
+    //==============================================================================
+    // Audio thread
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+private:
+    static constexpr int numSlots = 64;
+    static constexpr int framesPerSlot = 1024;
+
+    struct Slot
+    {
+        juce::AudioBuffer<float> audio { 2, framesPerSlot };
+        int numFrames = 0;
+        juce::uint32 generation = 0;
+        int trackSerial = 0;
+        juce::int64 sourcePosition = 0;     // of the first frame
+        double sourceSamplesPerFrame = 1.0;
+    };
+
+    struct Track
+    {
+        std::unique_ptr<DecodedBlockCache::Source> source;
+        int serial = 0;
+    };
+
+    struct Request
+    {
+        bool load = false;
+        juce::File file;
+        juce::int64 seekPosition = -1;
+        bool queueNext = false;
+        juce::File nextFile;
+    };
+
+    void run() override;
+    void handleAsyncUpdate() override;
+    void handleRequests();
+    Track openTrack(const juce::File& file);
+    void startDecoding(juce::uint32 generation, juce::int64 sourceSample);
+    void decodeSlot();
+
+    DecodedBlockCache& blockCache;
+
+    // Message thread -> decoder
+    mutable std::mutex requestLock;
+    Request request;
+    std::vector<std::pair<int, juce::File>> filesBySerial;  // recent tracks, for getCurrentFile()
+    juce::File loadedFile, failedFile;
+    int loadedSerial = 0;               // of loadedFile, or INT_MAX until it's open
+    std::atomic<juce::uint32> generation { 1 };
+    std::atomic<double> deviceSampleRate { 0.0 };
+    std::atomic<bool> playing { false };
+
+    // Decoder -> audio thread
+    juce::AbstractFifo fifo { numSlots };
+    std::array<Slot, numSlots> slots;
+    std::atomic<juce::uint32> endedGeneration { 0 };    // nothing more will be decoded for it
+
+    // Audio thread -> message thread
+    std::atomic<juce::int64> position { 0 };
+    std::atomic<int> playingSerial { 0 };
+    std::atomic<bool> reachedEnd { false };
+
+    // Decoder thread only
+    Track current, next;
+    int nextSerial = 1;
+    juce::uint32 decodingGeneration = 0;
+    double decodingRate = 0.0;
+    juce::int64 sourcePosition = 0;     // of the first staged sample
+    juce::AudioBuffer<float> staging;
+    int numStaged = 0;
+    juce::LagrangeInterpolator interpolators[2];
+
+    // Audio thread only
+    int readOffset = 0;                 // frames already played from the front slot
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PlaybackEngine)
+};
\ No newline at end of file
@@ -0,0 +1,416 @@
+#include "RowBitmap.h"
+
+//==============================================================================
+bool RowBitmap::Container::contains(juce::uint16 low) const noexcept
+{
+    if (isBitmap())
+        return (bits[low >> 6] >> (low & 63)) & 1;
+
+    return std::binary_search(values.begin(), values.end(), low);
+}
+
+void RowBitmap::Container::toBitmap()
+{
+    if (isBitmap())
+        return;
+
+    bits.assign(wordsPerBitmap, 0);
+    for (auto low : values)
+        bits[low >> 6] |= (juce::uint64)1 << (low & 63);
+
+    values.clear();
+    values.shrink_to_fit();
+}
+
+void RowBitmap::Container::toArrayIfSparse()
+{
+    if (!isBitmap() || cardinality > maxArraySize)
+        return;
+
+    values.clear();
+    values.reserve(cardinality);
+
+    for (size_t w = 0; w < bits.size(); ++w)
+        for (auto word = bits[w]; word != 0; word &= word - 1)
+            values.push_back((juce::uint16)(w * 64 + (size_t)findLowestSetBit(word)));
+
+    bits.clear();
+    bits.shrink_to_fit();
+}
+
+//==============================================================================
+RowBitmap::Container* RowBitmap::findContainer(juce::uint16 key) noexcept
+{
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, juce::uint16 k) { return c.key < k; });
+    return (it != containers.end() && it->key == key) ? &*it : nullptr;
+}
+
+const RowBitmap::Container* RowBitmap::findContainer(juce::uint16 key) const noexcept
+{
+    return const_cast<RowBitmap*>(this)->findContainer(key);
+}
+
+void RowBitmap::add(LibraryRow row)
+{
+    auto key = (juce::uint16)(row >> 16);
+    auto low = (juce::uint16)(row & 0xffff);
+
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, juce::uint16 k) { return c.key < k; });
+
+    if (it == containers.end() || it->key != key)
+    {
+        Container c;
+        c.key = key;
+        it = containers.insert(it, std::move(c));
+    }
+
+    auto& c = *it;
+
+    if (c.isBitmap())
+    {
+        auto& word = c.bits[low >> 6];
+        auto mask = (juce::uint64)1 << (low & 63);
+        if ((word & mask) == 0)
+        {
+            word |= mask;
+            ++c.cardinality;
+        }
+        return;
+    }
+
+    auto pos = std::lower_bound(c.values.begin(), c.values.end(), low);
+    if (pos != c.values.end() && *pos == low)
+        return;
+
+    c.values.insert(pos, low);
+    ++c.cardinality;
+
+    if (c.cardinality > maxArraySize)
+        c.toBitmap();
+}
+
+void RowBitmap::remove(LibraryRow row)
+{
+    auto key = (juce::uint16)(row >> 16);
+    auto low = (juce::uint16)(row & 0xffff);
+
+    auto* c = findContainer(key);
+    if (c == nullptr)
+        return;
+
+    if (c->isBitmap())
+    {
+        auto& word = c->bits[low >> 6];
+        auto mask = (juce::uint64)1 << (low & 63);
+        if ((word & mask) == 0)
+            return;
+
+        word &= ~mask;
+        --c->cardinality;
+        c->toArrayIfSparse();
+    }
+    else
+    {
+        auto pos = std::lower_bound(c->values.begin(), c->values.end(), low);
+        if (pos == c->values.end() || *pos != low)
+            return;
+
+        c->values.erase(pos);
+        --c->cardinality;
+    }
+
+    if (c->cardinality == 0)
+        containers.erase(containers.begin() + (c - containers.data()));
+}
+
+bool RowBitmap::contains(LibraryRow row) const noexcept
+{
+    auto* c = findContainer((juce::uint16)(row >> 16));
+    return c != nullptr && c->contains((juce::uint16)(row & 0xffff));
+}
+
+size_t RowBitmap::size() const noexcept
+{
+    size_t total = 0;
+    for (const auto& c : containers)
+        total += c.cardinality;
+    return total;
+}
+
+bool RowBitmap::operator== (const RowBitmap& other) const
+{
+    if (containers.size() != other.containers.size())
+        return false;
+
+    for (size_t i = 0; i < containers.size(); ++i)
+    {
+        const auto& a = containers[i];
+        const auto& b = other.containers[i];
+
+        if (a.key != b.key || a.cardinality != b.cardinality)
+            return false;
+
+        // Both sides use the same representation for the same cardinality
+        if (a.isBitmap() != b.isBitmap() || a.values != b.values || a.bits != b.bits)
+            return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+RowBitmap::Container RowBitmap::intersect(const Container& a, const Container& b)
+{
+    Container result;
+    result.key = a.key;
+
+    if (a.isBitmap() && b.isBitmap())
+    {
+        result.bits.resize(wordsPerBitmap);
+        for (size_t w = 0; w < wordsPerBitmap; ++w)
+        {
+            result.bits[w] = a.bits[w] & b.bits[w];
+            result.cardinality += (juce::uint32)juce::countNumberOfBits(result.bits[w]);
+        }
+        result.toArrayIfSparse();
+    }
+    else if (a.isBitmap() || b.isBitmap())
+    {
+        const auto& sparse = a.isBitmap() ? b : a;
+        const auto& dense  = a.isBitmap() ? a : b;
+
+        for (auto low : sparse.values)
+            if (dense.contains(low))
+                result.values.push_back(low);
+
+        result.cardinality = (juce::uint32)result.values.size();
+    }
+    else
+    {
+        std::set_intersection(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(),
+                              std::back_inserter(result.values));
+        result.cardinality = (juce::uint32)result.values.size();
+    }
+
+    return result;
+}
+
+RowBitmap::Container RowBitmap::unite(const Container& a, const Container& b)
+{
+    Container result;
+    result.key = a.key;
+
+    if (a.isBitmap() || b.isBitmap())
+    {
+        result = a.isBitmap() ? a : b;
+        const auto& other = a.isBitmap() ? b : a;
+
+        if (other.isBitmap())
+        {
+            for (size_t w = 0; w < wordsPerBitmap; ++w)
+                result.bits[w] |= other.bits[w];
+        }
+        else
+        {
+            for (auto low : other.values)
+                result.bits[low >> 6] |= (juce::uint64)1 << (low & 63);
+        }
+
+        result.cardinality = 0;
+        for (auto word : result.bits)
+            result.cardinality += (juce::uint32)juce::countNumberOfBits(word);
+    }
+    else
+    {
+        std::set_union(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(),
+                       std::back_inserter(result.values));
+        result.cardinality = (juce::uint32)result.values.size();
+
+        if (result.cardinality > maxArraySize)
+            result.toBitmap();
+    }
+
+    return result;
+}
+
+RowBitmap::Container RowBitmap::subtract(const Container& a, const Container& b)
+{
+    Container result;
+    result.key = a.key;
+
+    if (a.isBitmap())
+    {
+        result = a;
+
+        if (b.isBitmap())
+        {
+            for (size_t w = 0; w < wordsPerBitmap; ++w)
+                result.bits[w] &= ~b.bits[w];
+        }
+        else
+        {
+            for (auto low : b.values)
+                result.bits[low >> 6] &= ~((juce::uint64)1 << (low & 63));
+        }
+
+        result.cardinality = 0;
+        for (auto word : result.bits)
+            result.cardinality += (juce::uint32)juce::countNumberOfBits(word);
+
+        result.toArrayIfSparse();
+    }
+    else if (b.isBitmap())
+    {
+        for (auto low : a.values)
+            if (!b.contains(low))
+                result.values.push_back(low);
+
+        result.cardinality = (juce::uint32)result.values.size();
+    }
+    else
+    {
+        std::set_difference(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(),
+                            std::back_inserter(result.values));
+        result.cardinality = (juce::uint32)result.values.size();
+    }
+
+    return result;
+}
+
+RowBitmap& RowBitmap::operator&= (const RowBitmap& other)
+{
+    std::vector<Container> result;
+    size_t i = 0, j = 0;
+
+    while (i < containers.size() && j < other.containers.size())
+    {
+        const auto& a = containers[i];
+        const auto& b = other.containers[j];
+
+        if (a.key < b.key)      { ++i; continue; }
+        if (b.key < a.key)      { ++j; continue; }
+
+        auto c = intersect(a, b);
+        if (c.cardinality > 0)
+            result.push_back(std::move(c));
+
+        ++i;
+        ++j;
+    }
+
+    containers.swap(result);
+    return *this;
+}
+
+RowBitmap& RowBitmap::operator|= (const RowBitmap& other)
+{
+    std::vector<Container> result;
+    result.reserve(containers.size() + other.containers.size());
+    size_t i = 0, j = 0;
+
+    while (i < containers.size() || j < other.containers.size())
+    {
+        if (j == other.containers.size() || (i < containers.size() && containers[i].key < other.containers[j].key))
+            result.push_back(std::move(containers[i++]));
+        else if (i == containers.size() || other.containers[j].key < containers[i].key)
+            result.push_back(other.containers[j++]);
+        else
+            result.push_back(unite(containers[i++], other.containers[j++]));
+    }
+
+    containers.swap(result);
+    return *this;
+}
+
+RowBitmap& RowBitmap::operator-= (const RowBitmap& other)
+{
+    std::vector<Container> result;
+    size_t j = 0;
+
+    for (auto& a : containers)
+    {
+        while (j < other.containers.size() && other.containers[j].key < a.key)
+            ++j;
+
+        if (j < other.containers.size() && other.containers[j].key == a.key)
+        {
+            auto c = subtract(a, other.containers[j]);
+            if (c.cardinality > 0)
+                result.push_back(std::move(c));
+        }
+        else
+        {
+            result.push_back(std::move(a));
+        }
+    }
+
+    containers.swap(result);
+    return *this;
+}
+
+//==============================================================================
+std::vector<LibraryRow> RowBitmap::toVector() const
+{
+    std::vector<LibraryRow> rows;
+    rows.reserve(size());
+    forEach([&rows](LibraryRow row) { rows.push_back(row); });
+    return rows;
+}
+
+RowBitmap RowBitmap::fromSortedRows(const std::vector<LibraryRow>& rows)
+{
+    RowBitmap bitmap;
+
+    for (size_t i = 0; i < rows.size();)
+    {
+        Container c;
+        c.key = (juce::uint16)(rows[i] >> 16);
+
+        size_t end = i;
+        while (end < rows.size() && (juce::uint16)(rows[end] >> 16) == c.key)
+            ++end;
+
+        c.values.reserve(end - i);
+        for (size_t k = i; k < end; ++k)
+            if (c.values.empty() || c.values.back() != (juce::uint16)(rows[k] & 0xffff))
+                c.values.push_back((juce::uint16)(rows[k] & 0xffff));
+
+        c.cardinality = (juce::uint32)c.values.size();
+        if (c.cardinality > maxArraySize)
+            c.toBitmap();
+
+        bitmap.containers.push_back(std::move(c));
+        i = end;
+    }
+
+    return bitmap;
+}
+
+RowBitmap RowBitmap::fromWords(const std::vector<juce::uint64>& words)
+{
+    RowBitmap bitmap;
+
+    for (size_t first = 0; first < words.size(); first += wordsPerBitmap)
+    {
+        auto last = juce::jmin(words.size(), first + wordsPerBitmap);
+
+        Container c;
+        c.key = (juce::uint16)(first / wordsPerBitmap);
+
+        for (size_t w = first; w < last; ++w)
+            c.cardinality += (juce::uint32)juce::countNumberOfBits(words[w]);
+
+        if (c.cardinality == 0)
+            continue;
+
+        c.bits.assign(wordsPerBitmap, 0);
+        std::copy(words.begin() + (std::ptrdiff_t)first, words.begin() + (std::ptrdiff_t)last, c.bits.begin());
+        c.toArrayIfSparse();
+
+        bitmap.containers.push_back(std::move(c));
+    }
+
+    return bitmap;
+}
\ No newline at end of file
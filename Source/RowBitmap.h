@@ -0,0 +1,94 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LibraryTypes.h"
+
+//==============================================================================
+/**
+    Compressed set of library rows in the style of a roaring bitmap.
+
+    Rows are split by their upper 16 bits into containers. A container holds a
+    sorted array of the lower 16 bits while it is sparse and switches to a plain
+    65536-bit bitmap once it passes 4096 entries, so both sparse and dense sets
+    stay small and set operations run container by container.
+*/
+class RowBitmap
+{
+public:
+    RowBitmap() = default;
+
+    void add(LibraryRow row);
+    void remove(LibraryRow row);
+    bool contains(LibraryRow row) const noexcept;
+    void clear() noexcept                           { containers.clear(); }
+
+    bool isEmpty() const noexcept                   { return containers.empty(); }
+    size_t size() const noexcept;
+
+    RowBitmap& operator&= (const RowBitmap& other);
+    RowBitmap& operator|= (const RowBitmap& other);
+    RowBitmap& operator-= (const RowBitmap& other);
+
+    friend RowBitmap operator& (RowBitmap a, const RowBitmap& b)   { return a &= b; }
+    friend RowBitmap operator| (RowBitmap a, const RowBitmap& b)   { return a |= b; }
+    friend RowBitmap operator- (RowBitmap a, const RowBitmap& b)   { return a -= b; }
+
+    bool operator== (const RowBitmap& other) const;
+    bool operator!= (const RowBitmap& other) const                 { return !operator== (other); }
+
+    // Calls fn(LibraryRow) for every row in ascending order
+    template <typename Fn>
+    void forEach(Fn&& fn) const
+    {
+        for (const auto& c : containers)
+        {
+            auto high = (LibraryRow)c.key << 16;
+
+            if (c.isBitmap())
+            {
+                for (size_t w = 0; w < c.bits.size(); ++w)
+                {
+                    for (auto word = c.bits[w]; word != 0; word &= word - 1)
+                        fn(high | (LibraryRow)(w * 64 + (size_t)findLowestSetBit(word)));
+                }
+            }
+            else
+            {
+                for (auto low : c.values)
+                    fn(high | low);
+            }
+        }
+    }
+
+    std::vector<LibraryRow> toVector() const;
+    static RowBitmap fromSortedRows(const std::vector<LibraryRow>& rows);
+    static RowBitmap fromWords(const std::vector<juce::uint64>& words);   // dense bitset, 64 rows per word
+
+private:
+    struct Container
+    {
+        juce::uint16 key = 0;
+        juce::uint32 cardinality = 0;
+        std::vector<juce::uint16> values;   // sorted, used while the container is sparse
+        std::vector<juce::uint64> bits;     // 1024 words once it is dense
+
+        bool isBitmap() const noexcept      { return !bits.empty(); }
+        bool contains(juce::uint16 low) const noexcept;
+        void toBitmap();
+        void toArrayIfSparse();
+    };
+
+    static constexpr size_t maxArraySize = 4096;
+    static constexpr size_t wordsPerBitmap = 1024;
+
+    Container* findContainer(juce::uint16 key) noexcept;
+    const Container* findContainer(juce::uint16 key) const noexcept;
+
+    static Container intersect(const Container& a, const Container& b);
+    static Container unite(const Container& a, const Container& b);
+    static Container subtract(const Container& a, const Container& b);
+
+    std::vector<Container> containers; // sorted by key
+
+    JUCE_LEAK_DETECTOR(RowBitmap)
+};
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "SmartPlaylists.h"
+
+//==============================================================================
+const SmartPlaylist* SmartPlaylists::get(int index) const noexcept
+{
+    return juce::isPositiveAndBelow(index, size()) ? playlists[(size_t)index].get() : nullptr;
+}
+
+void SmartPlaylists::populate(SmartPlaylist& playlist, const QueryRunner& run)
+{
+    auto query = playlist.query;
+
+    // Ordering only matters when it decides which rows make the window
+    if (!playlist.isWindowed())
+        query.sortKeys.clear();
+
+    auto rows = run(query);
+    std::sort(rows.begin(), rows.end());
+    playlist.members = RowBitmap::fromSortedRows(rows);
+}
+
+int SmartPlaylists::add(const juce::String& name, const juce::String& queryText, const QueryRunner& run)
+{
+    auto playlist = std::make_unique<SmartPlaylist>();
+    playlist->name = name;
+    playlist->queryText = queryText;
+    playlist->query = LibraryQuery::parse(queryText);
+    populate(*playlist, run);
+
+    playlists.push_back(std::move(playlist));
+    return size() - 1;
+}
+
+bool SmartPlaylists::edit(int index, const juce::String& name, const juce::String& queryText, const QueryRunner& run)
+{
+    if (!juce::isPositiveAndBelow(index, size()))
+        return false;
+
+    auto& playlist = *playlists[(size_t)index];
+    playlist.name = name;
+
+    if (playlist.queryText != queryText)
+    {
+        playlist.queryText = queryText;
+        playlist.query = LibraryQuery::parse(queryText);
+        populate(playlist, run);
+    }
+
+    return true;
+}
+
+bool SmartPlaylists::remove(int index)
+{
+    if (!juce::isPositiveAndBelow(index, size()))
+        return false;
+
+    playlists.erase(playlists.begin() + index);
+    return true;
+}
+
+void SmartPlaylists::apply(const LibraryDelta& delta, const RecordingLookup& lookup, const QueryRunner& run)
+{
+    for (auto& playlist : playlists)
+    {
+        if (playlist->isWindowed())
+        {
+            populate(*playlist, run);
+            continue;
+        }
+
+        auto& members = playlist->members;
+
+        for (auto handle : delta.removed)
+            members.remove(handle.row);
+
+        auto test = [&playlist, &members, &lookup](RecordingHandle handle)
+        {
+            auto* recording = lookup(handle.row);
+
+            if (recording != nullptr && playlist->query.matches(*recording))
+                members.add(handle.row);
+            else
+                members.remove(handle.row);
+        };
+
+        for (auto handle : delta.inserted)
+            test(handle);
+
+        for (const auto& update : delta.updated)
+            test(update.handle);
+    }
+}
+
+bool SmartPlaylists::refreshRelativeDates(const QueryRunner& run)
+{
+    bool anyRefreshed = false;
+
+    for (auto& playlist : playlists)
+    {
+        if (!playlist->query.relativeToNow)
+            continue;
+
+        playlist->query = LibraryQuery::parse(playlist->queryText);
+        populate(*playlist, run);
+        anyRefreshed = true;
+    }
+
+    return anyRefreshed;
+}
+
+//==============================================================================
+std::vector<SmartPlaylist> SmartPlaylists::getCopies() const
+{
+    std::vector<SmartPlaylist> copies;
+    copies.reserve(playlists.size());
+
+    for (const auto& playlist : playlists)
+        copies.push_back(*playlist);
+
+    return copies;
+}
+
+juce::ValueTree SmartPlaylists::toValueTree(const std::vector<SmartPlaylist>& copies, const RecordingLookup& lookup)
+{
+    juce::ValueTree tree("SMART_PLAYLISTS");
+
+    for (const auto& playlist : copies)
+    {
+        juce::StringArray uids;
+        playlist.members.forEach([&uids, &lookup](LibraryRow row)
+        {
+            if (auto* recording = lookup(row))
+                uids.add(recording->uid);
+        });
+
+        juce::ValueTree playlistTree("SMART_PLAYLIST");
+        playlistTree.setProperty("name", playlist.name, nullptr);
+        playlistTree.setProperty("query", playlist.queryText, nullptr);
+        playlistTree.setProperty("members", uids.joinIntoString("\n"), nullptr);
+        tree.addChild(playlistTree, -1, nullptr);
+    }
+
+    return tree;
+}
+
+void SmartPlaylists::restore(const juce::ValueTree& tree, const std::function<LibraryRow (const juce::String&)>& findRow,
+                             const QueryRunner& run)
+{
+    playlists.clear();
+
+    for (auto playlistTree : tree)
+    {
+        if (!playlistTree.hasType("SMART_PLAYLIST"))
+            continue;
+
+        auto playlist = std::make_unique<SmartPlaylist>();
+        playlist->name = playlistTree["name"].toString();
+        playlist->queryText = playlistTree["query"].toString();
+        playlist->query = LibraryQuery::parse(playlist->queryText);
+
+        // Saved membership saves running the query at startup; recordings that
+        // weren't reloaded simply no longer resolve. It's out of date for
+        // relative dates, which have moved on since it was saved
+        if (playlistTree.hasProperty("members") && !playlist->isWindowed() && !playlist->query.relativeToNow)
+        {
+            std::vector<LibraryRow> rows;
+
+            for (const auto& uid : juce::StringArray::fromLines(playlistTree["members"].toString()))
+            {
+                auto row = findRow(uid);
+                if (row != invalidLibraryRow)
+                    rows.push_back(row);
+            }
+
+            std::sort(rows.begin(), rows.end());
+            playlist->members = RowBitmap::fromSortedRows(rows);
+        }
+        else
+        {
+            populate(*playlist, run);
+        }
+
+        playlists.push_back(std::move(playlist));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioRecorder.h"
+#include "LibraryTypes.h"
+#include "LibraryQuery.h"
+
+//==============================================================================
+// A named, saved library query together with its current members
+struct SmartPlaylist
+{
+    juce::String name;
+    juce::String queryText;
+    LibraryQuery query;
+    RowBitmap members;
+
+    // Membership of a limit/offset window depends on every other recording
+    bool isWindowed() const noexcept    { return query.limit >= 0 || query.offset > 0; }
+};
+
+//==============================================================================
+/**
+    The library's smart playlists, maintained as materialized views.
+
+    Queries aren't re-run when the library changes: each recording in a
+    LibraryDelta is tested once against each playlist's predicate and added
+    to or dropped from its member set. A full query only runs when a playlist
+    is created or edited, or for windowed playlists ("limit:100 sort:-date")
+    whose membership can shift without their own members changing. Queries
+    with relative dates ("date>-30d") are re-parsed and re-run when loaded
+    and once a day, since recordings age out of them without changing.
+*/
+class SmartPlaylists
+{
+public:
+    using RecordingLookup = std::function<const Recording* (LibraryRow)>;
+    using QueryRunner = std::function<std::vector<LibraryRow> (const LibraryQuery&)>;
+
+    SmartPlaylists() = default;
+
+    int size() const noexcept                           { return (int)playlists.size(); }
+    const SmartPlaylist* get(int index) const noexcept;
+
+    int add(const juce::String& name, const juce::String& queryText, const QueryRunner& run);
+    bool edit(int index, const juce::String& name, const juce::String& queryText, const QueryRunner& run);
+    bool remove(int index);
+    void clear()                                        { playlists.clear(); }
+
+    void apply(const LibraryDelta& delta, const RecordingLookup& lookup, const QueryRunner& run);
+
+    // Resolves relative dates against the current time again; returns true if any playlist had them
+    bool refreshRelativeDates(const QueryRunner& run);
+
+    // Members are stored by uid, since rows are only valid for one session. Copies
+    // let the playlists be serialised off the message thread against a snapshot
+    std::vector<SmartPlaylist> getCopies() const;
+    static juce::ValueTree toValueTree(const std::vector<SmartPlaylist>& copies, const RecordingLookup& lookup);
+    void restore(const juce::ValueTree& tree, const std::function<LibraryRow (const juce::String&)>& findRow,
+                 const QueryRunner& run);
+
+private:
+    static void populate(SmartPlaylist& playlist, const QueryRunner& run);
+
+    std::vector<std::unique_ptr<SmartPlaylist>> playlists;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SmartPlaylists)
+};
\ No newline at end of file
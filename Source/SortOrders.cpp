@@ -0,0 +1,101 @@
+#include "SortOrders.h"
+#include "LibraryQuery.h"
+
+//==============================================================================
+void SortOrders::add(LibraryRow row)
+{
+    for (auto& order : orders)
+        if (order != nullptr)
+            order->pending.push_back(row);
+}
+
+void SortOrders::update(LibraryRow row, int changedFields)
+{
+    for (size_t i = 0; i < orders.size(); ++i)
+    {
+        auto& order = orders[i];
+
+        if (order != nullptr && (changedFields & LibraryQuery::getDeltaField((LibrarySortField)i)) != 0)
+        {
+            order->stale.add(row);
+            order->pending.push_back(row);
+        }
+    }
+}
+
+void SortOrders::remove(LibraryRow row)
+{
+    // A row that is still pending is dropped by the merge once it no longer resolves
+    for (auto& order : orders)
+        if (order != nullptr)
+            order->stale.add(row);
+}
+
+void SortOrders::clear()
+{
+    for (auto& order : orders)
+        order.reset();
+}
+
+SortOrders::OrderPtr SortOrders::getOrder(LibrarySortField field, const RowBitmap& liveRows,
+                                          const RecordingLookup& lookup) const
+{
+    // Patches the cache below; the OrderPtr it returns is what other threads get to see
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    auto& order = orders[(size_t)field];
+
+    auto less = [field, &lookup](LibraryRow a, LibraryRow b)
+    {
+        auto* ra = lookup(a);
+        auto* rb = lookup(b);
+
+        if (ra != nullptr && rb != nullptr)
+        {
+            auto c = LibraryQuery::compare(*ra, *rb, field);
+            if (c != 0)
+                return c < 0;
+        }
+
+        return a < b;
+    };
+
+    if (order == nullptr)
+    {
+        order = std::make_unique<Order>();
+        order->rows = std::make_shared<std::vector<LibraryRow>>(liveRows.toVector());
+        std::sort(order->rows->begin(), order->rows->end(), less);
+        return order->rows;
+    }
+
+    auto& pending = order->pending;
+
+    if ((!order->stale.isEmpty() || !pending.empty()) && order->rows.use_count() > 1)
+        order->rows = std::make_shared<std::vector<LibraryRow>>(*order->rows);
+
+    auto& rows = *order->rows;
+
+    if (!order->stale.isEmpty())
+    {
+        auto& stale = order->stale;
+        rows.erase(std::remove_if(rows.begin(), rows.end(), [&stale](LibraryRow row) { return stale.contains(row); }),
+                   rows.end());
+        stale.clear();
+    }
+
+    if (!pending.empty())
+    {
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [&liveRows](LibraryRow row) { return !liveRows.contains(row); }),
+                      pending.end());
+
+        std::sort(pending.begin(), pending.end(), less);
+        pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+
+        auto middle = (std::ptrdiff_t)rows.size();
+        rows.insert(rows.end(), pending.begin(), pending.end());
+        std::inplace_merge(rows.begin(), rows.begin() + middle, rows.end(), less);
+        pending.clear();
+    }
+
+    return order->rows;
+}
\ No newline at end of file
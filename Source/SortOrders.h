@@ -0,0 +1,50 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioRecorder.h"
+#include "LibraryTypes.h"
+#include "RowBitmap.h"
+
+//==============================================================================
+/**
+    Cached sort permutations of the library, one per sort field.
+
+    An order is built the first time a query sorts by its field and from then
+    on is patched rather than re-sorted: rows that are added, or whose field
+    changes, are queued and merged in the next time the order is used, so
+    only the queued rows are sorted and stale entries drop out in the same
+    linear pass. An order that's still held elsewhere is copied before it is
+    patched, so a search thread can keep using the one it was given.
+
+    Like the rest of LibraryIndexes, it belongs to the message thread. That
+    includes getOrder(): it's const for the queries that call it, but builds
+    and patches the cached orders without a lock.
+*/
+class SortOrders
+{
+public:
+    using RecordingLookup = std::function<const Recording* (LibraryRow)>;
+
+    void add(LibraryRow row);
+    void update(LibraryRow row, int changedFields);     // LibraryDelta field bits
+    void remove(LibraryRow row);
+    void clear();
+
+    bool hasOrder(LibrarySortField field) const noexcept    { return orders[(size_t)field] != nullptr; }
+
+    using OrderPtr = std::shared_ptr<const std::vector<LibraryRow>>;
+
+    // Every live row in ascending order of the field, ties in row order. Message thread only.
+    OrderPtr getOrder(LibrarySortField field, const RowBitmap& liveRows, const RecordingLookup& lookup) const;
+
+private:
+    struct Order
+    {
+        std::shared_ptr<std::vector<LibraryRow>> rows;
+        std::vector<LibraryRow> pending;    // added or moved since the last merge
+        RowBitmap stale;                    // entries in rows that have to go
+    };
+
+    // Built on demand by queries, which are const
+    mutable std::array<std::unique_ptr<Order>, (size_t)numLibrarySortFields> orders;
+};
\ No newline at end of file
@@ -0,0 +1,548 @@
+#include "SparklineStore.h"
+
+namespace
+{
+    constexpr int storeMagic = 0x324c5343;     // "CSL2"
+    constexpr int storeVersion = 2;
+}
+
+SparklineStore::SparklineStore()
+    : juce::Thread("Sparkline Builder")
+{
+    storeFile = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                    .getChildFile("CapSure")
+                    .getChildFile("Sparklines.dat");
+
+    formatManager.registerBasicFormats();
+    startThread(juce::Thread::Priority::low);
+}
+
+SparklineStore::~SparklineStore()
+{
+    cancelPendingUpdate();
+    stopThread(5000);
+
+    // The builder has stopped, so this is the only thread left using the store
+    compact(true);
+}
+
+//==============================================================================
+bool SparklineStore::get(const juce::File& audioFile, juce::int64 fileSize, Sparkline& points)
+{
+    auto key = getKey(audioFile.getFullPathName());
+    bool found = false, queuedFile = false;
+
+    {
+        std::lock_guard<std::mutex> sl(lock);
+
+        auto isChecked = checked.count(key) > 0;
+        auto cached = cache.find(key);
+
+        // Once the builder has looked at the file itself, its stamps win over the library's
+        if (cached != cache.end() && (isChecked || fileSize <= 0 || cached->second.size == fileSize))
+        {
+            points = cached->second.points;
+            cached->second.lastUsed = ++useCounter;
+            found = true;
+        }
+
+        // Unchecked files are looked at, and sparklines dropped from the cache read back
+        if (!isChecked || (!found && index.count(key) > 0))
+            queuedFile = enqueue(audioFile, key);
+    }
+
+    if (queuedFile)
+        notify();
+
+    return found;
+}
+
+void SparklineStore::invalidate(const std::vector<juce::File>& audioFiles)
+{
+    std::lock_guard<std::mutex> sl(lock);
+
+    for (const auto& file : audioFiles)
+        checked.erase(getKey(file.getFullPathName()));
+}
+
+void SparklineStore::setLibrary(LibrarySnapshot::Ptr snapshot)
+{
+    std::lock_guard<std::mutex> sl(lock);
+    library = std::move(snapshot);
+}
+
+void SparklineStore::draw(juce::Graphics& g, const Sparkline& points, juce::Rectangle<float> area)
+{
+    auto width = (int)area.getWidth();
+    if (width <= 0 || area.getHeight() <= 0.0f)
+        return;
+
+    juce::RectangleList<float> bars;
+    auto centre = area.getCentreY();
+
+    for (int x = 0; x < width; ++x)
+    {
+        auto first = x * numPoints / width;
+        auto last = juce::jmax(first + 1, (x + 1) * numPoints / width);
+        juce::uint8 peak = 0;
+
+        for (int i = first; i < last; ++i)
+            peak = juce::jmax(peak, points[(size_t)i]);
+
+        auto height = juce::jmax(1.0f, area.getHeight() * (float)peak / 255.0f);
+        bars.addWithoutMerging({ area.getX() + (float)x, centre - height * 0.5f, 1.0f, height });
+    }
+
+    g.fillRectList(bars);
+}
+
+void SparklineStore::handleAsyncUpdate()
+{
+    if (onSparklinesReady != nullptr)
+        onSparklinesReady();
+}
+
+bool SparklineStore::enqueue(const juce::File& audioFile, juce::uint64 key)
+{
+    if (!queued.insert(key).second)
+        return false;
+
+    // Most recently painted first, so scrolling fast doesn't leave the new rows
+    // waiting; rows scrolled past long ago fall off the end
+    queue.push_front(audioFile);
+
+    while (queue.size() > maxQueued)
+    {
+        queued.erase(getKey(queue.back().getFullPathName()));
+        queue.pop_back();
+    }
+
+    return true;
+}
+
+void SparklineStore::addToCache(juce::uint64 key, juce::int64 size, const Sparkline& points)
+{
+    auto& cached = cache[key];
+    cached.size = size;
+    cached.points = points;
+    cached.lastUsed = ++useCounter;
+
+    if (cache.size() <= maxCached)
+        return;
+
+    // Least recently drawn quarter at a time, so eviction isn't a scan per sparkline
+    std::vector<std::pair<juce::uint64, juce::uint64>> byUse;
+    byUse.reserve(cache.size());
+
+    for (const auto& entry : cache)
+        byUse.emplace_back(entry.second.lastUsed, entry.first);
+
+    auto toEvict = byUse.begin() + (std::ptrdiff_t)(cache.size() / 4);
+    std::nth_element(byUse.begin(), toEvict, byUse.end());
+
+    for (auto it = byUse.begin(); it != toEvict; ++it)
+        cache.erase(it->second);
+}
+
+//==============================================================================
+void SparklineStore::run()
+{
+    load();
+
+    while (!threadShouldExit())
+    {
+        juce::File file;
+
+        {
+            std::lock_guard<std::mutex> sl(lock);
+
+            if (!queue.empty())
+            {
+                file = queue.front();
+                queue.pop_front();
+                queued.erase(getKey(file.getFullPathName()));
+            }
+        }
+
+        if (file == juce::File())
+        {
+            wait(-1);
+            continue;
+        }
+
+        check(file);
+
+        if (garbage >= juce::jmax(minWasteToCompact, (juce::int64)index.size() / 4))
+            compact(false);
+    }
+}
+
+void SparklineStore::check(const juce::File& audioFile)
+{
+    const auto& path = audioFile.getFullPathName();
+    auto key = getKey(path);
+    Entry entry;
+    bool known, upToDate;
+
+    {
+        std::lock_guard<std::mutex> sl(lock);
+
+        auto isChecked = checked.count(key) > 0;
+        auto it = index.find(key);
+        known = it != index.end();
+
+        // Already drawable, or found unreadable earlier this session
+        if (isChecked && (cache.count(key) > 0 || !known))
+            return;
+
+        if (known)
+            entry = it->second;
+
+        upToDate = known && isChecked;
+    }
+
+    auto size = audioFile.getSize();
+    auto modified = audioFile.getLastModificationTime().toMilliseconds();
+
+    if (known && !upToDate)
+        upToDate = entry.size == size && entry.modified == modified;
+
+    Sparkline points;
+
+    if (upToDate && readPoints(entry, path, points))
+    {
+        {
+            std::lock_guard<std::mutex> sl(lock);
+            checked.insert(key);
+            addToCache(key, entry.size, points);
+        }
+
+        triggerAsyncUpdate();
+        return;
+    }
+
+    Entry built;
+    built.size = size;
+    built.modified = modified;
+    auto isBuilt = build(audioFile, points);
+
+    if (threadShouldExit())
+        return;
+
+    // A sparkline that couldn't be written is still drawn this session, and built again next time
+    if (isBuilt)
+        append(path, built, points);
+
+    {
+        std::lock_guard<std::mutex> sl(lock);
+        checked.insert(key);
+
+        if (isBuilt)
+        {
+            index[key] = built;
+            addToCache(key, built.size, points);
+        }
+        else
+        {
+            index.erase(key);
+            cache.erase(key);
+        }
+    }
+
+    // Its old record is now dead weight in the file
+    if (known && entry.position >= 0)
+        ++garbage;
+
+    if (isBuilt)
+        triggerAsyncUpdate();
+}
+
+bool SparklineStore::build(const juce::File& audioFile, Sparkline& points)
+{
+    // A single pass that nothing else will reuse, so it reads the file directly
+    // rather than filling the decoded block cache
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(audioFile));
+
+    if (reader == nullptr || reader->lengthInSamples <= 0 || reader->numChannels == 0)
+        return false;
+
+    constexpr int blockSize = 1 << 16;
+    auto length = reader->lengthInSamples;
+    juce::AudioBuffer<float> buffer((int)reader->numChannels, blockSize);
+    std::array<float, numPoints> peaks {};
+
+    for (juce::int64 position = 0; position < length; position += blockSize)
+    {
+        if (threadShouldExit())
+            return false;
+
+        auto numToRead = (int)juce::jmin((juce::int64)blockSize, length - position);
+
+        if (!reader->read(&buffer, 0, numToRead, position, true, true))
+            return false;
+
+        for (int offset = 0; offset < numToRead;)
+        {
+            // Point p covers the samples s for which s * numPoints / length == p
+            auto point = (int)((position + offset) * numPoints / length);
+            auto pointEnd = ((juce::int64)(point + 1) * length + numPoints - 1) / numPoints;
+            auto count = (int)juce::jmin((juce::int64)(numToRead - offset), pointEnd - (position + offset));
+
+            for (int c = 0; c < buffer.getNumChannels(); ++c)
+            {
+                auto range = juce::FloatVectorOperations::findMinAndMax(buffer.getReadPointer(c, offset), count);
+                peaks[(size_t)point] = juce::jmax(peaks[(size_t)point], -range.getStart(), range.getEnd());
+            }
+
+            offset += count;
+        }
+    }
+
+    for (size_t i = 0; i < points.size(); ++i)
+        points[i] = (juce::uint8)juce::jlimit(0, 255, juce::roundToInt(peaks[i] * 255.0f));
+
+    return true;
+}
+
+//==============================================================================
+void SparklineStore::load()
+{
+    std::unordered_map<juce::uint64, Entry> entries;
+    juce::int64 validLength = 0, superseded = 0;
+
+    {
+        juce::FileInputStream file(storeFile);
+
+        if (file.openedOk())
+        {
+            juce::BufferedInputStream records(file, 1 << 16);
+            auto length = records.getTotalLength();
+
+            if (records.readInt() == storeMagic && records.readInt() == storeVersion)
+            {
+                validLength = records.getPosition();
+
+                // Later records for a path replace earlier ones; one cut short by a crash ends the store
+                while (validLength < length)
+                {
+                    if (threadShouldExit())
+                        return;
+
+                    Entry entry;
+                    entry.position = validLength;
+                    auto path = records.readString();
+                    entry.size = records.readInt64();
+                    entry.modified = records.readInt64();
+
+                    if (records.getPosition() + numPoints > length)
+                        break;
+
+                    records.skipNextBytes(numPoints);
+                    validLength = records.getPosition();
+
+                    if (!entries.insert_or_assign(getKey(path), entry).second)
+                        ++superseded;
+                }
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> sl(lock);
+
+        // Nothing is built before the index is loaded, so there's nothing to keep
+        index = std::move(entries);
+    }
+
+    garbage = superseded;
+    loaded = true;
+    openOutput(validLength);
+}
+
+void SparklineStore::openOutput(juce::int64 validLength)
+{
+    storeFile.getParentDirectory().createDirectory();
+    output = std::make_unique<juce::FileOutputStream>(storeFile, 1 << 14);
+
+    if (!output->openedOk())
+    {
+        output.reset();
+        return;
+    }
+
+    // Drops a torn last record, or a store in an older format
+    output->setPosition(validLength);
+    output->truncate();
+
+    if (validLength == 0)
+    {
+        output->writeInt(storeMagic);
+        output->writeInt(storeVersion);
+    }
+
+    output->flush();
+}
+
+bool SparklineStore::append(const juce::String& path, Entry& entry, const Sparkline& points)
+{
+    if (output == nullptr)
+        return false;
+
+    auto position = output->getPosition();
+    output->writeString(path);
+    output->writeInt64(entry.size);
+    output->writeInt64(entry.modified);
+    output->write(points.data(), numPoints);
+
+    // Flushed per record so that readPoints() can find it
+    output->flush();
+
+    if (output->getStatus().failed())
+    {
+        // Leaves at most one torn record at the end, which load() drops
+        output.reset();
+        return false;
+    }
+
+    entry.position = position;
+    return true;
+}
+
+bool SparklineStore::readPoints(const Entry& entry, const juce::String& path, Sparkline& points)
+{
+    if (entry.position < 0)
+        return false;
+
+    if (input == nullptr)
+    {
+        input = std::make_unique<juce::FileInputStream>(storeFile);
+
+        if (!input->openedOk())
+        {
+            input.reset();
+            return false;
+        }
+    }
+
+    if (!input->setPosition(entry.position))
+        return false;
+
+    // One read for the whole record, rather than one per field
+    juce::BufferedInputStream record(*input, 1024);
+
+    if (record.readString() != path)
+        return false;
+
+    record.readInt64();
+    record.readInt64();
+    return record.read(points.data(), numPoints) == numPoints;
+}
+
+void SparklineStore::compact(bool shuttingDown)
+{
+    // A store that was never fully loaded would lose everything past where loading stopped
+    if (!loaded)
+        return;
+
+    std::vector<std::pair<juce::uint64, Entry>> entries;
+    LibrarySnapshot::Ptr snapshot;
+
+    {
+        std::lock_guard<std::mutex> sl(lock);
+        entries.assign(index.begin(), index.end());
+        snapshot = library;
+    }
+
+    std::unordered_set<juce::uint64> wanted;
+
+    if (snapshot != nullptr)
+    {
+        wanted.reserve((size_t)snapshot->getNumRecordings());
+        snapshot->forEach([&wanted](RecordingHandle, const Recording& recording)
+        {
+            wanted.insert(getKey(recording.file.getFullPathName()));
+        });
+    }
+
+    // Files that have left the library, and sparklines that never made it to the file
+    auto dropped = std::remove_if(entries.begin(), entries.end(), [&](const auto& entry)
+    {
+        return entry.second.position < 0 || (snapshot != nullptr && wanted.count(entry.first) == 0);
+    });
+
+    auto waste = garbage + (juce::int64)(entries.end() - dropped);
+    entries.erase(dropped, entries.end());
+
+    auto threshold = shuttingDown ? minWasteToCompact
+                                  : juce::jmax(minWasteToCompact, (juce::int64)entries.size() / 4);
+
+    if (waste < threshold)
+        return;
+
+    // In file order, so the old store is read from front to back
+    std::sort(entries.begin(), entries.end(),
+              [](const auto& a, const auto& b) { return a.second.position < b.second.position; });
+
+    input.reset();
+    output.reset();
+
+    std::unordered_map<juce::uint64, Entry> compacted;
+    compacted.reserve(entries.size());
+    juce::TemporaryFile temp(storeFile);
+    bool written = false;
+
+    {
+        juce::FileInputStream oldStore(storeFile);
+        juce::FileOutputStream newStore(temp.getFile(), 1 << 16);
+
+        if (oldStore.openedOk() && newStore.openedOk())
+        {
+            juce::BufferedInputStream records(oldStore, 1 << 16);
+            Sparkline points;
+
+            newStore.writeInt(storeMagic);
+            newStore.writeInt(storeVersion);
+
+            for (auto& entry : entries)
+            {
+                // Only the builder is asked to stop; the last compaction runs after it has
+                if (!shuttingDown && threadShouldExit())
+                    break;
+
+                records.setPosition(entry.second.position);
+                auto path = records.readString();
+                records.readInt64();
+                records.readInt64();
+
+                if (getKey(path) != entry.first || records.read(points.data(), numPoints) != numPoints)
+                    continue;
+
+                entry.second.position = newStore.getPosition();
+                newStore.writeString(path);
+                newStore.writeInt64(entry.second.size);
+                newStore.writeInt64(entry.second.modified);
+                newStore.write(points.data(), numPoints);
+                compacted.insert(entry);
+            }
+
+            newStore.flush();
+            written = !newStore.getStatus().failed() && (shuttingDown || !threadShouldExit());
+        }
+    }
+
+    if (written && temp.overwriteTargetFileWithTemporary())
+    {
+        std::lock_guard<std::mutex> sl(lock);
+
+        // Anything dropped is looked at again if it's ever drawn
+        for (const auto& entry : index)
+            if (compacted.count(entry.first) == 0)
+                checked.erase(entry.first);
+
+        index = std::move(compacted);
+        garbage = 0;
+    }
+
+    if (!shuttingDown)
+        openOutput(storeFile.getSize());
+}
\ No newline at end of file
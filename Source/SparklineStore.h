@@ -0,0 +1,106 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LibrarySnapshot.h"
+
+//==============================================================================
+/**
+    A tiny waveform outline per audio file, for drawing in table rows.
+
+    Each sparkline is numPoints bytes, the peak level over successive equal
+    stretches of the file. They're appended to one file in the app data folder
+    as they're built, each with the size and modification time it came from,
+    and only an index of that file stays in memory: the points are read back
+    when a row is drawn and kept in a cache of the most recently drawn few.
+    Superseded records, and those for files the library no longer has, stay
+    in the file until they make up a good part of it or the store is shut
+    down, when it's rewritten without them.
+
+    Nothing is queued up front. A low-priority thread works through the files
+    get() couldn't answer for, most recently drawn first, checking each
+    against the stamps it was built from and decoding only those that are new
+    or changed.
+*/
+class SparklineStore : private juce::Thread,
+                       private juce::AsyncUpdater
+{
+public:
+    static constexpr int numPoints = 256;
+    using Sparkline = std::array<juce::uint8, numPoints>;
+
+    SparklineStore();
+    ~SparklineStore() override;
+
+    /** Copies the file's sparkline into points and returns true if there is
+        one that's still good. Until the file has been checked this session,
+        one built from a file of a different size than fileSize isn't. Files
+        without one are queued ahead of everything else. Never touches the
+        disk, so it's cheap enough for paintCell.
+    */
+    bool get(const juce::File& audioFile, juce::int64 fileSize, Sparkline& points);
+
+    // Files that may have changed on disk, to be checked again the next time they're drawn
+    void invalidate(const std::vector<juce::File>& audioFiles);
+
+    // The files worth keeping sparklines for; the others are dropped when the store is compacted
+    void setLibrary(LibrarySnapshot::Ptr snapshot);
+
+    static void draw(juce::Graphics& g, const Sparkline& points, juce::Rectangle<float> area);
+
+    // Called on the message thread when new sparklines are ready
+    std::function<void()> onSparklinesReady;
+
+private:
+    struct Entry
+    {
+        juce::int64 size = 0, modified = 0;
+        juce::int64 position = -1;      // of its record in storeFile, or -1 if it couldn't be written
+    };
+
+    struct Cached
+    {
+        juce::int64 size = 0;
+        Sparkline points {};
+        juce::uint64 lastUsed = 0;
+    };
+
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    void check(const juce::File& audioFile);
+    bool build(const juce::File& audioFile, Sparkline& points);
+    bool enqueue(const juce::File& audioFile, juce::uint64 key);
+    void addToCache(juce::uint64 key, juce::int64 size, const Sparkline& points);
+
+    void load();
+    void openOutput(juce::int64 validLength);
+    bool append(const juce::String& path, Entry& entry, const Sparkline& points);
+    bool readPoints(const Entry& entry, const juce::String& path, Sparkline& points);
+    void compact(bool shuttingDown);
+
+    static juce::uint64 getKey(const juce::String& path) noexcept    { return (juce::uint64)path.hashCode64(); }
+
+    juce::File storeFile;
+
+    std::mutex lock;
+    std::unordered_map<juce::uint64, Entry> index;       // by path key
+    std::unordered_map<juce::uint64, Cached> cache;
+    std::unordered_set<juce::uint64> checked;            // up to date, or unreadable, this session
+    std::deque<juce::File> queue;
+    std::unordered_set<juce::uint64> queued;
+    LibrarySnapshot::Ptr library;
+    juce::uint64 useCounter = 0;
+
+    // Builder thread only, and the destructor once it has stopped
+    juce::AudioFormatManager formatManager;
+    std::unique_ptr<juce::FileInputStream> input;
+    std::unique_ptr<juce::FileOutputStream> output;
+    juce::int64 garbage = 0;        // records in storeFile that no entry points at
+    bool loaded = false;
+
+    static constexpr size_t maxCached = 8192;
+    static constexpr size_t maxQueued = 512;
+    static constexpr juce::int64 minWasteToCompact = 256;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SparklineStore)
+};
\ No newline at end of file
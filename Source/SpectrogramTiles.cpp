@@ -0,0 +1,447 @@
+#include "SpectrogramTiles.h"
+
+namespace
+{
+    constexpr int tileMagic = 0x31505343;   // "CSP1"
+    constexpr int tileVersion = 1;
+    constexpr int settingsMagic = 0x53535343;   // "CSSS"
+    constexpr int settingsVersion = 1;
+
+    // Levels are stored as 0..255 over this many dB below full scale
+    constexpr float dynamicRangeDb = 120.0f;
+
+    const std::array<juce::PixelARGB, 256>& getColourMap()
+    {
+        static const auto map = []
+        {
+            juce::ColourGradient gradient(juce::Colour(0xff000004), 0.0f, 0.0f, juce::Colour(0xfffcffa4), 1.0f, 0.0f, false);
+            gradient.addColour(0.25, juce::Colour(0xff420a68));
+            gradient.addColour(0.5, juce::Colour(0xff932667));
+            gradient.addColour(0.75, juce::Colour(0xffdd513a));
+            gradient.addColour(0.9, juce::Colour(0xfffca50a));
+
+            std::array<juce::PixelARGB, 256> colours;
+            for (size_t i = 0; i < colours.size(); ++i)
+                colours[i] = gradient.getColourAtPosition((double)i / 255.0).getPixelARGB();
+
+            return colours;
+        }();
+
+        return map;
+    }
+}
+
+//==============================================================================
+class SpectrogramTiles::TileWorker : public juce::ThreadPoolJob
+{
+public:
+    explicit TileWorker(SpectrogramTiles& owner) : ThreadPoolJob("Spectrogram tile"), tiles(owner)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        Job job;
+
+        while (!shouldExit() && tiles.dequeue(job))
+        {
+            auto image = compute(job);
+
+            // A tile cut short hasn't failed, and can be asked for again
+            if (shouldExit())
+            {
+                tiles.abandon(job);
+                break;
+            }
+
+            tiles.addResult({ job.key, std::move(image), job.generation });
+        }
+
+        return jobHasFinished;
+    }
+
+private:
+    juce::Image compute(const Job& job)
+    {
+        if (job.generation != sourceGeneration)
+        {
+            source = tiles.blockCache.open(job.file);
+            sourceGeneration = job.generation;
+        }
+
+        if (source == nullptr)
+            return {};
+
+        auto numBins = 1 << (job.key.fftOrder - 1);
+        std::vector<juce::uint8> levels((size_t)tileColumns * (size_t)numBins);
+
+        auto sourceSize = job.file.getSize();
+        auto sourceModified = job.file.getLastModificationTime().toMilliseconds();
+        auto cacheFile = tiles.isDiskCacheEnabled() ? tiles.getDiskCacheFile(job.file, sourceSize, sourceModified, job.key)
+                                                    : juce::File();
+
+        if (cacheFile != juce::File() && load(cacheFile, sourceSize, sourceModified, levels))
+        {
+            // Its modification time is when it was last used, for trimDiskCache()
+            cacheFile.setLastModificationTime(juce::Time::getCurrentTime());
+        }
+        else
+        {
+            if (!analyse(job.key, levels))
+                return {};
+
+            if (cacheFile != juce::File() && save(cacheFile, sourceSize, sourceModified, levels))
+                tiles.addedToDiskCache(cacheFile.getSize());
+        }
+
+        juce::Image image(juce::Image::RGB, tileColumns, numBins, false, juce::SoftwareImageType());
+        juce::Image::BitmapData pixels(image, juce::Image::BitmapData::writeOnly);
+        const auto& colours = getColourMap();
+
+        for (int y = 0; y < numBins; ++y)
+            for (int x = 0; x < tileColumns; ++x)
+                reinterpret_cast<juce::PixelRGB*>(pixels.getPixelPointer(x, y))->set(colours[levels[(size_t)(y * tileColumns + x)]]);
+
+        return image;
+    }
+
+    // Fills levels with one column per hop, the highest frequency in the first row
+    bool analyse(TileKey key, std::vector<juce::uint8>& levels)
+    {
+        auto fftSize = 1 << key.fftOrder;
+        auto numBins = fftSize / 2;
+
+        if (fft == nullptr || fft->getSize() != fftSize)
+        {
+            fft = std::make_unique<juce::dsp::FFT>(key.fftOrder);
+            window = std::make_unique<juce::dsp::WindowingFunction<float>>((size_t)fftSize, juce::dsp::WindowingFunction<float>::hann, false);
+            fftData.assign((size_t)fftSize * 2, 0.0f);
+            power.assign((size_t)numBins, 0.0f);
+        }
+
+        auto numChannels = source->getNumChannels();
+        frame.setSize(numChannels, fftSize, false, false, true);
+
+        auto hop = (juce::int64)1 << key.hopLog2;
+        auto framesPerColumn = (int)juce::jlimit((juce::int64)1, (juce::int64)8, hop / fftSize);
+
+        // A full-scale sine through a Hann window peaks at fftSize / 4
+        auto referenceDb = 20.0f * std::log10((float)fftSize / 4.0f);
+
+        for (int column = 0; column < tileColumns; ++column)
+        {
+            if (shouldExit())
+                return false;
+
+            auto columnStart = (key.index * tileColumns + column) * hop;
+            if (columnStart >= source->getLengthInSamples())
+                break;
+
+            juce::FloatVectorOperations::clear(power.data(), numBins);
+
+            for (int f = 0; f < framesPerColumn; ++f)
+            {
+                auto centre = columnStart + hop * (2 * f + 1) / (2 * framesPerColumn);
+                source->read(frame, 0, fftSize, centre - fftSize / 2);
+
+                // Mixed down to mono
+                juce::FloatVectorOperations::copy(fftData.data(), frame.getReadPointer(0), fftSize);
+                for (int c = 1; c < numChannels; ++c)
+                    juce::FloatVectorOperations::add(fftData.data(), frame.getReadPointer(c), fftSize);
+                if (numChannels > 1)
+                    juce::FloatVectorOperations::multiply(fftData.data(), 1.0f / (float)numChannels, fftSize);
+
+                window->multiplyWithWindowingTable(fftData.data(), (size_t)fftSize);
+                fft->performFrequencyOnlyForwardTransform(fftData.data(), true);
+
+                juce::FloatVectorOperations::multiply(fftData.data(), fftData.data(), numBins);
+                juce::FloatVectorOperations::add(power.data(), fftData.data(), numBins);
+            }
+
+            for (int bin = 0; bin < numBins; ++bin)
+            {
+                auto db = 10.0f * std::log10(power[(size_t)bin] / (float)framesPerColumn + 1.0e-20f) - referenceDb;
+                auto level = juce::jlimit(0, 255, juce::roundToInt((db + dynamicRangeDb) * 255.0f / dynamicRangeDb));
+                levels[(size_t)((numBins - 1 - bin) * tileColumns + column)] = (juce::uint8)level;
+            }
+        }
+
+        return true;
+    }
+
+    static bool load(const juce::File& cacheFile, juce::int64 sourceSize, juce::int64 sourceModified, std::vector<juce::uint8>& levels)
+    {
+        juce::FileInputStream input(cacheFile);
+        if (!input.openedOk())
+            return false;
+
+        if (input.readInt() != tileMagic || input.readInt() != tileVersion
+             || input.readInt64() != sourceSize || input.readInt64() != sourceModified
+             || input.readInt64() != (juce::int64)levels.size())
+            return false;
+
+        return (size_t)input.read(levels.data(), levels.size()) == levels.size();
+    }
+
+    static bool save(const juce::File& cacheFile, juce::int64 sourceSize, juce::int64 sourceModified, const std::vector<juce::uint8>& levels)
+    {
+        cacheFile.getParentDirectory().createDirectory();
+        juce::TemporaryFile temp(cacheFile);
+
+        {
+            juce::FileOutputStream output(temp.getFile());
+            if (!output.openedOk())
+                return false;
+
+            output.writeInt(tileMagic);
+            output.writeInt(tileVersion);
+            output.writeInt64(sourceSize);
+            output.writeInt64(sourceModified);
+            output.writeInt64((juce::int64)levels.size());
+            output.write(levels.data(), levels.size());
+
+            output.flush();
+            if (output.getStatus().failed())
+                return false;
+        }
+
+        return temp.overwriteTargetFileWithTemporary();
+    }
+
+    SpectrogramTiles& tiles;
+
+    std::unique_ptr<DecodedBlockCache::Source> source;
+    juce::uint32 sourceGeneration = 0;
+
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+    std::vector<float> fftData, power;
+    juce::AudioBuffer<float> frame;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TileWorker)
+};
+
+//==============================================================================
+SpectrogramTiles::SpectrogramTiles(DecodedBlockCache& cache)
+    : blockCache(cache),
+      workers(juce::jlimit(2, 8, juce::SystemStats::getNumCpus() - 1))
+{
+    diskCacheDirectory = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                            .getChildFile("CapSure")
+                            .getChildFile("Spectrograms");
+
+    settingsFile = diskCacheDirectory.getSiblingFile("spectrograms.dat");
+
+    juce::FileInputStream in(settingsFile);
+    if (in.openedOk() && in.readInt() == settingsMagic && in.readInt() == settingsVersion)
+        diskCacheEnabled = in.readBool();
+}
+
+SpectrogramTiles::~SpectrogramTiles()
+{
+    cancelPendingUpdate();
+
+    {
+        std::lock_guard<std::mutex> sl(lock);
+        queue.clear();
+    }
+
+    workers.removeAllJobs(true, 5000);
+}
+
+int SpectrogramTiles::getHopLog2For(double samplesPerPixel) noexcept
+{
+    if (samplesPerPixel <= 1.0)
+        return minHopLog2;
+
+    return juce::jmax(minHopLog2, (int)std::floor(std::log2(samplesPerPixel) + 1.0e-9));
+}
+
+//==============================================================================
+void SpectrogramTiles::setSource(const juce::File& audioFile)
+{
+    {
+        std::lock_guard<std::mutex> sl(lock);
+
+        if (audioFile == file)
+            return;
+
+        file = audioFile;
+        ++generation;
+        queue.clear();
+        inFlight.clear();
+    }
+
+    tiles.clear();
+}
+
+void SpectrogramTiles::setDiskCacheEnabled(bool shouldCache)
+{
+    diskCacheEnabled = shouldCache;
+
+    settingsFile.getParentDirectory().createDirectory();
+    juce::TemporaryFile temp(settingsFile);
+
+    {
+        juce::FileOutputStream out(temp.getFile());
+        if (!out.openedOk())
+            return;
+
+        out.writeInt(settingsMagic);
+        out.writeInt(settingsVersion);
+        out.writeBool(shouldCache);
+
+        out.flush();
+        if (out.getStatus().failed())
+            return;
+    }
+
+    temp.overwriteTargetFileWithTemporary();
+}
+
+juce::File SpectrogramTiles::getDiskCacheFile(const juce::File& audioFile, juce::int64 sourceSize,
+                                              juce::int64 sourceModified, TileKey key) const
+{
+    // Tiles of a file that has since changed are never found again, and age out of the cache
+    auto stamp = juce::String::toHexString(audioFile.getFullPathName().hashCode64())
+                   + "-" + juce::String::toHexString(sourceSize)
+                   + "-" + juce::String::toHexString(sourceModified);
+
+    return diskCacheDirectory.getChildFile(stamp)
+                             .getChildFile(juce::String(key.fftOrder) + "-" + juce::String(key.hopLog2) + "-" + juce::String(key.index) + ".spec");
+}
+
+void SpectrogramTiles::addedToDiskCache(juce::int64 bytes)
+{
+    std::lock_guard<std::mutex> sl(diskLock);
+
+    // Measured the first time a tile is written, then kept up to date here
+    if (diskBytesUsed >= 0)
+        diskBytesUsed += bytes;
+
+    if (diskBytesUsed < 0 || diskBytesUsed > diskCacheBudget)
+        trimDiskCache();
+}
+
+void SpectrogramTiles::trimDiskCache()
+{
+    struct CachedTile
+    {
+        juce::File file;
+        juce::int64 size;
+        juce::Time lastUsed;
+    };
+
+    std::vector<CachedTile> cached;
+    juce::int64 total = 0;
+
+    for (const auto& entry : juce::RangedDirectoryIterator(diskCacheDirectory, true, "*.spec", juce::File::findFiles))
+    {
+        cached.push_back({ entry.getFile(), entry.getFileSize(), entry.getModificationTime() });
+        total += entry.getFileSize();
+    }
+
+    // Down to a little under the budget, so the next few tiles don't each trim again
+    if (total > diskCacheBudget)
+    {
+        std::sort(cached.begin(), cached.end(),
+                  [](const CachedTile& a, const CachedTile& b) { return a.lastUsed < b.lastUsed; });
+
+        for (const auto& tile : cached)
+        {
+            if (total <= diskCacheBudget / 10 * 9)
+                break;
+
+            if (tile.file.deleteFile())
+                total -= tile.size;
+        }
+
+        for (const auto& directory : diskCacheDirectory.findChildFiles(juce::File::findDirectories, false))
+            if (directory.getNumberOfChildFiles(juce::File::findFilesAndDirectories) == 0)
+                directory.deleteFile();
+    }
+
+    diskBytesUsed = total;
+}
+
+void SpectrogramTiles::request(const std::vector<TileKey>& wanted)
+{
+    std::lock_guard<std::mutex> sl(lock);
+
+    queue.clear();
+
+    for (auto key : wanted)
+        if (tiles.find(key) == nullptr && !tiles.hasFailed(key) && inFlight.count(key) == 0)
+            queue.push_back(key);
+
+    // Start workers as they're needed; each one leaves once the queue is empty
+    while (activeWorkers < workers.getNumThreads() && activeWorkers < (int)queue.size())
+    {
+        ++activeWorkers;
+        workers.addJob(new TileWorker(*this), true);
+    }
+}
+
+bool SpectrogramTiles::isBusy() const
+{
+    std::lock_guard<std::mutex> sl(lock);
+    return !queue.empty() || !inFlight.empty();
+}
+
+bool SpectrogramTiles::dequeue(Job& job)
+{
+    std::lock_guard<std::mutex> sl(lock);
+
+    if (queue.empty() || file == juce::File())
+    {
+        --activeWorkers;
+        return false;
+    }
+
+    job.key = queue.front();
+    job.file = file;
+    job.generation = generation;
+    queue.pop_front();
+    inFlight.insert(job.key);
+    return true;
+}
+
+void SpectrogramTiles::addResult(Computed result)
+{
+    {
+        std::lock_guard<std::mutex> sl(lock);
+
+        if (result.generation == generation)
+            inFlight.erase(result.key);
+
+        computed.push_back(std::move(result));
+    }
+
+    triggerAsyncUpdate();
+}
+
+void SpectrogramTiles::abandon(const Job& job)
+{
+    std::lock_guard<std::mutex> sl(lock);
+
+    if (job.generation == generation)
+        inFlight.erase(job.key);
+
+    // The worker leaves without going back to dequeue()
+    --activeWorkers;
+}
+
+void SpectrogramTiles::handleAsyncUpdate()
+{
+    std::vector<Computed> done;
+    juce::uint32 currentGeneration;
+
+    {
+        std::lock_guard<std::mutex> sl(lock);
+        done.swap(computed);
+        currentGeneration = generation;
+    }
+
+    if (tiles.add(done, currentGeneration) && onTilesReady != nullptr)
+        onTilesReady();
+}
\ No newline at end of file
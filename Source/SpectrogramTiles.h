@@ -0,0 +1,123 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "DecodedBlockCache.h"
+#include "TileCache.h"
+
+//==============================================================================
+/**
+    Spectrogram images of one file, tileColumns STFT frames wide.
+
+    Each tile is keyed by its FFT size, its hop (a power of two, one column
+    per hop) and its index along the file, so the view can pick the time and
+    frequency resolution for its zoom. Tiles are computed by a pool of
+    workers, each with its own block cache source and FFT; where the hop is
+    longer than the FFT, a column averages the power of several frames spread
+    over it. Finished tiles are kept in memory and, if enabled, as quantised
+    levels on disk, and arrive one by one so a long file fills in while the
+    view stays responsive.
+
+    On disk, tiles are grouped by the path, size and modification time of
+    their file, so a file that changes starts a fresh set. The whole cache is
+    kept under diskCacheBudget by deleting the tiles read or written longest
+    ago, and whether it's enabled is remembered between sessions.
+*/
+class SpectrogramTiles : private juce::AsyncUpdater
+{
+public:
+    explicit SpectrogramTiles(DecodedBlockCache& cache);
+    ~SpectrogramTiles() override;
+
+    static constexpr int tileColumns = 256;
+    static constexpr int minFftOrder = 9;
+    static constexpr int maxFftOrder = 12;
+    static constexpr int minHopLog2 = 5;
+    static constexpr juce::int64 diskCacheBudget = (juce::int64)1 << 30;
+
+    // The longest hop that still gives at least one column per pixel
+    static int getHopLog2For(double samplesPerPixel) noexcept;
+
+    struct TileKey
+    {
+        int fftOrder = 0;
+        int hopLog2 = 0;
+        juce::int64 index = 0;
+
+        bool operator==(const TileKey& other) const noexcept
+        {
+            return fftOrder == other.fftOrder && hopLog2 == other.hopLog2 && index == other.index;
+        }
+
+        bool operator<(const TileKey& other) const noexcept
+        {
+            if (fftOrder != other.fftOrder)     return fftOrder < other.fftOrder;
+            if (hopLog2 != other.hopLog2)       return hopLog2 < other.hopLog2;
+            return index < other.index;
+        }
+    };
+
+    //==============================================================================
+    // Message thread
+
+    // Drops every tile and starts over for another file
+    void setSource(const juce::File& file);
+
+    // Saved straight away, and restored by the next SpectrogramTiles
+    void setDiskCacheEnabled(bool shouldCache);
+    bool isDiskCacheEnabled() const noexcept            { return diskCacheEnabled.load(); }
+
+    juce::Image getTile(TileKey key)                    { return tiles.get(key); }
+
+    // Replaces whatever was still waiting to be computed, most wanted first
+    void request(const std::vector<TileKey>& tiles);
+    bool isBusy() const;
+
+    // Called on the message thread whenever new tiles arrive
+    std::function<void()> onTilesReady;
+
+private:
+    class TileWorker;
+
+    struct Job
+    {
+        TileKey key;
+        juce::File file;
+        juce::uint32 generation = 0;
+    };
+
+    using Computed = TileCache<TileKey>::Result;
+
+    void handleAsyncUpdate() override;
+
+    // Worker threads
+    bool dequeue(Job& job);
+    void addResult(Computed result);
+    void abandon(const Job& job);
+    juce::File getDiskCacheFile(const juce::File& audioFile, juce::int64 sourceSize,
+                                juce::int64 sourceModified, TileKey key) const;
+    void addedToDiskCache(juce::int64 bytes);
+    void trimDiskCache();
+
+    DecodedBlockCache& blockCache;
+    juce::File diskCacheDirectory, settingsFile;
+    std::atomic<bool> diskCacheEnabled { false };
+
+    std::mutex diskLock;
+    juce::int64 diskBytesUsed = -1;     // -1 until the cache has been measured
+
+    // Message thread only
+    TileCache<TileKey> tiles { (size_t)128 << 20 };
+
+    // Shared with the workers
+    mutable std::mutex lock;
+    juce::File file;
+    juce::uint32 generation = 0;
+    std::deque<TileKey> queue;
+    std::set<TileKey> inFlight;
+    std::vector<Computed> computed;
+    int activeWorkers = 0;
+
+    juce::ThreadPool workers;      // last, so it stops before anything it uses goes away
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectrogramTiles)
+};
\ No newline at end of file
@@ -0,0 +1,307 @@
+#include "TagIndex.h"
+
+std::string TagIndex::fold(const juce::String& tag)
+{
+    return tag.trim().toLowerCase().toStdString();
+}
+
+TagId TagIndex::findTag(const juce::String& name) const
+{
+    auto it = idsByName.find(fold(name));
+    return it != idsByName.end() ? it->second : invalidTagId;
+}
+
+juce::String TagIndex::getTagName(TagId id) const
+{
+    return id < entries.size() ? entries[id].name : juce::String();
+}
+
+const RowBitmap& TagIndex::getRows(TagId id) const
+{
+    static const RowBitmap empty;
+    return id < entries.size() ? entries[id].rows : empty;
+}
+
+int TagIndex::getCount(TagId id) const
+{
+    return (int)getRows(id).size();
+}
+
+std::vector<std::pair<juce::String, int>> TagIndex::getTagCounts() const
+{
+    std::vector<std::pair<juce::String, int>> counts;
+
+    for (const auto& entry : entries)
+        if (!entry.rows.isEmpty())
+            counts.emplace_back(entry.name, (int)entry.rows.size());
+
+    return counts;
+}
+
+TagId TagIndex::intern(const juce::String& name)
+{
+    auto key = fold(name);
+    auto it = idsByName.find(key);
+    if (it != idsByName.end())
+        return it->second;
+
+    TagId id;
+
+    if (!freeIds.empty())
+    {
+        id = freeIds.back();
+        freeIds.pop_back();
+        entries[id].name = name.trim();
+    }
+    else
+    {
+        id = (TagId)entries.size();
+        entries.push_back({ name.trim(), {} });
+    }
+
+    idsByName.emplace(std::move(key), id);
+    return id;
+}
+
+void TagIndex::release(TagId id)
+{
+    auto& entry = entries[id];
+    idsByName.erase(fold(entry.name));
+    entry = {};
+    freeIds.push_back(id);
+}
+
+void TagIndex::add(LibraryRow row, const juce::StringArray& tags)
+{
+    if (row >= tagsByRow.size())
+        tagsByRow.resize((size_t)row + 1);
+
+    auto& rowTags = tagsByRow[row];
+    for (auto id : rowTags)
+        removeRowFromTag(row, id);
+    rowTags.clear();
+
+    for (const auto& tag : tags)
+    {
+        if (tag.trim().isEmpty())
+            continue;
+
+        auto id = intern(tag);
+        if (std::find(rowTags.begin(), rowTags.end(), id) != rowTags.end())
+            continue;
+
+        rowTags.push_back(id);
+        entries[id].rows.add(row);
+    }
+}
+
+void TagIndex::update(LibraryRow row, const juce::StringArray& tags)
+{
+    add(row, tags);
+}
+
+void TagIndex::remove(LibraryRow row)
+{
+    if (row >= tagsByRow.size())
+        return;
+
+    for (auto id : tagsByRow[row])
+        removeRowFromTag(row, id);
+
+    tagsByRow[row].clear();
+    tagsByRow[row].shrink_to_fit();
+}
+
+void TagIndex::removeRowFromTag(LibraryRow row, TagId id)
+{
+    if (id >= entries.size())
+        return;
+
+    auto& rows = entries[id].rows;
+    rows.remove(row);
+
+    if (rows.isEmpty())
+        release(id);
+}
+
+void TagIndex::clear()
+{
+    entries.clear();
+    freeIds.clear();
+    idsByName.clear();
+    tagsByRow.clear();
+}
+
+RowBitmap TagIndex::rename(const juce::String& oldName, const juce::String& newName)
+{
+    auto oldId = findTag(oldName);
+    if (oldId == invalidTagId || newName.trim().isEmpty())
+        return {};
+
+    auto affected = entries[oldId].rows;
+    auto newKey = fold(newName);
+    auto existing = idsByName.find(newKey);
+
+    if (existing == idsByName.end() || existing->second == oldId)
+    {
+        // Plain rename (possibly just a change of case): members are unchanged
+        idsByName.erase(fold(entries[oldId].name));
+        idsByName[newKey] = oldId;
+        entries[oldId].name = newName.trim();
+        return affected;
+    }
+
+    // Merge into the existing tag
+    auto newId = existing->second;
+    entries[newId].rows |= affected;
+
+    affected.forEach([this, oldId, newId](LibraryRow row)
+    {
+        auto& rowTags = tagsByRow[row];
+        rowTags.erase(std::remove(rowTags.begin(), rowTags.end(), oldId), rowTags.end());
+
+        if (std::find(rowTags.begin(), rowTags.end(), newId) == rowTags.end())
+            rowTags.push_back(newId);
+    });
+
+    // Nothing carries the old tag any more, so it goes from getTagCounts() and the dictionary
+    release(oldId);
+    return affected;
+}
+
+//==============================================================================
+namespace
+{
+    class TagExpressionParser
+    {
+    public:
+        TagExpressionParser(const TagIndex& index, const RowBitmap& all, const juce::String& expression)
+            : tags(index), allRows(all)
+        {
+            tokenise(expression);
+        }
+
+        RowBitmap parse()
+        {
+            if (tokens.isEmpty())
+                return {};
+
+            return parseOr();
+        }
+
+    private:
+        void tokenise(const juce::String& text)
+        {
+            auto p = text.getCharPointer();
+
+            while (!p.isEmpty())
+            {
+                auto c = *p;
+
+                if (juce::CharacterFunctions::isWhitespace(c))
+                {
+                    ++p;
+                }
+                else if (c == '(' || c == ')' || c == '&' || c == '|')
+                {
+                    tokens.add(juce::String::charToString(c));
+                    ++p;
+                }
+                else if (c == '!' || c == '-')
+                {
+                    // Only at the start of a word, so "lo-fi" stays a single tag
+                    tokens.add("!");
+                    ++p;
+                }
+                else if (c == '"')
+                {
+                    ++p;
+                    juce::String word;
+                    while (!p.isEmpty() && *p != '"')
+                        word += *p++;
+                    if (!p.isEmpty())
+                        ++p;
+                    tokens.add("\"" + word);
+                }
+                else
+                {
+                    juce::String word;
+                    while (!p.isEmpty() && !juce::CharacterFunctions::isWhitespace(*p)
+                           && *p != '(' && *p != ')' && *p != '&' && *p != '|' && *p != '"')
+                        word += *p++;
+
+                    if (word.equalsIgnoreCase("and"))      tokens.add("&");
+                    else if (word.equalsIgnoreCase("or"))  tokens.add("|");
+                    else if (word.equalsIgnoreCase("not")) tokens.add("!");
+                    else                                   tokens.add("\"" + word);
+                }
+            }
+        }
+
+        bool atEnd() const                      { return position >= tokens.size(); }
+        juce::String peek() const               { return atEnd() ? juce::String() : tokens[position]; }
+
+        RowBitmap parseOr()
+        {
+            auto result = parseAnd();
+
+            while (peek() == "|")
+            {
+                ++position;
+                result |= parseAnd();
+            }
+
+            return result;
+        }
+
+        RowBitmap parseAnd()
+        {
+            auto result = parseUnary();
+
+            while (!atEnd() && peek() != "|" && peek() != ")")
+            {
+                if (peek() == "&")
+                    ++position;
+
+                if (atEnd())
+                    break;
+
+                result &= parseUnary();
+            }
+
+            return result;
+        }
+
+        RowBitmap parseUnary()
+        {
+            auto token = peek();
+            ++position;
+
+            if (token == "!")
+                return allRows - parseUnary();
+
+            if (token == "(")
+            {
+                auto result = parseOr();
+                if (peek() == ")")
+                    ++position;
+                return result;
+            }
+
+            if (token.startsWithChar('"'))
+                return tags.getRows(tags.findTag(token.substring(1)));
+
+            return {};
+        }
+
+        const TagIndex& tags;
+        const RowBitmap& allRows;
+        juce::StringArray tokens;
+        int position = 0;
+    };
+}
+
+RowBitmap TagIndex::evaluate(const juce::String& expression, const RowBitmap& allRows) const
+{
+    return TagExpressionParser(*this, allRows, expression).parse();
+}
\ No newline at end of file
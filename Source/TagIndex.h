@@ -0,0 +1,71 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LibraryTypes.h"
+#include "RowBitmap.h"
+
+using TagId = juce::uint32;
+
+constexpr TagId invalidTagId = 0xffffffffu;
+
+//==============================================================================
+/**
+    Interned tag dictionary for the library.
+
+    Every distinct tag (compared case-insensitively) gets an integer id and a
+    RowBitmap of the rows carrying it, so tag lookups, counts and boolean
+    combinations never have to look at the recordings themselves. Renaming or
+    merging a tag only touches that tag's members. A tag that loses its last
+    member is dropped from the dictionary, and its id is reused by the next
+    new tag.
+*/
+class TagIndex
+{
+public:
+    TagIndex() = default;
+
+    void add(LibraryRow row, const juce::StringArray& tags);
+    void update(LibraryRow row, const juce::StringArray& tags);
+    void remove(LibraryRow row);
+    void clear();
+
+    TagId findTag(const juce::String& name) const;
+    juce::String getTagName(TagId id) const;
+    const RowBitmap& getRows(TagId id) const;
+    int getCount(TagId id) const;
+
+    // Tags that currently have at least one member, with their member counts
+    std::vector<std::pair<juce::String, int>> getTagCounts() const;
+
+    /** Evaluates a tag expression such as "Live AND (Demo OR Mix) AND NOT Loop".
+        Operators are case-insensitive, "&", "|" and "!"/"-" are accepted as
+        shorthands, adjacent tags are ANDed and multi-word tags can be quoted.
+        allRows is the universe NOT is taken against.
+    */
+    RowBitmap evaluate(const juce::String& expression, const RowBitmap& allRows) const;
+
+    /** Renames a tag, merging it into newName if that tag already exists.
+        Returns the affected rows so the caller can patch its recordings.
+    */
+    RowBitmap rename(const juce::String& oldName, const juce::String& newName);
+
+    static std::string fold(const juce::String& tag);
+
+private:
+    struct Entry
+    {
+        juce::String name;
+        RowBitmap rows;
+    };
+
+    TagId intern(const juce::String& name);
+    void removeRowFromTag(LibraryRow row, TagId id);
+    void release(TagId id);
+
+    std::vector<Entry> entries;
+    std::vector<TagId> freeIds;     // entries released by release(), for intern() to reuse
+    std::unordered_map<std::string, TagId> idsByName;
+    std::vector<std::vector<TagId>> tagsByRow;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TagIndex)
+};
\ No newline at end of file
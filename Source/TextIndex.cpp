@@ -0,0 +1,326 @@
+#include "TextIndex.h"
+
+std::string TextIndex::fold(const juce::String& text)
+{
+    return text.toLowerCase().toStdString();
+}
+
+std::string TextIndex::buildDocument(const Recording& recording)
+{
+    // Fields (and individual tags) are separated so that a match can never
+    // straddle two of them
+    std::string document;
+    document.reserve(256);
+
+    auto append = [&document](const juce::String& text)
+    {
+        document += fold(text);
+        document += fieldSeparator;
+    };
+
+    // Same order as the Field enum, with tags last because there can be any
+    // number of them
+    append(recording.name);
+    append(recording.uid);
+    append(recording.artist);
+    append(recording.genre);
+    append(recording.file.getFullPathName());
+
+    for (const auto& tag : recording.tags)
+        append(tag);
+
+    return document;
+}
+
+TextIndex::Trigram TextIndex::makeTrigram(const char* bytes) noexcept
+{
+    return ((Trigram)(juce::uint8)bytes[0] << 16)
+         | ((Trigram)(juce::uint8)bytes[1] << 8)
+         |  (Trigram)(juce::uint8)bytes[2];
+}
+
+std::vector<TextIndex::Trigram> TextIndex::extractTrigrams(const std::string& text)
+{
+    std::vector<Trigram> trigrams;
+
+    if (text.size() < 3)
+        return trigrams;
+
+    trigrams.reserve(text.size() - 2);
+
+    for (size_t i = 0; i + 3 <= text.size(); ++i)
+    {
+        const char* p = text.data() + i;
+        if (p[0] == fieldSeparator || p[1] == fieldSeparator || p[2] == fieldSeparator)
+            continue;
+
+        trigrams.push_back(makeTrigram(p));
+    }
+
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    return trigrams;
+}
+
+void TextIndex::add(LibraryRow row, const Recording& recording)
+{
+    if (isLive(row))
+    {
+        update(row, recording);
+        return;
+    }
+
+    if (row >= documents.size())
+    {
+        documents.resize((size_t)row + 1);
+        live.resize((size_t)row + 1, false);
+    }
+
+    documents[row] = buildDocument(recording);
+    live[row] = true;
+    ++numLiveRows;
+
+    for (auto trigram : extractTrigrams(documents[row]))
+    {
+        auto& list = postings[trigram];
+
+        // Rows normally arrive in increasing order, so this is an append
+        if (list.empty() || list.back() < row)
+            list.push_back(row);
+        else
+            list.insert(std::lower_bound(list.begin(), list.end(), row), row);
+    }
+}
+
+void TextIndex::update(LibraryRow row, const Recording& recording)
+{
+    if (!isLive(row))
+    {
+        add(row, recording);
+        return;
+    }
+
+    auto newDocument = buildDocument(recording);
+    if (newDocument == documents[row])
+        return;
+
+    // Only touch the posting lists of trigrams that actually changed
+    auto oldTrigrams = extractTrigrams(documents[row]);
+    auto newTrigrams = extractTrigrams(newDocument);
+
+    std::vector<Trigram> removed, added;
+    std::set_difference(oldTrigrams.begin(), oldTrigrams.end(), newTrigrams.begin(), newTrigrams.end(),
+                        std::back_inserter(removed));
+    std::set_difference(newTrigrams.begin(), newTrigrams.end(), oldTrigrams.begin(), oldTrigrams.end(),
+                        std::back_inserter(added));
+
+    for (auto trigram : removed)
+    {
+        auto it = postings.find(trigram);
+        if (it == postings.end())
+            continue;
+
+        auto& list = it->second;
+        auto pos = std::lower_bound(list.begin(), list.end(), row);
+        if (pos != list.end() && *pos == row)
+            list.erase(pos);
+
+        if (list.empty())
+            postings.erase(it);
+    }
+
+    for (auto trigram : added)
+    {
+        auto& list = postings[trigram];
+        list.insert(std::lower_bound(list.begin(), list.end(), row), row);
+    }
+
+    documents[row] = std::move(newDocument);
+}
+
+void TextIndex::remove(LibraryRow row)
+{
+    if (!isLive(row))
+        return;
+
+    for (auto trigram : extractTrigrams(documents[row]))
+    {
+        auto it = postings.find(trigram);
+        if (it == postings.end())
+            continue;
+
+        auto& list = it->second;
+        auto pos = std::lower_bound(list.begin(), list.end(), row);
+        if (pos != list.end() && *pos == row)
+            list.erase(pos);
+
+        if (list.empty())
+            postings.erase(it);
+    }
+
+    documents[row] = {};
+    documents[row].shrink_to_fit();
+    live[row] = false;
+    --numLiveRows;
+}
+
+void TextIndex::clear()
+{
+    documents.clear();
+    live.clear();
+    postings.clear();
+    numLiveRows = 0;
+}
+
+bool TextIndex::documentContains(const std::string& document, const std::string& needle, Field field, bool wholeField)
+{
+    if (field == anyField && !wholeField)
+        return document.find(needle) != std::string::npos;
+
+    auto segmentEquals = [&document, &needle](size_t start, size_t end)
+    {
+        while (start < end && juce::CharacterFunctions::isWhitespace((juce::juce_wchar)(juce::uint8)document[start]))
+            ++start;
+
+        while (end > start && juce::CharacterFunctions::isWhitespace((juce::juce_wchar)(juce::uint8)document[end - 1]))
+            --end;
+
+        return document.compare(start, end - start, needle) == 0;
+    };
+
+    size_t start = 0;
+
+    for (int segment = 0; start < document.size(); ++segment)
+    {
+        auto end = document.find(fieldSeparator, start);
+        if (end == std::string::npos)
+            end = document.size();
+
+        if (field == anyField || segment == (int)field || (field == tagsField && segment >= (int)tagsField))
+        {
+            if (wholeField)
+            {
+                if (segmentEquals(start, end))
+                    return true;
+            }
+            else
+            {
+                auto pos = document.find(needle, start);
+                if (pos != std::string::npos && pos + needle.size() <= end)
+                    return true;
+            }
+
+            if (field != tagsField && field != anyField)
+                return false;
+        }
+
+        start = end + 1;
+    }
+
+    return false;
+}
+
+bool TextIndex::matches(LibraryRow row, const std::string& foldedTerm, Field field, bool wholeField) const
+{
+    return isLive(row) && documentContains(documents[row], foldedTerm, field, wholeField);
+}
+
+size_t TextIndex::estimateMatches(const std::string& foldedTerm) const
+{
+    if (foldedTerm.size() < 3)
+        return numLiveRows;
+
+    size_t smallest = numLiveRows;
+
+    for (auto trigram : extractTrigrams(foldedTerm))
+    {
+        auto it = postings.find(trigram);
+        if (it == postings.end())
+            return 0;
+
+        smallest = juce::jmin(smallest, it->second.size());
+    }
+
+    return smallest;
+}
+
+void TextIndex::intersectInto(PostingList& candidates, const PostingList& list)
+{
+    PostingList result;
+    result.reserve(candidates.size());
+
+    if (candidates.size() * 16 < list.size())
+    {
+        // Candidates are much sparser than the list: gallop through it
+        auto searchFrom = list.begin();
+        for (auto row : candidates)
+        {
+            searchFrom = std::lower_bound(searchFrom, list.end(), row);
+            if (searchFrom == list.end())
+                break;
+            if (*searchFrom == row)
+                result.push_back(row);
+        }
+    }
+    else
+    {
+        std::set_intersection(candidates.begin(), candidates.end(), list.begin(), list.end(),
+                              std::back_inserter(result));
+    }
+
+    candidates.swap(result);
+}
+
+std::vector<LibraryRow> TextIndex::search(const juce::String& term, Field field, bool wholeField) const
+{
+    std::vector<LibraryRow> results;
+    auto needle = fold(term);
+
+    if (needle.empty())
+    {
+        for (LibraryRow row = 0; row < (LibraryRow)live.size(); ++row)
+            if (live[row])
+                results.push_back(row);
+        return results;
+    }
+
+    if (needle.size() < 3)
+    {
+        // Too short for trigrams: scan the pre-folded text instead
+        for (LibraryRow row = 0; row < (LibraryRow)documents.size(); ++row)
+            if (live[row] && documentContains(documents[row], needle, field, wholeField))
+                results.push_back(row);
+        return results;
+    }
+
+    std::vector<const PostingList*> lists;
+    for (auto trigram : extractTrigrams(needle))
+    {
+        auto it = postings.find(trigram);
+        if (it == postings.end())
+            return results; // A trigram nobody has: no match possible
+
+        lists.push_back(&it->second);
+    }
+
+    if (lists.empty())
+        return results;
+
+    // Intersect smallest lists first so the candidate set shrinks quickly
+    std::sort(lists.begin(), lists.end(), [](const PostingList* a, const PostingList* b)
+    {
+        return a->size() < b->size();
+    });
+
+    PostingList candidates(*lists.front());
+    for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i)
+        intersectInto(candidates, *lists[i]);
+
+    // Trigram containment doesn't imply substring containment, so verify
+    results.reserve(candidates.size());
+    for (auto row : candidates)
+        if (documentContains(documents[row], needle, field, wholeField))
+            results.push_back(row);
+
+    return results;
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioRecorder.h"
+#include "LibraryTypes.h"
+
+//==============================================================================
+/**
+    Trigram inverted index over the searchable text of each recording
+    (name, uid, artist, genre, file path and tags).
+
+    Fields are case-folded once per add/update and kept alongside the posting
+    lists, so a query never touches the original juce::String objects. Queries of
+    three or more bytes intersect the posting lists of their trigrams and then
+    verify the surviving candidates; shorter ones scan the folded text. A
+    whole-field search matches only fields (or tags) equal to the term,
+    ignoring case and surrounding spaces.
+*/
+class TextIndex
+{
+public:
+    /** The searchable fields, in the order buildDocument() lays out their
+        segments; searches can be narrowed to one of them, or anyField.
+    */
+    enum Field
+    {
+        anyField = -1,
+        nameField = 0,
+        uidField,
+        artistField,
+        genreField,
+        pathField,
+        tagsField,      // one segment per tag, always last
+        numFields
+    };
+
+    TextIndex() = default;
+
+    void add(LibraryRow row, const Recording& recording);
+    void update(LibraryRow row, const Recording& recording);
+    void remove(LibraryRow row);
+    void clear();
+
+    // Rows whose text contains the term (case-insensitive), in ascending order
+    std::vector<LibraryRow> search(const juce::String& term, Field field = anyField, bool wholeField = false) const;
+
+    // Checks a single row against an already folded term, without the index
+    bool matches(LibraryRow row, const std::string& foldedTerm, Field field = anyField, bool wholeField = false) const;
+
+    // Upper bound on the number of rows a folded term can match
+    size_t estimateMatches(const std::string& foldedTerm) const;
+
+    size_t getNumRows() const noexcept          { return numLiveRows; }
+
+    static std::string fold(const juce::String& text);
+
+private:
+    using Trigram = juce::uint32;
+    using PostingList = std::vector<LibraryRow>;
+
+    static constexpr char fieldSeparator = '\x1f';
+
+    static std::string buildDocument(const Recording& recording);
+    static std::vector<Trigram> extractTrigrams(const std::string& text);
+    static Trigram makeTrigram(const char* bytes) noexcept;
+    static void intersectInto(PostingList& candidates, const PostingList& list);
+    static bool documentContains(const std::string& document, const std::string& needle, Field field, bool wholeField);
+
+    bool isLive(LibraryRow row) const noexcept   { return row < live.size() && live[row]; }
+
+    std::vector<std::string> documents;
+    std::vector<bool> live;
+    std::unordered_map<Trigram, PostingList> postings;
+    size_t numLiveRows = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TextIndex)
+};
\ No newline at end of file
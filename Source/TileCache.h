@@ -0,0 +1,121 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    The finished tiles of one source, as kept by WaveformTiles and
+    SpectrogramTiles on the message thread.
+
+    Tiles are dropped least recently drawn first once their images add up to
+    more than maxMemory. A tile that comes back without an image is remembered
+    as failed until the next clear(), so the view doesn't keep queueing it
+    every time it paints.
+*/
+template <typename Key>
+class TileCache
+{
+public:
+    explicit TileCache(size_t maxMemoryBytes) : maxMemory(maxMemoryBytes) {}
+
+    // What a renderer hands back; an invalid image means the tile couldn't be made
+    struct Result
+    {
+        Key key;
+        juce::Image image;
+        juce::uint32 generation = 0;
+    };
+
+    // Drops every tile, and forgets which ones failed
+    void clear()
+    {
+        tiles.clear();
+        failed.clear();
+        memoryUsed = 0;
+    }
+
+    /** Returns the tile if there is one, and marks it as just drawn; otherwise
+        an invalid image.
+    */
+    juce::Image get(const Key& key)
+    {
+        auto it = tiles.find(key);
+        if (it == tiles.end())
+            return {};
+
+        it->second.lastUsed = ++useCounter;
+        return it->second.image;
+    }
+
+    // The tile's image without marking it as drawn, or nullptr
+    const juce::Image* find(const Key& key) const
+    {
+        auto it = tiles.find(key);
+        return it != tiles.end() ? &it->second.image : nullptr;
+    }
+
+    bool hasFailed(const Key& key) const                { return failed.count(key) > 0; }
+
+    /** Takes the results from the given generation, ignoring older ones, then
+        evicts down to maxMemory. Returns true if any tiles were added.
+    */
+    bool add(std::vector<Result>& results, juce::uint32 generation)
+    {
+        auto anyAdded = false;
+
+        for (auto& result : results)
+        {
+            if (result.generation != generation)
+                continue;
+
+            if (!result.image.isValid())
+            {
+                failed.insert(result.key);
+                continue;
+            }
+
+            auto& tile = tiles[result.key];
+
+            if (tile.image.isValid())
+                memoryUsed -= getMemoryUsed(tile.image);
+
+            tile.image = std::move(result.image);
+            tile.lastUsed = ++useCounter;
+            memoryUsed += getMemoryUsed(tile.image);
+            anyAdded = true;
+        }
+
+        // Least recently drawn first
+        while (memoryUsed > maxMemory && tiles.size() > 1)
+        {
+            auto oldest = std::min_element(tiles.begin(), tiles.end(),
+                                           [](const auto& a, const auto& b) { return a.second.lastUsed < b.second.lastUsed; });
+
+            memoryUsed -= getMemoryUsed(oldest->second.image);
+            tiles.erase(oldest);
+        }
+
+        return anyAdded;
+    }
+
+private:
+    struct Tile
+    {
+        juce::Image image;
+        juce::uint64 lastUsed = 0;
+    };
+
+    static size_t getMemoryUsed(const juce::Image& image) noexcept
+    {
+        auto bytesPerPixel = image.getFormat() == juce::Image::ARGB ? 4 : (image.getFormat() == juce::Image::RGB ? 3 : 1);
+        return (size_t)image.getWidth() * (size_t)image.getHeight() * (size_t)bytesPerPixel;
+    }
+
+    std::map<Key, Tile> tiles;
+    std::set<Key> failed;
+    juce::uint64 useCounter = 0;
+    size_t memoryUsed = 0;
+    const size_t maxMemory;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TileCache)
+};
\ No newline at end of file
@@ -0,0 +1,618 @@
+#include "WatchedFolders.h"
+#include "LibraryManager.h"
+
+#if JUCE_LINUX
+ #include <sys/inotify.h>
+ #include <poll.h>
+ #include <unistd.h>
+#endif
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <sys/stat.h>
+#endif
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#endif
+
+namespace
+{
+    constexpr int stateMagic = 0x46575343; // "CSWF"
+    constexpr int stateVersion = 1;
+}
+
+//==============================================================================
+WatchedFolders::WatchedFolders(LibraryManager& libraryToUpdate)
+    : Thread("Watched folders"),
+      library(libraryToUpdate)
+{
+    formatManager.registerBasicFormats();
+
+    stateFile = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                    .getChildFile("CapSure")
+                    .getChildFile("watched_folders.dat");
+
+   #if JUCE_LINUX
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+   #endif
+
+    loadState();
+    startThread();
+}
+
+WatchedFolders::~WatchedFolders()
+{
+    stopThread(5000);
+    cancelPendingUpdate();
+
+   #if JUCE_LINUX
+    if (inotifyFd >= 0)
+        ::close(inotifyFd);
+   #endif
+}
+
+void WatchedFolders::addFolder(const juce::File& folder, bool recursive)
+{
+    {
+        std::lock_guard<std::mutex> lock(settingsLock);
+
+        for (const auto& setting : settings)
+            if (setting.root == folder)
+                return;
+
+        // Files imported before the folder was watched don't need probing again
+        settings.push_back({ folder, recursive, library.getKnownPathKeys() });
+        settingsChanged = true;
+    }
+
+    notify();
+}
+
+void WatchedFolders::removeFolder(const juce::File& folder)
+{
+    {
+        std::lock_guard<std::mutex> lock(settingsLock);
+        settings.erase(std::remove_if(settings.begin(), settings.end(),
+                                      [&folder](const FolderSettings& setting) { return setting.root == folder; }),
+                       settings.end());
+        settingsChanged = true;
+    }
+
+    notify();
+}
+
+juce::Array<juce::File> WatchedFolders::getFolders() const
+{
+    std::lock_guard<std::mutex> lock(settingsLock);
+
+    juce::Array<juce::File> roots;
+    for (const auto& setting : settings)
+        roots.add(setting.root);
+
+    return roots;
+}
+
+void WatchedFolders::rescanAll()
+{
+    rescanRequested = true;
+    notify();
+}
+
+//==============================================================================
+void WatchedFolders::run()
+{
+    auto lastPoll = juce::Time::getMillisecondCounter();
+    juce::uint32 lastEvent = 0;
+
+    while (!threadShouldExit())
+    {
+        syncFolders();
+
+        if (waitForEvents(250))
+            lastEvent = juce::Time::getMillisecondCounter();
+
+        auto now = juce::Time::getMillisecondCounter();
+
+        if (rescanRequested.exchange(false))
+            for (auto& folder : folders)
+                folder->dirty = true;
+
+        if (now - lastPoll >= (juce::uint32)pollIntervalMs)
+        {
+            for (auto& folder : folders)
+                if (!folder->watched)
+                    folder->dirty = true;
+
+            lastPoll = now;
+        }
+
+        // Let bursts of events (a large copy, say) settle before rescanning
+        if (lastEvent != 0 && now - lastEvent < (juce::uint32)debounceMs)
+            continue;
+
+        for (auto& folder : folders)
+        {
+            if (threadShouldExit())
+                return;
+
+            if (folder->dirty)
+            {
+                folder->dirty = false;
+                scan(*folder);
+            }
+        }
+
+        if (needsSave)
+        {
+            // Only persist snapshots the library has caught up with
+            std::lock_guard<std::mutex> lock(deltaLock);
+            if (pendingDeltas.empty())
+            {
+                saveState();
+                needsSave = false;
+            }
+        }
+    }
+}
+
+void WatchedFolders::syncFolders()
+{
+    std::lock_guard<std::mutex> lock(settingsLock);
+
+    if (!settingsChanged)
+        return;
+
+    settingsChanged = false;
+    needsSave = true;
+
+    for (auto it = folders.begin(); it != folders.end();)
+    {
+        auto stillWatched = std::any_of(settings.begin(), settings.end(),
+                                        [&it](const FolderSettings& setting) { return setting.root == (*it)->root; });
+
+        if (stillWatched)
+        {
+            ++it;
+        }
+        else
+        {
+            removeWatches(**it);
+            it = folders.erase(it);
+        }
+    }
+
+    for (auto& setting : settings)
+    {
+        auto known = std::any_of(folders.begin(), folders.end(),
+                                 [&setting](const std::unique_ptr<Folder>& folder) { return folder->root == setting.root; });
+
+        if (!known)
+        {
+            auto folder = std::make_unique<Folder>();
+            folder->root = setting.root;
+            folder->recursive = setting.recursive;
+            folder->alreadyImported = std::move(setting.alreadyImported);
+            folders.push_back(std::move(folder));
+        }
+    }
+}
+
+void WatchedFolders::scan(Folder& folder)
+{
+    // A missing root is more likely an unmounted drive than deleted files
+    if (!folder.root.isDirectory())
+        return;
+
+    Snapshot current;
+    current.reserve(folder.snapshot.size());
+
+    std::vector<std::pair<juce::File, FileState>> created;
+    juce::Array<juce::File> changed;
+
+    bool watchedAll = addWatch(folder, folder.root);
+
+    for (const auto& entry : juce::RangedDirectoryIterator(folder.root, folder.recursive, "*", juce::File::findFilesAndDirectories))
+    {
+        if (threadShouldExit())
+            return;
+
+        auto file = entry.getFile();
+
+        if (entry.isDirectory())
+        {
+            watchedAll = addWatch(folder, file) && watchedAll;
+            continue;
+        }
+
+        if (!LibraryManager::isAudioFile(file))
+            continue;
+
+        FileState state { entry.getFileSize(), entry.getModificationTime().toMilliseconds(), 0 };
+        auto key = file.getFullPathName().toStdString();
+        auto previous = folder.snapshot.find(key);
+
+        if (previous != folder.snapshot.end()
+             && previous->second.size == state.size
+             && previous->second.modified == state.modified)
+        {
+            // Filled in once for entries saved before the platform reported file IDs
+            auto unchanged = previous->second;
+            if (unchanged.inode == 0 && (unchanged.inode = getInode(file)) != 0)
+                needsSave = true;
+
+            current.emplace(std::move(key), unchanged);
+            continue;
+        }
+
+        state.inode = getInode(file);
+
+        if (previous != folder.snapshot.end())
+            changed.add(file);
+        else
+            created.push_back({ file, state });
+
+        current.emplace(std::move(key), state);
+    }
+
+    Delta delta;
+
+    // Whatever the walk didn't see has gone, unless it turns up again under a
+    // new name with the same inode. Entries without one (saved before the
+    // platform had file IDs, or on file systems without them) fall back to
+    // matching size and modification time, which a rename keeps, as long as
+    // only one file has them
+    std::unordered_map<juce::uint64, std::pair<juce::File, FileState>> goneByInode;
+    std::map<std::pair<juce::int64, juce::int64>, std::vector<juce::File>> goneByStamp;
+
+    for (const auto& entry : folder.snapshot)
+    {
+        if (current.count(entry.first) > 0)
+            continue;
+
+        juce::File file(juce::String(entry.first));
+
+        if (entry.second.inode != 0)
+            goneByInode[entry.second.inode] = { file, entry.second };
+        else
+            goneByStamp[{ entry.second.size, entry.second.modified }].push_back(file);
+    }
+
+    std::map<std::pair<juce::int64, juce::int64>, int> createdStamps;
+
+    for (const auto& entry : created)
+        ++createdStamps[{ entry.second.size, entry.second.modified }];
+
+    for (const auto& [file, state] : created)
+    {
+        auto gone = state.inode != 0 ? goneByInode.find(state.inode) : goneByInode.end();
+
+        if (gone != goneByInode.end() && gone->second.second.size == state.size)
+        {
+            delta.moved.push_back({ gone->second.first, file });
+            goneByInode.erase(gone);
+            continue;
+        }
+
+        auto stamp = std::make_pair(state.size, state.modified);
+        auto goneWithStamp = goneByStamp.find(stamp);
+
+        if (goneWithStamp != goneByStamp.end() && goneWithStamp->second.size() == 1 && createdStamps[stamp] == 1)
+        {
+            delta.moved.push_back({ goneWithStamp->second.front(), file });
+            goneByStamp.erase(goneWithStamp);
+            continue;
+        }
+
+        if (folder.alreadyImported.count(LibraryManager::getPathKey(file)) > 0)
+            continue;
+
+        auto recording = LibraryManager::createRecordingFromFile(file, formatManager);
+        if (recording.durationInSeconds > 0)
+            delta.added.push_back(std::move(recording));
+    }
+
+    for (const auto& gone : goneByInode)
+        delta.removed.add(gone.second.first);
+
+    for (const auto& gone : goneByStamp)
+        for (const auto& file : gone.second)
+            delta.removed.add(file);
+
+    for (const auto& file : changed)
+    {
+        auto recording = LibraryManager::createRecordingFromFile(file, formatManager);
+        if (recording.durationInSeconds > 0)
+            delta.changed.push_back(std::move(recording));
+    }
+
+    if (!created.empty() || !changed.isEmpty() || current.size() != folder.snapshot.size())
+        needsSave = true;
+
+    folder.snapshot.swap(current);
+    folder.alreadyImported.clear();
+    folder.watched = watchedAll;
+
+    if (!delta.isEmpty())
+    {
+        std::lock_guard<std::mutex> lock(deltaLock);
+        pendingDeltas.push_back(std::move(delta));
+        triggerAsyncUpdate();
+    }
+}
+
+//==============================================================================
+void WatchedFolders::handleAsyncUpdate()
+{
+    std::vector<Delta> deltas;
+
+    {
+        std::lock_guard<std::mutex> lock(deltaLock);
+        deltas.swap(pendingDeltas);
+    }
+
+    int added = 0, updated = 0, removed = 0;
+
+    {
+        LibraryManager::ScopedBatch batch(library);
+
+        for (auto& delta : deltas)
+        {
+            for (const auto& file : delta.removed)
+                if (library.removeRecording(library.findRecordingByFile(file)))
+                    ++removed;
+
+            for (const auto& move : delta.moved)
+            {
+                auto handle = library.findRecordingByFile(move.first);
+                if (auto* existing = library.getRecording(handle))
+                {
+                    auto recording = *existing;
+                    recording.file = move.second;
+
+                    // The new name was already imported on its own: keep the moved
+                    // recording, with the other's tags added, and drop the duplicate
+                    auto duplicate = library.findRecordingByFile(move.second);
+                    if (auto* other = library.getRecording(duplicate))
+                    {
+                        recording.tags.addArray(other->tags);
+                        recording.tags.removeDuplicates(true);
+                        library.removeRecording(duplicate);
+                    }
+
+                    if (library.updateRecording(handle, recording))
+                        ++updated;
+                }
+            }
+
+            // Keep the user's metadata, only the audio properties come from the file
+            for (const auto& probed : delta.changed)
+            {
+                auto handle = library.findRecordingByFile(probed.file);
+                if (auto* existing = library.getRecording(handle))
+                {
+                    auto recording = *existing;
+                    recording.durationInSeconds = probed.durationInSeconds;
+                    recording.sampleRate = probed.sampleRate;
+                    recording.numChannels = probed.numChannels;
+                    recording.fileSize = probed.fileSize;
+                    library.updateRecording(handle, recording);
+                    ++updated;
+                }
+                else
+                {
+                    delta.added.push_back(probed);
+                }
+            }
+
+            added += library.addRecordings(delta.added);
+        }
+    }
+
+    if (onChangesApplied && (added > 0 || updated > 0 || removed > 0))
+        onChangesApplied("Watched folders: " + juce::String(added) + " added, "
+                          + juce::String(updated) + " updated, " + juce::String(removed) + " removed");
+}
+
+//==============================================================================
+bool WatchedFolders::waitForEvents(int timeoutMs)
+{
+   #if JUCE_LINUX
+    if (inotifyFd >= 0)
+    {
+        pollfd descriptor { inotifyFd, POLLIN, 0 };
+        if (::poll(&descriptor, 1, timeoutMs) <= 0)
+            return false;
+
+        alignas(inotify_event) char buffer[16384];
+        bool anyEvents = false;
+
+        for (;;)
+        {
+            auto numRead = ::read(inotifyFd, buffer, sizeof(buffer));
+            if (numRead <= 0)
+                break;
+
+            for (auto* p = buffer; p < buffer + numRead;)
+            {
+                auto* event = reinterpret_cast<const inotify_event*>(p);
+
+                if ((event->mask & IN_Q_OVERFLOW) != 0)
+                {
+                    for (auto& folder : folders)
+                        folder->dirty = true;
+                }
+                else
+                {
+                    auto owners = watchOwners.find(event->wd);
+                    if (owners != watchOwners.end())
+                        for (auto* folder : owners->second)
+                            folder->dirty = true;
+                }
+
+                if ((event->mask & IN_IGNORED) != 0)
+                    watchOwners.erase(event->wd);
+
+                anyEvents = true;
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+
+        return anyEvents;
+    }
+   #endif
+
+    wait(timeoutMs);
+    return false;
+}
+
+bool WatchedFolders::addWatch(Folder& folder, const juce::File& directory)
+{
+   #if JUCE_LINUX
+    if (inotifyFd < 0)
+        return false;
+
+    // Re-adding an existing watch just returns its descriptor again
+    auto wd = inotify_add_watch(inotifyFd, directory.getFullPathName().toRawUTF8(),
+                                IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                                  | IN_DELETE_SELF | IN_MOVE_SELF);
+    if (wd < 0)
+        return false; // Usually out of watches, so this folder gets polled
+
+    // A directory under more than one watched folder keeps its watch until the last of them goes
+    auto& owners = watchOwners[wd];
+    if (std::find(owners.begin(), owners.end(), &folder) == owners.end())
+        owners.push_back(&folder);
+
+    return true;
+   #else
+    juce::ignoreUnused(folder, directory);
+    return false;
+   #endif
+}
+
+void WatchedFolders::removeWatches(const Folder& folder)
+{
+   #if JUCE_LINUX
+    for (auto it = watchOwners.begin(); it != watchOwners.end();)
+    {
+        auto& owners = it->second;
+        owners.erase(std::remove(owners.begin(), owners.end(), &folder), owners.end());
+
+        if (owners.empty())
+        {
+            inotify_rm_watch(inotifyFd, it->first);
+            it = watchOwners.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+   #else
+    juce::ignoreUnused(folder);
+   #endif
+}
+
+juce::uint64 WatchedFolders::getInode(const juce::File& file)
+{
+   #if JUCE_LINUX || JUCE_MAC
+    struct stat info;
+    if (::stat(file.getFullPathName().toRawUTF8(), &info) == 0)
+        return (juce::uint64)info.st_ino;
+   #elif JUCE_WINDOWS
+    // No access rights are needed just to read the file ID
+    auto handle = CreateFileW(file.getFullPathName().toWideCharPointer(), 0,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+
+    if (handle != INVALID_HANDLE_VALUE)
+    {
+        BY_HANDLE_FILE_INFORMATION info;
+        auto ok = GetFileInformationByHandle(handle, &info);
+        CloseHandle(handle);
+
+        if (ok)
+        {
+            auto index = ((juce::uint64)info.nFileIndexHigh << 32) | (juce::uint64)info.nFileIndexLow;
+            return index ^ ((juce::uint64)info.dwVolumeSerialNumber * 0x9e3779b97f4a7c15ull);
+        }
+    }
+   #else
+    juce::ignoreUnused(file);
+   #endif
+
+    return 0;
+}
+
+//==============================================================================
+void WatchedFolders::loadState()
+{
+    juce::FileInputStream in(stateFile);
+    if (!in.openedOk() || in.readInt() != stateMagic || in.readInt() != stateVersion)
+        return;
+
+    auto numFolders = in.readInt();
+
+    for (int i = 0; i < numFolders && !in.isExhausted(); ++i)
+    {
+        auto folder = std::make_unique<Folder>();
+        folder->root = juce::File(in.readString());
+        folder->recursive = in.readBool();
+
+        auto numFiles = in.readInt();
+        folder->snapshot.reserve((size_t)juce::jmax(0, numFiles));
+
+        for (int j = 0; j < numFiles && !in.isExhausted(); ++j)
+        {
+            auto path = in.readString().toStdString();
+
+            FileState state;
+            state.size = in.readInt64();
+            state.modified = in.readInt64();
+            state.inode = (juce::uint64)in.readInt64();
+            folder->snapshot.emplace(std::move(path), state);
+        }
+
+        settings.push_back({ folder->root, folder->recursive, {} });
+        folders.push_back(std::move(folder));
+    }
+}
+
+void WatchedFolders::saveState()
+{
+    juce::TemporaryFile temp(stateFile);
+
+    {
+        juce::FileOutputStream out(temp.getFile());
+        if (!out.openedOk())
+            return;
+
+        out.writeInt(stateMagic);
+        out.writeInt(stateVersion);
+        out.writeInt((int)folders.size());
+
+        for (const auto& folder : folders)
+        {
+            out.writeString(folder->root.getFullPathName());
+            out.writeBool(folder->recursive);
+            out.writeInt((int)folder->snapshot.size());
+
+            for (const auto& entry : folder->snapshot)
+            {
+                out.writeString(juce::String(entry.first));
+                out.writeInt64(entry.second.size);
+                out.writeInt64(entry.second.modified);
+                out.writeInt64((juce::int64)entry.second.inode);
+            }
+        }
+
+        out.flush();
+        if (out.getStatus().failed())
+            return;
+    }
+
+    temp.overwriteTargetFileWithTemporary();
+}
\ No newline at end of file
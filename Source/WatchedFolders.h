@@ -0,0 +1,115 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioRecorder.h"
+
+class LibraryManager;
+
+//==============================================================================
+/**
+    Folders the library keeps in sync with the file system.
+
+    For every watched folder a snapshot of (size, modification time, inode) per
+    audio file is persisted. A rescan walks the tree with stat calls only and
+    compares against the snapshot, so only new and changed files are probed;
+    files that disappeared are removed from the library, and renames are
+    recognised by their inode (the file ID on Windows) and simply repointed.
+
+    Rescans are triggered by inotify on Linux, and by polling elsewhere or
+    when a folder has more directories than the system will watch. Changes
+    are applied to the library on the message thread as one batch per scan.
+*/
+class WatchedFolders : private juce::Thread,
+                       private juce::AsyncUpdater
+{
+public:
+    explicit WatchedFolders(LibraryManager& library);
+    ~WatchedFolders() override;
+
+    void addFolder(const juce::File& folder, bool recursive = true);
+    void removeFolder(const juce::File& folder);
+    juce::Array<juce::File> getFolders() const;
+
+    void rescanAll();
+
+    // Called on the message thread with a summary of each batch of changes
+    std::function<void(const juce::String&)> onChangesApplied;
+
+private:
+    struct FileState
+    {
+        juce::int64 size = 0;
+        juce::int64 modified = 0;   // milliseconds since the epoch
+        juce::uint64 inode = 0;     // 0 where the platform has none
+    };
+
+    using Snapshot = std::unordered_map<std::string, FileState>;   // keyed by full path
+
+    struct Folder
+    {
+        juce::File root;
+        bool recursive = true;
+        Snapshot snapshot;
+        std::unordered_set<std::string> alreadyImported; // only consulted by the first scan
+        bool dirty = true;
+        bool watched = false;       // every directory has an inotify watch
+    };
+
+    struct FolderSettings
+    {
+        juce::File root;
+        bool recursive = true;
+        std::unordered_set<std::string> alreadyImported;
+    };
+
+    struct Delta
+    {
+        std::vector<Recording> added, changed;
+        std::vector<std::pair<juce::File, juce::File>> moved;
+        juce::Array<juce::File> removed;
+
+        bool isEmpty() const    { return added.empty() && changed.empty() && moved.empty() && removed.isEmpty(); }
+    };
+
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    void syncFolders();
+    void scan(Folder& folder);
+    bool waitForEvents(int timeoutMs);
+    bool addWatch(Folder& folder, const juce::File& directory);
+    void removeWatches(const Folder& folder);
+
+    void loadState();
+    void saveState();
+
+    static juce::uint64 getInode(const juce::File& file);
+
+    LibraryManager& library;
+    juce::File stateFile;
+
+    // Owned by the message thread, picked up by the scanner
+    mutable std::mutex settingsLock;
+    std::vector<FolderSettings> settings;
+    bool settingsChanged = false;
+
+    // Owned by the scanner thread
+    std::vector<std::unique_ptr<Folder>> folders;
+    juce::AudioFormatManager formatManager;
+    bool needsSave = false;
+
+    std::mutex deltaLock;
+    std::vector<Delta> pendingDeltas;
+
+    std::atomic<bool> rescanRequested { true };
+
+   #if JUCE_LINUX
+    int inotifyFd = -1;
+    std::unordered_map<int, std::vector<Folder*>> watchOwners;   // nested folders share a directory's watch
+   #endif
+
+    static constexpr int pollIntervalMs = 30000;
+    static constexpr int debounceMs = 1000;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WatchedFolders)
+};
\ No newline at end of file
@@ -0,0 +1,303 @@
+#include "WaveformTiles.h"
+
+namespace
+{
+    const juce::Colour extentColour(0xff1db954);
+    const juce::Colour levelColour(0xff6ee7a0);
+
+    void addColumn(juce::RectangleList<float>& extents, juce::RectangleList<float>& levels,
+                   float x, float centre, float halfHeight, const PeakPyramid::Range& range)
+    {
+        auto top = centre - range.max * halfHeight;
+        auto bottom = centre - range.min * halfHeight;
+        extents.addWithoutMerging({ x, top, 1.0f, juce::jmax(1.0f, bottom - top) });
+
+        auto rms = juce::jmin(range.rms, juce::jmax(range.max, -range.min)) * halfHeight;
+        levels.addWithoutMerging({ x, centre - rms, 1.0f, rms * 2.0f });
+    }
+}
+
+WaveformTiles::WaveformTiles(DecodedBlockCache& cache)
+    : juce::Thread("Waveform Renderer"),
+      blockCache(cache)
+{
+    startThread();
+}
+
+WaveformTiles::~WaveformTiles()
+{
+    cancelPendingUpdate();
+    stopThread(5000);
+}
+
+int WaveformTiles::getLevelFor(double samplesPerPixel) noexcept
+{
+    if (samplesPerPixel <= 0.0)
+        return minLevel;
+
+    return juce::jmax(minLevel, (int)std::floor(std::log2(samplesPerPixel) * stepsPerOctave + 1.0e-9));
+}
+
+//==============================================================================
+void WaveformTiles::setSource(const juce::File& audioFile, std::shared_ptr<const PeakPyramid> pyramid)
+{
+    {
+        std::lock_guard<std::mutex> sl(lock);
+
+        if (audioFile == file && pyramid == peaks)
+            return;
+
+        file = audioFile;
+        peaks = std::move(pyramid);
+        ++generation;
+        queue.clear();
+    }
+
+    tiles.clear();
+}
+
+void WaveformTiles::request(const std::vector<TileKey>& wanted, int height)
+{
+    if (height <= 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> sl(lock);
+
+        auto inFlightHeight = queueHeight;
+        queue.clear();
+        queueHeight = height;
+
+        for (auto key : wanted)
+        {
+            auto* image = tiles.find(key);
+
+            if ((image != nullptr && image->getHeight() == height) || tiles.hasFailed(key))
+                continue;
+
+            if (key == inFlight && inFlightHeight == height)
+                continue;
+
+            queue.push_back(key);
+        }
+
+        if (queue.empty())
+            return;
+    }
+
+    notify();
+}
+
+void WaveformTiles::handleAsyncUpdate()
+{
+    std::vector<Rendered> done;
+    juce::uint32 currentGeneration;
+
+    {
+        std::lock_guard<std::mutex> sl(lock);
+        done.swap(rendered);
+        currentGeneration = generation;
+    }
+
+    if (tiles.add(done, currentGeneration) && onTilesReady != nullptr)
+        onTilesReady();
+}
+
+//==============================================================================
+void WaveformTiles::run()
+{
+    while (!threadShouldExit())
+    {
+        TileKey key;
+        int height = 0;
+        juce::File audioFile;
+        std::shared_ptr<const PeakPyramid> pyramid;
+        juce::uint32 tileGeneration = 0;
+
+        {
+            std::lock_guard<std::mutex> sl(lock);
+
+            if (!queue.empty() && peaks != nullptr)
+            {
+                key = queue.front();
+                queue.pop_front();
+                inFlight = key;
+                height = queueHeight;
+                audioFile = file;
+                pyramid = peaks;
+                tileGeneration = generation;
+            }
+        }
+
+        if (pyramid == nullptr)
+        {
+            wait(-1);
+            continue;
+        }
+
+        // The file may have been rewritten since it was last opened
+        if (tileGeneration != sourceGeneration)
+        {
+            source = nullptr;
+            sourceFile = juce::File();
+            sourceGeneration = tileGeneration;
+        }
+
+        auto image = render(key, height, *pyramid, audioFile);
+
+        {
+            std::lock_guard<std::mutex> sl(lock);
+            inFlight = { std::numeric_limits<int>::min(), 0 };
+            rendered.push_back({ key, image, tileGeneration });
+        }
+
+        triggerAsyncUpdate();
+    }
+}
+
+juce::Image WaveformTiles::render(TileKey key, int height, const PeakPyramid& pyramid, const juce::File& audioFile)
+{
+    juce::Image image(juce::Image::ARGB, tileWidth, height, true, juce::SoftwareImageType());
+    juce::Graphics g(image);
+
+    if (getSamplesPerPixel(key.level) >= PeakPyramid::baseSamplesPerPeak
+         || !renderFromSamples(g, key, height, audioFile))
+        renderFromPeaks(g, key, height, pyramid);
+
+    return image;
+}
+
+void WaveformTiles::renderFromPeaks(juce::Graphics& g, TileKey key, int height, const PeakPyramid& pyramid)
+{
+    auto numChannels = pyramid.getNumChannels();
+    auto numSamples = pyramid.getNumSamples();
+    auto samplesPerPixel = getSamplesPerPixel(key.level);
+    auto laneHeight = (float)height / (float)numChannels;
+
+    juce::RectangleList<float> extents, levels;
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+        auto centre = laneHeight * ((float)c + 0.5f);
+
+        for (int x = 0; x < tileWidth; ++x)
+        {
+            auto start = (juce::int64)((double)(key.index * tileWidth + x) * samplesPerPixel);
+            auto end = juce::jmin(numSamples, (juce::int64)((double)(key.index * tileWidth + x + 1) * samplesPerPixel));
+
+            if (start >= numSamples)
+                break;
+
+            addColumn(extents, levels, (float)x, centre, laneHeight * 0.5f, pyramid.getRange(c, start, juce::jmax(start + 1, end)));
+        }
+    }
+
+    g.setColour(extentColour);
+    g.fillRectList(extents);
+
+    g.setColour(levelColour);
+    g.fillRectList(levels);
+}
+
+bool WaveformTiles::renderFromSamples(juce::Graphics& g, TileKey key, int height, const juce::File& audioFile)
+{
+    if (sourceFile != audioFile)
+    {
+        source = blockCache.open(audioFile);
+        sourceFile = audioFile;
+    }
+
+    if (source == nullptr)
+        return false;
+
+    auto numChannels = source->getNumChannels();
+    auto length = source->getLengthInSamples();
+    auto samplesPerPixel = getSamplesPerPixel(key.level);
+    auto tileStart = (double)(key.index * tileWidth) * samplesPerPixel;
+    auto laneHeight = (float)height / (float)numChannels;
+
+    // One sample either side, so lines carry on into the neighbouring tiles
+    auto first = (juce::int64)std::floor(tileStart) - 1;
+    auto numToRead = (int)std::ceil(tileWidth * samplesPerPixel) + 3;
+    auto last = juce::jmin(length, first + numToRead);
+
+    samples.setSize(numChannels, numToRead, false, false, true);
+
+    if (!source->read(samples, 0, numToRead, first))
+        return false;
+
+    if (samplesPerPixel >= 1.0)
+    {
+        juce::RectangleList<float> extents, levels;
+
+        for (int c = 0; c < numChannels; ++c)
+        {
+            auto* data = samples.getReadPointer(c);
+            auto centre = laneHeight * ((float)c + 0.5f);
+
+            for (int x = 0; x < tileWidth; ++x)
+            {
+                auto start = (juce::int64)((double)(key.index * tileWidth + x) * samplesPerPixel);
+                auto end = juce::jmin(last, juce::jmax(start + 1, (juce::int64)((double)(key.index * tileWidth + x + 1) * samplesPerPixel)));
+
+                if (start >= last)
+                    break;
+
+                PeakPyramid::Range range { data[start - first], data[start - first], 0.0f };
+                double sumOfSquares = 0.0;
+
+                for (auto n = start; n < end; ++n)
+                {
+                    auto sample = data[n - first];
+                    range.min = juce::jmin(range.min, sample);
+                    range.max = juce::jmax(range.max, sample);
+                    sumOfSquares += (double)sample * (double)sample;
+                }
+
+                range.rms = (float)std::sqrt(sumOfSquares / (double)(end - start));
+                addColumn(extents, levels, (float)x, centre, laneHeight * 0.5f, range);
+            }
+        }
+
+        g.setColour(extentColour);
+        g.fillRectList(extents);
+
+        g.setColour(levelColour);
+        g.fillRectList(levels);
+        return true;
+    }
+
+    // Fewer samples than pixels: join them up, and mark each one once they're far enough apart
+    auto markSamples = samplesPerPixel <= 1.0 / 6.0;
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+        auto* data = samples.getReadPointer(c);
+        auto centre = laneHeight * ((float)c + 0.5f);
+        auto halfHeight = laneHeight * 0.5f;
+        juce::Path line;
+        juce::RectangleList<float> marks;
+
+        for (auto n = juce::jmax((juce::int64)0, first); n < last; ++n)
+        {
+            auto x = (float)(((double)n - tileStart) / samplesPerPixel);
+            auto y = centre - data[n - first] * halfHeight;
+
+            if (n == juce::jmax((juce::int64)0, first))
+                line.startNewSubPath(x, y);
+            else
+                line.lineTo(x, y);
+
+            if (markSamples)
+                marks.addWithoutMerging({ x - 1.5f, y - 1.5f, 3.0f, 3.0f });
+        }
+
+        g.setColour(extentColour);
+        g.strokePath(line, juce::PathStrokeType(1.0f));
+
+        g.setColour(levelColour);
+        g.fillRectList(marks);
+    }
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PeakPyramid.h"
+#include "DecodedBlockCache.h"
+#include "TileCache.h"
+
+//==============================================================================
+/**
+    Pre-rendered images of one file's waveform, tileWidth pixels wide, at a
+    fixed set of zoom levels.
+
+    Level L shows 2^(L / stepsPerOctave) samples per pixel, from 16 pixels per
+    sample up to the whole file. Levels of baseSamplesPerPeak or more are
+    rendered from the peak pyramid; finer ones read decoded blocks, and below
+    one sample per pixel the samples themselves are drawn. Tiles are rendered
+    on a background thread, so the view only ever blits images, scaling them
+    slightly for zooms between levels.
+*/
+class WaveformTiles : private juce::Thread,
+                      private juce::AsyncUpdater
+{
+public:
+    explicit WaveformTiles(DecodedBlockCache& cache);
+    ~WaveformTiles() override;
+
+    static constexpr int tileWidth = 256;
+    static constexpr int stepsPerOctave = 4;
+    static constexpr int minLevel = -4 * stepsPerOctave;
+
+    static double getSamplesPerPixel(int level) noexcept       { return std::exp2((double)level / (double)stepsPerOctave); }
+
+    // The coarsest level showing at least as much detail as samplesPerPixel
+    static int getLevelFor(double samplesPerPixel) noexcept;
+
+    struct TileKey
+    {
+        int level = 0;
+        juce::int64 index = 0;
+
+        bool operator==(const TileKey& other) const noexcept    { return level == other.level && index == other.index; }
+        bool operator<(const TileKey& other) const noexcept     { return level != other.level ? level < other.level : index < other.index; }
+    };
+
+    //==============================================================================
+    // Message thread
+
+    // Drops every tile and starts over for another file
+    void setSource(const juce::File& file, std::shared_ptr<const PeakPyramid> peaks);
+
+    /** Returns the tile if one has been rendered, possibly at an older height;
+        otherwise an invalid image.
+    */
+    juce::Image getTile(TileKey key)                            { return tiles.get(key); }
+
+    // Replaces whatever was still waiting to be rendered, most wanted first
+    void request(const std::vector<TileKey>& tiles, int height);
+
+    // Called on the message thread whenever new tiles arrive
+    std::function<void()> onTilesReady;
+
+private:
+    using Rendered = TileCache<TileKey>::Result;
+
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    juce::Image render(TileKey key, int height, const PeakPyramid& pyramid, const juce::File& audioFile);
+    void renderFromPeaks(juce::Graphics& g, TileKey key, int height, const PeakPyramid& pyramid);
+    bool renderFromSamples(juce::Graphics& g, TileKey key, int height, const juce::File& audioFile);
+
+    DecodedBlockCache& blockCache;
+
+    // Message thread only
+    TileCache<TileKey> tiles { (size_t)64 << 20 };
+
+    // Shared with the renderer
+    std::mutex lock;
+    juce::File file;
+    std::shared_ptr<const PeakPyramid> peaks;
+    juce::uint32 generation = 0;
+    std::deque<TileKey> queue;
+    int queueHeight = 0;
+    TileKey inFlight { std::numeric_limits<int>::min(), 0 };
+    std::vector<Rendered> rendered;
+
+    // Renderer thread only
+    std::unique_ptr<DecodedBlockCache::Source> source;
+    juce::File sourceFile;
+    juce::uint32 sourceGeneration = 0;
+    juce::AudioBuffer<float> samples;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformTiles)
+};
\ No newline at end of file